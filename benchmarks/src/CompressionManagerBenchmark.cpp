@@ -0,0 +1,31 @@
+#include "CompressionManager.h"
+#include "Corpus.h"
+#include "VaultFormat.h"
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+	void BM_Compress(benchmark::State& state)
+	{
+		const auto data = CorpusGenerator::generate_data(VaultFormat::CHUNK_SIZE, static_cast<Content>(state.range(0)));
+		for (auto _ : state)
+			benchmark::DoNotOptimize(CompressionManager::compress(data));
+		state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * data.size()));
+	}
+
+	void BM_Uncompress(benchmark::State& state)
+	{
+		const auto data = CorpusGenerator::generate_data(VaultFormat::CHUNK_SIZE, static_cast<Content>(state.range(0)));
+		const auto compressed = CompressionManager::compress(data);
+		for (auto _ : state)
+			benchmark::DoNotOptimize(CompressionManager::uncompress(compressed, data.size()));
+		state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * data.size()));
+	}
+
+	constexpr std::int64_t INCOMPRESSIBLE = static_cast<std::int64_t>(Content::INCOMPRESSIBLE);
+	constexpr std::int64_t COMPRESSIBLE = static_cast<std::int64_t>(Content::COMPRESSIBLE);
+}
+
+BENCHMARK(BM_Compress)->ArgName("compressible")->Arg(INCOMPRESSIBLE)->Arg(COMPRESSIBLE);
+BENCHMARK(BM_Uncompress)->ArgName("compressible")->Arg(INCOMPRESSIBLE)->Arg(COMPRESSIBLE);
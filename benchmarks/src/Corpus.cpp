@@ -0,0 +1,141 @@
+#include "Corpus.h"
+
+#include <array>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+
+namespace
+{
+	constexpr std::array WORDS = {"vault ", "block ", "index ", "chunk ", "nonce ", "trailer ", "header ", "directory\n"};
+
+	std::string corpus_name(const CorpusKind kind)
+	{
+		switch (kind)
+		{
+		case CorpusKind::TINY_FILES:
+			return "tiny_files";
+		case CorpusKind::HUGE_RANDOM_FILES:
+			return "huge_random_files";
+		case CorpusKind::HUGE_TEXT_FILES:
+			return "huge_text_files";
+		case CorpusKind::DEEP_TREE:
+			break;
+		}
+		return "deep_tree";
+	}
+}
+
+std::filesystem::path CorpusGenerator::root()
+{
+	return std::filesystem::temp_directory_path() / "vault_bench";
+}
+
+const Corpus& CorpusGenerator::get(const CorpusKind kind)
+{
+	// Corpora are generated once and reused by the next runs, a marker next to them records that they are complete.
+	static std::mutex mutex;
+	static std::map<CorpusKind, Corpus> corpora;
+	std::lock_guard lock(mutex);
+	if (const auto it = corpora.find(kind); it != corpora.end())
+		return it->second;
+
+	const auto path = root() / corpus_name(kind) / corpus_name(kind);
+	auto marker = path;
+	marker += ".done";
+	Corpus corpus{corpus_name(kind), path};
+	if (std::ifstream stream(marker.string()); stream >> corpus.files >> corpus.bytes)
+		return corpora[kind] = corpus;
+
+	std::filesystem::remove_all(path.parent_path());
+	std::filesystem::create_directories(path);
+	corpus = generate(kind, path);
+	std::ofstream stream(marker.string());
+	stream << corpus.files << ' ' << corpus.bytes << std::endl;
+	if (!stream)
+		throw std::ios_base::failure("Failed to write the file: " + marker.string());
+	return corpora[kind] = corpus;
+}
+
+CompressionManager::Data CorpusGenerator::generate_data(const std::uint64_t size, const Content content, const std::uint64_t seed)
+{
+	// The generator is seeded so every run, and every commit, measures the same bytes.
+	std::mt19937_64 generator(seed);
+	CompressionManager::Data data;
+	data.reserve(size);
+	if (content == Content::INCOMPRESSIBLE)
+	{
+		while (data.size() < size)
+		{
+			const auto value = generator();
+			for (size_t i = 0; i < sizeof(value) && data.size() < size; ++i)
+				data.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+		}
+		return data;
+	}
+	while (data.size() < size)
+	{
+		const std::string_view word = WORDS[generator() % WORDS.size()];
+		for (size_t i = 0; i < word.size() && data.size() < size; ++i)
+			data.push_back(static_cast<std::uint8_t>(word[i]));
+	}
+	return data;
+}
+
+void CorpusGenerator::write_file(const std::filesystem::path& path, const std::uint64_t size, const Content content, const std::uint64_t seed)
+{
+	std::ofstream stream(path.string(), std::ios::binary);
+	if (!stream.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + path.string());
+	constexpr std::uint64_t CHUNK_SIZE = 16 * 1024 * 1024;
+	for (std::uint64_t written = 0; written < size; written += CHUNK_SIZE)
+	{
+		const auto data = generate_data(std::min(CHUNK_SIZE, size - written), content, seed + written);
+		stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	}
+	if (!stream)
+		throw std::ios_base::failure("Failed to write the file: " + path.string());
+}
+
+Corpus CorpusGenerator::generate(const CorpusKind kind, const std::filesystem::path& path)
+{
+	Corpus corpus{corpus_name(kind), path};
+	const auto add_file = [&corpus](const std::filesystem::path& file, const std::uint64_t size, const Content content)
+	{
+		write_file(file, size, content, corpus.files);
+		++corpus.files;
+		corpus.bytes += size;
+	};
+	switch (kind)
+	{
+	case CorpusKind::TINY_FILES:
+		for (std::uint64_t i = 0; i < TINY_FILES; ++i)
+		{
+			const auto directory = path / std::to_string(i / 1000);
+			if (i % 1000 == 0)
+				std::filesystem::create_directory(directory);
+			add_file(directory / (std::to_string(i) + ".txt"), TINY_FILE_SIZE, Content::COMPRESSIBLE);
+		}
+		break;
+	case CorpusKind::HUGE_RANDOM_FILES:
+	case CorpusKind::HUGE_TEXT_FILES:
+		for (std::uint64_t i = 0; i < HUGE_FILES; ++i)
+			add_file(path / ("huge" + std::to_string(i) + ".bin"), HUGE_FILE_SIZE, kind == CorpusKind::HUGE_TEXT_FILES ? Content::COMPRESSIBLE : Content::INCOMPRESSIBLE);
+		break;
+	case CorpusKind::DEEP_TREE:
+	{
+		auto directory = path;
+		for (std::uint64_t depth = 0; depth < TREE_DEPTH; ++depth)
+		{
+			for (std::uint64_t i = 0; i < TREE_FILES_PER_LEVEL; ++i)
+				add_file(directory / (std::to_string(i) + ".txt"), TREE_FILE_SIZE, i % 2 ? Content::COMPRESSIBLE : Content::INCOMPRESSIBLE);
+			directory /= "d";
+			std::filesystem::create_directory(directory);
+		}
+		break;
+	}
+	}
+	return corpus;
+}
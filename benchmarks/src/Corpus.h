@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "CompressionManager.h"
+
+enum class CorpusKind
+{
+	TINY_FILES,
+	HUGE_RANDOM_FILES,
+	HUGE_TEXT_FILES,
+	DEEP_TREE
+};
+
+enum class Content
+{
+	INCOMPRESSIBLE,
+	COMPRESSIBLE
+};
+
+struct Corpus
+{
+	std::string name;
+	std::filesystem::path path;
+	std::uint64_t files = 0;
+	std::uint64_t bytes = 0;
+};
+
+class CorpusGenerator
+{
+public:
+	static constexpr std::uint64_t TINY_FILES = 1000000;
+	static constexpr std::uint64_t TINY_FILE_SIZE = 100;
+	static constexpr std::uint64_t HUGE_FILES = 4;
+	static constexpr std::uint64_t HUGE_FILE_SIZE = 256 * 1024 * 1024;
+	static constexpr std::uint64_t TREE_DEPTH = 256;
+	static constexpr std::uint64_t TREE_FILES_PER_LEVEL = 16;
+	static constexpr std::uint64_t TREE_FILE_SIZE = 4096;
+
+	CorpusGenerator() = delete;
+
+	[[nodiscard]] static std::filesystem::path root();
+	[[nodiscard]] static const Corpus& get(CorpusKind kind);
+	[[nodiscard]] static CompressionManager::Data generate_data(std::uint64_t size, Content content, std::uint64_t seed = 0);
+
+private:
+	static void write_file(const std::filesystem::path& path, std::uint64_t size, Content content, std::uint64_t seed);
+	[[nodiscard]] static Corpus generate(CorpusKind kind, const std::filesystem::path& path);
+};
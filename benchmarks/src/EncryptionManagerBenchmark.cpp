@@ -0,0 +1,46 @@
+#include "Corpus.h"
+#include "EncryptionManager.h"
+#include "VaultFormat.h"
+
+#include <benchmark/benchmark.h>
+
+namespace
+{
+	void BM_Encrypt(benchmark::State& state)
+	{
+		const auto cipher = static_cast<Cipher>(state.range(0));
+		const auto key = EncryptionManager::generate_key();
+		const auto data = CorpusGenerator::generate_data(VaultFormat::CHUNK_SIZE, Content::INCOMPRESSIBLE);
+		state.SetLabel(std::string(EncryptionManager::cipher_name(cipher)));
+		for (auto _ : state)
+			benchmark::DoNotOptimize(EncryptionManager::encrypt(data, key, {}, cipher));
+		state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * data.size()));
+	}
+
+	void BM_Decrypt(benchmark::State& state)
+	{
+		const auto cipher = static_cast<Cipher>(state.range(0));
+		const auto key = EncryptionManager::generate_key();
+		const auto data = CorpusGenerator::generate_data(VaultFormat::CHUNK_SIZE, Content::INCOMPRESSIBLE);
+		const auto [encrypted, nonce] = EncryptionManager::encrypt(data, key, {}, cipher);
+		state.SetLabel(std::string(EncryptionManager::cipher_name(cipher)));
+		for (auto _ : state)
+			benchmark::DoNotOptimize(EncryptionManager::decrypt(encrypted, key, nonce, {}, cipher));
+		state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * data.size()));
+	}
+
+	void BM_DeriveKey(benchmark::State& state)
+	{
+		const EncryptionManager::Password password = "password";
+		const auto salt = EncryptionManager::generate_new_salt();
+		for (auto _ : state)
+			benchmark::DoNotOptimize(EncryptionManager::derive_key(password, salt, KdfParameters()));
+	}
+
+	constexpr std::int64_t CHACHA20_POLY1305 = static_cast<std::int64_t>(Cipher::CHACHA20_POLY1305);
+	constexpr std::int64_t AES_256_GCM = static_cast<std::int64_t>(Cipher::AES_256_GCM);
+}
+
+BENCHMARK(BM_Encrypt)->ArgName("cipher")->Arg(CHACHA20_POLY1305)->Arg(AES_256_GCM);
+BENCHMARK(BM_Decrypt)->ArgName("cipher")->Arg(CHACHA20_POLY1305)->Arg(AES_256_GCM);
+BENCHMARK(BM_DeriveKey)->Unit(benchmark::kMillisecond);
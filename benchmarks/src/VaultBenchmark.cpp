@@ -0,0 +1,130 @@
+#include "Corpus.h"
+#include "Vault.h"
+
+#include <benchmark/benchmark.h>
+
+// Measures each phase of closing and opening a vault on its own, through the private steps of Vault.
+class VaultBenchmark
+{
+public:
+	VaultBenchmark() = delete;
+
+	static void read_from_dir(Vault& vault)
+	{
+		vault.read_from_dir();
+	}
+
+	static void write_to_file(Vault& vault, const std::filesystem::path& source, const std::filesystem::path& destination, const bool compress)
+	{
+		vault.m_file = std::filesystem::directory_entry(destination);
+		vault.write_to_file(source, compress, false, KdfParameters(), Cipher::CHACHA20_POLY1305, {}, std::nullopt);
+	}
+
+	static void read_from_file(Vault& vault)
+	{
+		vault.read_from_file();
+	}
+
+	static void write_to_dir(Vault& vault, const std::filesystem::path& destination)
+	{
+		vault.m_file = std::filesystem::directory_entry(destination / vault.m_name);
+		vault.write_to_dir();
+	}
+
+	static std::filesystem::path closed_vault(const Corpus& corpus)
+	{
+		const auto path = corpus.path.parent_path() / (corpus.name + ".vlt");
+		if (!exists(path))
+		{
+			Vault vault(corpus.path);
+			read_from_dir(vault);
+			write_to_file(vault, corpus.path, path, false);
+		}
+		return path;
+	}
+};
+
+namespace
+{
+	const Corpus& corpus(benchmark::State& state)
+	{
+		const auto& corpus = CorpusGenerator::get(static_cast<CorpusKind>(state.range(0)));
+		state.SetLabel(corpus.name);
+		return corpus;
+	}
+
+	void report(benchmark::State& state, const Corpus& corpus)
+	{
+		state.SetBytesProcessed(static_cast<std::int64_t>(state.iterations() * corpus.bytes));
+		state.counters["files"] = benchmark::Counter(static_cast<double>(corpus.files), benchmark::Counter::kIsIterationInvariantRate);
+	}
+
+	void BM_ReadFromDir(benchmark::State& state)
+	{
+		const auto& source = corpus(state);
+		for (auto _ : state)
+		{
+			Vault vault(source.path);
+			VaultBenchmark::read_from_dir(vault);
+		}
+		report(state, source);
+	}
+
+	void BM_WriteToFile(benchmark::State& state)
+	{
+		const auto& source = corpus(state);
+		const auto destination = source.path.parent_path() / "output.vlt";
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			std::filesystem::remove(destination);
+			Vault vault(source.path);
+			VaultBenchmark::read_from_dir(vault);
+			state.ResumeTiming();
+			VaultBenchmark::write_to_file(vault, source.path, destination, state.range(1) != 0);
+		}
+		std::filesystem::remove(destination);
+		report(state, source);
+	}
+
+	void BM_ReadFromFile(benchmark::State& state)
+	{
+		const auto& source = corpus(state);
+		const auto path = VaultBenchmark::closed_vault(source);
+		for (auto _ : state)
+		{
+			Vault vault(path);
+			VaultBenchmark::read_from_file(vault);
+		}
+		report(state, source);
+	}
+
+	void BM_DirectoryCreate(benchmark::State& state)
+	{
+		const auto& source = corpus(state);
+		const auto path = VaultBenchmark::closed_vault(source);
+		const auto destination = source.path.parent_path() / "output";
+		for (auto _ : state)
+		{
+			state.PauseTiming();
+			std::filesystem::remove_all(destination);
+			std::filesystem::create_directory(destination);
+			Vault vault(path);
+			VaultBenchmark::read_from_file(vault);
+			state.ResumeTiming();
+			VaultBenchmark::write_to_dir(vault, destination);
+		}
+		std::filesystem::remove_all(destination);
+		report(state, source);
+	}
+
+	constexpr std::int64_t TINY_FILES = static_cast<std::int64_t>(CorpusKind::TINY_FILES);
+	constexpr std::int64_t HUGE_RANDOM_FILES = static_cast<std::int64_t>(CorpusKind::HUGE_RANDOM_FILES);
+	constexpr std::int64_t HUGE_TEXT_FILES = static_cast<std::int64_t>(CorpusKind::HUGE_TEXT_FILES);
+	constexpr std::int64_t DEEP_TREE = static_cast<std::int64_t>(CorpusKind::DEEP_TREE);
+}
+
+BENCHMARK(BM_ReadFromDir)->ArgName("corpus")->Arg(TINY_FILES)->Arg(HUGE_RANDOM_FILES)->Arg(DEEP_TREE)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_WriteToFile)->ArgNames({"corpus", "compress"})->ArgsProduct({{TINY_FILES, HUGE_RANDOM_FILES, HUGE_TEXT_FILES, DEEP_TREE}, {0, 1}})->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ReadFromFile)->ArgName("corpus")->Arg(TINY_FILES)->Arg(HUGE_RANDOM_FILES)->Arg(DEEP_TREE)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DirectoryCreate)->ArgName("corpus")->Arg(TINY_FILES)->Arg(HUGE_RANDOM_FILES)->Arg(DEEP_TREE)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -17,7 +17,11 @@ private:
 	CLI::App m_parser;
 	std::unique_ptr<VaultManager> m_vaultManager;
 	std::span<const char*> m_args;
+	std::optional<std::uint64_t> m_maxMemory;
+	bool m_stats = false;
+	std::optional<std::filesystem::path> m_trace;
 
 	void set_args_parsing();
+	void report_profile() const;
 	static void print_version();
 };
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+
+enum class Durability
+{
+	// Nothing is synced, the data reaches the disk when the system flushes it.
+	NONE,
+	// The data of the files written is synced before they are published.
+	DATA,
+	// The directories they are published in are synced too, so the new names survive a crash.
+	FULL
+};
+
+// A file written anonymously with O_TMPFILE, or under a hidden temporary name where that isn't supported,
+// and only published at its path by commit, so a crash or an error never leaves a partial file there.
+class AtomicFile
+{
+public:
+	AtomicFile(std::filesystem::path path, Durability durability);
+	// Writes under the given partial name instead, which is resumed after the offset if it isn't 0, and can be kept on failure.
+	AtomicFile(std::filesystem::path path, Durability durability, std::filesystem::path partial, std::uint64_t offset);
+	~AtomicFile();
+	AtomicFile(const AtomicFile&) = delete;
+	AtomicFile(AtomicFile&&) = delete;
+
+	[[nodiscard]] std::ostream& stream();
+	// Makes what was written so far durable, without publishing it.
+	void flush();
+	void commit();
+	// Publishes the file over the existing one at its path, which readers see whole before or after.
+	void replace();
+	void keep();
+
+	static void sync(const std::filesystem::path& path);
+	static void sync_file_system(const std::filesystem::path& path);
+
+private:
+	std::filesystem::path m_path;
+	Durability m_durability;
+	int m_descriptor;
+	std::filesystem::path m_temp;
+	std::ofstream m_stream;
+	bool m_committed;
+	bool m_kept;
+
+	void close();
+};
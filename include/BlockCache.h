@@ -0,0 +1,34 @@
+#pragma once
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <botan/secmem.h>
+
+class BlockCache
+{
+public:
+	using Data = Botan::secure_vector<std::uint8_t>;
+
+	explicit BlockCache(size_t capacity);
+	BlockCache(const BlockCache&) = delete;
+	BlockCache(BlockCache&&) = delete;
+
+	[[nodiscard]] std::shared_ptr<const Data> get(std::uint64_t key, const std::function<Data()>& load);
+
+	[[nodiscard]] size_t size() const;
+	[[nodiscard]] size_t capacity() const;
+
+private:
+	using Entry = std::pair<std::uint64_t, std::shared_ptr<const Data>>;
+
+	size_t m_capacity;
+	size_t m_size;
+	std::list<Entry> m_entries;
+	std::unordered_map<std::uint64_t, std::list<Entry>::iterator> m_index;
+	mutable std::mutex m_mutex;
+
+	void evict();
+};
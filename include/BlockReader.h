@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <optional>
+
+#include "Checkpoint.h"
+#include "MappedFile.h"
+#include "MerkleTree.h"
+#include "ProgressObserver.h"
+#include "VaultFormat.h"
+
+class BlockReader
+{
+public:
+	using Data = Botan::secure_vector<std::uint8_t>;
+
+	explicit BlockReader(const std::filesystem::path& path);
+
+	[[nodiscard]] static bool is_vault_file(const std::filesystem::path& path);
+	// Parses the XML header of a vault, the key slots following it are only flagged.
+	[[nodiscard]] static VaultHeader parse_header(std::span<const std::uint8_t> header);
+	// Parses the trailer of a vault, which is authenticated with the header when the vault is encrypted.
+	[[nodiscard]] static VaultTrailer parse_trailer(std::span<const std::uint8_t> trailer, const VaultHeader& header, std::span<const std::uint8_t> headerBytes, const std::optional<EncryptionManager::Key>& key);
+	// Decrypts and uncompresses a block as stored in a vault with the header.
+	[[nodiscard]] static Data decode(std::span<const std::uint8_t> stored, std::uint64_t size, const VaultHeader& header, const std::optional<EncryptionManager::Key>& key);
+
+	[[nodiscard]] const VaultHeader& header() const;
+	// The header as written, authenticated along with the trailer.
+	[[nodiscard]] std::span<const std::uint8_t> header_bytes() const;
+	[[nodiscard]] const std::optional<EncryptionManager::Key>& key() const;
+	// The length of the vault read, which ends before an append in progress or interrupted.
+	[[nodiscard]] std::uint64_t size() const;
+	[[nodiscard]] std::uint64_t key_slots_offset() const;
+	// Where the blocks start, after the header and the key slots.
+	[[nodiscard]] std::uint64_t data_offset() const;
+	[[nodiscard]] const BlockInfo& index() const;
+	[[nodiscard]] const std::vector<VolumeInfo>& volumes() const;
+	// The tree of the blocks, to append others to the vault.
+	[[nodiscard]] MerkleTree tree() const;
+	[[nodiscard]] std::filesystem::path volume_path(const VolumeInfo& volume) const;
+	[[nodiscard]] size_t mapped_volumes() const;
+	void set_key(EncryptionManager::Key key);
+	void set_progress(ProgressTracker* progress);
+	void report_entry() const;
+	void report_hole(std::uint64_t size) const;
+	void set_checkpoint(Checkpoint* checkpoint);
+	void checkpoint(const std::filesystem::path& path, const Checkpoint::Entry& entry) const;
+
+	[[nodiscard]] Data read(const BlockInfo& block) const;
+	[[nodiscard]] Data read_index() const;
+	// The block as stored, checked but not decoded, to copy it into a vault with the same header and key.
+	[[nodiscard]] Data stored(const BlockInfo& block) const;
+
+private:
+	MappedFile m_file;
+	std::uint64_t m_size;
+	std::filesystem::path m_directory;
+	VaultHeader m_header;
+	std::span<const std::uint8_t> m_headerBytes;
+	std::span<const std::uint8_t> m_trailer;
+	BlockInfo m_index;
+	std::uint64_t m_leaves;
+	std::span<const std::uint8_t> m_tree;
+	std::vector<std::uint8_t> m_root;
+	bool m_authenticated;
+	std::optional<EncryptionManager::Key> m_key;
+	ProgressTracker* m_progress;
+	Checkpoint* m_checkpoint;
+	std::vector<VolumeInfo> m_volumes;
+	mutable std::vector<std::unique_ptr<MappedFile>> m_volumeFiles;
+	mutable std::mutex m_volumeMutex;
+
+	void read_header();
+	void read_tail();
+	void load_trailer();
+	[[nodiscard]] const MappedFile& volume(std::uint64_t number) const;
+	[[nodiscard]] std::span<const std::uint8_t> checked(const MappedFile& file, const BlockInfo& block) const;
+	[[nodiscard]] Data load(const BlockInfo& block) const;
+};
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <istream>
+#include <memory>
+#include <optional>
+
+#include "Checkpoint.h"
+#include "MerkleTree.h"
+#include "ProgressObserver.h"
+#include "ThreadPool.h"
+#include "VaultFormat.h"
+#include "VolumeWriter.h"
+
+class BlockWriter
+{
+public:
+	using Data = Botan::secure_vector<std::uint8_t>;
+
+	struct Entry
+	{
+		std::uint64_t size = 0;
+		std::string checksum;
+		std::vector<BlockInfo> blocks;
+	};
+
+	// An unallocated range of a sparse file.
+	struct Hole
+	{
+		std::uint64_t offset;
+		std::uint64_t length;
+	};
+
+	BlockWriter(std::ostream& stream, VaultHeader header, std::optional<EncryptionManager::Key> key = std::nullopt, size_t threads = 1);
+	// Resumes a vault whose header and first blocks were written before the offset of the checkpoint, the stream is positioned there.
+	BlockWriter(std::ostream& stream, VaultHeader header, std::vector<std::uint8_t> headerBytes, std::optional<EncryptionManager::Key> key, size_t threads, Checkpoint& checkpoint);
+	// Appends to a vault ending at the offset, the stream is positioned there. The blocks are added to its tree, the index,
+	// the tree and the trailer written last supersede the previous ones.
+	BlockWriter(std::ostream& stream, VaultHeader header, std::vector<std::uint8_t> headerBytes, std::optional<EncryptionManager::Key> key, size_t threads, std::uint64_t offset, MerkleTree tree);
+	~BlockWriter();
+	BlockWriter(const BlockWriter&) = delete;
+	BlockWriter(BlockWriter&&) = delete;
+
+	[[nodiscard]] const VaultHeader& header() const;
+	void set_progress(ProgressTracker* progress);
+	void set_volumes(const std::filesystem::path& vault, std::uint64_t volumeSize);
+	// The directory the files are stored from, the entries of a framed vault name them relative to it.
+	void set_source(const std::filesystem::path& source);
+	// Names the file whose blocks are written next, in the entry framed before the first of them.
+	void begin_entry(const std::filesystem::path& path);
+	void report_entry();
+	// The entries recorded in the checkpoint of an encrypted vault are sealed with its key.
+	void set_checkpoint(Checkpoint* checkpoint);
+	// The entry of a file stored before an interrupted close, if it hasn't changed since.
+	[[nodiscard]] std::optional<Entry> resumed(const std::filesystem::path& path, std::filesystem::file_time_type lastWriteTime);
+	void checkpoint(const std::filesystem::path& path, std::filesystem::file_time_type lastWriteTime, const Entry& entry);
+
+	[[nodiscard]] BlockInfo write(Data data);
+	[[nodiscard]] Entry write(std::istream& stream, const std::vector<Hole>& holes = {});
+	// Writes a block of a vault with the same header and key as it is stored, without decoding it.
+	[[nodiscard]] BlockInfo copy(const BlockInfo& block, Data stored);
+	void finish(Data index);
+
+private:
+	struct EncodedBlock
+	{
+		std::uint64_t size;
+		Data stored;
+		std::string checksum;
+	};
+
+	std::ostream& m_stream;
+	VaultHeader m_header;
+	std::optional<EncryptionManager::Key> m_key;
+	std::uint64_t m_offset;
+	std::vector<std::uint8_t> m_headerBytes;
+	MerkleTree m_tree;
+	std::unique_ptr<ThreadPool> m_pool;
+	ProgressTracker* m_progress;
+	Checkpoint* m_checkpoint;
+	std::filesystem::path m_vault;
+	std::uint64_t m_volumeSize;
+	std::vector<std::unique_ptr<VolumeWriter>> m_volumes;
+	std::filesystem::path m_source;
+	std::optional<std::string> m_entry;
+	bool m_finished;
+
+	void write_header();
+	void open_volume();
+	void write_trailer(const BlockInfo& index, std::uint64_t treeOffset);
+	void write_raw(std::span<const std::uint8_t> data);
+	void write_frame(FrameType type, std::uint64_t length, std::uint64_t size);
+	[[nodiscard]] BlockInfo append(EncodedBlock block);
+	[[nodiscard]] EncodedBlock encode(Data data) const;
+};
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+#include <pugixml.hpp>
+
+#include "AtomicFile.h"
+#include "VaultFormat.h"
+
+// The journal of a close or an open in progress, kept next to its partial output so that an interrupted one can be resumed.
+// The entries are recorded as they are written, and committed every INTERVAL bytes once the output is synced,
+// so only the committed ones are trusted when resuming. The entries of an encrypted vault are sealed with its data key,
+// so that the journal left after a failure doesn't reveal the index the vault encrypts.
+class Checkpoint
+{
+public:
+	static constexpr std::uint64_t INTERVAL = 256ull * 1024 * 1024;
+
+	struct Entry
+	{
+		std::uint64_t size = 0;
+		std::filesystem::file_time_type lastWriteTime;
+		std::string checksum;
+		std::vector<BlockInfo> blocks;
+	};
+
+	// Starts a new journal, or reads the committed entries of the existing one when resuming the same origin.
+	Checkpoint(std::filesystem::path journal, std::filesystem::path root, const std::filesystem::path& origin, bool resume, Durability durability);
+	Checkpoint(const Checkpoint&) = delete;
+	Checkpoint(Checkpoint&&) = delete;
+
+	// The hidden names of the partial output and of its journal, next to the output.
+	[[nodiscard]] static std::filesystem::path partial_path(const std::filesystem::path& output);
+	[[nodiscard]] static std::filesystem::path journal_path(const std::filesystem::path& output);
+
+	[[nodiscard]] bool resumed() const;
+	[[nodiscard]] std::uint64_t offset() const;
+	// Every block committed, in the order they were written, including those of entries recorded again since.
+	[[nodiscard]] const std::vector<BlockInfo>& blocks() const;
+	[[nodiscard]] const Entry* find(const std::filesystem::path& path) const;
+
+	// Seals the entries recorded from now on, and opens the committed ones read sealed, which are not found before.
+	void seal(const EncryptionManager::Key& key, Cipher cipher);
+	// Called before committing, to sync the output up to the offset of the last entry recorded.
+	void set_sync(std::function<void()> sync);
+	// Records an entry written, the output ends at the offset after it, and commits once INTERVAL bytes were recorded.
+	void record(const std::filesystem::path& path, const Entry& entry, std::uint64_t offset = 0);
+	void commit();
+	// Commits what was written before a failure, and tells whether there is anything to resume from.
+	[[nodiscard]] bool keep();
+	void remove();
+
+private:
+	std::filesystem::path m_journal;
+	std::filesystem::path m_root;
+	std::string m_origin;
+	Durability m_durability;
+	std::optional<EncryptionManager::Key> m_key;
+	Cipher m_cipher;
+	std::vector<std::string> m_sealed;
+	std::ofstream m_stream;
+	std::function<void()> m_sync;
+	std::map<std::string, Entry> m_entries;
+	std::vector<BlockInfo> m_blocks;
+	std::uint64_t m_offset;
+	std::uint64_t m_pendingOffset;
+	std::uint64_t m_pendingBytes;
+	bool m_pending;
+	bool m_resumed;
+	bool m_committed;
+	mutable std::mutex m_mutex;
+
+	[[nodiscard]] std::uint64_t load();
+	void add(const pugi::xml_node& node);
+	[[nodiscard]] std::span<const std::uint8_t> associated_data() const;
+	[[nodiscard]] std::string relative(const std::filesystem::path& path) const;
+	void write_line(const pugi::xml_node& node);
+	void commit_locked();
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+#include <span>
+#include <string>
+#include <botan/secmem.h>
+
+namespace Botan
+{
+	class HashFunction;
+}
+
+class ChecksumManager
+{
+public:
+	using Data = Botan::secure_vector<std::uint8_t>;
+
+	static constexpr auto ALGORITHM = "BLAKE2b(256)";
+
+	class Stream
+	{
+	public:
+		explicit Stream(const std::string& algorithm = ALGORITHM);
+		~Stream();
+
+		void update(std::span<const std::uint8_t> data);
+		[[nodiscard]] std::string final();
+
+	private:
+		std::unique_ptr<Botan::HashFunction> m_hash;
+	};
+
+	ChecksumManager() = delete;
+
+	[[nodiscard]] static std::string compute(std::span<const std::uint8_t>, const std::string& algorithm = ALGORITHM);
+	[[nodiscard]] static bool matches(std::span<const std::uint8_t>, const std::string& checksum, const std::string& algorithm = ALGORITHM);
+};
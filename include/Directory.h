@@ -10,10 +10,12 @@ public:
 
 	[[nodiscard]] std::vector<std::unique_ptr<Node>>& children();
 	[[nodiscard]] const std::vector<std::unique_ptr<Node>>& children() const;
+	[[nodiscard]] const Node* find(const std::filesystem::path& path) const;
 
 protected:
 	std::vector<std::unique_ptr<Node>> m_children;
 
 	void write_content(pugi::xml_node& parentNode) const override;
-	void create(const std::filesystem::path& parentPath) const override;
+	void store(BlockWriter& writer, const std::filesystem::path& parentPath) override;
+	void create(const std::filesystem::path& parentPath, ThreadPool* pool) const override;
 };
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
+
+// Reports the entries changed below a directory, with inotify watches on it and on each of its subdirectories, added as they appear.
+// A burst of changes is reported once it stays quiet for the delay, or every few delays while it goes on.
+class DirectoryWatcher
+{
+public:
+	static constexpr std::chrono::milliseconds DEFAULT_DELAY{1000};
+	static constexpr int MAX_DELAYS = 5;
+
+	explicit DirectoryWatcher(std::filesystem::path root, std::chrono::milliseconds delay = DEFAULT_DELAY);
+	~DirectoryWatcher();
+	DirectoryWatcher(const DirectoryWatcher&) = delete;
+	DirectoryWatcher(DirectoryWatcher&&) = delete;
+
+	// Waits up to the timeout for a change, then for the burst to end, and returns the paths changed relative to the root, without
+	// those below another one. The root itself is returned when events were lost. A signal ends the wait with the changes seen so far.
+	[[nodiscard]] std::vector<std::filesystem::path> wait(std::chrono::milliseconds timeout);
+	// Reports the changes until SIGINT or SIGTERM is received.
+	void run(const std::function<void(const std::vector<std::filesystem::path>&)>& changed);
+
+	[[nodiscard]] static bool is_supported();
+
+private:
+	std::filesystem::path m_root;
+	std::chrono::milliseconds m_delay;
+	int m_fd;
+	std::map<int, std::filesystem::path> m_watches;
+
+	void watch(const std::filesystem::path& directory);
+	void unwatch(const std::filesystem::path& directory);
+	// Adds the paths of the events read before the timeout, tells whether there were any.
+	bool read_events(std::chrono::milliseconds timeout, std::set<std::filesystem::path>& changed);
+};
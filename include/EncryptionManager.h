@@ -1,10 +1,34 @@
 #pragma once
 
+#include <chrono>
+#include <optional>
+#include <span>
 #include <string>
 #include <array>
 #include <vector>
 #include <botan/secmem.h>
 
+struct KdfParameters
+{
+	std::uint32_t memory = 64 * 1024;
+	std::uint32_t iterations = 3;
+	std::uint32_t lanes = 4;
+
+	auto operator<=>(const KdfParameters&) const = default;
+};
+
+enum class Cipher
+{
+	CHACHA20_POLY1305,
+	AES_256_GCM
+};
+
+struct KdfCalibration
+{
+	KdfParameters parameters;
+	std::chrono::milliseconds duration;
+};
+
 class EncryptionManager
 {
 public:
@@ -14,12 +38,31 @@ public:
 	using Data = Botan::secure_vector<std::uint8_t>;
 	using Password = std::basic_string<char, std::char_traits<char>, Botan::secure_allocator<char>>;
 
+	static constexpr size_t NONCE_SIZE = 24;
+	static constexpr size_t TAG_SIZE = 16;
+	static constexpr std::array CIPHERS = {Cipher::AES_256_GCM, Cipher::CHACHA20_POLY1305};
+	static constexpr auto KDF_ALGORITHM = "Argon2id";
+	static constexpr std::uint32_t MAX_KDF_MEMORY = 4 * 1024 * 1024;
+	static constexpr std::uint32_t MAX_KDF_ITERATIONS = 1000;
+	static constexpr std::uint32_t MAX_KDF_LANES = 64;
+
 	EncryptionManager() = delete;
 
 	[[nodiscard]] static std::pair<Data, Nonce> encrypt(Data, const Password&, const Salt&);
+	[[nodiscard]] static std::pair<Data, Nonce> encrypt(Data, const Key&, std::span<const std::uint8_t> associatedData = {}, Cipher cipher = Cipher::CHACHA20_POLY1305);
 	[[nodiscard]] static Data decrypt(Data, const Password&, const Salt&, const Nonce&);
+	[[nodiscard]] static Data decrypt(Data, const Key&, const Nonce&, std::span<const std::uint8_t> associatedData = {}, Cipher cipher = Cipher::CHACHA20_POLY1305);
 	[[nodiscard]] static Salt generate_new_salt();
-
-private:
-	[[nodiscard]] static Key derive_key(const Password&, const Salt&);
+	[[nodiscard]] static Key generate_key();
+	[[nodiscard]] static Key derive_key(const Password&, const Salt&, const KdfParameters&);
+	[[nodiscard]] static KdfParameters legacy_kdf_parameters();
+	static void validate(const KdfParameters&);
+	[[nodiscard]] static std::chrono::milliseconds benchmark(const KdfParameters&);
+	[[nodiscard]] static std::string_view cipher_name(Cipher cipher);
+	[[nodiscard]] static std::optional<Cipher> find_cipher(std::string_view name);
+	[[nodiscard]] static size_t nonce_size(Cipher cipher);
+	[[nodiscard]] static bool has_hardware_aes();
+	[[nodiscard]] static Cipher preferred_cipher();
+	[[nodiscard]] static double measure_throughput(Cipher cipher, std::chrono::milliseconds duration);
+	[[nodiscard]] static KdfCalibration calibrate(std::chrono::milliseconds target, std::uint32_t maxMemory = MAX_KDF_MEMORY);
 };
@@ -1,20 +1,61 @@
 #pragma once
 
 #include "Node.h"
+#include "VaultFormat.h"
+#include <functional>
+#include <map>
+#include <memory>
+#include <span>
 #include <vector>
 
+class BlockCache;
+class BlockReader;
+
 class File final : public Node
 {
 public:
-	File(std::string name, std::filesystem::file_time_type lastWriteTime, std::filesystem::perms permissions, std::string data);
+	using Data = Botan::secure_vector<std::uint8_t>;
+
+	File(std::string name, std::filesystem::file_time_type lastWriteTime, std::filesystem::perms permissions, std::string data = {});
+	File(std::string name, std::filesystem::file_time_type lastWriteTime, std::filesystem::perms permissions, std::uint64_t size, std::string checksum, std::vector<BlockInfo> blocks, std::shared_ptr<const BlockReader> reader);
 
 	[[nodiscard]] const std::string& data() const;
+	[[nodiscard]] std::uint64_t size() const;
+	[[nodiscard]] const std::string& checksum() const;
+	[[nodiscard]] const std::vector<BlockInfo>& blocks() const;
+	[[nodiscard]] Data content() const;
+	[[nodiscard]] Data content(std::uint64_t offset, std::uint64_t length, BlockCache& cache) const;
+	void write_range(std::ostream& stream, std::uint64_t offset, std::uint64_t length) const;
+	[[nodiscard]] bool verify() const;
+	// Checks one block of the file on its own, against its checksum and the Merkle tree, so the blocks of a file are checked in parallel.
+	[[nodiscard]] bool verify(const BlockInfo& block) const;
+	// Counts the file in the progress once all its blocks were checked.
+	void report_verified() const;
+	// Copies the blocks of the file into a vault being compacted, those shared with other entries only once.
+	void copy_blocks(BlockWriter& writer, const BlockReader& reader, std::map<std::uint64_t, BlockInfo>& copied);
 
-	static std::vector<uint8_t> read(const std::filesystem::path& path);
+	// The path in the vault of the file this one is a hard link to, empty if it has its own content.
+	[[nodiscard]] const std::string& link() const;
+	void link_to(const std::string& path, const File& target);
+	void break_link();
+	// The links to a same file found when closing share the path of the first one stored, the others refer to it.
+	void set_hard_link(std::shared_ptr<std::string> firstLink, std::string path);
+	void create_link(const std::filesystem::path& parentPath, const std::filesystem::path& target) const;
 
 private:
 	std::string m_data;
+	std::uint64_t m_size;
+	std::string m_checksum;
+	std::vector<BlockInfo> m_blocks;
+	std::shared_ptr<const BlockReader> m_reader;
+	std::string m_link;
+	std::shared_ptr<std::string> m_firstLink;
+	std::string m_path;
+
+	void read_chunks(const std::function<void(std::span<const std::uint8_t>)>& consumer, const std::function<void(std::uint64_t)>& skip = {}) const;
+	void read_range(std::uint64_t offset, std::uint64_t length, const std::function<void(std::span<const std::uint8_t>)>& consumer, BlockCache* cache) const;
 
 	void write_content(pugi::xml_node& parentNode) const override;
-	void create(const std::filesystem::path& parentPath) const override;
+	void store(BlockWriter& writer, const std::filesystem::path& parentPath) override;
+	void create(const std::filesystem::path& parentPath, ThreadPool* pool) const override;
 };
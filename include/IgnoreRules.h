@@ -0,0 +1,37 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class IgnoreRules
+{
+public:
+	static constexpr auto FILE_NAME = ".vaultignore";
+
+	IgnoreRules() = default;
+	explicit IgnoreRules(const std::vector<std::string>& patterns);
+
+	void add(std::string_view pattern, const std::string& base = {});
+	void load(const std::filesystem::path& file, const std::string& base = {});
+
+	[[nodiscard]] bool empty() const;
+	[[nodiscard]] std::optional<bool> excluded(std::string_view path, bool directory) const;
+	[[nodiscard]] bool matches(std::string_view path, bool directory) const;
+
+	[[nodiscard]] static bool match(std::string_view pattern, std::string_view text);
+
+private:
+	struct Rule
+	{
+		std::string pattern;
+		std::string base;
+		bool negated;
+		bool directoryOnly;
+		bool anchored;
+	};
+
+	std::vector<Rule> m_rules;
+};
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <map>
+#include <optional>
+#include <string>
+
+#include "EncryptionManager.h"
+
+class KeyAgent
+{
+public:
+	struct Entry
+	{
+		EncryptionManager::Salt salt;
+		KdfParameters kdf;
+		EncryptionManager::Key key;
+	};
+
+	static constexpr std::chrono::seconds DEFAULT_TTL = std::chrono::minutes(15);
+	static constexpr auto SOCKET_VARIABLE = "VAULT_AGENT_SOCK";
+
+	KeyAgent(std::filesystem::path socket, std::chrono::seconds ttl = DEFAULT_TTL);
+	~KeyAgent();
+	KeyAgent(const KeyAgent&) = delete;
+	KeyAgent(KeyAgent&&) = delete;
+
+	void run();
+
+	[[nodiscard]] static bool is_supported();
+	[[nodiscard]] static std::filesystem::path default_socket();
+	// The default socket if an agent of this user listens on it, checked once per operation so nothing else is tried without one.
+	[[nodiscard]] static std::optional<std::filesystem::path> running_socket();
+
+	[[nodiscard]] static std::optional<EncryptionManager::Key> get(const std::filesystem::path& socket, const EncryptionManager::Salt& salt, const KdfParameters& kdf);
+	[[nodiscard]] static std::optional<Entry> find(const std::filesystem::path& socket, const std::filesystem::path& vault);
+	static bool put(const std::filesystem::path& socket, const std::filesystem::path& vault, const Entry& entry);
+	static bool stop(const std::filesystem::path& socket);
+
+private:
+	struct StoredKey
+	{
+		KdfParameters kdf;
+		EncryptionManager::Key key;
+		std::string vault;
+		std::chrono::steady_clock::time_point expiry;
+	};
+
+	std::filesystem::path m_socket;
+	std::chrono::seconds m_ttl;
+	std::map<EncryptionManager::Salt, StoredKey> m_keys;
+	std::atomic<bool> m_running;
+	int m_fd;
+
+	void serve(int client);
+	void purge();
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <future>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "EncryptionManager.h"
+#include "MemoryBudget.h"
+
+// The password of a batch and the keys derived from it, shared by the vaults it opens and closes concurrently,
+// so the password is prompted once and each key derived once per salt and parameters. The keys are derived one at a time,
+// so the memory of a single derivation is charged against the budget of all the vaults.
+class KeyRing
+{
+public:
+	explicit KeyRing(MemoryBudget budget = MemoryBudget());
+	KeyRing(const KeyRing&) = delete;
+	KeyRing(KeyRing&&) = delete;
+
+	// Prompted on first use only, a failed confirmation is not asked again.
+	[[nodiscard]] const EncryptionManager::Password& password();
+	// The vaults unlocking the same salt with the same parameters wait for the one deriving its key.
+	[[nodiscard]] EncryptionManager::Key derive(const EncryptionManager::Salt& salt, const KdfParameters& kdf);
+	// The salt shared by the vaults closed with these parameters, with its key.
+	[[nodiscard]] std::pair<EncryptionManager::Salt, EncryptionManager::Key> closing_key(const KdfParameters& kdf);
+
+private:
+	MemoryBudget m_budget;
+	std::mutex m_passwordMutex;
+	bool m_asked = false;
+	std::optional<EncryptionManager::Password> m_password;
+	std::mutex m_mutex;
+	std::mutex m_derivationMutex;
+	std::map<std::pair<EncryptionManager::Salt, KdfParameters>, std::shared_future<EncryptionManager::Key>> m_keys;
+	std::vector<std::pair<KdfParameters, EncryptionManager::Salt>> m_closingSalts;
+};
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "EncryptionManager.h"
+
+enum class KeySlotAction
+{
+	CHANGE,
+	ADD,
+	REMOVE
+};
+
+struct KeySlot
+{
+	EncryptionManager::Salt salt;
+	KdfParameters kdf;
+	EncryptionManager::Data wrappedKey;
+};
+
+class KeySlots
+{
+public:
+	static constexpr size_t COUNT = 8;
+	static constexpr size_t SLOT_SIZE = 128;
+	static constexpr size_t SIZE = COUNT * SLOT_SIZE;
+
+	KeySlots() = default;
+	explicit KeySlots(std::span<const std::uint8_t> area);
+
+	[[nodiscard]] std::vector<size_t> active() const;
+	[[nodiscard]] const KeySlot& slot(size_t index) const;
+	[[nodiscard]] std::optional<EncryptionManager::Key> unlock(size_t index, const EncryptionManager::Key& passwordKey) const;
+	size_t add(const EncryptionManager::Key& dataKey, EncryptionManager::Salt salt, const KdfParameters& kdf, const EncryptionManager::Key& passwordKey);
+	void remove(size_t index);
+
+	void write(std::ostream& stream) const;
+	void store(const std::filesystem::path& vault, std::uint64_t offset, size_t index) const;
+
+private:
+	std::array<std::optional<KeySlot>, COUNT> m_slots;
+
+	void write_slot(std::ostream& stream, size_t index) const;
+	[[nodiscard]] static EncryptionManager::Data associated_data(const KeySlot& slot);
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+
+class MappedFile
+{
+public:
+	explicit MappedFile(const std::filesystem::path& path);
+	~MappedFile();
+	MappedFile(const MappedFile&) = delete;
+	MappedFile(MappedFile&&) = delete;
+
+	[[nodiscard]] std::span<const std::uint8_t> data() const;
+	[[nodiscard]] std::span<const std::uint8_t> data(std::uint64_t offset, std::uint64_t size) const;
+	[[nodiscard]] std::size_t size() const;
+	// Drops the pages of a range from the memory of the process, they are read again from the file if needed,
+	// so a mapping read through doesn't keep the whole file resident.
+	void release(std::uint64_t offset, std::uint64_t size) const;
+
+private:
+	const std::uint8_t* m_data;
+	std::size_t m_size;
+#ifdef _WIN32
+	void* m_file;
+	void* m_mapping;
+#endif
+};
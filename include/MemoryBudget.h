@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+#include "VaultFormat.h"
+
+class MemoryBudget
+{
+public:
+	static constexpr std::uint64_t BASE_MEMORY = 32 * 1024 * 1024;
+	static constexpr std::uint64_t WORKER_MEMORY = 6 * VaultFormat::CHUNK_SIZE;
+
+	explicit MemoryBudget(std::optional<std::uint64_t> limit = std::nullopt);
+
+	[[nodiscard]] const std::optional<std::uint64_t>& limit() const;
+	[[nodiscard]] size_t threads() const;
+	[[nodiscard]] std::uint64_t cache_size(std::uint64_t requested) const;
+	// How many operations can run at once within the budget, at most the number requested.
+	[[nodiscard]] size_t operations(size_t requested) const;
+	// The budget of one of the operations run at once, which share the memory and the processors.
+	[[nodiscard]] MemoryBudget share(size_t operations) const;
+	// The most memory a key derivation can use within the budget, in KiB like the parameters.
+	[[nodiscard]] std::uint32_t kdf_memory() const;
+	// Refuses to derive a key with more memory than the budget leaves.
+	void check(const KdfParameters& kdf) const;
+
+	[[nodiscard]] static std::uint64_t peak_rss();
+	[[nodiscard]] static std::string format(std::uint64_t bytes);
+
+private:
+	std::optional<std::uint64_t> m_limit;
+	size_t m_processors;
+};
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "VaultFormat.h"
+
+class MerkleTree
+{
+public:
+	using Hash = std::vector<std::uint8_t>;
+
+	explicit MerkleTree(std::string algorithm);
+	// Continues the tree of a vault from the leaves serialized first in it.
+	MerkleTree(std::string algorithm, std::span<const std::uint8_t> leaves);
+
+	void add(const BlockInfo& block);
+	[[nodiscard]] std::uint64_t leaves() const;
+	[[nodiscard]] Hash root() const;
+	// The length of the tree once written.
+	[[nodiscard]] std::uint64_t size() const;
+	std::uint64_t write(std::ostream& stream) const;
+
+	[[nodiscard]] static std::uint64_t serialized_size(std::uint64_t leaves, size_t hashSize);
+	[[nodiscard]] static bool verify(const BlockInfo& block, std::span<const std::uint8_t> tree, std::uint64_t leaves, std::span<const std::uint8_t> root, const std::string& algorithm);
+
+private:
+	std::string m_algorithm;
+	std::vector<std::uint8_t> m_leaves;
+	size_t m_hashSize;
+
+	[[nodiscard]] std::vector<std::vector<std::uint8_t>> build() const;
+
+	[[nodiscard]] static Hash leaf(const BlockInfo& block, const std::string& algorithm);
+	[[nodiscard]] static Hash node(std::span<const std::uint8_t> left, std::span<const std::uint8_t> right, const std::string& algorithm);
+};
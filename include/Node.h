@@ -3,14 +3,23 @@
 #include <filesystem>
 #include <pugixml.hpp>
 
+class BlockWriter;
+class ThreadPool;
+
 class Node
 {
 public:
 	Node(std::string name, std::filesystem::file_time_type lastWriteTime, std::filesystem::perms permissions);
 	virtual ~Node() = default;
 
+	[[nodiscard]] const std::string& name() const;
+	[[nodiscard]] std::filesystem::file_time_type last_write_time() const;
+	[[nodiscard]] std::filesystem::perms permissions() const;
+	void set_attributes(std::filesystem::file_time_type lastWriteTime, std::filesystem::perms permissions);
+
 	virtual void write_content(pugi::xml_node& parentNode) const = 0;
-	virtual void create(const std::filesystem::path& path) const = 0;
+	virtual void store(BlockWriter& writer, const std::filesystem::path& parentPath) = 0;
+	virtual void create(const std::filesystem::path& path, ThreadPool* pool) const = 0;
 
 protected:
 	std::string m_name;
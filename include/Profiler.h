@@ -0,0 +1,48 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+
+class Profiler
+{
+public:
+	enum class Counter
+	{
+		BYTES_READ,
+		BYTES_WRITTEN,
+		FILES,
+		IO_CALLS,
+		ALLOCATIONS
+	};
+
+	class Scope
+	{
+	public:
+		explicit Scope(const char* name);
+		~Scope();
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+
+	private:
+		const char* m_name;
+		std::chrono::steady_clock::time_point m_start;
+	};
+
+	static constexpr size_t COUNTERS = 5;
+
+	Profiler() = delete;
+
+	static void enable(bool trace = false);
+	static void reset();
+	[[nodiscard]] static bool enabled();
+	static void count(Counter counter, std::uint64_t value = 1);
+	[[nodiscard]] static std::uint64_t counter(Counter counter);
+	// Set by the vault executable, which replaces the global operator new to count the allocations, they are reported only then.
+	static void count_allocations(bool counted = true);
+	[[nodiscard]] static bool counts_allocations();
+
+	static void print_summary(std::ostream& stream);
+	static void write_trace(const std::filesystem::path& path);
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <ostream>
+#include <string>
+
+#include "ProgressObserver.h"
+
+class ProgressBar final : public ProgressObserver
+{
+public:
+	static constexpr size_t WIDTH = 24;
+
+	explicit ProgressBar(std::ostream& stream);
+
+	void on_progress(const Progress& progress) override;
+	[[nodiscard]] static std::string format(const Progress& progress);
+
+private:
+	std::ostream& m_stream;
+	size_t m_lineSize;
+};
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+enum class ProgressPhase
+{
+	SCANNING,
+	STORING,
+	EXTRACTING,
+	VERIFYING
+};
+
+struct Progress
+{
+	ProgressPhase phase = ProgressPhase::SCANNING;
+	bool finished = false;
+	std::uint64_t entries = 0;
+	std::uint64_t totalEntries = 0;
+	// Bytes read from and written to the disk. The total is the original size of the entries,
+	// which is read when storing and written when extracting or verifying.
+	std::uint64_t bytesIn = 0;
+	std::uint64_t bytesOut = 0;
+	std::uint64_t totalBytes = 0;
+	std::chrono::steady_clock::duration elapsed{};
+};
+
+class ProgressObserver
+{
+public:
+	virtual ~ProgressObserver() = default;
+
+	// Called at most every ProgressTracker::INTERVAL while a phase runs and once when it finishes,
+	// possibly from a worker thread but never concurrently.
+	virtual void on_progress(const Progress& progress) = 0;
+};
+
+class ProgressTracker
+{
+public:
+	static constexpr std::chrono::milliseconds INTERVAL{100};
+
+	explicit ProgressTracker(ProgressObserver& observer);
+	ProgressTracker(const ProgressTracker&) = delete;
+	ProgressTracker& operator=(const ProgressTracker&) = delete;
+
+	void start(ProgressPhase phase, std::uint64_t totalEntries = 0, std::uint64_t totalBytes = 0);
+	void add(std::uint64_t entries, std::uint64_t bytesIn, std::uint64_t bytesOut);
+	void finish();
+	[[nodiscard]] Progress progress() const;
+
+private:
+	ProgressObserver& m_observer;
+	mutable std::mutex m_mutex;
+	ProgressPhase m_phase;
+	std::uint64_t m_totalEntries;
+	std::uint64_t m_totalBytes;
+	std::chrono::steady_clock::time_point m_start;
+	std::atomic<std::uint64_t> m_entries;
+	std::atomic<std::uint64_t> m_bytesIn;
+	std::atomic<std::uint64_t> m_bytesOut;
+	std::atomic<std::chrono::steady_clock::rep> m_next;
+
+	[[nodiscard]] Progress snapshot(bool finished) const;
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <filesystem>
+#include <optional>
+#include <pugixml.hpp>
+#include <string>
+#include <vector>
+
+#include "EncryptionManager.h"
+
+struct Recipient
+{
+	EncryptionManager::Data publicKey;
+	EncryptionManager::Data ephemeralKey;
+	EncryptionManager::Data wrappedKey;
+};
+
+class Recipients
+{
+public:
+	static constexpr size_t KEY_SIZE = 32;
+	static constexpr auto PUBLIC_KEY_PREFIX = "vault-x25519-public:";
+	static constexpr auto SECRET_KEY_PREFIX = "vault-x25519-secret:";
+
+	Recipients() = default;
+	explicit Recipients(const pugi::xml_node& header);
+
+	[[nodiscard]] bool empty() const;
+	[[nodiscard]] const std::vector<Recipient>& entries() const;
+	void add(const EncryptionManager::Key& dataKey, const EncryptionManager::Data& publicKey);
+	[[nodiscard]] std::optional<EncryptionManager::Key> unlock(const EncryptionManager::Key& secretKey) const;
+
+	void write(pugi::xml_node& header) const;
+
+	[[nodiscard]] static EncryptionManager::Data generate_identity(const std::filesystem::path& identity);
+	[[nodiscard]] static EncryptionManager::Data read_public_key(const std::filesystem::path& file);
+	[[nodiscard]] static EncryptionManager::Key read_identity(const std::filesystem::path& file);
+	[[nodiscard]] static EncryptionManager::Data public_key(const EncryptionManager::Key& secretKey);
+	[[nodiscard]] static std::string format_public_key(const EncryptionManager::Data& publicKey);
+
+private:
+	std::vector<Recipient> m_recipients;
+
+	[[nodiscard]] static EncryptionManager::Key wrapping_key(const EncryptionManager::Key& secretKey, const EncryptionManager::Data& peerKey, const Recipient& recipient);
+};
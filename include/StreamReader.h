@@ -0,0 +1,58 @@
+#pragma once
+
+#include <filesystem>
+#include <functional>
+#include <istream>
+#include <map>
+#include <optional>
+
+#include "ProgressObserver.h"
+#include "VaultFormat.h"
+
+// Reads a framed vault forward from a stream that can't be seeked, such as the standard input. The blocks of each file
+// follow the entry naming it, so the file is extracted as they arrive, and they are authenticated by the trailer ending the stream.
+class StreamReader
+{
+public:
+	using Data = Botan::secure_vector<std::uint8_t>;
+
+	// A file extracted from the stream, with the blocks it was read from.
+	struct Entry
+	{
+		std::uint64_t size = 0;
+		std::string checksum;
+		std::vector<BlockInfo> blocks;
+	};
+
+	// Reads the header and the key slots of the vault, or only as much of the stream as tells it isn't a framed vault.
+	explicit StreamReader(std::istream& stream);
+	StreamReader(const StreamReader&) = delete;
+	StreamReader& operator=(const StreamReader&) = delete;
+
+	[[nodiscard]] bool framed() const;
+	[[nodiscard]] const VaultHeader& header() const;
+	// The bytes read so far, which start the copy of a vault that isn't framed.
+	[[nodiscard]] std::span<const std::uint8_t> prefix() const;
+	void set_key(EncryptionManager::Key key);
+	void set_progress(ProgressTracker* progress);
+
+	// Reads the stream to its end, extracting the files selected by their path in the vault below the directory, and
+	// returns the index once the blocks read match the Merkle root of the trailer.
+	[[nodiscard]] Data extract(const std::filesystem::path& directory, const std::function<bool(const std::filesystem::path&)>& selected);
+	// The files extracted, by their path in the vault.
+	[[nodiscard]] const std::map<std::string, Entry>& entries() const;
+
+private:
+	std::istream& m_stream;
+	std::vector<std::uint8_t> m_prefix;
+	std::uint64_t m_headerSize;
+	VaultHeader m_header;
+	std::optional<EncryptionManager::Key> m_key;
+	ProgressTracker* m_progress;
+	std::uint64_t m_offset;
+	std::map<std::string, Entry> m_entries;
+
+	[[nodiscard]] bool read_prefix(size_t size);
+	[[nodiscard]] Data read(std::uint64_t size);
+	void clear_way(const std::filesystem::path& directory, const std::filesystem::path& path);
+};
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+class ThreadPool
+{
+public:
+	explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+	~ThreadPool();
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool(ThreadPool&&) = delete;
+
+	template <typename Function>
+	[[nodiscard]] std::future<std::invoke_result_t<Function>> submit(Function&& function);
+
+	[[nodiscard]] size_t size() const;
+
+private:
+	std::vector<std::jthread> m_workers;
+	std::queue<std::function<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_stopping;
+
+	void work();
+};
+
+template <typename Function>
+std::future<std::invoke_result_t<Function>> ThreadPool::submit(Function&& function)
+{
+	auto task = std::make_shared<std::packaged_task<std::invoke_result_t<Function>()>>(std::forward<Function>(function));
+	auto future = task->get_future();
+	{
+		std::scoped_lock lock(m_mutex);
+		m_tasks.emplace([task] { (*task)(); });
+	}
+	m_condition.notify_one();
+	return future;
+}
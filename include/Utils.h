@@ -12,6 +12,9 @@ enum class Answer
 	ABORT
 };
 
-std::optional<EncryptionManager::Password> ask_password_with_confirmation();
+std::optional<EncryptionManager::Password> ask_password_with_confirmation(const std::string& name = "password");
+void read_passwords_from_terminal(bool enabled);
 Answer ask_confirmation(const std::string& question, Answer defaultAnswer = Answer::YES);
-std::filesystem::path get_temp_name(const std::filesystem::path& parentPath);
+std::filesystem::path get_temp_name(const std::filesystem::path& parentPath, const std::string& prefix = "temp");
+// Removes a directory from a process detached from this one, which goes on once it exits. Returns false if it couldn't be started.
+bool remove_detached(const std::filesystem::path& path);
@@ -1,28 +1,118 @@
 #pragma once
 
+#include "AtomicFile.h"
 #include "Directory.h"
+#include "IgnoreRules.h"
+#include "KeySlots.h"
+#include "MemoryBudget.h"
+#include "ProgressObserver.h"
+#include "VaultFormat.h"
+#include <istream>
+#include <memory>
 #include <optional>
 
+class BlockReader;
+class Checkpoint;
+class StreamReader;
+class KeyRing;
+class VaultBenchmark;
 class VaultManager;
 
+struct DirectoryInfo
+{
+	std::string path;
+	std::uint64_t files = 0;
+	std::uint64_t directories = 0;
+	std::uint64_t size = 0;
+	std::uint64_t compressedSize = 0;
+	std::uint64_t storedSize = 0;
+};
+
+struct VaultInfo
+{
+	std::optional<VaultHeader> header;
+	std::uint64_t fileSize = 0;
+	std::uint64_t indexSize = 0;
+	std::vector<VolumeInfo> volumes;
+	// Every directory with the totals of its whole subtree, the root first and the others sorted by path.
+	std::vector<DirectoryInfo> directories;
+};
+
+enum class SourceRemoval
+{
+	NOW,
+	BACKGROUND,
+	KEEP
+};
+
 class Vault final : public Directory
 {
+	friend VaultBenchmark;
 	friend VaultManager;
 
 public:
-	explicit Vault(const std::filesystem::path& file);
+	static constexpr size_t PASSWORD_ATTEMPTS = 3;
 
-	void open(const std::optional<std::filesystem::path>& destination = std::nullopt);
-	void close(const std::optional<std::filesystem::path>& destination = std::nullopt, const std::optional<std::string>& extension = std::nullopt, bool compress = false, bool encrypt = false);
+	explicit Vault(const std::filesystem::path& file, MemoryBudget budget = MemoryBudget());
+
+	void open(const std::optional<std::filesystem::path>& destination = std::nullopt, const std::vector<std::string>& only = {});
+	void close(const std::optional<std::filesystem::path>& destination = std::nullopt, const std::optional<std::string>& extension = std::nullopt, bool compress = false, bool encrypt = false, const KdfParameters& kdf = KdfParameters(), const std::optional<Cipher>& cipher = std::nullopt, const std::vector<std::filesystem::path>& recipients = {}, const std::optional<std::uint64_t>& volumeSize = std::nullopt);
+	void write(std::ostream& stream, bool compress = false, bool encrypt = false, const KdfParameters& kdf = KdfParameters(), const std::optional<Cipher>& cipher = std::nullopt, const std::vector<std::filesystem::path>& recipients = {});
+	[[nodiscard]] std::vector<std::string> verify();
+	[[nodiscard]] VaultInfo info();
+	void load();
+	void change_password(KeySlotAction action = KeySlotAction::CHANGE);
+	// Appends the entries changed in the directory the vault was closed from, given by their paths relative to it, with a new
+	// index superseding the previous one. The index is loaded on the first update and kept in memory for the next ones.
+	void update(const std::filesystem::path& source, const std::vector<std::filesystem::path>& changed);
+	void set_identity(const std::filesystem::path& identity);
+	void set_exclude_patterns(const std::vector<std::string>& patterns);
+	void set_progress_observer(ProgressObserver& observer);
+	void set_durability(Durability durability);
+	void set_source_removal(SourceRemoval removal);
+	void set_resume(bool resume);
+	// Encrypts the vault closed with the password key the agent cached for it, instead of prompting for a new password.
+	void set_use_agent(bool useAgent);
+	// Unlocks and encrypts with the password and the keys of a batch instead of prompting for them.
+	void set_key_ring(std::shared_ptr<KeyRing> keyRing);
 
 private:
 	std::filesystem::directory_entry m_file;
 	bool m_opened;
+	MemoryBudget m_budget;
+	std::optional<EncryptionManager::Key> m_identity;
+	IgnoreRules m_excludes;
+	std::unique_ptr<ProgressTracker> m_progress;
+	Durability m_durability;
+	SourceRemoval m_sourceRemoval;
+	bool m_resume;
+	bool m_useAgent;
+	std::shared_ptr<KeyRing> m_keyRing;
+	std::shared_ptr<BlockReader> m_reader;
+	std::istream* m_stream;
+
+	// A vault read from a stream, which is opened in the destination as it is read.
+	Vault(std::istream& stream, MemoryBudget budget);
 
+	void open_stream(const std::filesystem::path& destination, const std::vector<std::string>& only);
 	void read_from_dir();
 	void write_to_dir() const;
-	void read_from_file();
-	void write_to_file(bool compress, bool encrypt) const;
+	void remove_source(const std::filesystem::path& source);
+	void append(const std::filesystem::path& source, const std::vector<std::pair<Node*, std::filesystem::path>>& stored);
+	// Rewrites the vault with only the blocks of its entries, dropping those superseded by the appends.
+	void compact();
+	std::shared_ptr<BlockReader> read_from_file();
+	void load_index(const std::shared_ptr<BlockReader>& reader);
+	void unlock(BlockReader& reader) const;
+	// The data key of a vault encrypted for recipients or with key slots, none when it is derived from the password alone.
+	[[nodiscard]] std::optional<EncryptionManager::Key> unlock_data_key(const VaultHeader& header, const std::filesystem::path& vault) const;
+	void read_from_legacy_file();
+	void read_content(const pugi::xml_node& root, const std::shared_ptr<const BlockReader>& reader, bool legacy);
+	[[nodiscard]] std::vector<EncryptionManager::Data> scan_for_closing(bool encrypt, const KdfParameters& kdf, const std::vector<std::filesystem::path>& recipients);
+	void write_to_file(const std::filesystem::path& source, bool compress, bool encrypt, const KdfParameters& kdf, Cipher cipher, const std::vector<EncryptionManager::Data>& recipients, const std::optional<std::uint64_t>& volumeSize);
+	void write_to_stream(std::ostream& stream, const std::filesystem::path& source, bool compress, bool encrypt, const KdfParameters& kdf, Cipher cipher, const std::vector<EncryptionManager::Data>& recipients, const std::optional<std::filesystem::path>& agentVault, const std::optional<std::uint64_t>& volumeSize, Checkpoint* checkpoint);
+	[[nodiscard]] std::unique_ptr<BlockWriter> create_writer(std::ostream& stream, bool compress, bool encrypt, const KdfParameters& kdf, Cipher cipher, const std::vector<EncryptionManager::Data>& recipients, const std::optional<std::filesystem::path>& agentVault, bool framed) const;
+	[[nodiscard]] std::unique_ptr<BlockWriter> resume_writer(std::ostream& stream, bool compress, bool encrypt, Cipher cipher, Checkpoint& checkpoint) const;
 
 	void write_content(pugi::xml_node& parentNode) const override;
 };
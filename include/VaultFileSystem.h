@@ -0,0 +1,27 @@
+#pragma once
+
+#include "BlockCache.h"
+#include "Directory.h"
+#include "File.h"
+#include <string>
+#include <unordered_map>
+
+class VaultFileSystem
+{
+public:
+	static constexpr size_t DEFAULT_CACHE_SIZE = 64 * 1024 * 1024;
+
+	explicit VaultFileSystem(const Directory& root, size_t cacheSize = DEFAULT_CACHE_SIZE);
+
+	[[nodiscard]] static bool is_supported();
+
+	void mount(const std::filesystem::path& mountpoint);
+
+	[[nodiscard]] const Node* find(const std::string& path) const;
+	[[nodiscard]] File::Data read(const File& file, std::uint64_t offset, std::uint64_t length);
+
+private:
+	const Directory& m_root;
+	BlockCache m_cache;
+	std::unordered_map<std::string, const Node*> m_nodes;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <ostream>
+#include <span>
+#include <vector>
+
+#include "EncryptionManager.h"
+#include "KeySlots.h"
+#include "Recipients.h"
+
+struct BlockInfo
+{
+	std::uint64_t id = 0;
+	std::uint64_t offset = 0;
+	std::uint64_t size = 0;
+	std::uint64_t storedSize = 0;
+	std::string checksum;
+	// Blocks of a multi-volume vault are in the numbered volumes, 0 is the vault file itself.
+	std::uint64_t volume = 0;
+
+	// A chunk in a hole of a sparse file is not stored and reads as zeros.
+	[[nodiscard]] bool hole() const { return storedSize == 0; }
+};
+
+struct VolumeInfo
+{
+	std::string name;
+	std::uint64_t size = 0;
+};
+
+struct VaultHeader
+{
+	std::uint32_t version = 0;
+	bool compressed = false;
+	bool encrypted = false;
+	std::string checksum;
+	EncryptionManager::Salt salt;
+	KdfParameters kdf;
+	std::optional<KeySlots> keySlots;
+	Cipher cipher = Cipher::CHACHA20_POLY1305;
+	Recipients recipients;
+	// The data of a vault in a single file is framed, so it can be read forward from a stream without its index.
+	bool framed = false;
+};
+
+struct VaultTrailer
+{
+	BlockInfo index;
+	std::uint64_t leaves = 0;
+	std::uint64_t treeOffset = 0;
+	std::vector<std::uint8_t> root;
+	std::vector<VolumeInfo> volumes;
+};
+
+// Each block of a framed vault follows a frame telling its type, its length as stored and its size. The blocks of a file
+// follow an entry naming it, and the holes between them have frames of their own.
+enum class FrameType : std::uint8_t
+{
+	ENTRY = 'E',
+	BLOCK = 'B',
+	HOLE = 'H',
+	INDEX = 'I',
+	TREE = 'T',
+	TRAILER = 'Z'
+};
+
+class VaultFormat
+{
+public:
+	static constexpr std::array<char, 8> MAGIC = {'V', 'A', 'U', 'L', 'T', '\0', '\r', '\n'};
+	static constexpr std::uint32_t VERSION = 5;
+	static constexpr std::uint32_t FIRST_VERSION = 4;
+	static constexpr std::uint64_t CHUNK_SIZE = 1024 * 1024;
+	static constexpr size_t TAIL_SIZE = sizeof(std::uint64_t) + MAGIC.size();
+	static constexpr std::uint64_t MIN_VOLUME_SIZE = 2 * CHUNK_SIZE;
+	static constexpr size_t FRAME_SIZE = 1 + 2 * sizeof(std::uint64_t);
+
+	VaultFormat() = delete;
+
+	[[nodiscard]] static bool has_magic(std::span<const std::uint8_t> data);
+	[[nodiscard]] static std::filesystem::path volume_path(const std::filesystem::path& vault, std::uint64_t volume);
+	// The hidden journal of an append in progress, holding the length of the vault before it.
+	[[nodiscard]] static std::filesystem::path append_journal_path(const std::filesystem::path& vault);
+	// The length journaled, if an append is in progress or was interrupted. A journal torn before anything was appended has none.
+	[[nodiscard]] static std::optional<std::uint64_t> appended_length(const std::filesystem::path& vault);
+	// The checksum and Merkle tree algorithm is fixed by the format version, the header only names it.
+	[[nodiscard]] static std::string checksum_algorithm(std::uint32_t version);
+
+	static void write_uint(std::ostream& stream, std::uint64_t value, size_t size);
+	static void write_frame(std::ostream& stream, FrameType type, std::uint64_t length, std::uint64_t size);
+	[[nodiscard]] static std::uint64_t read_uint(std::span<const std::uint8_t> data, size_t size);
+};
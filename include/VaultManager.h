@@ -1,14 +1,76 @@
 #pragma once
 
+#include <chrono>
 #include <filesystem>
+#include <memory>
 #include <optional>
+#include <string>
+#include <vector>
+
+#include "EncryptionManager.h"
+#include "KeySlots.h"
+#include "MemoryBudget.h"
+#include "ProgressObserver.h"
+#include "Vault.h"
+
+enum class BatchAction
+{
+	OPEN,
+	CLOSE
+};
+
+// A line of a batch manifest, with the options of the open or close command it stands for.
+struct BatchJob
+{
+	BatchAction action = BatchAction::OPEN;
+	std::filesystem::path vault;
+	std::optional<std::filesystem::path> destination;
+	std::optional<std::string> extension;
+	std::optional<std::filesystem::path> identity;
+	bool compress = false;
+	bool encrypt = false;
+	// The entries to extract when opening, or to leave out when closing.
+	std::vector<std::string> patterns;
+
+	bool operator==(const BatchJob&) const = default;
+};
+
+struct BatchResult
+{
+	std::optional<std::string> error;
+	std::chrono::milliseconds duration{0};
+};
 
 class VaultManager
 {
 public:
+	static constexpr auto STANDARD_STREAM = "-";
+
 	VaultManager() = default;
 	virtual ~VaultManager() = default;
 
-	virtual void open_vault(const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination);
-	virtual void close_vault(const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination, const std::optional<std::string>& extension, bool compress, bool encrypt);
+	virtual void set_max_memory(const std::optional<std::uint64_t>& maxMemory);
+	virtual void set_progress_observer(std::shared_ptr<ProgressObserver> observer);
+	virtual void open_vault(const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination, const std::optional<std::filesystem::path>& identity, const std::vector<std::string>& only, Durability durability, bool resume);
+	virtual void stream_vault(const std::filesystem::path& vault, bool compress, bool encrypt, const KdfParameters& kdf, const std::optional<Cipher>& cipher, const std::vector<std::filesystem::path>& recipients, const std::vector<std::string>& excludes);
+	virtual void close_vault(const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination, const std::optional<std::string>& extension, bool compress, bool encrypt, const KdfParameters& kdf, const std::optional<Cipher>& cipher, const std::vector<std::filesystem::path>& recipients, const std::optional<std::uint64_t>& volumeSize, const std::vector<std::string>& excludes, Durability durability, SourceRemoval removal, bool resume, bool useAgent);
+	virtual std::vector<std::string> verify_vault(const std::filesystem::path& vault);
+	virtual void info_vault(const std::filesystem::path& vault, const std::optional<std::filesystem::path>& identity, bool json);
+	virtual void cat_vault(const std::filesystem::path& vault, const std::filesystem::path& entry, std::uint64_t offset, const std::optional<std::uint64_t>& length);
+	virtual void mount_vault(const std::filesystem::path& vault, const std::filesystem::path& mountpoint, size_t cacheSize);
+	virtual KdfCalibration calibrate_kdf(std::chrono::milliseconds target);
+	virtual double benchmark_cipher(Cipher cipher);
+	virtual void passwd_vault(const std::filesystem::path& vault, KeySlotAction action);
+	virtual void run_agent(const std::filesystem::path& socket, std::chrono::seconds ttl);
+	virtual void stop_agent(const std::filesystem::path& socket);
+	virtual void generate_identity(const std::filesystem::path& identity);
+	// Runs the jobs concurrently within the memory budget, and reports the result of each one instead of stopping at the first failure.
+	virtual std::vector<BatchResult> run_batch(const std::vector<BatchJob>& jobs, size_t concurrency, Durability durability);
+	// Closes the directory into the vault if it doesn't exist, brings it up to date otherwise, then appends the entries changed
+	// until interrupted. The directory is left in place.
+	virtual void watch_vault(const std::filesystem::path& directory, const std::filesystem::path& vault, bool compress, bool encrypt, const std::vector<std::string>& excludes, std::chrono::milliseconds delay, Durability durability);
+
+protected:
+	MemoryBudget m_budget;
+	std::shared_ptr<ProgressObserver> m_observer;
 };
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <botan/secmem.h>
+
+class VolumeWriter
+{
+public:
+	using Data = Botan::secure_vector<std::uint8_t>;
+
+	static constexpr size_t DEPTH = 4;
+
+	VolumeWriter(std::filesystem::path path, const std::vector<std::uint8_t>& header);
+	~VolumeWriter();
+	VolumeWriter(const VolumeWriter&) = delete;
+	VolumeWriter(VolumeWriter&&) = delete;
+
+	[[nodiscard]] const std::filesystem::path& path() const;
+	[[nodiscard]] std::uint64_t size() const;
+
+	void write(Data data);
+	void seal();
+	void close();
+
+private:
+	std::filesystem::path m_path;
+	std::ofstream m_stream;
+	std::uint64_t m_size;
+	std::deque<Data> m_queue;
+	bool m_sealed;
+	std::exception_ptr m_error;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::jthread m_thread;
+
+	void work();
+};
@@ -0,0 +1,96 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <new>
+
+// The global allocation functions of the vault executable, replaced to count its allocations for --stats and --trace.
+// This file is only linked into the executable, so the library and the programs using it keep their own allocator.
+namespace
+{
+	[[noreturn]] void out_of_memory()
+	{
+		throw std::bad_alloc();
+	}
+
+	// Like the default operator new, the new handler is called until it frees enough memory, and bad_alloc thrown without one.
+	template <typename Allocate>
+	void* allocate_with(Allocate&& allocateOnce)
+	{
+		Profiler::count(Profiler::Counter::ALLOCATIONS);
+		while (true)
+		{
+			if (void* pointer = allocateOnce())
+				return pointer;
+			const auto handler = std::get_new_handler();
+			if (!handler)
+				out_of_memory();
+			handler();
+		}
+	}
+
+	void* allocate(const std::size_t size)
+	{
+		return allocate_with([size] { return std::malloc(size ? size : 1); });
+	}
+
+	void* allocate(std::size_t size, const std::align_val_t alignment)
+	{
+		// aligned_alloc takes a size multiple of the alignment, at least that of a pointer.
+		const auto align = std::max(static_cast<std::size_t>(alignment), sizeof(void*));
+		if (size > std::numeric_limits<std::size_t>::max() - align)
+			out_of_memory();
+		size = (std::max<std::size_t>(size, 1) + align - 1) / align * align;
+#ifdef _WIN32
+		return allocate_with([size, align] { return _aligned_malloc(size, align); });
+#else
+		return allocate_with([size, align] { return std::aligned_alloc(align, size); });
+#endif
+	}
+
+	void deallocate(void* pointer) noexcept
+	{
+		std::free(pointer);
+	}
+
+	void deallocate(void* pointer, std::align_val_t) noexcept
+	{
+#ifdef _WIN32
+		_aligned_free(pointer);
+#else
+		std::free(pointer);
+#endif
+	}
+
+	template <typename... Arguments>
+	void* allocate_nothrow(const Arguments... arguments) noexcept
+	{
+		try { return allocate(arguments...); }
+		catch (const std::bad_alloc&) { return nullptr; }
+	}
+
+	[[maybe_unused]] const bool counted = (Profiler::count_allocations(), true);
+}
+
+void* operator new(const std::size_t size) { return allocate(size); }
+void* operator new[](const std::size_t size) { return allocate(size); }
+void* operator new(const std::size_t size, const std::nothrow_t&) noexcept { return allocate_nothrow(size); }
+void* operator new[](const std::size_t size, const std::nothrow_t&) noexcept { return allocate_nothrow(size); }
+void* operator new(const std::size_t size, const std::align_val_t alignment) { return allocate(size, alignment); }
+void* operator new[](const std::size_t size, const std::align_val_t alignment) { return allocate(size, alignment); }
+void* operator new(const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate_nothrow(size, alignment); }
+void* operator new[](const std::size_t size, const std::align_val_t alignment, const std::nothrow_t&) noexcept { return allocate_nothrow(size, alignment); }
+
+void operator delete(void* pointer) noexcept { deallocate(pointer); }
+void operator delete[](void* pointer) noexcept { deallocate(pointer); }
+void operator delete(void* pointer, std::size_t) noexcept { deallocate(pointer); }
+void operator delete[](void* pointer, std::size_t) noexcept { deallocate(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { deallocate(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { deallocate(pointer); }
+void operator delete(void* pointer, const std::align_val_t alignment) noexcept { deallocate(pointer, alignment); }
+void operator delete[](void* pointer, const std::align_val_t alignment) noexcept { deallocate(pointer, alignment); }
+void operator delete(void* pointer, std::size_t, const std::align_val_t alignment) noexcept { deallocate(pointer, alignment); }
+void operator delete[](void* pointer, std::size_t, const std::align_val_t alignment) noexcept { deallocate(pointer, alignment); }
+void operator delete(void* pointer, const std::align_val_t alignment, const std::nothrow_t&) noexcept { deallocate(pointer, alignment); }
+void operator delete[](void* pointer, const std::align_val_t alignment, const std::nothrow_t&) noexcept { deallocate(pointer, alignment); }
@@ -1,6 +1,63 @@
 #include "Application.h"
 
+#include "DirectoryWatcher.h"
+#include "KeyAgent.h"
+#include "Profiler.h"
+#include "ProgressBar.h"
 #include "Utils.h"
+#include "VaultFileSystem.h"
+
+#include <fstream>
+#include <iomanip>
+
+namespace
+{
+	Durability parse_durability(const std::string& value)
+	{
+		if (value == "none")
+			return Durability::NONE;
+		return value == "data" ? Durability::DATA : Durability::FULL;
+	}
+
+	// Each line of a manifest holds the arguments of an open or close command, the blank ones and those starting with # are skipped.
+	std::vector<BatchJob> read_manifest(const std::filesystem::path& manifest)
+	{
+		std::ifstream file(manifest);
+		if (!file.is_open())
+			throw std::ios_base::failure("Failed to open the file: " + manifest.string());
+		std::vector<BatchJob> jobs;
+		std::string line;
+		for (size_t number = 1; std::getline(file, line); ++number)
+		{
+			if (!line.empty() && line.back() == '\r')
+				line.pop_back();
+			if (const auto start = line.find_first_not_of(" \t"); start == std::string::npos || line[start] == '#')
+				continue;
+			BatchJob job;
+			CLI::App parser("A job of the batch", "vault");
+			parser.require_subcommand(1, 1);
+			const auto open = parser.add_subcommand("open", "Open a vault");
+			open->add_option("vault, -v, --vault", job.vault)
+			    ->required();
+			open->add_option("-d, --destination", job.destination);
+			open->add_option("-i, --identity", job.identity);
+			open->add_option("--only", job.patterns);
+			const auto close = parser.add_subcommand("close", "Close a vault");
+			close->add_option("vault, -v, --vault", job.vault)
+			     ->required();
+			close->add_option("-d, --destination", job.destination);
+			close->add_option("-e, --extension", job.extension);
+			close->add_option("--exclude", job.patterns);
+			close->add_flag("-C, --compress", job.compress);
+			close->add_flag("-E, --encrypt", job.encrypt);
+			try { parser.parse(line, false); }
+			catch (const CLI::ParseError& e) { throw std::invalid_argument("Invalid line " + std::to_string(number) + " of " + manifest.string() + ": " + e.what()); }
+			job.action = open->parsed() ? BatchAction::OPEN : BatchAction::CLOSE;
+			jobs.push_back(std::move(job));
+		}
+		return jobs;
+	}
+}
 
 Application::Application(const std::span<const char*>& args, std::unique_ptr<VaultManager> vaultManager):
 	m_parser("A small, portable file system with encryption capabilities.", "vault"),
@@ -17,6 +74,9 @@ int Application::execute()
 		if (m_args.size() == 1)
 			throw CLI::CallForHelp();
 		m_parser.parse(static_cast<int>(m_args.size()), m_args.data());
+		if (m_maxMemory)
+			std::cerr << "Peak memory usage: " << MemoryBudget::format(MemoryBudget::peak_rss()) << " (budget: " << MemoryBudget::format(*m_maxMemory) << ")" << std::endl;
+		report_profile();
 	}
 	catch (const CLI::CallForVersion&)
 	{
@@ -29,20 +89,51 @@ int Application::execute()
 	catch (const std::exception& e)
 	{
 		std::cerr << "Error: " << e.what() << std::endl;
+		try { report_profile(); }
+		catch (const std::exception& traceError) { std::cerr << "Error: " << traceError.what() << std::endl; }
 		return EXIT_FAILURE;
 	}
 	return EXIT_SUCCESS;
 }
 
+void Application::report_profile() const
+{
+	if (m_stats)
+		Profiler::print_summary(std::cerr);
+	if (m_trace)
+		Profiler::write_trace(*m_trace);
+}
+
 void Application::set_args_parsing()
 {
 	m_parser.require_subcommand(0, 1)
+	        ->fallthrough()
 #if defined(WIN32)
 			->allow_windows_style_options()
 #endif
 			;
 
 	m_parser.add_flag_callback("-v, --version", [] { throw CLI::CallForVersion(); }, "Print the version and exit");
+	m_parser.add_option_function<std::uint64_t>("--max-memory", [this](const std::uint64_t& maxMemory)
+		{
+			m_vaultManager->set_max_memory(maxMemory);
+			m_maxMemory = maxMemory;
+		}, "Limit the memory used by buffers and threads (e.g. 512MiB) and report the peak memory usage")
+	        ->transform(CLI::AsSizeValue(false))
+	        ->trigger_on_parse();
+	m_parser.add_flag_callback("--progress", [this] { m_vaultManager->set_progress_observer(std::make_shared<ProgressBar>(std::cerr)); },
+		"Show the progress of closing, opening and verifying a vault with its throughput and remaining time");
+	m_parser.add_flag_callback("--stats", [this]
+		{
+			Profiler::enable();
+			m_stats = true;
+		}, "Print the time spent in each phase and the I/O counters");
+	m_parser.add_option_function<std::filesystem::path>("--trace", [this](const std::filesystem::path& trace)
+		{
+			Profiler::enable(true);
+			m_trace = trace;
+		}, "Write a Chrome trace_event file of each phase (open it in chrome://tracing or Perfetto)")
+	        ->trigger_on_parse();
 
 	m_parser.add_subcommand("help", "Print this help message and exit")
 	        ->silent()
@@ -59,30 +150,275 @@ void Application::set_args_parsing()
 	const auto compress = std::make_shared<bool>(false);
 
 	const auto open = m_parser.add_subcommand("open", "Open a vault");
-	open->add_option("vault, -v, --vault", *vaultPath, "Path to the vault file")
+	open->add_option("vault, -v, --vault", *vaultPath, "Path to the vault file, or - to read it from the standard input")
 	    ->required()
-	    ->check(CLI::ExistingFile);
+	    ->check(CLI::ExistingFile | CLI::IsMember({VaultManager::STANDARD_STREAM}));
 	open->add_option("destination, -d, --destination", *destination, "Path to the destination directory")
 	    ->check(CLI::ExistingDirectory);
-	open->callback([this, vaultPath, destination] { m_vaultManager->open_vault(*vaultPath, *destination); });
+	const auto identity = std::make_shared<std::optional<std::filesystem::path>>();
+	open->add_option("-i, --identity", *identity, "Path to an identity file to open a vault encrypted for its public key")
+	    ->check(CLI::ExistingFile);
+	const auto only = std::make_shared<std::vector<std::string>>();
+	open->add_option("--only", *only, "Gitignore-style patterns of the entries to extract, leaving the vault closed, the other entries are never read");
+	const auto fsync = std::make_shared<std::string>("full");
+	open->add_option("--fsync", *fsync, "Durability of the extracted entries: none, data synced before the vault is removed, or full with the directories too")
+	    ->capture_default_str()
+	    ->check(CLI::IsMember({"none", "data", "full"}));
+	const auto resume = std::make_shared<bool>(false);
+	open->add_flag("--resume", *resume, "Continue an interrupted open after the entries it extracted");
+	open->callback([this, vaultPath, destination, identity, only, fsync, resume] { m_vaultManager->open_vault(*vaultPath, *destination, *identity, *only, parse_durability(*fsync), *resume); });
 
 	const auto close = m_parser.add_subcommand("close", "Close a vault");
 	close->add_option("vault, -v, --vault", *vaultPath, "Path to the vault file")
 	     ->required()
 	     ->check(CLI::ExistingDirectory);
-	close->add_option("destination, -d, --destination", *destination, "Path to the destination directory")
-	     ->check(CLI::ExistingDirectory);
-	close->add_option("extension, -e, --extension", *extension, "Extension of the vault file");
-	close->add_flag("-E, --encrypt", *encrypt, "Encrypt the vault file, you will be prompted for a password");
+	const auto destinationOption = close->add_option("destination, -d, --destination", *destination, "Path to the destination directory")
+	                                    ->check(CLI::ExistingDirectory);
+	const auto extensionOption = close->add_option("extension, -e, --extension", *extension, "Extension of the vault file");
+	const auto output = std::make_shared<std::optional<std::string>>();
+	const auto outputOption = close->add_option("-o, --output", *output, "Write the vault to the standard output with -, leaving the directory in place")
+	                               ->check(CLI::IsMember({VaultManager::STANDARD_STREAM}))
+	                               ->excludes(destinationOption)
+	                               ->excludes(extensionOption);
+	const auto volumeSize = std::make_shared<std::optional<std::uint64_t>>();
+	const auto volumeSizeOption = close->add_option("--volume-size", *volumeSize, "Split the vault in volumes of at most this size (e.g. 4G) next to a small vault file listing them")
+	     ->transform(CLI::AsSizeValue(false))
+	     ->excludes(outputOption);
+	const auto excludes = std::make_shared<std::vector<std::string>>();
+	close->add_option("--exclude", *excludes, "Gitignore-style pattern of the entries to leave out, overriding the .vaultignore files, can be repeated");
+	close->add_option("--fsync", *fsync, "Durability of the vault file: none, data synced before the source is removed, or full with its directory too")
+	     ->capture_default_str()
+	     ->check(CLI::IsMember({"none", "data", "full"}))
+	     ->excludes(outputOption);
+	const auto keepSource = std::make_shared<bool>(false);
+	const auto keepSourceFlag = close->add_flag("--keep-source", *keepSource, "Leave the directory in place once the vault is written")
+	                                 ->excludes(outputOption);
+	const auto removeInBackground = std::make_shared<bool>(false);
+	close->add_flag("--remove-in-background", *removeInBackground, "Move the directory aside once the vault is written and remove it in the background")
+	     ->excludes(outputOption)
+	     ->excludes(keepSourceFlag);
+	close->add_flag("--resume", *resume, "Continue an interrupted close after the entries it stored, if the directory is still there")
+	     ->excludes(outputOption)
+	     ->excludes(volumeSizeOption);
+	const auto encryptFlag = close->add_flag("-E, --encrypt", *encrypt, "Encrypt the vault file, you will be prompted for a password");
 	close->add_flag("-C, --compress", *compress, "Compress the vault file");
-	close->callback([this, vaultPath, destination, extension, encrypt, compress]
+	const auto kdf = std::make_shared<KdfParameters>();
+	const auto kdfMemory = std::make_shared<std::uint32_t>(kdf->memory / 1024);
+	close->add_option("--kdf-memory", *kdfMemory, "Memory used to derive the key from the password in MiB")
+	     ->capture_default_str()
+	     ->check(CLI::Range(1u, EncryptionManager::MAX_KDF_MEMORY / 1024))
+	     ->needs(encryptFlag);
+	close->add_option("--kdf-iterations", kdf->iterations, "Number of passes used to derive the key from the password")
+	     ->capture_default_str()
+	     ->check(CLI::Range(1u, EncryptionManager::MAX_KDF_ITERATIONS))
+	     ->needs(encryptFlag);
+	close->add_option("--kdf-lanes", kdf->lanes, "Number of lanes used to derive the key from the password, derived in parallel")
+	     ->capture_default_str()
+	     ->check(CLI::Range(1u, EncryptionManager::MAX_KDF_LANES))
+	     ->needs(encryptFlag);
+	const auto cipher = std::make_shared<std::string>("auto");
+	close->add_option("--cipher", *cipher, "Cipher of the vault, auto picks AES-256-GCM when the CPU has AES instructions and ChaCha20-Poly1305 otherwise")
+	     ->capture_default_str()
+	     ->check(CLI::IsMember({"auto", "aes-gcm", "chacha20"}))
+	     ->needs(encryptFlag);
+	const auto recipients = std::make_shared<std::vector<std::filesystem::path>>();
+	const auto recipientOption = close->add_option("-r, --recipient", *recipients, "Path to a public key file to encrypt the vault for instead of a password, can be repeated")
+	                                  ->check(CLI::ExistingFile)
+	                                  ->needs(encryptFlag);
+	const auto useAgent = std::make_shared<bool>(false);
+	close->add_flag("--use-agent", *useAgent, "Encrypt with the password the vault was opened with, cached by the key agent, instead of prompting for one")
+	     ->needs(encryptFlag)
+	     ->excludes(outputOption)
+	     ->excludes(recipientOption);
+	close->callback([this, vaultPath, destination, extension, output, volumeSize, excludes, fsync, keepSource, removeInBackground, resume, encrypt, compress, kdf, kdfMemory, cipher, recipients, useAgent]
 		{
-			if (constexpr std::array args = {"-v", "--vault", "-d", "--destination", "-E", "--encrypt", "-C", "--compress"}; extension->has_value() && std::ranges::find(args, extension->value()) != args.end())
+			if (constexpr std::array args = {"-v", "--vault", "-d", "--destination", "-o", "--output", "--volume-size", "--exclude", "--fsync", "--keep-source", "--remove-in-background", "--resume", "-E", "--encrypt", "-C", "--compress", "--kdf-memory", "--kdf-iterations", "--kdf-lanes", "--cipher", "-r", "--recipient", "--use-agent"}; extension->has_value() && std::ranges::find(args, extension->value()) != args.end())
 			{
 				if (const auto answer = ask_confirmation("Your are trying to set the extension as " + extension->value() + " but it is a flag.\nAre you sure you want to continue?", Answer::NO); answer != Answer::YES)
 					return;
 			}
-			m_vaultManager->close_vault(*vaultPath, *destination, *extension, *compress, *encrypt);
+			kdf->memory = *kdfMemory * 1024;
+			std::optional<Cipher> selectedCipher;
+			if (*cipher != "auto")
+				selectedCipher = *cipher == "aes-gcm" ? Cipher::AES_256_GCM : Cipher::CHACHA20_POLY1305;
+			if (output->has_value())
+			{
+				m_vaultManager->stream_vault(*vaultPath, *compress, *encrypt, *kdf, selectedCipher, *recipients, *excludes);
+				return;
+			}
+			const auto removal = *keepSource ? SourceRemoval::KEEP : *removeInBackground ? SourceRemoval::BACKGROUND : SourceRemoval::NOW;
+			m_vaultManager->close_vault(*vaultPath, *destination, *extension, *compress, *encrypt, *kdf, selectedCipher, *recipients, *volumeSize, *excludes, parse_durability(*fsync), removal, *resume, *useAgent);
+		});
+
+	const auto manifest = std::make_shared<std::filesystem::path>();
+	const auto jobs = std::make_shared<size_t>(4);
+	const auto batch = m_parser.add_subcommand("batch", "Open and close the vaults listed in a manifest concurrently, prompting once for their password");
+	batch->add_option("manifest, --manifest", *manifest, "Path to the manifest, with the arguments of an open or close command on each line")
+	     ->required()
+	     ->check(CLI::ExistingFile);
+	batch->add_option("-j, --jobs", *jobs, "Number of vaults opened or closed at once, lowered to fit the memory budget")
+	     ->capture_default_str()
+	     ->check(CLI::PositiveNumber);
+	batch->add_option("--fsync", *fsync, "Durability of the vault files and of the extracted entries: none, data or full")
+	     ->capture_default_str()
+	     ->check(CLI::IsMember({"none", "data", "full"}));
+	batch->callback([this, manifest, jobs, fsync]
+		{
+			const auto batchJobs = read_manifest(*manifest);
+			const auto results = m_vaultManager->run_batch(batchJobs, *jobs, parse_durability(*fsync));
+			size_t failed = 0;
+			for (size_t index = 0; index < batchJobs.size() && index < results.size(); ++index)
+			{
+				const auto& [error, duration] = results[index];
+				std::cout << (error ? "FAILED " : "OK     ") << (batchJobs[index].action == BatchAction::OPEN ? "open  " : "close ") << batchJobs[index].vault.string()
+					<< " in " << std::fixed << std::setprecision(1) << static_cast<double>(duration.count()) / 1000 << " s" << (error ? ": " + *error : "") << std::endl;
+				failed += error.has_value();
+			}
+			if (failed)
+				throw std::runtime_error(std::to_string(failed) + " of " + std::to_string(batchJobs.size()) + " jobs failed");
+			std::cout << batchJobs.size() << " jobs done" << std::endl;
+		});
+
+	const auto watchedVault = std::make_shared<std::filesystem::path>();
+	const auto delay = std::make_shared<std::uint64_t>(DirectoryWatcher::DEFAULT_DELAY.count());
+	const auto watchExcludes = std::make_shared<std::vector<std::string>>();
+	const auto watch = m_parser.add_subcommand("watch", "Keep a vault in sync with a directory, appending the entries changed until interrupted");
+	watch->add_option("directory, -s, --source", *vaultPath, "Path to the directory to watch, left in place")
+	     ->required()
+	     ->check(CLI::ExistingDirectory);
+	watch->add_option("vault, -v, --vault", *watchedVault, "Path to the vault file, closed from the directory if it doesn't exist")
+	     ->required();
+	watch->add_option("--delay", *delay, "Time without change after which the changes are synced (e.g. 500ms or 2s)")
+	     ->capture_default_str()
+	     ->transform(CLI::AsNumberWithUnit(std::map<std::string, std::uint64_t>{{"ms", 1}, {"s", 1000}}))
+	     ->check(CLI::PositiveNumber);
+	watch->add_option("--exclude", *watchExcludes, "Gitignore-style pattern of the entries to leave out, overriding the .vaultignore files, can be repeated");
+	watch->add_option("--fsync", *fsync, "Durability of each update of the vault: none, data synced before it is complete, or full with its directory too")
+	     ->capture_default_str()
+	     ->check(CLI::IsMember({"none", "data", "full"}));
+	watch->add_flag("-E, --encrypt", *encrypt, "Encrypt the vault file if it is created, you will be prompted for a password");
+	watch->add_flag("-C, --compress", *compress, "Compress the vault file if it is created");
+	watch->callback([this, vaultPath, watchedVault, delay, watchExcludes, fsync, encrypt, compress]
+		{
+			m_vaultManager->watch_vault(*vaultPath, *watchedVault, *compress, *encrypt, *watchExcludes, std::chrono::milliseconds(*delay), parse_durability(*fsync));
+		});
+
+	const auto verify = m_parser.add_subcommand("verify", "Verify the integrity of a closed vault");
+	verify->add_option("vault, -v, --vault", *vaultPath, "Path to the vault file")
+	      ->required()
+	      ->check(CLI::ExistingFile);
+	verify->callback([this, vaultPath]
+		{
+			const auto corrupted = m_vaultManager->verify_vault(*vaultPath);
+			for (const auto& entry : corrupted)
+				std::cerr << "Corrupted: " << entry << std::endl;
+			if (!corrupted.empty())
+				throw std::runtime_error(std::to_string(corrupted.size()) + " corrupted entries in " + vaultPath->string());
+			std::cout << vaultPath->string() << ": OK" << std::endl;
+		});
+
+	const auto json = std::make_shared<bool>(false);
+	const auto info = m_parser.add_subcommand("info", "Print the header of a closed vault and the size of each directory, reading only its index");
+	info->add_option("vault, -v, --vault", *vaultPath, "Path to the vault file")
+	    ->required()
+	    ->check(CLI::ExistingFile);
+	info->add_option("-i, --identity", *identity, "Path to an identity file to read a vault encrypted for its public key")
+	    ->check(CLI::ExistingFile);
+	info->add_flag("--json", *json, "Print the information as JSON");
+	info->callback([this, vaultPath, identity, json] { m_vaultManager->info_vault(*vaultPath, *identity, *json); });
+
+	const auto entry = std::make_shared<std::filesystem::path>();
+	const auto offset = std::make_shared<std::uint64_t>(0);
+	const auto length = std::make_shared<std::optional<std::uint64_t>>();
+	const auto cat = m_parser.add_subcommand("cat", "Print a file of a closed vault without extracting the vault");
+	cat->add_option("vault, -v, --vault", *vaultPath, "Path to the vault file")
+	   ->required()
+	   ->check(CLI::ExistingFile);
+	cat->add_option("path, -p, --path", *entry, "Path of the file inside the vault")
+	   ->required();
+	cat->add_option("--offset", *offset, "Offset of the first byte to print")
+	   ->capture_default_str();
+	cat->add_option("--length", *length, "Number of bytes to print, until the end of the file by default");
+	cat->callback([this, vaultPath, entry, offset, length] { m_vaultManager->cat_vault(*vaultPath, *entry, *offset, *length); });
+
+	const auto mountpoint = std::make_shared<std::filesystem::path>();
+	const auto cacheSize = std::make_shared<size_t>(VaultFileSystem::DEFAULT_CACHE_SIZE / (1024 * 1024));
+	const auto mount = m_parser.add_subcommand("mount", "Mount a closed vault as a read-only file system until it is unmounted");
+	mount->add_option("vault, -v, --vault", *vaultPath, "Path to the vault file")
+	     ->required()
+	     ->check(CLI::ExistingFile);
+	mount->add_option("mountpoint, -m, --mountpoint", *mountpoint, "Path to the directory to mount the vault on")
+	     ->required()
+	     ->check(CLI::ExistingDirectory);
+	mount->add_option("--cache-size", *cacheSize, "Size of the block cache in MiB")
+	     ->capture_default_str()
+	     ->check(CLI::PositiveNumber);
+	mount->callback([this, vaultPath, mountpoint, cacheSize] { m_vaultManager->mount_vault(*vaultPath, *mountpoint, *cacheSize * 1024 * 1024); });
+
+	const auto addSlot = std::make_shared<bool>(false);
+	const auto removeSlot = std::make_shared<bool>(false);
+	const auto passwd = m_parser.add_subcommand("passwd", "Change, add or remove a password of an encrypted vault without rewriting its content");
+	passwd->add_option("vault, -v, --vault", *vaultPath, "Path to the vault file")
+	      ->required()
+	      ->check(CLI::ExistingFile);
+	const auto addFlag = passwd->add_flag("-a, --add", *addSlot, "Add a password, the current ones keep working");
+	passwd->add_flag("-r, --remove", *removeSlot, "Remove a password, at least one must remain")
+	      ->excludes(addFlag);
+	passwd->callback([this, vaultPath, addSlot, removeSlot]
+		{
+			const auto action = *addSlot ? KeySlotAction::ADD : *removeSlot ? KeySlotAction::REMOVE : KeySlotAction::CHANGE;
+			m_vaultManager->passwd_vault(*vaultPath, action);
+		});
+
+	const auto target = std::make_shared<std::uint64_t>(500);
+	const auto kdfBench = m_parser.add_subcommand("kdf-bench", "Find the key derivation parameters that take a target duration on this machine");
+	kdfBench->add_option("-t, --target", *target, "Target duration of the key derivation (e.g. 500ms or 1s)")
+	        ->capture_default_str()
+	        ->transform(CLI::AsNumberWithUnit(std::map<std::string, std::uint64_t>{{"ms", 1}, {"s", 1000}}))
+	        ->check(CLI::PositiveNumber);
+	kdfBench->callback([this, target]
+		{
+			const auto [parameters, duration] = m_vaultManager->calibrate_kdf(std::chrono::milliseconds(*target));
+			std::cout << EncryptionManager::KDF_ALGORITHM << ": " << parameters.memory / 1024 << " MiB, " << parameters.iterations << " iterations, "
+				<< parameters.lanes << " lanes in " << duration.count() << " ms" << std::endl;
+			std::cout << "Use: vault close <vault> -E --kdf-memory " << parameters.memory / 1024 << " --kdf-iterations " << parameters.iterations
+				<< " --kdf-lanes " << parameters.lanes << std::endl;
+		});
+
+	const auto identityPath = std::make_shared<std::filesystem::path>();
+	const auto keygen = m_parser.add_subcommand("keygen", "Generate an X25519 identity and its public key to encrypt vaults without a password");
+	keygen->add_option("identity, -o, --output", *identityPath, "Path to the identity file, the public key is written next to it with a .pub extension")
+	      ->required();
+	keygen->callback([this, identityPath] { m_vaultManager->generate_identity(*identityPath); });
+
+	const auto cipherBench = m_parser.add_subcommand("cipher-bench", "Measure the throughput of each cipher on this machine");
+	cipherBench->callback([this]
+		{
+			for (const auto cipher : EncryptionManager::CIPHERS)
+			{
+				const auto throughput = m_vaultManager->benchmark_cipher(cipher);
+				std::cout << EncryptionManager::cipher_name(cipher) << ": " << std::fixed << std::setprecision(2) << throughput / 1e9 << " GB/s"
+					<< (cipher == EncryptionManager::preferred_cipher() ? " (default)" : "") << std::endl;
+			}
+			std::cout << "Hardware AES: " << (EncryptionManager::has_hardware_aes() ? "yes" : "no") << std::endl;
+		});
+
+	const auto socket = std::make_shared<std::filesystem::path>(KeyAgent::default_socket());
+	const auto ttl = std::make_shared<std::uint64_t>(KeyAgent::DEFAULT_TTL.count());
+	const auto stopAgent = std::make_shared<bool>(false);
+	const auto agent = m_parser.add_subcommand("agent", "Keep the keys of encrypted vaults in memory so they are not derived again for each command");
+	agent->add_option("-s, --socket", *socket, "Path to the socket of the agent, set " + std::string(KeyAgent::SOCKET_VARIABLE) + " to it for the other commands")
+	     ->capture_default_str();
+	agent->add_option("-t, --ttl", *ttl, "Time after which a key is forgotten (e.g. 90s, 15m or 1h)")
+	     ->capture_default_str()
+	     ->transform(CLI::AsNumberWithUnit(std::map<std::string, std::uint64_t>{{"s", 1}, {"m", 60}, {"h", 3600}}));
+	agent->add_flag("--stop", *stopAgent, "Stop the running agent and forget its keys");
+	agent->callback([this, socket, ttl, stopAgent]
+		{
+			if (*stopAgent)
+				m_vaultManager->stop_agent(*socket);
+			else
+				m_vaultManager->run_agent(*socket, std::chrono::seconds(*ttl));
 		});
 }
 
@@ -0,0 +1,263 @@
+#include "AtomicFile.h"
+#include "Profiler.h"
+#include "Utils.h"
+
+#include <cstdio>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+	#include <cerrno>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+namespace
+{
+	std::filesystem::path directory_of(const std::filesystem::path& path)
+	{
+		return path.has_parent_path() ? path.parent_path() : std::filesystem::path(".");
+	}
+
+	// Renames only if nothing is at the target, in a single call, and reports false if something is. Where the system has
+	// no such rename, this fails rather than check and rename, which would replace a file created in between.
+	bool rename_without_replacing(const std::filesystem::path& from, const std::filesystem::path& to)
+	{
+#ifdef _WIN32
+		// Without MOVEFILE_REPLACE_EXISTING, the move fails if the target exists.
+		if (MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_WRITE_THROUGH))
+			return true;
+		if (GetLastError() == ERROR_ALREADY_EXISTS || GetLastError() == ERROR_FILE_EXISTS)
+			return false;
+#elif defined(RENAME_NOREPLACE)
+		if (::renameat2(AT_FDCWD, from.c_str(), AT_FDCWD, to.c_str(), RENAME_NOREPLACE) == 0)
+			return true;
+		if (errno == EEXIST)
+			return false;
+#elif defined(RENAME_EXCL)
+		if (::renamex_np(from.c_str(), to.c_str(), RENAME_EXCL) == 0)
+			return true;
+		if (errno == EEXIST)
+			return false;
+#endif
+		throw std::ios_base::failure("Failed to create the file without replacing an existing one: " + to.string());
+	}
+
+#ifdef O_TMPFILE
+	std::string descriptor_path(const int descriptor)
+	{
+		return "/proc/self/fd/" + std::to_string(descriptor);
+	}
+#endif
+}
+
+AtomicFile::AtomicFile(std::filesystem::path path, const Durability durability):
+	m_path(std::move(path)),
+	m_durability(durability),
+	m_descriptor(-1),
+	m_committed(false),
+	m_kept(false)
+{
+#ifdef O_TMPFILE
+	// The anonymous file has no name until it is linked, it is reopened through /proc to be written as a stream.
+	m_descriptor = ::open(directory_of(m_path).c_str(), O_TMPFILE | O_WRONLY | O_CLOEXEC, 0666);
+	if (m_descriptor >= 0)
+	{
+		m_stream.open(descriptor_path(m_descriptor), std::ios::binary);
+		if (!m_stream.is_open())
+		{
+			::close(m_descriptor);
+			m_descriptor = -1;
+		}
+	}
+#endif
+	if (m_descriptor < 0)
+	{
+		m_temp = get_temp_name(directory_of(m_path), "." + m_path.filename().string() + ".tmp");
+		m_stream.open(m_temp.string(), std::ios::binary);
+	}
+	if (!m_stream.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + m_path.string());
+}
+
+AtomicFile::AtomicFile(std::filesystem::path path, const Durability durability, std::filesystem::path partial, const std::uint64_t offset):
+	m_path(std::move(path)),
+	m_durability(durability),
+	m_descriptor(-1),
+	m_temp(std::move(partial)),
+	m_committed(false),
+	m_kept(false)
+{
+	if (offset)
+	{
+		std::error_code error;
+		if (file_size(m_temp, error) < offset || error)
+			throw std::runtime_error(m_temp.string() + " is shorter than its checkpoint");
+		// What was written after the offset is dropped, it is written again.
+		resize_file(m_temp, offset);
+		m_stream.open(m_temp.string(), std::ios::binary | std::ios::in | std::ios::out);
+		m_stream.seekp(0, std::ios::end);
+	}
+	else
+		m_stream.open(m_temp.string(), std::ios::binary | std::ios::trunc);
+	if (!m_stream.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + m_temp.string());
+}
+
+AtomicFile::~AtomicFile()
+{
+	if (m_stream.is_open())
+		m_stream.close();
+#ifndef _WIN32
+	if (m_descriptor >= 0)
+		::close(m_descriptor);
+#endif
+	if (!m_committed && !m_kept && !m_temp.empty())
+	{
+		std::error_code error;
+		std::filesystem::remove(m_temp, error);
+	}
+}
+
+std::ostream& AtomicFile::stream()
+{
+	return m_stream;
+}
+
+void AtomicFile::flush()
+{
+	if (!m_stream.flush())
+		throw std::ios_base::failure("Failed to write the file: " + m_path.string());
+	if (m_durability == Durability::NONE)
+		return;
+#ifndef _WIN32
+	if (m_descriptor >= 0)
+	{
+		if (::fsync(m_descriptor) != 0)
+			throw std::ios_base::failure("Failed to sync the file: " + m_path.string());
+		Profiler::count(Profiler::Counter::IO_CALLS);
+		return;
+	}
+#endif
+	sync(m_temp);
+}
+
+void AtomicFile::commit()
+{
+	close();
+
+	// Linking never replaces an existing file, unlike a plain rename, so a vault created meanwhile is kept.
+#ifdef O_TMPFILE
+	if (m_descriptor >= 0)
+	{
+		if (::linkat(AT_FDCWD, descriptor_path(m_descriptor).c_str(), AT_FDCWD, m_path.c_str(), AT_SYMLINK_FOLLOW) != 0)
+		{
+			if (errno == EEXIST)
+				throw std::runtime_error(m_path.string() + " already exists");
+			throw std::ios_base::failure("Failed to create the file: " + m_path.string());
+		}
+	}
+	else
+#endif
+	{
+		// Without hard links, as on FAT, the file is renamed, never over an existing one either.
+		std::error_code error;
+		std::filesystem::create_hard_link(m_temp, m_path, error);
+		if (!error)
+			std::filesystem::remove(m_temp);
+		else if (error == std::errc::file_exists || !rename_without_replacing(m_temp, m_path))
+			throw std::runtime_error(m_path.string() + " already exists");
+	}
+	m_committed = true;
+	if (m_durability == Durability::FULL)
+		sync(directory_of(m_path));
+}
+
+void AtomicFile::replace()
+{
+	close();
+#ifdef O_TMPFILE
+	// An anonymous file can't be linked over another one, it is named first and renamed over it.
+	if (m_descriptor >= 0)
+	{
+		m_temp = get_temp_name(directory_of(m_path), "." + m_path.filename().string() + ".tmp");
+		if (::linkat(AT_FDCWD, descriptor_path(m_descriptor).c_str(), AT_FDCWD, m_temp.c_str(), AT_SYMLINK_FOLLOW) != 0)
+		{
+			m_temp.clear();
+			throw std::ios_base::failure("Failed to create the file: " + m_path.string());
+		}
+	}
+#endif
+	std::filesystem::rename(m_temp, m_path);
+	m_committed = true;
+	if (m_durability == Durability::FULL)
+		sync(directory_of(m_path));
+}
+
+void AtomicFile::close()
+{
+	m_stream.close();
+	if (!m_stream)
+		throw std::ios_base::failure("Failed to write the file: " + m_path.string());
+#ifndef _WIN32
+	if (m_descriptor >= 0)
+	{
+		if (m_durability != Durability::NONE && ::fsync(m_descriptor) != 0)
+			throw std::ios_base::failure("Failed to sync the file: " + m_path.string());
+		Profiler::count(Profiler::Counter::IO_CALLS);
+	}
+	else
+#endif
+	if (m_durability != Durability::NONE)
+		sync(m_temp);
+}
+
+void AtomicFile::keep()
+{
+	m_kept = true;
+}
+
+void AtomicFile::sync(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+	// Only files can be flushed on Windows, the directory entries are journaled by NTFS.
+	if (std::filesystem::is_directory(path))
+		return;
+	const auto file = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::ios_base::failure("Failed to open the file: " + path.string());
+	const auto synced = FlushFileBuffers(file);
+	CloseHandle(file);
+#else
+	const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0)
+		throw std::ios_base::failure("Failed to open the file: " + path.string());
+	const auto synced = ::fsync(descriptor) == 0;
+	::close(descriptor);
+#endif
+	if (!synced)
+		throw std::ios_base::failure("Failed to sync the file: " + path.string());
+	Profiler::count(Profiler::Counter::IO_CALLS);
+}
+
+void AtomicFile::sync_file_system(const std::filesystem::path& path)
+{
+#ifdef __linux__
+	// syncfs flushes the whole file system at once, which is cheaper than syncing the files one by one.
+	const int descriptor = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+	if (descriptor < 0)
+		throw std::ios_base::failure("Failed to open the file: " + path.string());
+	const auto synced = ::syncfs(descriptor) == 0;
+	::close(descriptor);
+	if (!synced)
+		throw std::ios_base::failure("Failed to sync the file system of " + path.string());
+	Profiler::count(Profiler::Counter::IO_CALLS);
+#else
+	for (const auto& entry : std::filesystem::recursive_directory_iterator(path))
+	{
+		if (entry.is_regular_file())
+			sync(entry.path());
+	}
+#endif
+}
@@ -0,0 +1,57 @@
+#include "BlockCache.h"
+
+BlockCache::BlockCache(const size_t capacity):
+	m_capacity(capacity),
+	m_size(0)
+{
+}
+
+std::shared_ptr<const BlockCache::Data> BlockCache::get(const std::uint64_t key, const std::function<Data()>& load)
+{
+	{
+		std::scoped_lock lock(m_mutex);
+		if (const auto it = m_index.find(key); it != m_index.end())
+		{
+			m_entries.splice(m_entries.begin(), m_entries, it->second);
+			return it->second->second;
+		}
+	}
+
+	auto data = std::make_shared<const Data>(load());
+	if (data->size() > m_capacity)
+		return data;
+
+	std::scoped_lock lock(m_mutex);
+	if (const auto it = m_index.find(key); it != m_index.end())
+	{
+		m_entries.splice(m_entries.begin(), m_entries, it->second);
+		return it->second->second;
+	}
+	m_entries.emplace_front(key, data);
+	m_index.emplace(key, m_entries.begin());
+	m_size += data->size();
+	evict();
+	return data;
+}
+
+size_t BlockCache::size() const
+{
+	std::scoped_lock lock(m_mutex);
+	return m_size;
+}
+
+size_t BlockCache::capacity() const
+{
+	return m_capacity;
+}
+
+void BlockCache::evict()
+{
+	while (m_size > m_capacity && !m_entries.empty())
+	{
+		const auto& [key, data] = m_entries.back();
+		m_size -= data->size();
+		m_index.erase(key);
+		m_entries.pop_back();
+	}
+}
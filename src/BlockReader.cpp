@@ -0,0 +1,367 @@
+#include "BlockReader.h"
+#include "ChecksumManager.h"
+#include "CompressionManager.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <botan/base64.h>
+#include <botan/hex.h>
+#include <pugixml.hpp>
+
+BlockReader::BlockReader(const std::filesystem::path& path):
+	m_file(path),
+	m_size(m_file.size()),
+	m_directory(path.parent_path()),
+	m_leaves(0),
+	m_authenticated(false),
+	m_progress(nullptr),
+	m_checkpoint(nullptr)
+{
+	// The trailer of the vault before an append is still valid after it, while the new one may not be written yet,
+	// so the vault is read as it was until the append is complete. The blocks appended are left unread.
+	if (const auto length = VaultFormat::appended_length(path); length && *length <= m_size)
+		m_size = *length;
+	read_header();
+	read_tail();
+	if (!m_header.encrypted)
+		load_trailer();
+}
+
+bool BlockReader::is_vault_file(const std::filesystem::path& path)
+{
+	std::ifstream file(path.string(), std::ios::binary);
+	if (!file.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + path.string());
+	std::array<std::uint8_t, VaultFormat::MAGIC.size()> magic{};
+	file.read(reinterpret_cast<char*>(magic.data()), magic.size());
+	return file.gcount() == static_cast<std::streamsize>(magic.size()) && VaultFormat::has_magic(magic);
+}
+
+VaultHeader BlockReader::parse_header(const std::span<const std::uint8_t> bytes)
+{
+	auto doc = pugi::xml_document();
+	if (!doc.load_buffer(bytes.data(), bytes.size()))
+		throw std::runtime_error("Invalid vault file format: unreadable header");
+	const auto root = doc.document_element();
+
+	using namespace std::string_view_literals;
+	VaultHeader header;
+	if (root.name() == "volume"sv)
+		throw std::runtime_error("This is volume " + std::string(root.attribute("number").value()) + " of the vault " + root.attribute("vault").value() + ", open the vault file instead");
+	if (root.name() != "header"sv)
+		throw std::runtime_error("Invalid vault file format: missing header tag");
+	header.version = root.attribute("version").as_uint();
+	header.checksum = VaultFormat::checksum_algorithm(header.version);
+	// The header of a plain vault is not authenticated, so it must not choose a weaker algorithm.
+	if (root.attribute("checksum").value() != header.checksum)
+		throw std::runtime_error("Unsupported checksum algorithm " + std::string(root.attribute("checksum").value()));
+	header.compressed = root.attribute("compression").value() == "zlib"sv;
+	const auto cipher = EncryptionManager::find_cipher(root.attribute("encryption").value());
+	header.encrypted = cipher.has_value();
+	header.cipher = cipher.value_or(Cipher::CHACHA20_POLY1305);
+	if (!header.compressed && root.attribute("compression").value() != "none"sv)
+		throw std::runtime_error("Unsupported compression " + std::string(root.attribute("compression").value()));
+	if (!header.encrypted && root.attribute("encryption").value() != "none"sv)
+		throw std::runtime_error("Unsupported encryption " + std::string(root.attribute("encryption").value()));
+	if (header.encrypted)
+		header.recipients = Recipients(root);
+	if (header.encrypted && root.attribute("keySlots"))
+	{
+		if (root.attribute("keySlots").as_ullong() != KeySlots::COUNT)
+			throw std::runtime_error("Unsupported number of key slots " + std::string(root.attribute("keySlots").value()));
+		header.keySlots.emplace();
+	}
+	else if (header.encrypted && header.recipients.empty())
+	{
+		header.salt = Botan::base64_decode(root.attribute("salt").value());
+		// Vaults written before the parameters were recorded used the legacy ones.
+		if (!root.attribute("kdf"))
+			header.kdf = EncryptionManager::legacy_kdf_parameters();
+		else if (root.attribute("kdf").value() != std::string_view(EncryptionManager::KDF_ALGORITHM))
+			throw std::runtime_error("Unsupported key derivation function " + std::string(root.attribute("kdf").value()));
+		else
+		{
+			header.kdf = {root.attribute("kdfMemory").as_uint(), root.attribute("kdfIterations").as_uint(), root.attribute("kdfLanes").as_uint()};
+			try { EncryptionManager::validate(header.kdf); }
+			catch (const std::invalid_argument& e) { throw std::runtime_error("Invalid vault file format: " + std::string(e.what())); }
+		}
+	}
+	header.framed = root.attribute("framed").as_bool();
+	return header;
+}
+
+VaultTrailer BlockReader::parse_trailer(const std::span<const std::uint8_t> bytes, const VaultHeader& header, const std::span<const std::uint8_t> headerBytes, const std::optional<EncryptionManager::Key>& key)
+{
+	Data trailer(bytes.begin(), bytes.end());
+	if (header.encrypted)
+	{
+		if (!key)
+			throw std::runtime_error("The vault is encrypted but no key has been provided");
+		const auto nonceSize = EncryptionManager::nonce_size(header.cipher);
+		if (trailer.size() < nonceSize)
+			throw std::runtime_error("Invalid vault file format: truncated trailer");
+		const EncryptionManager::Nonce nonce(trailer.begin(), trailer.begin() + nonceSize);
+		try { trailer = EncryptionManager::decrypt(Data(trailer.begin() + nonceSize, trailer.end()), *key, nonce, headerBytes, header.cipher); }
+		catch (const std::exception&) { throw std::runtime_error("Failed to authenticate the vault: wrong password or corrupted vault"); }
+	}
+
+	auto doc = pugi::xml_document();
+	if (!doc.load_buffer(trailer.data(), trailer.size()))
+		throw std::runtime_error("Invalid vault file format: unreadable trailer");
+	const auto root = doc.document_element();
+
+	using namespace std::string_view_literals;
+	if (root.name() != "trailer"sv)
+		throw std::runtime_error("Invalid vault file format: missing trailer tag");
+	VaultTrailer result;
+	const auto index = root.child("index");
+	result.index = {0, index.attribute("offset").as_ullong(), index.attribute("size").as_ullong(), index.attribute("storedSize").as_ullong(), index.attribute("checksum").value()};
+	result.leaves = root.attribute("leaves").as_ullong();
+	result.treeOffset = root.attribute("treeOffset").as_ullong();
+	const auto rootHash = Botan::hex_decode(root.attribute("root").value());
+	result.root.assign(rootHash.begin(), rootHash.end());
+	for (const auto& volume : root.children("volume"))
+	{
+		const std::filesystem::path name = volume.attribute("name").value();
+		if (name.empty() || name != name.filename())
+			throw std::runtime_error("Invalid vault file format: invalid volume name " + name.string());
+		result.volumes.push_back({name.string(), volume.attribute("size").as_ullong()});
+	}
+	return result;
+}
+
+BlockReader::Data BlockReader::decode(const std::span<const std::uint8_t> stored, const std::uint64_t size, const VaultHeader& header, const std::optional<EncryptionManager::Key>& key)
+{
+	Data data(stored.begin(), stored.end());
+	if (header.encrypted)
+	{
+		if (!key)
+			throw std::runtime_error("The vault is encrypted but no key has been provided");
+		const auto nonceSize = EncryptionManager::nonce_size(header.cipher);
+		if (data.size() < nonceSize)
+			throw std::runtime_error("Invalid vault file format: truncated encrypted block");
+		const EncryptionManager::Nonce nonce(data.begin(), data.begin() + nonceSize);
+		data = EncryptionManager::decrypt(Data(data.begin() + nonceSize, data.end()), *key, nonce, {}, header.cipher);
+	}
+	if (header.compressed)
+		return CompressionManager::uncompress(data, size);
+	if (data.size() != size)
+		throw std::runtime_error("Invalid vault file format: block size mismatch");
+	return data;
+}
+
+const VaultHeader& BlockReader::header() const
+{
+	return m_header;
+}
+
+std::span<const std::uint8_t> BlockReader::header_bytes() const
+{
+	return m_headerBytes;
+}
+
+const std::optional<EncryptionManager::Key>& BlockReader::key() const
+{
+	return m_key;
+}
+
+std::uint64_t BlockReader::size() const
+{
+	return m_size;
+}
+
+std::uint64_t BlockReader::key_slots_offset() const
+{
+	return VaultFormat::MAGIC.size() + sizeof(std::uint32_t) + m_headerBytes.size();
+}
+
+std::uint64_t BlockReader::data_offset() const
+{
+	return key_slots_offset() + (m_header.keySlots ? KeySlots::SIZE : 0);
+}
+
+const BlockInfo& BlockReader::index() const
+{
+	return m_index;
+}
+
+const std::vector<VolumeInfo>& BlockReader::volumes() const
+{
+	return m_volumes;
+}
+
+MerkleTree BlockReader::tree() const
+{
+	if (!m_authenticated)
+		throw std::runtime_error("The vault is encrypted but no key has been provided");
+	return MerkleTree(m_header.checksum, m_tree.first(m_leaves * m_root.size()));
+}
+
+std::filesystem::path BlockReader::volume_path(const VolumeInfo& volume) const
+{
+	return m_directory / volume.name;
+}
+
+size_t BlockReader::mapped_volumes() const
+{
+	std::scoped_lock lock(m_volumeMutex);
+	return static_cast<size_t>(std::ranges::count_if(m_volumeFiles, [](const auto& file) { return file != nullptr; }));
+}
+
+void BlockReader::set_key(EncryptionManager::Key key)
+{
+	m_key = std::move(key);
+	if (!m_authenticated)
+		load_trailer();
+}
+
+void BlockReader::set_progress(ProgressTracker* progress)
+{
+	m_progress = progress;
+}
+
+void BlockReader::report_entry() const
+{
+	if (m_progress)
+		m_progress->add(1, 0, 0);
+}
+
+void BlockReader::report_hole(const std::uint64_t size) const
+{
+	if (m_progress)
+		m_progress->add(0, 0, size);
+}
+
+BlockReader::Data BlockReader::read(const BlockInfo& block) const
+{
+	if (!m_authenticated)
+		throw std::runtime_error("The vault is encrypted but no key has been provided");
+	if (!MerkleTree::verify(block, m_tree, m_leaves, m_root, m_header.checksum))
+		throw std::runtime_error("Unauthenticated vault block at offset " + std::to_string(block.offset));
+	auto data = load(block);
+	if (m_progress)
+		m_progress->add(0, block.storedSize, data.size());
+	return data;
+}
+
+BlockReader::Data BlockReader::read_index() const
+{
+	if (!m_authenticated)
+		throw std::runtime_error("The vault is encrypted but no key has been provided");
+	try { return load(m_index); }
+	catch (const std::runtime_error& e) { throw std::runtime_error("Failed to read the vault index: " + std::string(e.what())); }
+}
+
+BlockReader::Data BlockReader::stored(const BlockInfo& block) const
+{
+	if (!m_authenticated)
+		throw std::runtime_error("The vault is encrypted but no key has been provided");
+	if (!MerkleTree::verify(block, m_tree, m_leaves, m_root, m_header.checksum))
+		throw std::runtime_error("Unauthenticated vault block at offset " + std::to_string(block.offset));
+	const auto& file = block.volume ? volume(block.volume) : m_file;
+	const auto stored = checked(file, block);
+	Data data(stored.begin(), stored.end());
+	file.release(block.offset, block.storedSize);
+	return data;
+}
+
+void BlockReader::set_checkpoint(Checkpoint* checkpoint)
+{
+	m_checkpoint = checkpoint;
+}
+
+void BlockReader::checkpoint(const std::filesystem::path& path, const Checkpoint::Entry& entry) const
+{
+	if (m_checkpoint)
+		m_checkpoint->record(path, entry);
+}
+
+void BlockReader::read_header()
+{
+	const auto data = m_file.data();
+	if (!VaultFormat::has_magic(data))
+		throw std::runtime_error("Invalid vault file format: missing magic number");
+	const auto headerSize = VaultFormat::read_uint(data.subspan(VaultFormat::MAGIC.size()), sizeof(std::uint32_t));
+	m_headerBytes = m_file.data(VaultFormat::MAGIC.size() + sizeof(std::uint32_t), headerSize);
+	m_header = parse_header(m_headerBytes);
+	if (m_header.keySlots)
+	{
+		if (m_file.size() < key_slots_offset() + KeySlots::SIZE)
+			throw std::runtime_error("Invalid vault file format: truncated key slots");
+		m_header.keySlots = KeySlots(m_file.data(key_slots_offset(), KeySlots::SIZE));
+	}
+}
+
+void BlockReader::read_tail()
+{
+	const auto dataOffset = data_offset();
+	if (m_size < dataOffset + VaultFormat::TAIL_SIZE)
+		throw std::runtime_error("Invalid vault file format: missing trailer");
+	const auto tail = m_file.data(m_size - VaultFormat::TAIL_SIZE, VaultFormat::TAIL_SIZE);
+	if (!VaultFormat::has_magic(tail.last(VaultFormat::MAGIC.size())))
+		throw std::runtime_error("Invalid vault file format: truncated vault");
+	const auto trailerSize = VaultFormat::read_uint(tail, sizeof(std::uint64_t));
+	if (trailerSize > m_size - dataOffset - VaultFormat::TAIL_SIZE)
+		throw std::runtime_error("Invalid vault file format: trailer out of bounds");
+	m_trailer = m_file.data(m_size - VaultFormat::TAIL_SIZE - trailerSize, trailerSize);
+}
+
+void BlockReader::load_trailer()
+{
+	auto trailer = parse_trailer(m_trailer, m_header, m_headerBytes, m_key);
+	m_index = std::move(trailer.index);
+	m_leaves = trailer.leaves;
+	m_root = std::move(trailer.root);
+	m_tree = m_file.data(trailer.treeOffset, MerkleTree::serialized_size(m_leaves, m_root.size()));
+	m_volumes = std::move(trailer.volumes);
+	m_volumeFiles.resize(m_volumes.size());
+	m_authenticated = true;
+}
+
+const MappedFile& BlockReader::volume(const std::uint64_t number) const
+{
+	if (number == 0 || number > m_volumes.size())
+		throw std::runtime_error("Invalid vault file format: unknown volume " + std::to_string(number));
+	// Volumes are only mapped when one of their blocks is read, so the missing ones only fail the entries they hold.
+	std::scoped_lock lock(m_volumeMutex);
+	auto& file = m_volumeFiles[number - 1];
+	if (file)
+		return *file;
+	const auto& info = m_volumes[number - 1];
+	const auto path = volume_path(info);
+	if (!exists(path))
+		throw std::runtime_error("Missing vault volume: " + path.string());
+	auto mapped = std::make_unique<MappedFile>(path);
+	if (mapped->size() != info.size)
+		throw std::runtime_error("Invalid vault volume: " + path.string() + " has " + std::to_string(mapped->size()) + " bytes instead of " + std::to_string(info.size));
+	if (!VaultFormat::has_magic(mapped->data()))
+		throw std::runtime_error("Invalid vault volume: " + path.string() + " has no magic number");
+	const auto headerSize = VaultFormat::read_uint(mapped->data().subspan(VaultFormat::MAGIC.size()), sizeof(std::uint32_t));
+	const auto header = mapped->data(VaultFormat::MAGIC.size() + sizeof(std::uint32_t), headerSize);
+	auto doc = pugi::xml_document();
+	using namespace std::string_view_literals;
+	if (!doc.load_buffer(header.data(), header.size()) || doc.document_element().name() != "volume"sv || doc.document_element().attribute("number").as_ullong() != number)
+		throw std::runtime_error("Invalid vault volume: " + path.string() + " is not volume " + std::to_string(number) + " of the vault");
+	Profiler::count(Profiler::Counter::IO_CALLS);
+	file = std::move(mapped);
+	return *file;
+}
+
+std::span<const std::uint8_t> BlockReader::checked(const MappedFile& file, const BlockInfo& block) const
+{
+	const auto stored = file.data(block.offset, block.storedSize);
+	Profiler::count(Profiler::Counter::BYTES_READ, stored.size());
+	if (!ChecksumManager::matches(stored, block.checksum, m_header.checksum))
+		throw std::runtime_error("Corrupted vault block at offset " + std::to_string(block.offset));
+	return stored;
+}
+
+BlockReader::Data BlockReader::load(const BlockInfo& block) const
+{
+	const auto& file = block.volume ? volume(block.volume) : m_file;
+	// Verifying or opening a vault reads each block once, its pages aren't needed after it is decoded.
+	auto data = decode(checked(file, block), block.size, m_header, m_key);
+	file.release(block.offset, block.storedSize);
+	return data;
+}
@@ -0,0 +1,428 @@
+#include "BlockWriter.h"
+#include "ChecksumManager.h"
+#include "CompressionManager.h"
+#include "MemoryBudget.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <deque>
+#include <sstream>
+#include <botan/base64.h>
+#include <botan/hex.h>
+#include <pugixml.hpp>
+
+BlockWriter::BlockWriter(std::ostream& stream, VaultHeader header, std::optional<EncryptionManager::Key> key, const size_t threads):
+	m_stream(stream),
+	m_header(std::move(header)),
+	m_key(std::move(key)),
+	m_offset(0),
+	m_tree(m_header.checksum),
+	m_pool(threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr),
+	m_progress(nullptr),
+	m_checkpoint(nullptr),
+	m_volumeSize(0),
+	m_finished(false)
+{
+	if (m_header.encrypted != m_key.has_value())
+		throw std::invalid_argument("An encryption key must be provided if and only if the vault is encrypted");
+	write_header();
+}
+
+BlockWriter::BlockWriter(std::ostream& stream, VaultHeader header, std::vector<std::uint8_t> headerBytes, std::optional<EncryptionManager::Key> key, const size_t threads, Checkpoint& checkpoint):
+	m_stream(stream),
+	m_header(std::move(header)),
+	m_key(std::move(key)),
+	m_offset(checkpoint.offset()),
+	m_headerBytes(std::move(headerBytes)),
+	m_tree(m_header.checksum),
+	m_pool(threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr),
+	m_progress(nullptr),
+	m_checkpoint(&checkpoint),
+	m_volumeSize(0),
+	m_finished(false)
+{
+	if (m_header.encrypted != m_key.has_value())
+		throw std::invalid_argument("An encryption key must be provided if and only if the vault is encrypted");
+	if (m_key)
+		checkpoint.seal(*m_key, m_header.cipher);
+	// The tree is rebuilt from the blocks committed, which must be the first leaves in the order they were written.
+	for (const auto& block : checkpoint.blocks())
+	{
+		if (block.id != m_tree.leaves() || block.volume || block.offset + block.storedSize > m_offset)
+			throw std::runtime_error("Invalid checkpoint: the block " + std::to_string(block.id) + " is not in the partial vault");
+		m_tree.add(block);
+	}
+}
+
+BlockWriter::BlockWriter(std::ostream& stream, VaultHeader header, std::vector<std::uint8_t> headerBytes, std::optional<EncryptionManager::Key> key, const size_t threads, const std::uint64_t offset, MerkleTree tree):
+	m_stream(stream),
+	m_header(std::move(header)),
+	m_key(std::move(key)),
+	m_offset(offset),
+	m_headerBytes(std::move(headerBytes)),
+	m_tree(std::move(tree)),
+	m_pool(threads > 1 ? std::make_unique<ThreadPool>(threads) : nullptr),
+	m_progress(nullptr),
+	m_checkpoint(nullptr),
+	m_volumeSize(0),
+	m_finished(false)
+{
+	if (m_header.encrypted != m_key.has_value())
+		throw std::invalid_argument("An encryption key must be provided if and only if the vault is encrypted");
+}
+
+BlockWriter::~BlockWriter()
+{
+	// The volumes of a vault that is not finished are removed with it.
+	for (const auto& volume : m_volumes)
+	{
+		try { volume->close(); }
+		catch (const std::exception&) {}
+		if (!m_finished)
+		{
+			std::error_code error;
+			std::filesystem::remove(volume->path(), error);
+		}
+	}
+}
+
+const VaultHeader& BlockWriter::header() const
+{
+	return m_header;
+}
+
+void BlockWriter::set_progress(ProgressTracker* progress)
+{
+	m_progress = progress;
+}
+
+void BlockWriter::set_volumes(const std::filesystem::path& vault, const std::uint64_t volumeSize)
+{
+	if (volumeSize < VaultFormat::MIN_VOLUME_SIZE)
+		throw std::invalid_argument("The volume size must be at least " + MemoryBudget::format(VaultFormat::MIN_VOLUME_SIZE));
+	if (m_header.framed)
+		throw std::invalid_argument("A framed vault can't be split in volumes");
+	m_vault = vault;
+	m_volumeSize = volumeSize;
+}
+
+void BlockWriter::set_source(const std::filesystem::path& source)
+{
+	m_source = source;
+}
+
+void BlockWriter::begin_entry(const std::filesystem::path& path)
+{
+	// A file without blocks has nothing to extract, so it gets no entry.
+	if (m_header.framed)
+		m_entry = (m_source.empty() ? path : path.lexically_relative(m_source)).generic_string();
+}
+
+void BlockWriter::report_entry()
+{
+	if (m_progress)
+		m_progress->add(1, 0, 0);
+}
+
+void BlockWriter::set_checkpoint(Checkpoint* checkpoint)
+{
+	m_checkpoint = checkpoint;
+	if (m_checkpoint && m_key)
+		m_checkpoint->seal(*m_key, m_header.cipher);
+}
+
+std::optional<BlockWriter::Entry> BlockWriter::resumed(const std::filesystem::path& path, const std::filesystem::file_time_type lastWriteTime)
+{
+	if (!m_checkpoint)
+		return std::nullopt;
+	const auto entry = m_checkpoint->find(path);
+	std::error_code error;
+	if (!entry || entry->lastWriteTime != lastWriteTime || entry->size != file_size(path, error) || error)
+		return std::nullopt;
+	if (m_progress)
+	{
+		std::uint64_t stored = 0;
+		for (const auto& block : entry->blocks)
+			stored += block.storedSize;
+		m_progress->add(1, entry->size, stored);
+	}
+	return Entry{entry->size, entry->checksum, entry->blocks};
+}
+
+void BlockWriter::checkpoint(const std::filesystem::path& path, const std::filesystem::file_time_type lastWriteTime, const Entry& entry)
+{
+	if (m_checkpoint)
+		m_checkpoint->record(path, {entry.size, lastWriteTime, entry.checksum, entry.blocks}, m_offset);
+}
+
+BlockInfo BlockWriter::write(Data data)
+{
+	return append(encode(std::move(data)));
+}
+
+BlockWriter::Entry BlockWriter::write(std::istream& stream, const std::vector<Hole>& holes)
+{
+	Entry entry;
+	ChecksumManager::Stream checksum(m_header.checksum);
+	// Chunks are encoded on the pool but written in order, with a bounded number of them in flight.
+	std::deque<std::future<EncodedBlock>> pending;
+	const auto depth = m_pool ? 2 * m_pool->size() : 0;
+	std::uint64_t end = 0;
+	if (!holes.empty())
+	{
+		stream.seekg(0, std::ios::end);
+		end = static_cast<std::uint64_t>(stream.tellg());
+		stream.seekg(0);
+	}
+	auto hole = holes.begin();
+	while (stream)
+	{
+		// A chunk entirely in a hole is recorded without being read, so only the allocated data is stored.
+		while (hole != holes.end() && hole->offset + hole->length <= entry.size)
+			++hole;
+		if (const auto length = std::min<std::uint64_t>(VaultFormat::CHUNK_SIZE, end - std::min(end, entry.size));
+			length && hole != holes.end() && hole->offset <= entry.size && entry.size + length <= hole->offset + hole->length)
+		{
+			for (; !pending.empty(); pending.pop_front())
+				entry.blocks.push_back(append(pending.front().get()));
+			entry.blocks.push_back(append({length, {}, {}}));
+			entry.size += length;
+			if (!stream.seekg(static_cast<std::streamoff>(entry.size)))
+				throw std::ios_base::failure("Failed to read the data to store");
+			if (m_progress)
+				m_progress->add(0, length, 0);
+			continue;
+		}
+
+		Data chunk(VaultFormat::CHUNK_SIZE);
+		stream.read(reinterpret_cast<char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+		if (stream.bad())
+			throw std::ios_base::failure("Failed to read the data to store");
+		chunk.resize(static_cast<size_t>(stream.gcount()));
+		Profiler::count(Profiler::Counter::IO_CALLS);
+		Profiler::count(Profiler::Counter::BYTES_READ, chunk.size());
+		if (m_progress)
+			m_progress->add(0, chunk.size(), 0);
+		if (chunk.empty())
+			break;
+		checksum.update(chunk);
+		entry.size += chunk.size();
+		if (!m_pool)
+		{
+			entry.blocks.push_back(write(std::move(chunk)));
+			continue;
+		}
+		pending.push_back(m_pool->submit([this, chunk = std::move(chunk)]() mutable { return encode(std::move(chunk)); }));
+		if (pending.size() >= depth)
+		{
+			entry.blocks.push_back(append(pending.front().get()));
+			pending.pop_front();
+		}
+	}
+	for (; !pending.empty(); pending.pop_front())
+		entry.blocks.push_back(append(pending.front().get()));
+	m_entry.reset();
+	entry.checksum = checksum.final();
+	if (m_progress)
+		m_progress->add(1, 0, 0);
+	return entry;
+}
+
+BlockInfo BlockWriter::copy(const BlockInfo& block, Data stored)
+{
+	return append({block.size, std::move(stored), block.checksum});
+}
+
+void BlockWriter::finish(Data index)
+{
+	const auto encoded = encode(std::move(index));
+	m_entry.reset();
+	write_frame(FrameType::INDEX, encoded.stored.size(), encoded.size);
+	const BlockInfo block{0, m_offset, encoded.size, encoded.stored.size(), encoded.checksum};
+	write_raw(encoded.stored);
+	write_frame(FrameType::TREE, m_tree.size(), m_tree.size());
+	const auto treeOffset = m_offset;
+	m_offset += m_tree.write(m_stream);
+	for (const auto& volume : m_volumes)
+		volume->close();
+	write_trailer(block, treeOffset);
+	m_stream.flush();
+	if (!m_stream)
+		throw std::ios_base::failure("Failed to write the vault index");
+	m_finished = true;
+}
+
+void BlockWriter::write_header()
+{
+	auto doc = pugi::xml_document();
+	auto node = doc.append_child("header");
+	if (!node)
+		throw std::runtime_error("Failed to create the XML node");
+	node.append_attribute("version").set_value(m_header.version);
+	node.append_attribute("compression").set_value(m_header.compressed ? "zlib" : "none");
+	node.append_attribute("encryption").set_value(m_header.encrypted ? EncryptionManager::cipher_name(m_header.cipher).data() : "none");
+	node.append_attribute("checksum").set_value(m_header.checksum.c_str());
+	if (m_header.encrypted && m_header.keySlots)
+		node.append_attribute("keySlots").set_value(KeySlots::COUNT);
+	else if (m_header.encrypted && m_header.recipients.empty())
+	{
+		node.append_attribute("salt").set_value(Botan::base64_encode(m_header.salt).c_str());
+		node.append_attribute("kdf").set_value(EncryptionManager::KDF_ALGORITHM);
+		node.append_attribute("kdfMemory").set_value(m_header.kdf.memory);
+		node.append_attribute("kdfIterations").set_value(m_header.kdf.iterations);
+		node.append_attribute("kdfLanes").set_value(m_header.kdf.lanes);
+	}
+	if (m_header.encrypted)
+		m_header.recipients.write(node);
+	if (m_header.framed)
+		node.append_attribute("framed").set_value(true);
+
+	std::ostringstream content;
+	doc.save(content, "", pugi::format_raw | pugi::format_no_declaration);
+	const auto str = content.str();
+
+	m_stream.write(VaultFormat::MAGIC.data(), VaultFormat::MAGIC.size());
+	VaultFormat::write_uint(m_stream, str.size(), sizeof(std::uint32_t));
+	m_stream.write(str.data(), static_cast<std::streamsize>(str.size()));
+	if (m_header.keySlots)
+		m_header.keySlots->write(m_stream);
+	if (!m_stream)
+		throw std::ios_base::failure("Failed to write the vault header");
+	m_offset = VaultFormat::MAGIC.size() + sizeof(std::uint32_t) + str.size() + (m_header.keySlots ? KeySlots::SIZE : 0);
+	m_headerBytes.assign(str.begin(), str.end());
+}
+
+void BlockWriter::write_trailer(const BlockInfo& index, const std::uint64_t treeOffset)
+{
+	auto doc = pugi::xml_document();
+	auto node = doc.append_child("trailer");
+	if (!node)
+		throw std::runtime_error("Failed to create the XML node");
+	node.append_attribute("leaves").set_value(std::to_string(m_tree.leaves()).c_str());
+	node.append_attribute("treeOffset").set_value(std::to_string(treeOffset).c_str());
+	node.append_attribute("root").set_value(Botan::hex_encode(m_tree.root(), false).c_str());
+	auto indexNode = node.append_child("index");
+	if (!indexNode)
+		throw std::runtime_error("Failed to create the XML node");
+	indexNode.append_attribute("offset").set_value(std::to_string(index.offset).c_str());
+	indexNode.append_attribute("size").set_value(std::to_string(index.size).c_str());
+	indexNode.append_attribute("storedSize").set_value(std::to_string(index.storedSize).c_str());
+	indexNode.append_attribute("checksum").set_value(index.checksum.c_str());
+	for (const auto& volume : m_volumes)
+	{
+		auto volumeNode = node.append_child("volume");
+		if (!volumeNode)
+			throw std::runtime_error("Failed to create the XML node");
+		volumeNode.append_attribute("name").set_value(volume->path().filename().string().c_str());
+		volumeNode.append_attribute("size").set_value(std::to_string(volume->size()).c_str());
+	}
+
+	std::ostringstream content;
+	doc.save(content, "", pugi::format_raw | pugi::format_no_declaration);
+	const auto str = content.str();
+
+	Data trailer(str.begin(), str.end());
+	if (m_key)
+	{
+		auto [encryptedTrailer, nonce] = EncryptionManager::encrypt(std::move(trailer), *m_key, m_headerBytes, m_header.cipher);
+		nonce.insert(nonce.end(), encryptedTrailer.begin(), encryptedTrailer.end());
+		trailer = std::move(nonce);
+	}
+	write_frame(FrameType::TRAILER, trailer.size(), trailer.size());
+	write_raw(trailer);
+	VaultFormat::write_uint(m_stream, trailer.size(), sizeof(std::uint64_t));
+	m_stream.write(VaultFormat::MAGIC.data(), VaultFormat::MAGIC.size());
+}
+
+void BlockWriter::write_raw(const std::span<const std::uint8_t> data)
+{
+	m_stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	if (!m_stream)
+		throw std::ios_base::failure("Failed to write the vault data");
+	Profiler::count(Profiler::Counter::IO_CALLS);
+	Profiler::count(Profiler::Counter::BYTES_WRITTEN, data.size());
+	m_offset += data.size();
+}
+
+void BlockWriter::write_frame(const FrameType type, const std::uint64_t length, const std::uint64_t size)
+{
+	if (!m_header.framed)
+		return;
+	VaultFormat::write_frame(m_stream, type, length, size);
+	if (!m_stream)
+		throw std::ios_base::failure("Failed to write the vault data");
+	m_offset += VaultFormat::FRAME_SIZE;
+}
+
+void BlockWriter::open_volume()
+{
+	// Each volume starts with its own header, so its blocks can be decoded without the other volumes.
+	auto doc = pugi::xml_document();
+	auto node = doc.append_child("volume");
+	if (!node)
+		throw std::runtime_error("Failed to create the XML node");
+	node.append_attribute("version").set_value(m_header.version);
+	node.append_attribute("number").set_value(std::to_string(m_volumes.size() + 1).c_str());
+	node.append_attribute("vault").set_value(m_vault.filename().string().c_str());
+	node.append_attribute("compression").set_value(m_header.compressed ? "zlib" : "none");
+	node.append_attribute("encryption").set_value(m_header.encrypted ? EncryptionManager::cipher_name(m_header.cipher).data() : "none");
+	node.append_attribute("checksum").set_value(m_header.checksum.c_str());
+
+	std::ostringstream content;
+	doc.save(content, "", pugi::format_raw | pugi::format_no_declaration);
+	const auto str = content.str();
+	if (!m_volumes.empty())
+		m_volumes.back()->seal();
+	m_volumes.push_back(std::make_unique<VolumeWriter>(VaultFormat::volume_path(m_vault, m_volumes.size() + 1), std::vector<std::uint8_t>(str.begin(), str.end())));
+}
+
+BlockInfo BlockWriter::append(EncodedBlock block)
+{
+	// The entry naming the file is framed before its first block, or the first hole in it.
+	if (m_entry)
+	{
+		const auto entry = encode(Data(m_entry->begin(), m_entry->end()));
+		m_entry.reset();
+		write_frame(FrameType::ENTRY, entry.stored.size(), entry.size);
+		write_raw(entry.stored);
+	}
+	// A hole has nothing to store, and no leaf in the tree since it has nothing to authenticate.
+	if (block.stored.empty())
+	{
+		write_frame(FrameType::HOLE, 0, block.size);
+		return {0, 0, block.size, 0, {}};
+	}
+	write_frame(FrameType::BLOCK, block.stored.size(), block.size);
+	BlockInfo info{m_tree.leaves(), m_offset, block.size, block.stored.size(), block.checksum};
+	if (!m_volumeSize)
+		write_raw(block.stored);
+	else
+	{
+		// A block is never split, the volume is full when the next one doesn't fit in it.
+		if (m_volumes.empty() || m_volumes.back()->size() + block.stored.size() > m_volumeSize)
+			open_volume();
+		info.volume = m_volumes.size();
+		info.offset = m_volumes.back()->size();
+		m_volumes.back()->write(std::move(block.stored));
+	}
+	m_tree.add(info);
+	if (m_progress)
+		m_progress->add(0, 0, info.storedSize);
+	return info;
+}
+
+BlockWriter::EncodedBlock BlockWriter::encode(Data data) const
+{
+	EncodedBlock block{data.size(), {}, {}};
+	if (m_header.compressed)
+		data = CompressionManager::compress(data);
+	if (m_key)
+	{
+		auto [encryptedData, nonce] = EncryptionManager::encrypt(std::move(data), *m_key, {}, m_header.cipher);
+		nonce.insert(nonce.end(), encryptedData.begin(), encryptedData.end());
+		data = std::move(nonce);
+	}
+	block.checksum = ChecksumManager::compute(data, m_header.checksum);
+	block.stored = std::move(data);
+	return block;
+}
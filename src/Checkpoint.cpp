@@ -0,0 +1,302 @@
+#include "Checkpoint.h"
+
+#include <sstream>
+#include <stdexcept>
+#include <botan/base64.h>
+
+namespace
+{
+	void write_block(pugi::xml_node& node, const BlockInfo& block)
+	{
+		auto child = node.append_child(block.hole() ? "hole" : "block");
+		if (!child)
+			throw std::runtime_error("Failed to create the XML node");
+		child.append_attribute("size").set_value(std::to_string(block.size).c_str());
+		if (block.hole())
+			return;
+		child.append_attribute("id").set_value(std::to_string(block.id).c_str());
+		child.append_attribute("offset").set_value(std::to_string(block.offset).c_str());
+		child.append_attribute("storedSize").set_value(std::to_string(block.storedSize).c_str());
+		child.append_attribute("checksum").set_value(block.checksum.c_str());
+	}
+
+	BlockInfo read_block(const pugi::xml_node& node)
+	{
+		using namespace std::string_view_literals;
+		if (node.name() == "hole"sv)
+			return {0, 0, node.attribute("size").as_ullong(), 0, {}};
+		return {node.attribute("id").as_ullong(), node.attribute("offset").as_ullong(), node.attribute("size").as_ullong(), node.attribute("storedSize").as_ullong(), node.attribute("checksum").value()};
+	}
+}
+
+Checkpoint::Checkpoint(std::filesystem::path journal, std::filesystem::path root, const std::filesystem::path& origin, const bool resume, const Durability durability):
+	m_journal(std::move(journal)),
+	m_root(std::move(root)),
+	m_origin(absolute(origin).lexically_normal().generic_string()),
+	m_durability(durability),
+	m_cipher(Cipher::CHACHA20_POLY1305),
+	m_offset(0),
+	m_pendingOffset(0),
+	m_pendingBytes(0),
+	m_pending(false),
+	m_resumed(false),
+	m_committed(false)
+{
+	std::uint64_t length = 0;
+	if (resume && exists(m_journal))
+		length = load();
+	if (m_resumed)
+	{
+		// The lines recorded after the last commit, possibly torn by the interruption, are dropped.
+		resize_file(m_journal, length);
+		m_stream.open(m_journal.string(), std::ios::binary | std::ios::app);
+		m_committed = true;
+	}
+	else
+		m_stream.open(m_journal.string(), std::ios::binary | std::ios::trunc);
+	if (!m_stream.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + m_journal.string());
+	if (m_resumed)
+		return;
+	auto doc = pugi::xml_document();
+	auto node = doc.append_child("checkpoint");
+	if (!node)
+		throw std::runtime_error("Failed to create the XML node");
+	node.append_attribute("origin").set_value(m_origin.c_str());
+	write_line(node);
+}
+
+std::filesystem::path Checkpoint::partial_path(const std::filesystem::path& output)
+{
+	return output.parent_path() / ("." + output.filename().string() + ".partial");
+}
+
+std::filesystem::path Checkpoint::journal_path(const std::filesystem::path& output)
+{
+	return output.parent_path() / ("." + output.filename().string() + ".checkpoint");
+}
+
+bool Checkpoint::resumed() const
+{
+	return m_resumed;
+}
+
+std::uint64_t Checkpoint::offset() const
+{
+	return m_offset;
+}
+
+const std::vector<BlockInfo>& Checkpoint::blocks() const
+{
+	return m_blocks;
+}
+
+const Checkpoint::Entry* Checkpoint::find(const std::filesystem::path& path) const
+{
+	const auto entry = m_entries.find(relative(path));
+	return entry != m_entries.end() ? &entry->second : nullptr;
+}
+
+void Checkpoint::seal(const EncryptionManager::Key& key, const Cipher cipher)
+{
+	std::scoped_lock lock(m_mutex);
+	if (m_key)
+		return;
+	m_key = key;
+	m_cipher = cipher;
+	for (const auto& line : m_sealed)
+	{
+		auto doc = pugi::xml_document();
+		doc.load_buffer(line.data(), line.size());
+		const auto node = doc.document_element();
+		EncryptionManager::Data data;
+		try
+		{
+			const auto nonce = Botan::base64_decode(node.attribute("nonce").value());
+			data = EncryptionManager::decrypt(Botan::base64_decode(node.attribute("data").value()), key, nonce, associated_data(), cipher);
+		}
+		catch (const std::exception&)
+		{
+			throw std::runtime_error("Invalid checkpoint: an entry of " + m_journal.string() + " can't be unsealed");
+		}
+		auto entry = pugi::xml_document();
+		if (!entry.load_buffer(data.data(), data.size()) || entry.document_element().name() != std::string_view("file"))
+			throw std::runtime_error("Invalid checkpoint: an entry of " + m_journal.string() + " can't be read");
+		add(entry.document_element());
+	}
+	m_sealed.clear();
+}
+
+void Checkpoint::set_sync(std::function<void()> sync)
+{
+	m_sync = std::move(sync);
+}
+
+void Checkpoint::record(const std::filesystem::path& path, const Entry& entry, const std::uint64_t offset)
+{
+	auto doc = pugi::xml_document();
+	auto node = doc.append_child("file");
+	if (!node)
+		throw std::runtime_error("Failed to create the XML node");
+	node.append_attribute("path").set_value(relative(path).c_str());
+	node.append_attribute("size").set_value(std::to_string(entry.size).c_str());
+	node.append_attribute("lastWriteTime").set_value(std::to_string(entry.lastWriteTime.time_since_epoch().count()).c_str());
+	node.append_attribute("checksum").set_value(entry.checksum.c_str());
+	for (const auto& block : entry.blocks)
+		write_block(node, block);
+
+	std::scoped_lock lock(m_mutex);
+	if (m_key)
+	{
+		std::ostringstream content;
+		node.print(content, "", pugi::format_raw);
+		const auto line = content.str();
+		auto [data, nonce] = EncryptionManager::encrypt(EncryptionManager::Data(line.begin(), line.end()), *m_key, associated_data(), m_cipher);
+		auto sealedDoc = pugi::xml_document();
+		auto sealed = sealedDoc.append_child("sealed");
+		if (!sealed)
+			throw std::runtime_error("Failed to create the XML node");
+		sealed.append_attribute("nonce").set_value(Botan::base64_encode(nonce).c_str());
+		sealed.append_attribute("data").set_value(Botan::base64_encode(data).c_str());
+		write_line(sealed);
+	}
+	else
+		write_line(node);
+	m_pending = true;
+	m_pendingOffset = offset;
+	m_pendingBytes += entry.size;
+	if (m_pendingBytes >= INTERVAL)
+		commit_locked();
+}
+
+void Checkpoint::commit()
+{
+	std::scoped_lock lock(m_mutex);
+	commit_locked();
+}
+
+bool Checkpoint::keep()
+{
+	std::scoped_lock lock(m_mutex);
+	try { commit_locked(); }
+	catch (const std::exception&) {}
+	return m_committed;
+}
+
+void Checkpoint::remove()
+{
+	std::scoped_lock lock(m_mutex);
+	m_stream.close();
+	std::error_code error;
+	std::filesystem::remove(m_journal, error);
+}
+
+std::uint64_t Checkpoint::load()
+{
+	std::ifstream stream(m_journal.string(), std::ios::binary);
+	if (!stream.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + m_journal.string());
+
+	using namespace std::string_view_literals;
+	std::vector<std::string> pending;
+	std::uint64_t length = 0;
+	std::uint64_t position = 0;
+	std::string line;
+	for (bool first = true; std::getline(stream, line); first = false)
+	{
+		// A line without its end was torn by the interruption, it and the following ones are ignored.
+		if (stream.eof())
+			break;
+		position += line.size() + 1;
+		auto doc = pugi::xml_document();
+		if (!doc.load_buffer(line.data(), line.size()))
+			break;
+		const auto node = doc.document_element();
+		if (first)
+		{
+			// A journal left by the close or the open of something else is not resumed.
+			if (node.name() != "checkpoint"sv || node.attribute("origin").value() != m_origin)
+				return 0;
+			continue;
+		}
+		if (node.name() == "file"sv || node.name() == "sealed"sv)
+			pending.push_back(std::move(line));
+		else if (node.name() == "commit"sv)
+		{
+			// The sealed entries are only read once the key is known.
+			for (const auto& entry : pending)
+			{
+				auto entryDoc = pugi::xml_document();
+				entryDoc.load_buffer(entry.data(), entry.size());
+				if (entryDoc.document_element().name() == "sealed"sv)
+					m_sealed.push_back(entry);
+				else
+					add(entryDoc.document_element());
+			}
+			pending.clear();
+			m_offset = node.attribute("offset").as_ullong();
+			m_resumed = true;
+			length = position;
+		}
+		else
+			break;
+	}
+	return length;
+}
+
+void Checkpoint::add(const pugi::xml_node& node)
+{
+	Entry entry{node.attribute("size").as_ullong(), std::filesystem::file_time_type(std::filesystem::file_time_type::duration(node.attribute("lastWriteTime").as_llong())), node.attribute("checksum").value(), {}};
+	for (const auto& child : node.children())
+	{
+		entry.blocks.push_back(read_block(child));
+		if (!entry.blocks.back().hole())
+			m_blocks.push_back(entry.blocks.back());
+	}
+	m_entries.insert_or_assign(node.attribute("path").value(), std::move(entry));
+}
+
+std::span<const std::uint8_t> Checkpoint::associated_data() const
+{
+	// The entries are bound to the journal of their origin.
+	return {reinterpret_cast<const std::uint8_t*>(m_origin.data()), m_origin.size()};
+}
+
+std::string Checkpoint::relative(const std::filesystem::path& path) const
+{
+	return path.lexically_relative(m_root).generic_string();
+}
+
+void Checkpoint::write_line(const pugi::xml_node& node)
+{
+	std::ostringstream content;
+	node.print(content, "", pugi::format_raw);
+	m_stream << content.str() << '\n';
+	if (!m_stream)
+		throw std::ios_base::failure("Failed to write the file: " + m_journal.string());
+}
+
+void Checkpoint::commit_locked()
+{
+	if (!m_pending)
+		return;
+	// The output is synced before the commit is, so a committed entry is always in it after a crash.
+	if (m_sync)
+		m_sync();
+	auto doc = pugi::xml_document();
+	auto node = doc.append_child("commit");
+	if (!node)
+		throw std::runtime_error("Failed to create the XML node");
+	node.append_attribute("offset").set_value(std::to_string(m_pendingOffset).c_str());
+	write_line(node);
+	if (!m_stream.flush())
+		throw std::ios_base::failure("Failed to write the file: " + m_journal.string());
+	if (m_durability != Durability::NONE)
+		AtomicFile::sync(m_journal);
+	// The first commit makes the names of the journal and of the partial output durable too.
+	if (!m_committed && m_durability == Durability::FULL)
+		AtomicFile::sync(m_journal.has_parent_path() ? m_journal.parent_path() : ".");
+	m_committed = true;
+	m_pending = false;
+	m_pendingBytes = 0;
+}
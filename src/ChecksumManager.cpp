@@ -0,0 +1,33 @@
+#include "ChecksumManager.h"
+
+#include <botan/hash.h>
+#include <botan/hex.h>
+
+std::string ChecksumManager::compute(const std::span<const std::uint8_t> data, const std::string& algorithm)
+{
+	const auto hash = Botan::HashFunction::create_or_throw(algorithm);
+	hash->update(data.data(), data.size());
+	return Botan::hex_encode(hash->final(), false);
+}
+
+bool ChecksumManager::matches(const std::span<const std::uint8_t> data, const std::string& checksum, const std::string& algorithm)
+{
+	return compute(data, algorithm) == checksum;
+}
+
+ChecksumManager::Stream::Stream(const std::string& algorithm):
+	m_hash(Botan::HashFunction::create_or_throw(algorithm))
+{
+}
+
+ChecksumManager::Stream::~Stream() = default;
+
+void ChecksumManager::Stream::update(const std::span<const std::uint8_t> data)
+{
+	m_hash->update(data.data(), data.size());
+}
+
+std::string ChecksumManager::Stream::final()
+{
+	return Botan::hex_encode(m_hash->final(), false);
+}
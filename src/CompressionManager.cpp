@@ -1,10 +1,12 @@
 #include "CompressionManager.h"
+#include "Profiler.h"
 
 #include <stdexcept>
 #include <zlib.h>
 
 CompressionManager::Data CompressionManager::compress(const Data& data)
 {
+	const Profiler::Scope scope("compress");
 	const auto srcLen = static_cast<uLong>(data.size());
 	uLong destLen = compressBound(srcLen);
 	Data compressedData(destLen);
@@ -18,6 +20,7 @@ CompressionManager::Data CompressionManager::compress(const Data& data)
 
 CompressionManager::Data CompressionManager::uncompress(const Data& data, const size_t originalSize)
 {
+	const Profiler::Scope scope("uncompress");
 	Data decompressedData(originalSize);
 
 	auto uncompressedSize = static_cast<uLongf>(originalSize);
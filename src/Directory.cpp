@@ -1,4 +1,7 @@
 #include "Directory.h"
+#include "File.h"
+#include "ThreadPool.h"
+#include <algorithm>
 #include <date.h>
 
 Directory::Directory(std::string name, const std::filesystem::file_time_type lastWriteTime, const std::filesystem::perms permissions):
@@ -16,6 +19,24 @@ const std::vector<std::unique_ptr<Node>>& Directory::children() const
 	return m_children;
 }
 
+const Node* Directory::find(const std::filesystem::path& path) const
+{
+	const Node* node = this;
+	for (const auto& part : path.relative_path())
+	{
+		if (part.empty() || part == ".")
+			continue;
+		const auto directory = dynamic_cast<const Directory*>(node);
+		if (!directory)
+			return nullptr;
+		const auto child = std::ranges::find_if(directory->m_children, [&part](const auto& c) { return c->name() == part.string(); });
+		if (child == directory->m_children.end())
+			return nullptr;
+		node = child->get();
+	}
+	return node;
+}
+
 void Directory::write_content(pugi::xml_node& parentNode) const
 {
 	auto node = parentNode.append_child("directory");
@@ -32,14 +53,43 @@ void Directory::write_content(pugi::xml_node& parentNode) const
 	}
 }
 
-void Directory::create(const std::filesystem::path& parentPath) const
+void Directory::store(BlockWriter& writer, const std::filesystem::path& parentPath)
 {
 	const auto directory_path = parentPath / m_name;
-	create_directory(directory_path);
 	for (const auto& child : m_children)
 	{
-		child->create(directory_path);
+		child->store(writer, directory_path);
+	}
+}
+
+void Directory::create(const std::filesystem::path& parentPath, ThreadPool* pool) const
+{
+	const auto directory_path = parentPath / m_name;
+	create_directory(directory_path);
+	std::vector<std::future<void>> files;
+	std::exception_ptr error;
+	// Files are extracted on the pool, and waited for before the directory attributes are restored.
+	for (auto child = m_children.begin(); child != m_children.end() && !error; ++child)
+	{
+		if (const Node* file = child->get(); pool && dynamic_cast<const File*>(file))
+			files.push_back(pool->submit([file, directory_path] { file->create(directory_path, nullptr); }));
+		else
+		{
+			try { (*child)->create(directory_path, pool); }
+			catch (...) { error = std::current_exception(); }
+		}
+	}
+	for (auto& file : files)
+	{
+		try { file.get(); }
+		catch (...)
+		{
+			if (!error)
+				error = std::current_exception();
+		}
 	}
-	permissions(directory_path, m_permissions);
-	last_write_time(directory_path, m_lastWriteTime);
+	if (error)
+		std::rethrow_exception(error);
+	std::filesystem::permissions(directory_path, m_permissions);
+	std::filesystem::last_write_time(directory_path, m_lastWriteTime);
 }
@@ -0,0 +1,226 @@
+#include "DirectoryWatcher.h"
+
+#include <algorithm>
+#include <array>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+	#include <cerrno>
+	#include <poll.h>
+	#include <sys/inotify.h>
+	#include <unistd.h>
+#endif
+
+namespace
+{
+	volatile std::sig_atomic_t interrupted = 0;
+
+	// Tells whether a path is the entry or one below it, the empty path being the root.
+	bool is_within(const std::filesystem::path& path, const std::filesystem::path& entry)
+	{
+		return std::mismatch(entry.begin(), entry.end(), path.begin(), path.end()).first == entry.end();
+	}
+
+#ifdef __linux__
+	// The files are watched through their directory, the changes of their content and of their attributes are both reported.
+	constexpr std::uint32_t EVENTS = IN_CREATE | IN_DELETE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+	void on_signal(int)
+	{
+		interrupted = 1;
+	}
+#endif
+}
+
+DirectoryWatcher::DirectoryWatcher(std::filesystem::path root, const std::chrono::milliseconds delay):
+	m_root(std::move(root)),
+	m_delay(delay),
+	m_fd(-1)
+{
+#ifndef __linux__
+	throw std::runtime_error("Watching a directory is only supported on Linux");
+#else
+	if (delay.count() <= 0)
+		throw std::invalid_argument("The delay of the changes must be positive");
+	if (!is_directory(m_root))
+		throw std::invalid_argument(m_root.string() + " is not a directory");
+	m_fd = inotify_init1(IN_CLOEXEC | IN_NONBLOCK);
+	if (m_fd < 0)
+		throw std::runtime_error("Failed to watch " + m_root.string() + ": " + std::strerror(errno));
+	try { watch({}); }
+	catch (...)
+	{
+		::close(m_fd);
+		throw;
+	}
+	if (m_watches.empty())
+	{
+		::close(m_fd);
+		throw std::runtime_error("Failed to watch " + m_root.string());
+	}
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+#ifdef __linux__
+	if (m_fd >= 0)
+		::close(m_fd);
+#endif
+}
+
+std::vector<std::filesystem::path> DirectoryWatcher::wait(const std::chrono::milliseconds timeout)
+{
+	std::set<std::filesystem::path> changed;
+	if (!read_events(timeout, changed))
+		return {};
+	// The changes are gathered until the burst is over, or reported at the deadline while it goes on.
+	const auto deadline = std::chrono::steady_clock::now() + m_delay * MAX_DELAYS;
+	while (!interrupted)
+	{
+		const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+		if (remaining.count() <= 0 || !read_events(std::min(m_delay, remaining), changed))
+			break;
+	}
+	// The paths are sorted component by component, so the ones below an entry follow it.
+	std::vector<std::filesystem::path> paths;
+	for (const auto& path : changed)
+	{
+		if (paths.empty() || !is_within(path, paths.back()))
+			paths.push_back(path);
+	}
+	return paths;
+}
+
+void DirectoryWatcher::run(const std::function<void(const std::vector<std::filesystem::path>&)>& changed)
+{
+#ifdef __linux__
+	struct sigaction action{}, previousInterrupt{}, previousTerminate{};
+	action.sa_handler = on_signal;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, &previousInterrupt);
+	sigaction(SIGTERM, &action, &previousTerminate);
+
+	// A signal ends the wait with the changes seen so far, they are reported before stopping.
+	interrupted = 0;
+	try
+	{
+		while (!interrupted)
+		{
+			if (const auto paths = wait(std::chrono::seconds(1)); !paths.empty())
+				changed(paths);
+		}
+	}
+	catch (...)
+	{
+		sigaction(SIGINT, &previousInterrupt, nullptr);
+		sigaction(SIGTERM, &previousTerminate, nullptr);
+		throw;
+	}
+	sigaction(SIGINT, &previousInterrupt, nullptr);
+	sigaction(SIGTERM, &previousTerminate, nullptr);
+#endif
+}
+
+bool DirectoryWatcher::is_supported()
+{
+#ifdef __linux__
+	return true;
+#else
+	return false;
+#endif
+}
+
+void DirectoryWatcher::watch(const std::filesystem::path& directory)
+{
+#ifdef __linux__
+	const auto add = [this](const std::filesystem::path& relative)
+	{
+		const auto path = m_root / relative;
+		const auto descriptor = inotify_add_watch(m_fd, path.c_str(), EVENTS);
+		if (descriptor >= 0)
+		{
+			m_watches[descriptor] = relative;
+			return true;
+		}
+		// A directory removed meanwhile is reported by its parent.
+		if (errno == ENOENT || errno == ENOTDIR)
+			return false;
+		if (errno == ENOSPC)
+			throw std::runtime_error("Too many directories to watch in " + m_root.string() + ", raise fs.inotify.max_user_watches");
+		throw std::runtime_error("Failed to watch " + path.string() + ": " + std::strerror(errno));
+	};
+	// The subdirectories created before the watch was added are watched too, their entries are scanned with them.
+	if (!add(directory))
+		return;
+	std::error_code error;
+	for (auto entry = std::filesystem::recursive_directory_iterator(m_root / directory, std::filesystem::directory_options::skip_permission_denied, error);
+		!error && entry != std::filesystem::recursive_directory_iterator(); entry.increment(error))
+	{
+		if (!entry->is_symlink() && entry->is_directory())
+			add(entry->path().lexically_relative(m_root));
+	}
+#endif
+}
+
+void DirectoryWatcher::unwatch(const std::filesystem::path& directory)
+{
+#ifdef __linux__
+	std::erase_if(m_watches, [this, &directory](const auto& watch)
+	{
+		if (!is_within(watch.second, directory))
+			return false;
+		inotify_rm_watch(m_fd, watch.first);
+		return true;
+	});
+#endif
+}
+
+bool DirectoryWatcher::read_events(const std::chrono::milliseconds timeout, std::set<std::filesystem::path>& changed)
+{
+#ifndef __linux__
+	return false;
+#else
+	pollfd descriptor{m_fd, POLLIN, 0};
+	if (::poll(&descriptor, 1, static_cast<int>(timeout.count())) <= 0)
+		return false;
+	alignas(inotify_event) std::array<char, 64 * 1024> buffer{};
+	const auto length = ::read(m_fd, buffer.data(), buffer.size());
+	if (length <= 0)
+		return false;
+	for (size_t offset = 0; offset < static_cast<size_t>(length);)
+	{
+		inotify_event event{};
+		std::memcpy(&event, buffer.data() + offset, sizeof(event));
+		const std::string name = event.len ? buffer.data() + offset + sizeof(event) : "";
+		offset += sizeof(event) + event.len;
+		// Events were lost, the whole directory is reported and watched again.
+		if (event.mask & IN_Q_OVERFLOW)
+		{
+			changed.emplace();
+			watch({});
+			continue;
+		}
+		const auto watch = m_watches.find(event.wd);
+		if (watch == m_watches.end())
+			continue;
+		const auto path = name.empty() ? watch->second : watch->second / name;
+		if (event.mask & IN_IGNORED)
+		{
+			if (path.empty())
+				throw std::runtime_error(m_root.string() + " was removed or unmounted");
+			m_watches.erase(watch);
+			continue;
+		}
+		changed.insert(path);
+		// A directory moved away is watched again under its new name if it stays below the root.
+		if ((event.mask & IN_ISDIR) && (event.mask & IN_MOVED_FROM))
+			unwatch(path);
+		else if ((event.mask & IN_ISDIR) && (event.mask & (IN_CREATE | IN_MOVED_TO)))
+			this->watch(path);
+	}
+	return true;
+#endif
+}
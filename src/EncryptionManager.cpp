@@ -1,24 +1,49 @@
+#include <algorithm>
 #include <thread>
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__aarch64__) && defined(__linux__)
+	#include <asm/hwcap.h>
+	#include <sys/auxv.h>
+#endif
 #include <botan/argon2.h>
 #include <botan/auto_rng.h>
 #include <botan/aead.h>
 
 #include "EncryptionManager.h"
+#include "Profiler.h"
 
 #include <iostream>
 
+namespace
+{
+	// Seeding an RNG reads the system entropy, so each thread seeds its own once instead of for every block it encrypts.
+	Botan::RandomNumberGenerator& rng()
+	{
+		thread_local Botan::AutoSeeded_RNG generator;
+		return generator;
+	}
+}
+
 std::pair<EncryptionManager::Data, EncryptionManager::Nonce> EncryptionManager::encrypt(Data data, const Password& password, const Salt& salt)
 {
 	if (data.empty())
 		return {data, {}};
 
-	const auto encryptor = Botan::AEAD_Mode::create_or_throw("ChaCha20Poly1305", Botan::Cipher_Dir::Encryption);
-	Botan::AutoSeeded_RNG rng;
-	Nonce nonce(24);
-	rng.randomize(nonce);
-	Key key = derive_key(password, salt);
+	return encrypt(std::move(data), derive_key(password, salt, legacy_kdf_parameters()));
+}
+
+std::pair<EncryptionManager::Data, EncryptionManager::Nonce> EncryptionManager::encrypt(Data data, const Key& key, const std::span<const std::uint8_t> associatedData, const Cipher cipher)
+{
+	if (data.empty())
+		return {data, {}};
+	const Profiler::Scope scope("encrypt");
+
+	const auto encryptor = Botan::AEAD_Mode::create_or_throw(cipher_name(cipher), Botan::Cipher_Dir::Encryption);
+	Nonce nonce(nonce_size(cipher));
+	rng().randomize(nonce);
 	encryptor->set_key(key);
-	encryptor->set_associated_data(nullptr, 0);
+	encryptor->set_associated_data(associatedData.data(), associatedData.size());
 	encryptor->start(nonce);
 	encryptor->finish(data);
 	return std::make_pair(data, nonce);
@@ -28,13 +53,23 @@ EncryptionManager::Data EncryptionManager::decrypt(Data data, const Password& pa
 {
 	if (data.empty())
 		return data;
-	if (nonce.size() != 24)
+	if (nonce.size() != NONCE_SIZE)
 		throw std::invalid_argument("Nonce must be 24 bytes long");
 
-	const auto decryptor = Botan::AEAD_Mode::create_or_throw("ChaCha20Poly1305", Botan::Cipher_Dir::Decryption);
-	Key key = derive_key(password, salt);
+	return decrypt(std::move(data), derive_key(password, salt, legacy_kdf_parameters()), nonce);
+}
+
+EncryptionManager::Data EncryptionManager::decrypt(Data data, const Key& key, const Nonce& nonce, const std::span<const std::uint8_t> associatedData, const Cipher cipher)
+{
+	if (data.empty())
+		return data;
+	if (nonce.size() != nonce_size(cipher))
+		throw std::invalid_argument("Nonce must be " + std::to_string(nonce_size(cipher)) + " bytes long");
+	const Profiler::Scope scope("decrypt");
+
+	const auto decryptor = Botan::AEAD_Mode::create_or_throw(cipher_name(cipher), Botan::Cipher_Dir::Decryption);
 	decryptor->set_key(key);
-	decryptor->set_associated_data(nullptr, 0);
+	decryptor->set_associated_data(associatedData.data(), associatedData.size());
 	decryptor->start(nonce);
 	try { decryptor->finish(data); }
 	catch (const Botan::Integrity_Failure&) { throw std::runtime_error("Decryption failed: Incorrect password or data has been tampered with."); }
@@ -43,18 +78,139 @@ EncryptionManager::Data EncryptionManager::decrypt(Data data, const Password& pa
 
 EncryptionManager::Salt EncryptionManager::generate_new_salt()
 {
-	Botan::AutoSeeded_RNG rng;
 	Salt salt(16);
-	rng.randomize(salt);
+	rng().randomize(salt);
 	return salt;
 }
 
-EncryptionManager::Key EncryptionManager::derive_key(const Password& password, const Salt& salt)
+EncryptionManager::Key EncryptionManager::generate_key()
+{
+	Key key(32);
+	rng().randomize(key);
+	return key;
+}
+
+EncryptionManager::Key EncryptionManager::derive_key(const Password& password, const Salt& salt, const KdfParameters& parameters)
 {
 	if (salt.size() != 16)
 		throw std::invalid_argument("Salt must be 16 bytes long");
+	validate(parameters);
+	const Profiler::Scope scope("derive_key");
 	Key key(32);
-	const Botan::Argon2 argon2(2, 64, 3, std::thread::hardware_concurrency() >= 4 ? 4 : 1);
+	// Botan derives the lanes on its thread pool, so more lanes use more cores.
+	const Botan::Argon2 argon2(2, parameters.memory, parameters.iterations, parameters.lanes);
 	argon2.derive_key(key.data(), key.size(), password.data(), password.size(), salt.data(), salt.size());
 	return key;
 }
+
+KdfParameters EncryptionManager::legacy_kdf_parameters()
+{
+	return {64, 3, std::thread::hardware_concurrency() >= 4 ? 4u : 1u};
+}
+
+void EncryptionManager::validate(const KdfParameters& parameters)
+{
+	if (parameters.lanes < 1 || parameters.lanes > MAX_KDF_LANES)
+		throw std::invalid_argument("The number of key derivation lanes must be between 1 and " + std::to_string(MAX_KDF_LANES));
+	if (parameters.iterations < 1 || parameters.iterations > MAX_KDF_ITERATIONS)
+		throw std::invalid_argument("The number of key derivation iterations must be between 1 and " + std::to_string(MAX_KDF_ITERATIONS));
+	if (parameters.memory < 8 * parameters.lanes || parameters.memory > MAX_KDF_MEMORY)
+		throw std::invalid_argument("The key derivation memory must be between " + std::to_string(8 * parameters.lanes) + " and " + std::to_string(MAX_KDF_MEMORY) + " KiB");
+}
+
+std::chrono::milliseconds EncryptionManager::benchmark(const KdfParameters& parameters)
+{
+	const Password password = "benchmark";
+	const auto salt = generate_new_salt();
+	const auto start = std::chrono::steady_clock::now();
+	[[maybe_unused]] const auto key = derive_key(password, salt, parameters);
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+}
+
+std::string_view EncryptionManager::cipher_name(const Cipher cipher)
+{
+	switch (cipher)
+	{
+	case Cipher::AES_256_GCM:
+		return "AES-256/GCM";
+	case Cipher::CHACHA20_POLY1305:
+		break;
+	}
+	return "ChaCha20Poly1305";
+}
+
+std::optional<Cipher> EncryptionManager::find_cipher(const std::string_view name)
+{
+	const auto it = std::ranges::find(CIPHERS, name, cipher_name);
+	if (it == CIPHERS.end())
+		return std::nullopt;
+	return *it;
+}
+
+size_t EncryptionManager::nonce_size(const Cipher cipher)
+{
+	// ChaCha20Poly1305 uses the extended 24 bytes nonce of XChaCha20 so random nonces never collide.
+	return cipher == Cipher::AES_256_GCM ? 12 : NONCE_SIZE;
+}
+
+bool EncryptionManager::has_hardware_aes()
+{
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul");
+#elif defined(_M_X64) || defined(_M_IX86)
+	std::array<int, 4> info{};
+	__cpuid(info.data(), 1);
+	return (info[2] & 1 << 25) && (info[2] & 1 << 1);
+#elif defined(__aarch64__) && defined(__APPLE__)
+	return true;
+#elif defined(__aarch64__) && defined(__linux__)
+	const auto capabilities = getauxval(AT_HWCAP);
+	return (capabilities & HWCAP_AES) && (capabilities & HWCAP_PMULL);
+#else
+	return false;
+#endif
+}
+
+Cipher EncryptionManager::preferred_cipher()
+{
+	// Without AES instructions, AES-GCM is both slower than ChaCha20Poly1305 and exposed to cache timing attacks.
+	return has_hardware_aes() ? Cipher::AES_256_GCM : Cipher::CHACHA20_POLY1305;
+}
+
+double EncryptionManager::measure_throughput(const Cipher cipher, const std::chrono::milliseconds duration)
+{
+	constexpr size_t BLOCK_SIZE = 1024 * 1024;
+	const auto key = generate_key();
+	Data data(BLOCK_SIZE);
+	std::uint64_t bytes = 0;
+	const auto start = std::chrono::steady_clock::now();
+	auto elapsed = std::chrono::steady_clock::duration::zero();
+	while (elapsed < duration)
+	{
+		data = encrypt(std::move(data), key, {}, cipher).first;
+		data.resize(BLOCK_SIZE);
+		bytes += BLOCK_SIZE;
+		elapsed = std::chrono::steady_clock::now() - start;
+	}
+	return static_cast<double>(bytes) / std::chrono::duration<double>(elapsed).count();
+}
+
+KdfCalibration EncryptionManager::calibrate(const std::chrono::milliseconds target, const std::uint32_t maxMemory)
+{
+	KdfParameters parameters{KdfParameters().memory, 1, std::clamp(std::thread::hardware_concurrency(), 1u, MAX_KDF_LANES)};
+	parameters.memory = std::clamp(parameters.memory, 8 * parameters.lanes, std::max(maxMemory, 8 * parameters.lanes));
+	auto duration = benchmark(parameters);
+	// Memory is raised first since it is what makes guessing expensive on dedicated hardware, then iterations fill the remaining time.
+	while (duration * 2 <= target && parameters.memory <= maxMemory / 2)
+	{
+		parameters.memory *= 2;
+		duration = benchmark(parameters);
+	}
+	if (duration < target)
+	{
+		parameters.iterations = std::clamp<std::uint32_t>(static_cast<std::uint32_t>(target.count() / std::max<std::chrono::milliseconds::rep>(duration.count(), 1)), 1, MAX_KDF_ITERATIONS);
+		duration = benchmark(parameters);
+	}
+	return {parameters, duration};
+}
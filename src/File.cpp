@@ -1,12 +1,68 @@
 #include "File.h"
+#include "BlockCache.h"
+#include "BlockReader.h"
+#include "BlockWriter.h"
+#include "ChecksumManager.h"
+#include "Profiler.h"
 #include <botan/base64.h>
+#include <algorithm>
 #include <fstream>
+#include <ranges>
 #include <utility>
 #include <date.h>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	// Zero pages of a sparse file are left as holes when it is extracted.
+	constexpr size_t PAGE_SIZE = 4096;
+
+	// Finds the holes of a file with SEEK_HOLE and SEEK_DATA, there are none where the system can't report them.
+	std::vector<BlockWriter::Hole> find_holes(const std::filesystem::path& path)
+	{
+		std::vector<BlockWriter::Hole> holes;
+#if defined(SEEK_HOLE) && defined(SEEK_DATA)
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return holes;
+		const auto end = ::lseek(fd, 0, SEEK_END);
+		for (off_t position = 0; position < end;)
+		{
+			const auto hole = ::lseek(fd, position, SEEK_HOLE);
+			if (hole < 0 || hole >= end)
+				break;
+			// ENXIO means there is no data after the hole, it goes to the end of the file.
+			auto data = ::lseek(fd, hole, SEEK_DATA);
+			if (data < 0)
+				data = end;
+			holes.push_back({static_cast<std::uint64_t>(hole), static_cast<std::uint64_t>(data - hole)});
+			position = data;
+		}
+		::close(fd);
+#else
+		static_cast<void>(path);
+#endif
+		return holes;
+	}
+}
+
 File::File(std::string name, const std::filesystem::file_time_type lastWriteTime, const std::filesystem::perms permissions, std::string data):
 	Node(std::move(name), lastWriteTime, permissions),
-	m_data(std::move(data))
+	m_data(std::move(data)),
+	m_size(m_data.size() / 4 * 3 - std::ranges::count(m_data | std::views::reverse | std::views::take(2), '='))
+{
+}
+
+File::File(std::string name, const std::filesystem::file_time_type lastWriteTime, const std::filesystem::perms permissions, const std::uint64_t size, std::string checksum, std::vector<BlockInfo> blocks, std::shared_ptr<const BlockReader> reader):
+	Node(std::move(name), lastWriteTime, permissions),
+	m_size(size),
+	m_checksum(std::move(checksum)),
+	m_blocks(std::move(blocks)),
+	m_reader(std::move(reader))
 {
 }
 
@@ -15,25 +71,199 @@ const std::string& File::data() const
 	return m_data;
 }
 
-std::vector<uint8_t> File::read(const std::filesystem::path& path)
+std::uint64_t File::size() const
 {
-	std::ifstream file(path.string(), std::ios::binary | std::ios::ate);
+	return m_size;
+}
 
-	if (!file.is_open())
-		throw std::ios_base::failure("Failed to open the file: " + path.string());
+const std::string& File::checksum() const
+{
+	return m_checksum;
+}
 
-	const std::streamsize fileSize = file.tellg();
-	if (fileSize < 0)
-		throw std::ios_base::failure("Failed to get " + path.string() + " size.");
+const std::vector<BlockInfo>& File::blocks() const
+{
+	return m_blocks;
+}
 
-	std::vector<uint8_t> fileData(fileSize);
-	file.seekg(0, std::ios::beg);
-	if (!file.read(reinterpret_cast<char*>(fileData.data()), fileSize))
-		throw std::ios_base::failure("Failed to read " + path.string() + " data.");
+File::Data File::content() const
+{
+	Data content;
+	content.reserve(m_size);
+	read_chunks([&content](const std::span<const std::uint8_t> chunk) { content.insert(content.end(), chunk.begin(), chunk.end()); });
+	return content;
+}
 
-	file.close();
+File::Data File::content(const std::uint64_t offset, const std::uint64_t length, BlockCache& cache) const
+{
+	Data content;
+	read_range(offset, length, [&content](const std::span<const std::uint8_t> chunk) { content.insert(content.end(), chunk.begin(), chunk.end()); }, &cache);
+	return content;
+}
+
+void File::write_range(std::ostream& stream, const std::uint64_t offset, const std::uint64_t length) const
+{
+	read_range(offset, length, [&stream](const std::span<const std::uint8_t> chunk)
+		{
+			if (!stream.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size())))
+				throw std::ios_base::failure("Failed to write the content of the file");
+		}, nullptr);
+}
+
+bool File::verify() const
+{
+	try
+	{
+		read_chunks([](std::span<const std::uint8_t>) {});
+		return true;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
+
+bool File::verify(const BlockInfo& block) const
+{
+	if (!m_reader)
+		return verify();
+	if (block.hole())
+	{
+		m_reader->report_hole(block.size);
+		return true;
+	}
+	try
+	{
+		static_cast<void>(m_reader->read(block));
+		return true;
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
 
-	return std::move(fileData);
+void File::report_verified() const
+{
+	if (m_reader)
+		m_reader->report_entry();
+}
+
+void File::copy_blocks(BlockWriter& writer, const BlockReader& reader, std::map<std::uint64_t, BlockInfo>& copied)
+{
+	for (auto& block : m_blocks)
+	{
+		// A hole has nothing to copy, it is only framed in its place.
+		if (block.hole())
+		{
+			block = writer.copy(block, {});
+			continue;
+		}
+		auto [copy, inserted] = copied.try_emplace(block.id);
+		if (inserted)
+			copy->second = writer.copy(block, reader.stored(block));
+		block = copy->second;
+	}
+}
+
+const std::string& File::link() const
+{
+	return m_link;
+}
+
+void File::link_to(const std::string& path, const File& target)
+{
+	m_link = path;
+	m_size = target.m_size;
+	m_checksum = target.m_checksum;
+	m_blocks = target.m_blocks;
+}
+
+void File::break_link()
+{
+	m_link.clear();
+}
+
+void File::set_hard_link(std::shared_ptr<std::string> firstLink, std::string path)
+{
+	m_firstLink = std::move(firstLink);
+	m_path = std::move(path);
+}
+
+void File::create_link(const std::filesystem::path& parentPath, const std::filesystem::path& target) const
+{
+	const auto full_path = parentPath / m_name;
+	std::error_code error;
+	create_hard_link(target, full_path, error);
+	if (error)
+		throw std::ios_base::failure("Failed to create the hard link " + full_path.string() + ": " + error.message());
+	Profiler::count(Profiler::Counter::IO_CALLS);
+	if (m_reader)
+		m_reader->report_entry();
+}
+
+void File::read_chunks(const std::function<void(std::span<const std::uint8_t>)>& consumer, const std::function<void(std::uint64_t)>& skip) const
+{
+	if (!m_reader)
+	{
+		consumer(Botan::base64_decode(m_data));
+		return;
+	}
+
+	ChecksumManager::Stream checksum(m_reader->header().checksum);
+	std::uint64_t size = 0;
+	for (const auto& block : m_blocks)
+	{
+		// The checksum only covers the stored data, the holes are zeros without being read.
+		if (block.hole())
+		{
+			size += block.size;
+			if (skip)
+				skip(block.size);
+			else
+				consumer(Data(block.size));
+			m_reader->report_hole(block.size);
+			continue;
+		}
+		const auto data = m_reader->read(block);
+		checksum.update(data);
+		size += data.size();
+		consumer(data);
+	}
+	if (size != m_size || checksum.final() != m_checksum)
+		throw std::runtime_error("Corrupted vault entry: " + m_name);
+	m_reader->report_entry();
+}
+
+void File::read_range(const std::uint64_t offset, std::uint64_t length, const std::function<void(std::span<const std::uint8_t>)>& consumer, BlockCache* cache) const
+{
+	if (offset >= m_size || length == 0)
+		return;
+	length = std::min(length, m_size - offset);
+	if (!m_reader)
+	{
+		const auto data = Botan::base64_decode(m_data);
+		const auto begin = std::min<std::uint64_t>(offset, data.size());
+		const auto end = std::min<std::uint64_t>(offset + length, data.size());
+		consumer(std::span(data).subspan(begin, end - begin));
+		return;
+	}
+
+	if (m_blocks.empty())
+		throw std::runtime_error("Corrupted vault entry: " + m_name);
+	// Every chunk but the last one has the same size, so the first chunk of the range can be found directly.
+	const auto chunkSize = std::max<std::uint64_t>(m_blocks.front().size, 1);
+	const auto first = std::min<std::uint64_t>(offset / chunkSize, m_blocks.size() - 1);
+	auto position = first * chunkSize;
+	for (auto block = m_blocks.begin() + static_cast<std::ptrdiff_t>(first); block != m_blocks.end() && position < offset + length; ++block)
+	{
+		const auto data = block->hole() ? std::make_shared<const Data>(block->size) : cache ? cache->get(block->id, [&] { return m_reader->read(*block); }) : std::make_shared<const Data>(m_reader->read(*block));
+		const auto begin = offset > position ? offset - position : 0;
+		const auto end = std::min<std::uint64_t>(data->size(), offset + length - position);
+		if (begin < end)
+			consumer(std::span(*data).subspan(begin, end - begin));
+		position += block->size;
+	}
 }
 
 void File::write_content(pugi::xml_node& parentNode) const
@@ -42,23 +272,133 @@ void File::write_content(pugi::xml_node& parentNode) const
 	if (!node)
 		throw std::runtime_error("Failed to create the XML node");
 	node.append_attribute("name").set_value(m_name.c_str());
-	node.append_attribute("data").set_value(m_data.c_str());
+	if (!m_link.empty())
+		node.append_attribute("link").set_value(m_link.c_str());
+	else
+	{
+		node.append_attribute("size").set_value(std::to_string(m_size).c_str());
+		node.append_attribute("checksum").set_value(m_checksum.c_str());
+	}
 #if defined(__cpp_lib_chrono) && __cpp_lib_chrono >= 201907L
 	node.append_attribute("lastWriteTime").set_value(date::format("%F %T", std::chrono::clock_cast<std::chrono::system_clock>(m_lastWriteTime)).c_str());
 #endif
 	node.append_attribute("permissions").set_value(std::to_string(static_cast<int>(m_permissions)).c_str());
+	if (!m_link.empty())
+		return;
+	for (const auto& [id, offset, size, storedSize, checksum, volume] : m_blocks)
+	{
+		if (!storedSize)
+		{
+			auto hole = node.append_child("hole");
+			if (!hole)
+				throw std::runtime_error("Failed to create the XML node");
+			hole.append_attribute("size").set_value(std::to_string(size).c_str());
+			continue;
+		}
+		auto block = node.append_child("block");
+		if (!block)
+			throw std::runtime_error("Failed to create the XML node");
+		block.append_attribute("id").set_value(std::to_string(id).c_str());
+		block.append_attribute("offset").set_value(std::to_string(offset).c_str());
+		block.append_attribute("size").set_value(std::to_string(size).c_str());
+		block.append_attribute("storedSize").set_value(std::to_string(storedSize).c_str());
+		block.append_attribute("checksum").set_value(checksum.c_str());
+		if (volume)
+			block.append_attribute("volume").set_value(std::to_string(volume).c_str());
+	}
+}
+
+void File::store(BlockWriter& writer, const std::filesystem::path& parentPath)
+{
+	// Only the first link stored to a file has its content, the others refer to it.
+	if (m_firstLink && !m_firstLink->empty())
+	{
+		m_link = *m_firstLink;
+		writer.report_entry();
+		return;
+	}
+	const auto path = parentPath / m_name;
+	auto [size, checksum, blocks] = [&]
+	{
+		// A file stored before an interrupted close is taken from the checkpoint if it hasn't changed since.
+		if (auto entry = writer.resumed(path, m_lastWriteTime))
+			return std::move(*entry);
+		std::ifstream file(path.string(), std::ios::binary);
+		if (!file.is_open())
+			throw std::ios_base::failure("Failed to open the file: " + path.string());
+		Profiler::count(Profiler::Counter::FILES);
+		Profiler::count(Profiler::Counter::IO_CALLS);
+		writer.begin_entry(path);
+		auto entry = [&]
+		{
+			try { return writer.write(file, find_holes(path)); }
+			catch (const std::ios_base::failure&) { throw std::ios_base::failure("Failed to read " + path.string() + " data."); }
+		}();
+		writer.checkpoint(path, m_lastWriteTime, entry);
+		return entry;
+	}();
+	m_size = size;
+	m_checksum = std::move(checksum);
+	m_blocks = std::move(blocks);
+	if (m_firstLink)
+		*m_firstLink = m_path;
 }
 
-void File::create(const std::filesystem::path& parentPath) const
+void File::create(const std::filesystem::path& parentPath, ThreadPool*) const
 {
+	// Hard links are made once the files they refer to are extracted.
+	if (!m_link.empty())
+		return;
 	const auto full_path = parentPath / m_name;
 	std::ofstream file(full_path.string(), std::ios::binary);
 	if (!file.is_open())
 		throw std::ios_base::failure("Failed to create the file: " + full_path.string());
+	Profiler::count(Profiler::Counter::FILES);
+	Profiler::count(Profiler::Counter::IO_CALLS);
 
-	const auto data = Botan::base64_decode(m_data);
-	file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
+	const auto write = [&file, &full_path](const std::span<const std::uint8_t> data)
+	{
+		if (!file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())))
+			throw std::ios_base::failure("Failed to write the file: " + full_path.string());
+		Profiler::count(Profiler::Counter::IO_CALLS);
+		Profiler::count(Profiler::Counter::BYTES_WRITTEN, data.size());
+	};
+	const auto skip = [&file, &full_path](const std::uint64_t size)
+	{
+		if (!file.seekp(static_cast<std::streamoff>(size), std::ios::cur))
+			throw std::ios_base::failure("Failed to write the file: " + full_path.string());
+	};
+	// The holes of a sparse file are skipped rather than written, with the zero pages around them,
+	// and the file is extended to its size at the end, so they are unallocated again.
+	const auto sparse = std::ranges::any_of(m_blocks, &BlockInfo::hole);
+	read_chunks([&](const std::span<const std::uint8_t> chunk)
+		{
+			if (!sparse)
+			{
+				write(chunk);
+				return;
+			}
+			const auto zero = [&chunk](const size_t page) { return std::ranges::all_of(chunk.subspan(page, std::min(PAGE_SIZE, chunk.size() - page)), [](const std::uint8_t byte) { return byte == 0; }); };
+			for (size_t begin = 0; begin < chunk.size();)
+			{
+				const auto hole = zero(begin);
+				auto end = begin;
+				while (end < chunk.size() && zero(end) == hole)
+					end = std::min(end + PAGE_SIZE, chunk.size());
+				if (hole)
+					skip(end - begin);
+				else
+					write(chunk.subspan(begin, end - begin));
+				begin = end;
+			}
+		}, skip);
 	file.close();
-	permissions(full_path, m_permissions);
-	last_write_time(full_path, m_lastWriteTime);
+	if (!file)
+		throw std::ios_base::failure("Failed to write the file: " + full_path.string());
+	if (sparse)
+		std::filesystem::resize_file(full_path, m_size);
+	std::filesystem::permissions(full_path, m_permissions);
+	std::filesystem::last_write_time(full_path, m_lastWriteTime);
+	if (m_reader)
+		m_reader->checkpoint(full_path, {m_size, m_lastWriteTime, m_checksum, {}});
 }
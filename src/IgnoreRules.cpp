@@ -0,0 +1,169 @@
+#include "IgnoreRules.h"
+
+#include <fstream>
+#include <ranges>
+
+namespace
+{
+	// Matches a character class at the start of the pattern, with ranges and ! or ^ negation, and returns its length.
+	std::optional<size_t> match_class(const std::string_view pattern, const char c)
+	{
+		const size_t start = pattern.size() > 1 && (pattern[1] == '!' || pattern[1] == '^') ? 2 : 1;
+		const auto end = pattern.find(']', start + 1);
+		if (end == std::string_view::npos)
+			return std::nullopt;
+		bool found = false;
+		for (size_t i = start; i < end; ++i)
+		{
+			if (i + 2 < end && pattern[i + 1] == '-')
+			{
+				found = found || (pattern[i] <= c && c <= pattern[i + 2]);
+				i += 2;
+			}
+			else
+				found = found || pattern[i] == c;
+		}
+		if (c == '/' || found == (start == 2))
+			return 0;
+		return end + 1;
+	}
+}
+
+IgnoreRules::IgnoreRules(const std::vector<std::string>& patterns)
+{
+	for (const auto& pattern : patterns)
+		add(pattern);
+}
+
+void IgnoreRules::add(std::string_view pattern, const std::string& base)
+{
+	if (pattern.ends_with('\r'))
+		pattern.remove_suffix(1);
+	while (pattern.ends_with(' ') && !pattern.ends_with("\\ "))
+		pattern.remove_suffix(1);
+	if (pattern.empty() || pattern.starts_with('#'))
+		return;
+
+	Rule rule{{}, base, pattern.starts_with('!'), false, false};
+	if (rule.negated)
+		pattern.remove_prefix(1);
+	rule.directoryOnly = pattern.ends_with('/');
+	while (pattern.ends_with('/'))
+		pattern.remove_suffix(1);
+	// As with gitignore, a pattern with a slash is relative to its base, the others match a name at any depth.
+	rule.anchored = pattern.find('/') != std::string_view::npos;
+	while (pattern.starts_with('/'))
+		pattern.remove_prefix(1);
+	if (pattern.empty())
+		return;
+	rule.pattern = pattern;
+	m_rules.push_back(std::move(rule));
+}
+
+void IgnoreRules::load(const std::filesystem::path& file, const std::string& base)
+{
+	std::ifstream stream(file.string());
+	if (!stream.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + file.string());
+	std::string line;
+	while (std::getline(stream, line))
+		add(line, base);
+}
+
+bool IgnoreRules::empty() const
+{
+	return m_rules.empty();
+}
+
+std::optional<bool> IgnoreRules::excluded(const std::string_view path, const bool directory) const
+{
+	// The last rule matching the path decides, so a later negated rule includes what an earlier one excluded.
+	for (const auto& rule : m_rules | std::views::reverse)
+	{
+		if (rule.directoryOnly && !directory)
+			continue;
+		auto relative = path;
+		if (!rule.base.empty())
+		{
+			if (!relative.starts_with(rule.base) || relative.size() <= rule.base.size() || relative[rule.base.size()] != '/')
+				continue;
+			relative.remove_prefix(rule.base.size() + 1);
+		}
+		if (!rule.anchored)
+			relative = relative.substr(relative.rfind('/') + 1);
+		if (match(rule.pattern, relative))
+			return !rule.negated;
+	}
+	return std::nullopt;
+}
+
+bool IgnoreRules::matches(const std::string_view path, const bool directory) const
+{
+	return excluded(path, directory).value_or(false);
+}
+
+bool IgnoreRules::match(std::string_view pattern, std::string_view text)
+{
+	while (!pattern.empty())
+	{
+		if (pattern.starts_with("**"))
+		{
+			// **/ matches any number of directories, none included, and a trailing ** matches everything.
+			pattern.remove_prefix(2);
+			if (pattern.starts_with('/'))
+			{
+				pattern.remove_prefix(1);
+				if (match(pattern, text))
+					return true;
+				for (size_t i = 0; i < text.size(); ++i)
+				{
+					if (text[i] == '/' && match(pattern, text.substr(i + 1)))
+						return true;
+				}
+				return false;
+			}
+			for (size_t i = 0; i <= text.size(); ++i)
+			{
+				if (match(pattern, text.substr(i)))
+					return true;
+			}
+			return false;
+		}
+		if (pattern.front() == '*')
+		{
+			pattern.remove_prefix(1);
+			for (size_t i = 0;; ++i)
+			{
+				if (match(pattern, text.substr(i)))
+					return true;
+				if (i == text.size() || text[i] == '/')
+					return false;
+			}
+		}
+		if (text.empty())
+			return false;
+		if (pattern.front() == '?')
+		{
+			if (text.front() == '/')
+				return false;
+		}
+		else if (const auto length = pattern.front() == '[' ? match_class(pattern, text.front()) : std::nullopt)
+		{
+			if (*length == 0)
+				return false;
+			pattern.remove_prefix(*length);
+			text.remove_prefix(1);
+			continue;
+		}
+		else
+		{
+			if (pattern.front() == '\\' && pattern.size() > 1)
+				pattern.remove_prefix(1);
+			if (pattern.front() != text.front())
+				return false;
+		}
+		pattern.remove_prefix(1);
+		text.remove_prefix(1);
+	}
+	return text.empty();
+}
@@ -0,0 +1,483 @@
+#include "KeyAgent.h"
+
+#include <array>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+	#include <cerrno>
+	#include <fcntl.h>
+	#include <poll.h>
+	#include <sys/socket.h>
+	#include <sys/stat.h>
+	#include <sys/un.h>
+	#include <unistd.h>
+	#if defined(__linux__)
+		#include <sys/prctl.h>
+	#endif
+#endif
+
+namespace
+{
+	using Buffer = Botan::secure_vector<std::uint8_t>;
+
+	enum class Command : std::uint8_t
+	{
+		GET = 'G',
+		FIND = 'F',
+		PUT = 'P',
+		STOP = 'S'
+	};
+
+	constexpr std::uint8_t FOUND = 0;
+	constexpr std::uint8_t MISSING = 1;
+	constexpr std::uint32_t MAX_MESSAGE_SIZE = 64 * 1024;
+	constexpr int TIMEOUT_SECONDS = 5;
+
+	volatile std::sig_atomic_t interrupted = 0;
+
+	void append_uint(Buffer& buffer, const std::uint32_t value)
+	{
+		for (size_t i = 0; i < sizeof(value); ++i)
+			buffer.push_back(static_cast<std::uint8_t>(value >> (8 * i)));
+	}
+
+	std::uint32_t read_uint(const std::span<const std::uint8_t> data)
+	{
+		std::uint32_t value = 0;
+		for (size_t i = 0; i < sizeof(value); ++i)
+			value |= static_cast<std::uint32_t>(data[i]) << (8 * i);
+		return value;
+	}
+
+	void append_field(Buffer& buffer, const std::span<const std::uint8_t> field)
+	{
+		append_uint(buffer, static_cast<std::uint32_t>(field.size()));
+		buffer.insert(buffer.end(), field.begin(), field.end());
+	}
+
+	void append_field(Buffer& buffer, const std::string& field)
+	{
+		append_field(buffer, std::span(reinterpret_cast<const std::uint8_t*>(field.data()), field.size()));
+	}
+
+	void append_field(Buffer& buffer, const KdfParameters& kdf)
+	{
+		Buffer field;
+		append_uint(field, kdf.memory);
+		append_uint(field, kdf.iterations);
+		append_uint(field, kdf.lanes);
+		append_field(buffer, field);
+	}
+
+	class FieldReader
+	{
+	public:
+		explicit FieldReader(const std::span<const std::uint8_t> data):
+			m_data(data)
+		{
+		}
+
+		std::span<const std::uint8_t> next()
+		{
+			if (m_data.size() < sizeof(std::uint32_t))
+				throw std::runtime_error("Truncated key agent message");
+			const auto size = read_uint(m_data);
+			if (m_data.size() - sizeof(std::uint32_t) < size)
+				throw std::runtime_error("Truncated key agent message");
+			const auto field = m_data.subspan(sizeof(std::uint32_t), size);
+			m_data = m_data.subspan(sizeof(std::uint32_t) + size);
+			return field;
+		}
+
+		std::string next_string()
+		{
+			const auto field = next();
+			return {field.begin(), field.end()};
+		}
+
+		KdfParameters next_kdf()
+		{
+			const auto field = next();
+			if (field.size() != 3 * sizeof(std::uint32_t))
+				throw std::runtime_error("Invalid key derivation parameters in key agent message");
+			return {read_uint(field), read_uint(field.subspan(4)), read_uint(field.subspan(8))};
+		}
+
+	private:
+		std::span<const std::uint8_t> m_data;
+	};
+
+#ifndef _WIN32
+	bool send_message(const int fd, const Buffer& payload)
+	{
+		Buffer message;
+		append_field(message, payload);
+#if defined(MSG_NOSIGNAL)
+		constexpr int flags = MSG_NOSIGNAL;
+#else
+		constexpr int flags = 0;
+#endif
+		for (size_t sent = 0; sent < message.size();)
+		{
+			const auto written = ::send(fd, message.data() + sent, message.size() - sent, flags);
+			if (written < 0 && errno == EINTR)
+				continue;
+			if (written <= 0)
+				return false;
+			sent += static_cast<size_t>(written);
+		}
+		return true;
+	}
+
+	bool receive_exactly(const int fd, std::uint8_t* data, const size_t size)
+	{
+		for (size_t received = 0; received < size;)
+		{
+			const auto count = ::recv(fd, data + received, size - received, 0);
+			if (count < 0 && errno == EINTR)
+				continue;
+			if (count <= 0)
+				return false;
+			received += static_cast<size_t>(count);
+		}
+		return true;
+	}
+
+	std::optional<Buffer> receive_message(const int fd)
+	{
+		std::array<std::uint8_t, sizeof(std::uint32_t)> header{};
+		if (!receive_exactly(fd, header.data(), header.size()))
+			return std::nullopt;
+		const auto size = read_uint(header);
+		if (size == 0 || size > MAX_MESSAGE_SIZE)
+			return std::nullopt;
+		Buffer payload(size);
+		if (!receive_exactly(fd, payload.data(), payload.size()))
+			return std::nullopt;
+		return payload;
+	}
+
+	void set_timeout(const int fd)
+	{
+		timeval timeout{TIMEOUT_SECONDS, 0};
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+#if defined(SO_NOSIGPIPE)
+		constexpr int enabled = 1;
+		setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &enabled, sizeof(enabled));
+#endif
+	}
+
+	sockaddr_un make_address(const std::filesystem::path& socket)
+	{
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		const auto& path = socket.native();
+		if (path.size() >= sizeof(address.sun_path))
+			throw std::invalid_argument("The key agent socket path is too long: " + socket.string());
+		std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+		return address;
+	}
+
+	bool is_peer_trusted(const int fd)
+	{
+#if defined(__linux__)
+		ucred credentials{};
+		socklen_t size = sizeof(credentials);
+		if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &credentials, &size) < 0)
+			return false;
+		return credentials.uid == geteuid();
+#else
+		uid_t uid;
+		gid_t gid;
+		if (getpeereid(fd, &uid, &gid) < 0)
+			return false;
+		return uid == geteuid();
+#endif
+	}
+
+	int connect_to(const std::filesystem::path& socket)
+	{
+		// A socket created by another user could be an impostor collecting keys.
+		struct stat status{};
+		if (lstat(socket.c_str(), &status) < 0 || !S_ISSOCK(status.st_mode) || status.st_uid != geteuid())
+			return -1;
+		const auto address = make_address(socket);
+		const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+		if (fd < 0)
+			return -1;
+		set_timeout(fd);
+		if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 || !is_peer_trusted(fd))
+		{
+			::close(fd);
+			return -1;
+		}
+		return fd;
+	}
+
+	void on_signal(int)
+	{
+		interrupted = 1;
+	}
+#endif
+
+	std::optional<Buffer> request(const std::filesystem::path& socket, const Buffer& message)
+	{
+#ifdef _WIN32
+		return std::nullopt;
+#else
+		const int fd = connect_to(socket);
+		if (fd < 0)
+			return std::nullopt;
+		std::optional<Buffer> reply;
+		if (send_message(fd, message))
+			reply = receive_message(fd);
+		::close(fd);
+		if (!reply || reply->front() != FOUND)
+			return std::nullopt;
+		return reply;
+#endif
+	}
+}
+
+KeyAgent::KeyAgent(std::filesystem::path socket, const std::chrono::seconds ttl):
+	m_socket(std::move(socket)),
+	m_ttl(ttl),
+	m_running(false),
+	m_fd(-1)
+{
+#ifdef _WIN32
+	throw std::runtime_error("The key agent is only available on Unix systems");
+#else
+	if (ttl.count() < 0)
+		throw std::invalid_argument("The key agent time to live must not be negative");
+	const auto address = make_address(m_socket);
+	if (const auto status = std::filesystem::symlink_status(m_socket); std::filesystem::exists(status))
+	{
+		if (!std::filesystem::is_socket(status))
+			throw std::runtime_error(m_socket.string() + " already exists and is not a socket");
+		if (const int fd = connect_to(m_socket); fd >= 0)
+		{
+			::close(fd);
+			throw std::runtime_error("A key agent is already listening on " + m_socket.string());
+		}
+		std::filesystem::remove(m_socket);
+	}
+	m_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+	if (m_fd < 0)
+		throw std::runtime_error("Failed to create the key agent socket");
+	fcntl(m_fd, F_SETFD, FD_CLOEXEC);
+	const auto mask = umask(0177);
+	const auto bound = ::bind(m_fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address));
+	umask(mask);
+	if (bound < 0 || listen(m_fd, 8) < 0)
+	{
+		::close(m_fd);
+		throw std::runtime_error("Failed to listen on " + m_socket.string() + ": " + std::strerror(errno));
+	}
+#if defined(__linux__)
+	// Keys must not end up in a core dump or be readable through ptrace.
+	prctl(PR_SET_DUMPABLE, 0);
+#endif
+#endif
+}
+
+KeyAgent::~KeyAgent()
+{
+#ifndef _WIN32
+	if (m_fd >= 0)
+	{
+		::close(m_fd);
+		std::error_code error;
+		std::filesystem::remove(m_socket, error);
+	}
+#endif
+}
+
+void KeyAgent::run()
+{
+#ifndef _WIN32
+	struct sigaction action{}, previousInterrupt{}, previousTerminate{};
+	action.sa_handler = on_signal;
+	sigemptyset(&action.sa_mask);
+	sigaction(SIGINT, &action, &previousInterrupt);
+	sigaction(SIGTERM, &action, &previousTerminate);
+
+	m_running = true;
+	interrupted = 0;
+	while (m_running && !interrupted)
+	{
+		pollfd listener{m_fd, POLLIN, 0};
+		const auto ready = poll(&listener, 1, 1000);
+		purge();
+		if (ready <= 0)
+			continue;
+		const int client = accept(m_fd, nullptr, nullptr);
+		if (client < 0)
+			continue;
+		set_timeout(client);
+		if (is_peer_trusted(client))
+		{
+			try { serve(client); }
+			catch (const std::runtime_error&) {}
+		}
+		::close(client);
+	}
+	m_keys.clear();
+	sigaction(SIGINT, &previousInterrupt, nullptr);
+	sigaction(SIGTERM, &previousTerminate, nullptr);
+#endif
+}
+
+bool KeyAgent::is_supported()
+{
+#ifdef _WIN32
+	return false;
+#else
+	return true;
+#endif
+}
+
+std::filesystem::path KeyAgent::default_socket()
+{
+	if (const auto socket = std::getenv(SOCKET_VARIABLE); socket && *socket)
+		return socket;
+#ifdef _WIN32
+	return {};
+#else
+	if (const auto runtime = std::getenv("XDG_RUNTIME_DIR"); runtime && *runtime)
+		return std::filesystem::path(runtime) / "vault-agent.sock";
+	return std::filesystem::temp_directory_path() / ("vault-agent-" + std::to_string(geteuid()) + ".sock");
+#endif
+}
+
+std::optional<std::filesystem::path> KeyAgent::running_socket()
+{
+#ifdef _WIN32
+	return std::nullopt;
+#else
+	auto socket = default_socket();
+	const int fd = connect_to(socket);
+	if (fd < 0)
+		return std::nullopt;
+	::close(fd);
+	return socket;
+#endif
+}
+
+std::optional<EncryptionManager::Key> KeyAgent::get(const std::filesystem::path& socket, const EncryptionManager::Salt& salt, const KdfParameters& kdf)
+{
+	Buffer message{static_cast<std::uint8_t>(Command::GET)};
+	append_field(message, salt);
+	append_field(message, kdf);
+	const auto reply = request(socket, message);
+	if (!reply)
+		return std::nullopt;
+	try
+	{
+		FieldReader fields{std::span(*reply).subspan(1)};
+		const auto key = fields.next();
+		return EncryptionManager::Key(key.begin(), key.end());
+	}
+	catch (const std::runtime_error&) { return std::nullopt; }
+}
+
+std::optional<KeyAgent::Entry> KeyAgent::find(const std::filesystem::path& socket, const std::filesystem::path& vault)
+{
+	Buffer message{static_cast<std::uint8_t>(Command::FIND)};
+	append_field(message, vault.string());
+	const auto reply = request(socket, message);
+	if (!reply)
+		return std::nullopt;
+	try
+	{
+		FieldReader fields{std::span(*reply).subspan(1)};
+		const auto salt = fields.next();
+		const auto kdf = fields.next_kdf();
+		const auto key = fields.next();
+		return Entry{{salt.begin(), salt.end()}, kdf, {key.begin(), key.end()}};
+	}
+	catch (const std::runtime_error&) { return std::nullopt; }
+}
+
+bool KeyAgent::put(const std::filesystem::path& socket, const std::filesystem::path& vault, const Entry& entry)
+{
+	Buffer message{static_cast<std::uint8_t>(Command::PUT)};
+	append_field(message, vault.string());
+	append_field(message, entry.salt);
+	append_field(message, entry.kdf);
+	append_field(message, entry.key);
+	return request(socket, message).has_value();
+}
+
+bool KeyAgent::stop(const std::filesystem::path& socket)
+{
+	return request(socket, Buffer{static_cast<std::uint8_t>(Command::STOP)}).has_value();
+}
+
+void KeyAgent::serve(const int client)
+{
+#ifndef _WIN32
+	const auto message = receive_message(client);
+	if (!message)
+		return;
+	FieldReader fields{std::span(*message).subspan(1)};
+	Buffer reply{MISSING};
+	switch (static_cast<Command>(message->front()))
+	{
+	case Command::GET:
+	{
+		const auto salt = fields.next();
+		const auto kdf = fields.next_kdf();
+		if (const auto it = m_keys.find(EncryptionManager::Salt(salt.begin(), salt.end())); it != m_keys.end() && it->second.kdf == kdf)
+		{
+			reply = {FOUND};
+			append_field(reply, it->second.key);
+		}
+		break;
+	}
+	case Command::FIND:
+	{
+		const auto vault = fields.next_string();
+		auto latest = m_keys.end();
+		for (auto it = m_keys.begin(); it != m_keys.end(); ++it)
+		{
+			if (it->second.vault == vault && (latest == m_keys.end() || it->second.expiry > latest->second.expiry))
+				latest = it;
+		}
+		if (latest != m_keys.end())
+		{
+			reply = {FOUND};
+			append_field(reply, latest->first);
+			append_field(reply, latest->second.kdf);
+			append_field(reply, latest->second.key);
+		}
+		break;
+	}
+	case Command::PUT:
+	{
+		const auto vault = fields.next_string();
+		const auto salt = fields.next();
+		const auto kdf = fields.next_kdf();
+		const auto key = fields.next();
+		m_keys[EncryptionManager::Salt(salt.begin(), salt.end())] = {kdf, EncryptionManager::Key(key.begin(), key.end()), vault, std::chrono::steady_clock::now() + m_ttl};
+		reply = {FOUND};
+		break;
+	}
+	case Command::STOP:
+		m_running = false;
+		reply = {FOUND};
+		break;
+	}
+	send_message(client, reply);
+#endif
+}
+
+void KeyAgent::purge()
+{
+	const auto now = std::chrono::steady_clock::now();
+	std::erase_if(m_keys, [now](const auto& entry) { return entry.second.expiry <= now; });
+}
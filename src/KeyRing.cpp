@@ -0,0 +1,68 @@
+#include "KeyRing.h"
+#include "Utils.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+KeyRing::KeyRing(MemoryBudget budget):
+	m_budget(std::move(budget))
+{
+}
+
+const EncryptionManager::Password& KeyRing::password()
+{
+	std::scoped_lock lock(m_passwordMutex);
+	if (!m_asked)
+	{
+		m_asked = true;
+		m_password = ask_password_with_confirmation();
+	}
+	if (!m_password)
+		throw std::runtime_error("Password confirmation failed");
+	return *m_password;
+}
+
+EncryptionManager::Key KeyRing::derive(const EncryptionManager::Salt& salt, const KdfParameters& kdf)
+{
+	m_budget.check(kdf);
+	std::promise<EncryptionManager::Key> promise;
+	std::shared_future<EncryptionManager::Key> key;
+	bool derives = false;
+	{
+		std::scoped_lock lock(m_mutex);
+		auto [entry, inserted] = m_keys.try_emplace({salt, kdf});
+		if (inserted)
+			entry->second = promise.get_future().share();
+		key = entry->second;
+		derives = inserted;
+	}
+	// The key is derived out of the lock, so the vaults needing other keys go on meanwhile, but only once the others are derived.
+	if (derives)
+	{
+		try
+		{
+			const auto& secret = password();
+			std::scoped_lock lock(m_derivationMutex);
+			promise.set_value(EncryptionManager::derive_key(secret, salt, kdf));
+		}
+		catch (...) { promise.set_exception(std::current_exception()); }
+	}
+	return key.get();
+}
+
+std::pair<EncryptionManager::Salt, EncryptionManager::Key> KeyRing::closing_key(const KdfParameters& kdf)
+{
+	EncryptionManager::Salt salt;
+	{
+		std::scoped_lock lock(m_mutex);
+		if (const auto shared = std::ranges::find(m_closingSalts, kdf, &std::pair<KdfParameters, EncryptionManager::Salt>::first); shared != m_closingSalts.end())
+			salt = shared->second;
+		else
+		{
+			salt = EncryptionManager::generate_new_salt();
+			m_closingSalts.emplace_back(kdf, salt);
+		}
+	}
+	auto key = derive(salt, kdf);
+	return {std::move(salt), std::move(key)};
+}
@@ -0,0 +1,146 @@
+#include "KeySlots.h"
+#include "VaultFormat.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+	constexpr size_t SALT_SIZE = 16;
+	constexpr size_t KEY_SIZE = 32;
+	constexpr size_t TAG_SIZE = 16;
+	constexpr size_t WRAPPED_KEY_SIZE = EncryptionManager::NONCE_SIZE + KEY_SIZE + TAG_SIZE;
+	constexpr size_t SLOT_CONTENT_SIZE = sizeof(std::uint32_t) + SALT_SIZE + 3 * sizeof(std::uint32_t) + WRAPPED_KEY_SIZE;
+	constexpr std::uint32_t ACTIVE = 1;
+
+	static_assert(SLOT_CONTENT_SIZE <= KeySlots::SLOT_SIZE);
+}
+
+KeySlots::KeySlots(const std::span<const std::uint8_t> area)
+{
+	if (area.size() < SIZE)
+		throw std::runtime_error("Invalid vault file format: truncated key slots");
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		auto data = area.subspan(i * SLOT_SIZE, SLOT_SIZE);
+		if (VaultFormat::read_uint(data, sizeof(std::uint32_t)) != ACTIVE)
+			continue;
+		data = data.subspan(sizeof(std::uint32_t));
+		KeySlot slot;
+		slot.salt.assign(data.begin(), data.begin() + SALT_SIZE);
+		data = data.subspan(SALT_SIZE);
+		slot.kdf.memory = static_cast<std::uint32_t>(VaultFormat::read_uint(data, sizeof(std::uint32_t)));
+		slot.kdf.iterations = static_cast<std::uint32_t>(VaultFormat::read_uint(data.subspan(4), sizeof(std::uint32_t)));
+		slot.kdf.lanes = static_cast<std::uint32_t>(VaultFormat::read_uint(data.subspan(8), sizeof(std::uint32_t)));
+		data = data.subspan(3 * sizeof(std::uint32_t));
+		slot.wrappedKey.assign(data.begin(), data.begin() + WRAPPED_KEY_SIZE);
+		try { EncryptionManager::validate(slot.kdf); }
+		catch (const std::invalid_argument& e) { throw std::runtime_error("Invalid vault file format: key slot " + std::to_string(i) + ": " + e.what()); }
+		m_slots[i] = std::move(slot);
+	}
+}
+
+std::vector<size_t> KeySlots::active() const
+{
+	std::vector<size_t> indices;
+	for (size_t i = 0; i < COUNT; ++i)
+	{
+		if (m_slots[i])
+			indices.push_back(i);
+	}
+	return indices;
+}
+
+const KeySlot& KeySlots::slot(const size_t index) const
+{
+	if (index >= COUNT || !m_slots[index])
+		throw std::invalid_argument("The key slot " + std::to_string(index) + " is not in use");
+	return *m_slots[index];
+}
+
+std::optional<EncryptionManager::Key> KeySlots::unlock(const size_t index, const EncryptionManager::Key& passwordKey) const
+{
+	const auto& keySlot = slot(index);
+	const EncryptionManager::Nonce nonce(keySlot.wrappedKey.begin(), keySlot.wrappedKey.begin() + EncryptionManager::NONCE_SIZE);
+	try
+	{
+		return EncryptionManager::decrypt(EncryptionManager::Data(keySlot.wrappedKey.begin() + EncryptionManager::NONCE_SIZE, keySlot.wrappedKey.end()), passwordKey, nonce, associated_data(keySlot));
+	}
+	catch (const std::exception&)
+	{
+		return std::nullopt;
+	}
+}
+
+size_t KeySlots::add(const EncryptionManager::Key& dataKey, EncryptionManager::Salt salt, const KdfParameters& kdf, const EncryptionManager::Key& passwordKey)
+{
+	if (dataKey.size() != KEY_SIZE || salt.size() != SALT_SIZE)
+		throw std::invalid_argument("Key slots hold 32 bytes keys derived with 16 bytes salts");
+	const auto free = std::ranges::find_if(m_slots, [](const auto& slot) { return !slot.has_value(); });
+	if (free == m_slots.end())
+		throw std::runtime_error("All the " + std::to_string(COUNT) + " key slots of the vault are in use");
+	KeySlot keySlot{std::move(salt), kdf, {}};
+	auto [wrappedKey, nonce] = EncryptionManager::encrypt(dataKey, passwordKey, associated_data(keySlot));
+	keySlot.wrappedKey = std::move(nonce);
+	keySlot.wrappedKey.insert(keySlot.wrappedKey.end(), wrappedKey.begin(), wrappedKey.end());
+	*free = std::move(keySlot);
+	return static_cast<size_t>(free - m_slots.begin());
+}
+
+void KeySlots::remove(const size_t index)
+{
+	if (index >= COUNT || !m_slots[index])
+		throw std::invalid_argument("The key slot " + std::to_string(index) + " is not in use");
+	m_slots[index].reset();
+}
+
+void KeySlots::write(std::ostream& stream) const
+{
+	for (size_t i = 0; i < COUNT; ++i)
+		write_slot(stream, i);
+}
+
+void KeySlots::store(const std::filesystem::path& vault, const std::uint64_t offset, const size_t index) const
+{
+	// Only the slot itself is rewritten, so the other slots stay valid if this is interrupted.
+	std::fstream file(vault.string(), std::ios::in | std::ios::out | std::ios::binary);
+	if (!file.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + vault.string());
+	file.seekp(static_cast<std::streamoff>(offset + index * SLOT_SIZE));
+	write_slot(file, index);
+	file.flush();
+	if (!file)
+		throw std::ios_base::failure("Failed to write the key slot " + std::to_string(index) + " of " + vault.string());
+}
+
+void KeySlots::write_slot(std::ostream& stream, const size_t index) const
+{
+	std::array<char, SLOT_SIZE> padding{};
+	if (!m_slots[index])
+	{
+		stream.write(padding.data(), padding.size());
+		return;
+	}
+	const auto& keySlot = *m_slots[index];
+	VaultFormat::write_uint(stream, ACTIVE, sizeof(std::uint32_t));
+	stream.write(reinterpret_cast<const char*>(keySlot.salt.data()), static_cast<std::streamsize>(keySlot.salt.size()));
+	VaultFormat::write_uint(stream, keySlot.kdf.memory, sizeof(std::uint32_t));
+	VaultFormat::write_uint(stream, keySlot.kdf.iterations, sizeof(std::uint32_t));
+	VaultFormat::write_uint(stream, keySlot.kdf.lanes, sizeof(std::uint32_t));
+	stream.write(reinterpret_cast<const char*>(keySlot.wrappedKey.data()), static_cast<std::streamsize>(keySlot.wrappedKey.size()));
+	stream.write(padding.data(), SLOT_SIZE - SLOT_CONTENT_SIZE);
+}
+
+EncryptionManager::Data KeySlots::associated_data(const KeySlot& slot)
+{
+	// The salt and parameters are authenticated with the wrapped key so a slot can't be altered to derive another key.
+	std::ostringstream data;
+	data.write(reinterpret_cast<const char*>(slot.salt.data()), static_cast<std::streamsize>(slot.salt.size()));
+	VaultFormat::write_uint(data, slot.kdf.memory, sizeof(std::uint32_t));
+	VaultFormat::write_uint(data, slot.kdf.iterations, sizeof(std::uint32_t));
+	VaultFormat::write_uint(data, slot.kdf.lanes, sizeof(std::uint32_t));
+	const auto str = data.str();
+	return {str.begin(), str.end()};
+}
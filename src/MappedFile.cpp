@@ -0,0 +1,115 @@
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <ios>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& path):
+	m_data(nullptr),
+	m_size(0)
+{
+#ifdef _WIN32
+	m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_file == INVALID_HANDLE_VALUE)
+		throw std::ios_base::failure("Failed to open the file: " + path.string());
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_file, &size))
+	{
+		CloseHandle(m_file);
+		throw std::ios_base::failure("Failed to get " + path.string() + " size.");
+	}
+	m_size = static_cast<std::size_t>(size.QuadPart);
+	m_mapping = nullptr;
+	if (m_size == 0)
+		return;
+	m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_mapping)
+		m_data = static_cast<const std::uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data)
+	{
+		if (m_mapping)
+			CloseHandle(m_mapping);
+		CloseHandle(m_file);
+		throw std::ios_base::failure("Failed to map the file: " + path.string());
+	}
+#else
+	const int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		throw std::ios_base::failure("Failed to open the file: " + path.string());
+	struct stat status{};
+	if (fstat(fd, &status) < 0)
+	{
+		::close(fd);
+		throw std::ios_base::failure("Failed to get " + path.string() + " size.");
+	}
+	m_size = static_cast<std::size_t>(status.st_size);
+	if (m_size != 0)
+	{
+		void* mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapping == MAP_FAILED)
+		{
+			::close(fd);
+			throw std::ios_base::failure("Failed to map the file: " + path.string());
+		}
+		m_data = static_cast<const std::uint8_t*>(mapping);
+		madvise(mapping, m_size, MADV_SEQUENTIAL);
+	}
+	::close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef _WIN32
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	CloseHandle(m_file);
+#else
+	if (m_data)
+		munmap(const_cast<std::uint8_t*>(m_data), m_size);
+#endif
+}
+
+std::span<const std::uint8_t> MappedFile::data() const
+{
+	return {m_data, m_size};
+}
+
+std::span<const std::uint8_t> MappedFile::data(const std::uint64_t offset, const std::uint64_t size) const
+{
+	if (offset > m_size || size > m_size - offset)
+		throw std::runtime_error("Invalid vault file format: block out of bounds");
+	return {m_data + offset, static_cast<std::size_t>(size)};
+}
+
+std::size_t MappedFile::size() const
+{
+	return m_size;
+}
+
+void MappedFile::release(const std::uint64_t offset, const std::uint64_t size) const
+{
+	if (!m_data || offset >= m_size)
+		return;
+	// The range is widened to whole pages, the pages of a neighbouring block are read again from the file if it needs them.
+	const auto end = static_cast<std::size_t>(std::min<std::uint64_t>(offset + size, m_size));
+#ifdef _WIN32
+	// Unlocking pages that aren't locked removes them from the working set.
+	VirtualUnlock(const_cast<std::uint8_t*>(m_data + offset), end - static_cast<std::size_t>(offset));
+#else
+	static const auto pageSize = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	const auto start = static_cast<std::size_t>(offset) / pageSize * pageSize;
+	madvise(const_cast<std::uint8_t*>(m_data) + start, end - start, MADV_DONTNEED);
+#endif
+}
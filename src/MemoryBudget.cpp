@@ -0,0 +1,97 @@
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+	#include <sys/resource.h>
+#endif
+
+MemoryBudget::MemoryBudget(const std::optional<std::uint64_t> limit):
+	m_limit(limit),
+	m_processors(std::max<size_t>(std::thread::hardware_concurrency(), 1))
+{
+	if (m_limit && *m_limit < BASE_MEMORY + WORKER_MEMORY)
+		throw std::invalid_argument("The memory budget of " + format(*m_limit) + " is too small, at least " + format(BASE_MEMORY + WORKER_MEMORY) + " is required");
+}
+
+const std::optional<std::uint64_t>& MemoryBudget::limit() const
+{
+	return m_limit;
+}
+
+size_t MemoryBudget::threads() const
+{
+	if (!m_limit)
+		return m_processors;
+	return std::clamp<size_t>(static_cast<size_t>((*m_limit - BASE_MEMORY) / WORKER_MEMORY), 1, m_processors);
+}
+
+std::uint64_t MemoryBudget::cache_size(const std::uint64_t requested) const
+{
+	if (!m_limit)
+		return requested;
+	return std::min(requested, *m_limit - BASE_MEMORY - threads() * WORKER_MEMORY);
+}
+
+size_t MemoryBudget::operations(const size_t requested) const
+{
+	const auto operations = std::max<size_t>(requested, 1);
+	if (!m_limit)
+		return operations;
+	return std::clamp<size_t>(static_cast<size_t>(*m_limit / (BASE_MEMORY + WORKER_MEMORY)), 1, operations);
+}
+
+MemoryBudget MemoryBudget::share(const size_t operations) const
+{
+	if (operations == 0 || operations > this->operations(operations))
+		throw std::invalid_argument("The memory budget of " + format(m_limit.value_or(0)) + " can't be shared by " + std::to_string(operations) + " operations");
+	MemoryBudget budget(m_limit ? std::optional(*m_limit / operations) : std::nullopt);
+	budget.m_processors = std::max<size_t>(m_processors / operations, 1);
+	return budget;
+}
+
+std::uint32_t MemoryBudget::kdf_memory() const
+{
+	if (!m_limit)
+		return EncryptionManager::MAX_KDF_MEMORY;
+	return static_cast<std::uint32_t>(std::min<std::uint64_t>(EncryptionManager::MAX_KDF_MEMORY, (*m_limit - BASE_MEMORY) / 1024));
+}
+
+void MemoryBudget::check(const KdfParameters& kdf) const
+{
+	if (m_limit && kdf.memory > kdf_memory())
+		throw std::invalid_argument("The key derivation needs " + format(kdf.memory * 1024ull) + ", more than the " + format(kdf_memory() * 1024ull) + " left by the memory budget of " + format(*m_limit));
+}
+
+std::uint64_t MemoryBudget::peak_rss()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return 0;
+	return counters.PeakWorkingSetSize;
+#else
+	rusage usage{};
+	if (getrusage(RUSAGE_SELF, &usage) != 0)
+		return 0;
+#ifdef __APPLE__
+	return static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+	return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+std::string MemoryBudget::format(const std::uint64_t bytes)
+{
+	std::ostringstream stream;
+	stream << std::fixed << std::setprecision(1) << static_cast<double>(bytes) / (1024 * 1024) << " MiB";
+	return stream.str();
+}
@@ -0,0 +1,151 @@
+#include "MerkleTree.h"
+
+#include <algorithm>
+#include <ios>
+#include <stdexcept>
+#include <botan/hash.h>
+
+namespace
+{
+	constexpr std::uint8_t LEAF_PREFIX = 0x00;
+	constexpr std::uint8_t NODE_PREFIX = 0x01;
+}
+
+MerkleTree::MerkleTree(std::string algorithm):
+	m_algorithm(std::move(algorithm)),
+	m_hashSize(Botan::HashFunction::create_or_throw(m_algorithm)->output_length())
+{
+}
+
+MerkleTree::MerkleTree(std::string algorithm, const std::span<const std::uint8_t> leaves):
+	MerkleTree(std::move(algorithm))
+{
+	if (leaves.size() % m_hashSize)
+		throw std::runtime_error("Invalid Merkle tree: truncated leaf");
+	m_leaves.assign(leaves.begin(), leaves.end());
+}
+
+void MerkleTree::add(const BlockInfo& block)
+{
+	const auto hash = leaf(block, m_algorithm);
+	m_leaves.insert(m_leaves.end(), hash.begin(), hash.end());
+}
+
+std::uint64_t MerkleTree::leaves() const
+{
+	return m_leaves.size() / m_hashSize;
+}
+
+MerkleTree::Hash MerkleTree::root() const
+{
+	if (m_leaves.empty())
+		return Botan::HashFunction::create_or_throw(m_algorithm)->final<Hash>();
+	return build().back();
+}
+
+std::uint64_t MerkleTree::size() const
+{
+	return serialized_size(leaves(), m_hashSize);
+}
+
+std::uint64_t MerkleTree::write(std::ostream& stream) const
+{
+	if (m_leaves.empty())
+		return 0;
+	std::uint64_t written = 0;
+	for (const auto& level : build())
+	{
+		stream.write(reinterpret_cast<const char*>(level.data()), static_cast<std::streamsize>(level.size()));
+		written += level.size();
+	}
+	if (!stream)
+		throw std::ios_base::failure("Failed to write the vault Merkle tree");
+	return written;
+}
+
+std::uint64_t MerkleTree::serialized_size(std::uint64_t leaves, const size_t hashSize)
+{
+	if (leaves == 0)
+		return 0;
+	std::uint64_t nodes = leaves;
+	while (leaves > 1)
+	{
+		leaves = (leaves + 1) / 2;
+		nodes += leaves;
+	}
+	return nodes * hashSize;
+}
+
+bool MerkleTree::verify(const BlockInfo& block, const std::span<const std::uint8_t> tree, const std::uint64_t leaves, const std::span<const std::uint8_t> root, const std::string& algorithm)
+{
+	auto hash = leaf(block, algorithm);
+	const auto hashSize = hash.size();
+	if (block.id >= leaves || tree.size() != serialized_size(leaves, hashSize))
+		return false;
+
+	std::uint64_t levelOffset = 0;
+	std::uint64_t count = leaves;
+	std::uint64_t index = block.id;
+	while (count > 1)
+	{
+		if (const auto sibling = index ^ 1; sibling < count)
+		{
+			const auto siblingHash = tree.subspan(levelOffset + sibling * hashSize, hashSize);
+			hash = index & 1 ? node(siblingHash, hash, algorithm) : node(hash, siblingHash, algorithm);
+		}
+		levelOffset += count * hashSize;
+		index /= 2;
+		count = (count + 1) / 2;
+	}
+	return std::ranges::equal(hash, root);
+}
+
+std::vector<std::vector<std::uint8_t>> MerkleTree::build() const
+{
+	std::vector<std::vector<std::uint8_t>> levels{m_leaves};
+	while (levels.back().size() > m_hashSize)
+	{
+		const auto& previous = levels.back();
+		const auto count = previous.size() / m_hashSize;
+		std::vector<std::uint8_t> level;
+		level.reserve((count + 1) / 2 * m_hashSize);
+		for (size_t i = 0; i < count; i += 2)
+		{
+			const auto left = std::span(previous).subspan(i * m_hashSize, m_hashSize);
+			if (i + 1 == count)
+			{
+				level.insert(level.end(), left.begin(), left.end());
+				continue;
+			}
+			const auto hash = node(left, std::span(previous).subspan((i + 1) * m_hashSize, m_hashSize), m_algorithm);
+			level.insert(level.end(), hash.begin(), hash.end());
+		}
+		levels.push_back(std::move(level));
+	}
+	return levels;
+}
+
+MerkleTree::Hash MerkleTree::leaf(const BlockInfo& block, const std::string& algorithm)
+{
+	const auto hash = Botan::HashFunction::create_or_throw(algorithm);
+	hash->update(LEAF_PREFIX);
+	for (const auto value : {block.id, block.offset, block.size, block.storedSize})
+	{
+		for (size_t i = 0; i < sizeof(value); ++i)
+			hash->update(static_cast<std::uint8_t>(value >> 8 * i));
+	}
+	hash->update(block.checksum);
+	// The volume is only hashed for multi-volume vaults, so the leaves of single file vaults are unchanged.
+	for (size_t i = 0; block.volume && i < sizeof(block.volume); ++i)
+		hash->update(static_cast<std::uint8_t>(block.volume >> 8 * i));
+	return hash->final<Hash>();
+}
+
+MerkleTree::Hash MerkleTree::node(const std::span<const std::uint8_t> left, const std::span<const std::uint8_t> right, const std::string& algorithm)
+{
+	const auto hash = Botan::HashFunction::create_or_throw(algorithm);
+	hash->update(NODE_PREFIX);
+	hash->update(left);
+	hash->update(right);
+	return hash->final<Hash>();
+}
@@ -8,3 +8,24 @@ Node::Node(std::string name, const std::filesystem::file_time_type lastWriteTime
 	m_permissions(permissions)
 {
 }
+
+const std::string& Node::name() const
+{
+	return m_name;
+}
+
+std::filesystem::file_time_type Node::last_write_time() const
+{
+	return m_lastWriteTime;
+}
+
+std::filesystem::perms Node::permissions() const
+{
+	return m_permissions;
+}
+
+void Node::set_attributes(const std::filesystem::file_time_type lastWriteTime, const std::filesystem::perms permissions)
+{
+	m_lastWriteTime = lastWriteTime;
+	m_permissions = permissions;
+}
@@ -0,0 +1,187 @@
+#include "Profiler.h"
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+	struct Timer
+	{
+		std::uint64_t calls = 0;
+		std::chrono::nanoseconds total{0};
+	};
+
+	struct Event
+	{
+		const char* name;
+		size_t thread;
+		std::chrono::steady_clock::time_point start;
+		std::chrono::steady_clock::duration duration;
+	};
+
+	constexpr std::array<const char*, Profiler::COUNTERS> COUNTER_NAMES = {"bytes_read", "bytes_written", "files", "io_calls", "allocations"};
+
+	// The flag and the counters are constant initialized, so allocations made before main are safe to count.
+	std::atomic<bool> enabledFlag{false};
+	std::atomic<bool> allocationsCounted{false};
+	std::array<std::atomic<std::uint64_t>, Profiler::COUNTERS> counters{};
+
+	struct State
+	{
+		std::mutex mutex;
+		bool tracing = false;
+		std::chrono::steady_clock::time_point origin;
+		std::map<std::string_view, Timer> timers;
+		std::vector<Event> events;
+		std::map<std::thread::id, size_t> threads;
+	};
+
+	State& state()
+	{
+		static State state;
+		return state;
+	}
+
+	void record(const char* name, const std::chrono::steady_clock::time_point start, const std::chrono::steady_clock::time_point end)
+	{
+		auto& profile = state();
+		std::lock_guard lock(profile.mutex);
+		auto& timer = profile.timers[name];
+		++timer.calls;
+		timer.total += end - start;
+		if (profile.tracing)
+		{
+			const auto [thread, inserted] = profile.threads.try_emplace(std::this_thread::get_id(), profile.threads.size() + 1);
+			profile.events.push_back({name, thread->second, start, end - start});
+		}
+	}
+
+	double microseconds(const std::chrono::steady_clock::duration duration)
+	{
+		return std::chrono::duration<double, std::micro>(duration).count();
+	}
+}
+
+Profiler::Scope::Scope(const char* name):
+	m_name(enabled() ? name : nullptr),
+	m_start(m_name ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point())
+{
+}
+
+Profiler::Scope::~Scope()
+{
+	if (m_name)
+		record(m_name, m_start, std::chrono::steady_clock::now());
+}
+
+void Profiler::enable(const bool trace)
+{
+	auto& profile = state();
+	{
+		std::lock_guard lock(profile.mutex);
+		profile.tracing = profile.tracing || trace;
+		if (!enabled())
+			profile.origin = std::chrono::steady_clock::now();
+	}
+	enabledFlag.store(true, std::memory_order_relaxed);
+}
+
+void Profiler::reset()
+{
+	enabledFlag.store(false, std::memory_order_relaxed);
+	for (auto& value : counters)
+		value.store(0, std::memory_order_relaxed);
+	auto& profile = state();
+	std::lock_guard lock(profile.mutex);
+	profile.tracing = false;
+	profile.timers.clear();
+	profile.events.clear();
+	profile.threads.clear();
+}
+
+bool Profiler::enabled()
+{
+	return enabledFlag.load(std::memory_order_relaxed);
+}
+
+void Profiler::count(const Counter counter, const std::uint64_t value)
+{
+	if (enabled())
+		counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+std::uint64_t Profiler::counter(const Counter counter)
+{
+	return counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+}
+
+void Profiler::count_allocations(const bool counted)
+{
+	allocationsCounted.store(counted, std::memory_order_relaxed);
+}
+
+bool Profiler::counts_allocations()
+{
+	return allocationsCounted.load(std::memory_order_relaxed);
+}
+
+void Profiler::print_summary(std::ostream& stream)
+{
+	auto& profile = state();
+	std::lock_guard lock(profile.mutex);
+	std::vector<std::pair<std::string_view, Timer>> timers(profile.timers.begin(), profile.timers.end());
+	std::ranges::sort(timers, std::greater(), [](const auto& timer) { return timer.second.total; });
+
+	// Phases running on the thread pool are summed over the threads, so they can exceed the wall time.
+	const auto flags = stream.flags();
+	stream << std::left << std::setw(20) << "Phase" << std::right << std::setw(10) << "Calls" << std::setw(14) << "Total (ms)" << std::setw(14) << "Mean (us)" << '\n';
+	for (const auto& [name, timer] : timers)
+	{
+		const auto total = std::chrono::duration<double, std::milli>(timer.total).count();
+		stream << std::left << std::setw(20) << name << std::right << std::setw(10) << timer.calls << std::fixed << std::setprecision(1)
+			<< std::setw(14) << total << std::setw(14) << 1000 * total / static_cast<double>(timer.calls) << '\n';
+	}
+	stream.flags(flags);
+	stream << "Read: " << MemoryBudget::format(counter(Counter::BYTES_READ)) << ", written: " << MemoryBudget::format(counter(Counter::BYTES_WRITTEN))
+		<< ", files: " << counter(Counter::FILES) << ", I/O calls: " << counter(Counter::IO_CALLS);
+	if (counts_allocations())
+		stream << ", allocations: " << counter(Counter::ALLOCATIONS);
+	stream << std::endl;
+}
+
+void Profiler::write_trace(const std::filesystem::path& path)
+{
+	std::ofstream stream(path.string());
+	if (!stream.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + path.string());
+
+	auto& profile = state();
+	std::lock_guard lock(profile.mutex);
+	// Chrome trace_event format, complete events are in microseconds since the profiler was enabled.
+	stream << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+	auto end = profile.origin;
+	for (const auto& event : profile.events)
+	{
+		stream << "{\"name\":\"" << event.name << "\",\"cat\":\"vault\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread
+			<< ",\"ts\":" << microseconds(event.start - profile.origin) << ",\"dur\":" << microseconds(event.duration) << "},";
+		end = std::max(end, event.start + event.duration);
+	}
+	stream << "{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"ts\":" << microseconds(end - profile.origin) << ",\"args\":{";
+	for (size_t i = 0; i < COUNTERS; ++i)
+	{
+		if (static_cast<Counter>(i) != Counter::ALLOCATIONS || counts_allocations())
+			stream << (i ? "," : "") << '"' << COUNTER_NAMES[i] << "\":" << counter(static_cast<Counter>(i));
+	}
+	stream << "}}],\"displayTimeUnit\":\"ms\"}" << std::endl;
+	if (!stream)
+		throw std::ios_base::failure("Failed to write the trace to " + path.string());
+}
@@ -0,0 +1,77 @@
+#include "ProgressBar.h"
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	const char* phase_name(const ProgressPhase phase)
+	{
+		switch (phase)
+		{
+		case ProgressPhase::SCANNING:
+			return "Scanning";
+		case ProgressPhase::STORING:
+			return "Storing";
+		case ProgressPhase::EXTRACTING:
+			return "Extracting";
+		case ProgressPhase::VERIFYING:
+			break;
+		}
+		return "Verifying";
+	}
+}
+
+ProgressBar::ProgressBar(std::ostream& stream):
+	m_stream(stream),
+	m_lineSize(0)
+{
+}
+
+void ProgressBar::on_progress(const Progress& progress)
+{
+	// The line is redrawn in place, padded to erase the end of a longer previous one.
+	const auto line = format(progress);
+	m_stream << '\r' << line << std::string(m_lineSize > line.size() ? m_lineSize - line.size() : 0, ' ');
+	m_lineSize = line.size();
+	if (progress.finished)
+	{
+		m_stream << std::endl;
+		m_lineSize = 0;
+	}
+	else
+		m_stream.flush();
+}
+
+std::string ProgressBar::format(const Progress& progress)
+{
+	std::ostringstream line;
+	line << std::left << std::setw(11) << phase_name(progress.phase) << std::right;
+	if (progress.phase == ProgressPhase::SCANNING)
+	{
+		line << progress.entries << " entries, " << MemoryBudget::format(progress.bytesIn);
+		return line.str();
+	}
+
+	// The original bytes are the ones read when storing, and the ones written back otherwise.
+	const auto bytes = progress.phase == ProgressPhase::STORING ? progress.bytesIn : progress.bytesOut;
+	const auto ratio = progress.finished ? 1.0 : progress.totalBytes ? std::min(1.0, static_cast<double>(bytes) / static_cast<double>(progress.totalBytes)) : 0.0;
+	const auto filled = static_cast<size_t>(ratio * WIDTH);
+	const auto seconds = std::chrono::duration<double>(progress.elapsed).count();
+	const auto rate = seconds > 0 ? static_cast<double>(bytes) / seconds : 0.0;
+	line << '[' << std::string(filled, '#') << std::string(WIDTH - filled, '.') << "] " << std::setw(3) << static_cast<int>(ratio * 100) << "%  "
+		<< progress.entries << "/" << progress.totalEntries << " entries  " << MemoryBudget::format(bytes) << "  "
+		<< std::fixed << std::setprecision(1) << rate / 1e6 << " MB/s  ";
+	if (progress.finished)
+		line << "in " << static_cast<std::uint64_t>(seconds) << "s";
+	else if (rate > 0 && progress.totalBytes >= bytes)
+	{
+		const auto eta = static_cast<std::uint64_t>(static_cast<double>(progress.totalBytes - bytes) / rate);
+		line << "ETA " << eta / 60 << ":" << std::setw(2) << std::setfill('0') << eta % 60;
+	}
+	else
+		line << "ETA --:--";
+	return line.str();
+}
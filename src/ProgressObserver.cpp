@@ -0,0 +1,60 @@
+#include "ProgressObserver.h"
+
+ProgressTracker::ProgressTracker(ProgressObserver& observer):
+	m_observer(observer),
+	m_phase(ProgressPhase::SCANNING),
+	m_totalEntries(0),
+	m_totalBytes(0),
+	m_start(std::chrono::steady_clock::now()),
+	m_entries(0),
+	m_bytesIn(0),
+	m_bytesOut(0),
+	m_next(0)
+{
+}
+
+void ProgressTracker::start(const ProgressPhase phase, const std::uint64_t totalEntries, const std::uint64_t totalBytes)
+{
+	std::lock_guard lock(m_mutex);
+	m_phase = phase;
+	m_totalEntries = totalEntries;
+	m_totalBytes = totalBytes;
+	m_start = std::chrono::steady_clock::now();
+	m_entries = 0;
+	m_bytesIn = 0;
+	m_bytesOut = 0;
+	m_next = (m_start + INTERVAL).time_since_epoch().count();
+}
+
+void ProgressTracker::add(const std::uint64_t entries, const std::uint64_t bytesIn, const std::uint64_t bytesOut)
+{
+	m_entries.fetch_add(entries, std::memory_order_relaxed);
+	m_bytesIn.fetch_add(bytesIn, std::memory_order_relaxed);
+	m_bytesOut.fetch_add(bytesOut, std::memory_order_relaxed);
+
+	// Only the thread that moves the deadline forward notifies, the others go on without waiting for the observer.
+	const auto now = std::chrono::steady_clock::now();
+	auto next = m_next.load(std::memory_order_relaxed);
+	if (now.time_since_epoch().count() < next || !m_next.compare_exchange_strong(next, (now + INTERVAL).time_since_epoch().count()))
+		return;
+	std::lock_guard lock(m_mutex);
+	m_observer.on_progress(snapshot(false));
+}
+
+void ProgressTracker::finish()
+{
+	std::lock_guard lock(m_mutex);
+	m_observer.on_progress(snapshot(true));
+}
+
+Progress ProgressTracker::progress() const
+{
+	std::lock_guard lock(m_mutex);
+	return snapshot(false);
+}
+
+Progress ProgressTracker::snapshot(const bool finished) const
+{
+	return {m_phase, finished, m_entries.load(std::memory_order_relaxed), m_totalEntries, m_bytesIn.load(std::memory_order_relaxed),
+		m_bytesOut.load(std::memory_order_relaxed), m_totalBytes, std::chrono::steady_clock::now() - m_start};
+}
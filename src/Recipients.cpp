@@ -0,0 +1,181 @@
+#include "Recipients.h"
+
+#include <algorithm>
+#include <botan/auto_rng.h>
+#include <botan/base64.h>
+#include <botan/pubkey.h>
+#include <botan/x25519.h>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+	constexpr size_t WRAPPED_KEY_SIZE = EncryptionManager::NONCE_SIZE + Recipients::KEY_SIZE + 16;
+
+	EncryptionManager::Data decode_key(const std::string_view encoded, const size_t size)
+	{
+		EncryptionManager::Data key;
+		try { key = Botan::base64_decode(encoded); }
+		catch (const std::exception&) { key.clear(); }
+		if (key.size() != size)
+			throw std::runtime_error("Invalid key encoding");
+		return key;
+	}
+
+	// Key files hold a single prefixed key, blank lines and lines starting with # are ignored.
+	EncryptionManager::Data read_key_file(const std::filesystem::path& file, const std::string_view prefix, const std::string& description)
+	{
+		std::ifstream stream(file.string());
+		if (!stream.is_open())
+			throw std::ios_base::failure("Failed to open the file: " + file.string());
+		std::string line;
+		while (std::getline(stream, line))
+		{
+			if (line.ends_with('\r'))
+				line.pop_back();
+			if (line.empty() || line.starts_with('#'))
+				continue;
+			if (!line.starts_with(prefix))
+				break;
+			try { return decode_key(std::string_view(line).substr(prefix.size()), Recipients::KEY_SIZE); }
+			catch (const std::runtime_error&) { break; }
+		}
+		throw std::runtime_error(file.string() + " is not a valid " + description + " file");
+	}
+}
+
+Recipients::Recipients(const pugi::xml_node& header)
+{
+	for (const auto child : header.children("recipient"))
+	{
+		try
+		{
+			m_recipients.push_back({decode_key(child.attribute("publicKey").value(), KEY_SIZE),
+				decode_key(child.attribute("ephemeralKey").value(), KEY_SIZE),
+				decode_key(child.attribute("wrappedKey").value(), WRAPPED_KEY_SIZE)});
+		}
+		catch (const std::runtime_error&)
+		{
+			throw std::runtime_error("Invalid vault file format: invalid recipient " + std::to_string(m_recipients.size()));
+		}
+	}
+}
+
+bool Recipients::empty() const
+{
+	return m_recipients.empty();
+}
+
+const std::vector<Recipient>& Recipients::entries() const
+{
+	return m_recipients;
+}
+
+void Recipients::add(const EncryptionManager::Key& dataKey, const EncryptionManager::Data& publicKey)
+{
+	if (publicKey.size() != KEY_SIZE)
+		throw std::invalid_argument("X25519 public keys are 32 bytes long");
+	// Each recipient gets its own ephemeral key, so the wrapped keys share nothing but the data key.
+	Botan::AutoSeeded_RNG rng;
+	const Botan::X25519_PrivateKey ephemeral(rng);
+	const auto ephemeralPublicKey = ephemeral.public_value();
+	Recipient recipient{publicKey, {ephemeralPublicKey.begin(), ephemeralPublicKey.end()}, {}};
+	const auto key = wrapping_key(ephemeral.raw_private_key_bits(), publicKey, recipient);
+	auto [wrappedKey, nonce] = EncryptionManager::encrypt(dataKey, key);
+	recipient.wrappedKey = std::move(nonce);
+	recipient.wrappedKey.insert(recipient.wrappedKey.end(), wrappedKey.begin(), wrappedKey.end());
+	m_recipients.push_back(std::move(recipient));
+}
+
+std::optional<EncryptionManager::Key> Recipients::unlock(const EncryptionManager::Key& secretKey) const
+{
+	const auto publicKey = public_key(secretKey);
+	for (const auto& recipient : m_recipients)
+	{
+		if (recipient.publicKey != publicKey)
+			continue;
+		const auto key = wrapping_key(secretKey, recipient.ephemeralKey, recipient);
+		const EncryptionManager::Nonce nonce(recipient.wrappedKey.begin(), recipient.wrappedKey.begin() + EncryptionManager::NONCE_SIZE);
+		try { return EncryptionManager::decrypt(EncryptionManager::Data(recipient.wrappedKey.begin() + EncryptionManager::NONCE_SIZE, recipient.wrappedKey.end()), key, nonce); }
+		catch (const std::exception&) {}
+	}
+	return std::nullopt;
+}
+
+void Recipients::write(pugi::xml_node& header) const
+{
+	for (const auto& [publicKey, ephemeralKey, wrappedKey] : m_recipients)
+	{
+		auto node = header.append_child("recipient");
+		if (!node)
+			throw std::runtime_error("Failed to create the XML node");
+		node.append_attribute("publicKey").set_value(Botan::base64_encode(publicKey).c_str());
+		node.append_attribute("ephemeralKey").set_value(Botan::base64_encode(ephemeralKey).c_str());
+		node.append_attribute("wrappedKey").set_value(Botan::base64_encode(wrappedKey).c_str());
+	}
+}
+
+EncryptionManager::Data Recipients::generate_identity(const std::filesystem::path& identity)
+{
+	auto publicFile = identity;
+	publicFile += ".pub";
+	if (exists(identity))
+		throw std::runtime_error(identity.string() + " already exists");
+	if (exists(publicFile))
+		throw std::runtime_error(publicFile.string() + " already exists");
+
+	Botan::AutoSeeded_RNG rng;
+	const Botan::X25519_PrivateKey key(rng);
+	const auto publicValue = key.public_value();
+	const EncryptionManager::Data publicKey(publicValue.begin(), publicValue.end());
+
+	// The permissions are restricted before the secret key is written to the file.
+	std::ofstream stream(identity.string());
+	if (!stream.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + identity.string());
+	std::filesystem::permissions(identity, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+	stream << "# public key: " << format_public_key(publicKey) << '\n'
+		<< SECRET_KEY_PREFIX << Botan::base64_encode(key.raw_private_key_bits()) << '\n';
+	if (!stream.flush())
+		throw std::ios_base::failure("Failed to write the identity to " + identity.string());
+
+	std::ofstream publicStream(publicFile.string());
+	if (!publicStream.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + publicFile.string());
+	publicStream << format_public_key(publicKey) << '\n';
+	if (!publicStream.flush())
+		throw std::ios_base::failure("Failed to write the public key to " + publicFile.string());
+	return publicKey;
+}
+
+EncryptionManager::Data Recipients::read_public_key(const std::filesystem::path& file)
+{
+	return read_key_file(file, PUBLIC_KEY_PREFIX, "X25519 public key");
+}
+
+EncryptionManager::Key Recipients::read_identity(const std::filesystem::path& file)
+{
+	return read_key_file(file, SECRET_KEY_PREFIX, "X25519 identity");
+}
+
+EncryptionManager::Data Recipients::public_key(const EncryptionManager::Key& secretKey)
+{
+	const auto publicValue = Botan::X25519_PrivateKey(secretKey).public_value();
+	return {publicValue.begin(), publicValue.end()};
+}
+
+std::string Recipients::format_public_key(const EncryptionManager::Data& publicKey)
+{
+	return PUBLIC_KEY_PREFIX + Botan::base64_encode(publicKey);
+}
+
+EncryptionManager::Key Recipients::wrapping_key(const EncryptionManager::Key& secretKey, const EncryptionManager::Data& peerKey, const Recipient& recipient)
+{
+	// Both public keys salt the derivation, so a wrapped key only opens for the recipient it was made for.
+	Botan::AutoSeeded_RNG rng;
+	const Botan::X25519_PrivateKey key(secretKey);
+	const Botan::PK_Key_Agreement agreement(key, rng, "HKDF(SHA-256)");
+	EncryptionManager::Data salt = recipient.ephemeralKey;
+	salt.insert(salt.end(), recipient.publicKey.begin(), recipient.publicKey.end());
+	return agreement.derive_key(KEY_SIZE, peerKey, salt.data(), salt.size()).bits_of();
+}
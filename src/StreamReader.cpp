@@ -0,0 +1,241 @@
+#include "StreamReader.h"
+#include "BlockReader.h"
+#include "ChecksumManager.h"
+#include "MerkleTree.h"
+#include "Profiler.h"
+
+#include <algorithm>
+#include <fstream>
+
+StreamReader::StreamReader(std::istream& stream):
+	m_stream(stream),
+	m_headerSize(0),
+	m_progress(nullptr),
+	m_offset(0)
+{
+	// Anything else than a vault, such as a legacy one, is left to be read as a whole.
+	if (!read_prefix(VaultFormat::MAGIC.size()) || !VaultFormat::has_magic(m_prefix) || !read_prefix(sizeof(std::uint32_t)))
+		return;
+	m_headerSize = VaultFormat::read_uint(std::span(m_prefix).subspan(VaultFormat::MAGIC.size()), sizeof(std::uint32_t));
+	if (!read_prefix(m_headerSize))
+		return;
+	auto header = BlockReader::parse_header(std::span(m_prefix).subspan(VaultFormat::MAGIC.size() + sizeof(std::uint32_t)));
+	if (header.keySlots)
+	{
+		if (!read_prefix(KeySlots::SIZE))
+			return;
+		header.keySlots = KeySlots(std::span(m_prefix).last(KeySlots::SIZE));
+	}
+	m_header = std::move(header);
+	m_offset = m_prefix.size();
+}
+
+bool StreamReader::framed() const
+{
+	return m_header.framed;
+}
+
+const VaultHeader& StreamReader::header() const
+{
+	return m_header;
+}
+
+std::span<const std::uint8_t> StreamReader::prefix() const
+{
+	return m_prefix;
+}
+
+void StreamReader::set_key(EncryptionManager::Key key)
+{
+	m_key = std::move(key);
+}
+
+void StreamReader::set_progress(ProgressTracker* progress)
+{
+	m_progress = progress;
+}
+
+StreamReader::Data StreamReader::extract(const std::filesystem::path& directory, const std::function<bool(const std::filesystem::path&)>& selected)
+{
+	if (!m_header.framed)
+		throw std::runtime_error("Invalid vault file format: the vault can't be read from a stream");
+	if (m_header.encrypted && !m_key)
+		throw std::runtime_error("The vault is encrypted but no key has been provided");
+	create_directories(directory);
+	MerkleTree tree(m_header.checksum);
+	std::optional<BlockInfo> index;
+	Data indexData;
+
+	// The file being extracted, until the next entry or the index.
+	std::ofstream file;
+	std::filesystem::path path;
+	Entry* entry = nullptr;
+	std::optional<ChecksumManager::Stream> checksum;
+	bool sparse = false;
+	const auto close = [&]
+	{
+		if (!entry)
+			return;
+		file.close();
+		if (!file)
+			throw std::ios_base::failure("Failed to write the file: " + path.string());
+		// The file is extended to its size, past a hole at its end.
+		if (sparse)
+			std::filesystem::resize_file(path, entry->size);
+		entry->checksum = checksum->final();
+		entry = nullptr;
+		checksum.reset();
+		sparse = false;
+		if (m_progress)
+			m_progress->add(1, 0, 0);
+	};
+
+	for (;;)
+	{
+		const auto frame = read(VaultFormat::FRAME_SIZE);
+		const auto length = VaultFormat::read_uint(std::span(frame).subspan(1), sizeof(std::uint64_t));
+		const auto size = VaultFormat::read_uint(std::span(frame).subspan(1 + sizeof(std::uint64_t)), sizeof(std::uint64_t));
+		const auto offset = m_offset;
+		switch (static_cast<FrameType>(frame[0]))
+		{
+		case FrameType::ENTRY:
+		{
+			close();
+			const auto name = BlockReader::decode(read(length), size, m_header, m_key);
+			const std::filesystem::path relative = std::string(name.begin(), name.end());
+			// Nothing is written outside the directory, whatever the stream holds.
+			if (relative.empty() || relative.has_root_path() || std::any_of(relative.begin(), relative.end(), [](const std::filesystem::path& part) { return part.empty() || part == "." || part == ".."; }))
+				throw std::runtime_error("Invalid vault file format: invalid entry " + relative.string());
+			if (!selected(relative))
+				break;
+			path = directory / relative;
+			clear_way(directory, relative);
+			file.open(path.string(), std::ios::binary | std::ios::trunc);
+			if (!file.is_open())
+				throw std::ios_base::failure("Failed to create the file: " + path.string());
+			Profiler::count(Profiler::Counter::FILES);
+			entry = &(m_entries[relative.generic_string()] = Entry());
+			checksum.emplace(m_header.checksum);
+			break;
+		}
+		case FrameType::BLOCK:
+		{
+			// Every block is a leaf of the tree, those of the files left out are only hashed.
+			const auto stored = read(length);
+			const BlockInfo block{tree.leaves(), offset, size, length, ChecksumManager::compute(stored, m_header.checksum)};
+			tree.add(block);
+			if (m_progress)
+				m_progress->add(0, length, size);
+			if (!entry)
+				break;
+			const auto data = BlockReader::decode(stored, size, m_header, m_key);
+			if (!file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())))
+				throw std::ios_base::failure("Failed to write the file: " + path.string());
+			Profiler::count(Profiler::Counter::BYTES_WRITTEN, data.size());
+			checksum->update(data);
+			entry->size += data.size();
+			entry->blocks.push_back(block);
+			break;
+		}
+		case FrameType::HOLE:
+			if (length)
+				throw std::runtime_error("Invalid vault file format: hole with data at offset " + std::to_string(offset));
+			if (!entry)
+				break;
+			if (!file.seekp(static_cast<std::streamoff>(size), std::ios::cur))
+				throw std::ios_base::failure("Failed to write the file: " + path.string());
+			entry->size += size;
+			entry->blocks.push_back({0, 0, size, 0, {}});
+			sparse = true;
+			break;
+		case FrameType::INDEX:
+			close();
+			indexData = read(length);
+			index = BlockInfo{0, offset, size, length, ChecksumManager::compute(indexData, m_header.checksum)};
+			break;
+		case FrameType::TREE:
+			close();
+			static_cast<void>(read(length));
+			break;
+		case FrameType::TRAILER:
+		{
+			close();
+			const auto trailer = read(length);
+			const auto tail = read(VaultFormat::TAIL_SIZE);
+			if (!VaultFormat::has_magic(std::span(tail).last(VaultFormat::MAGIC.size())) || VaultFormat::read_uint(tail, sizeof(std::uint64_t)) != length)
+				throw std::runtime_error("Invalid vault file format: truncated vault");
+			// The data appended to a vault follows the trailer it had before, only the last one is read.
+			if (m_stream.peek() != std::char_traits<char>::eof())
+				break;
+			if (m_stream.bad())
+				throw std::ios_base::failure("Failed to read the vault from the stream");
+			const auto parsed = BlockReader::parse_trailer(trailer, m_header, std::span(m_prefix).subspan(VaultFormat::MAGIC.size() + sizeof(std::uint32_t), m_headerSize), m_key);
+			if (!parsed.volumes.empty() || parsed.leaves != tree.leaves() || !std::ranges::equal(parsed.root, tree.root()))
+				throw std::runtime_error("Unauthenticated vault: the blocks read don't match its Merkle tree");
+			if (!index || index->offset != parsed.index.offset || index->size != parsed.index.size || index->storedSize != parsed.index.storedSize || index->checksum != parsed.index.checksum)
+				throw std::runtime_error("Failed to read the vault index: it doesn't match the trailer");
+			try { return BlockReader::decode(indexData, index->size, m_header, m_key); }
+			catch (const std::runtime_error& e) { throw std::runtime_error("Failed to read the vault index: " + std::string(e.what())); }
+		}
+		default:
+			throw std::runtime_error("Invalid vault file format: unknown frame at offset " + std::to_string(offset - VaultFormat::FRAME_SIZE));
+		}
+	}
+}
+
+const std::map<std::string, StreamReader::Entry>& StreamReader::entries() const
+{
+	return m_entries;
+}
+
+bool StreamReader::read_prefix(const size_t size)
+{
+	const auto begin = m_prefix.size();
+	m_prefix.resize(begin + size);
+	m_stream.read(reinterpret_cast<char*>(m_prefix.data() + begin), static_cast<std::streamsize>(size));
+	if (m_stream.bad())
+		throw std::ios_base::failure("Failed to read the vault from the stream");
+	m_prefix.resize(begin + static_cast<size_t>(m_stream.gcount()));
+	return m_prefix.size() == begin + size;
+}
+
+StreamReader::Data StreamReader::read(const std::uint64_t size)
+{
+	// The length comes from the stream, the data is only allocated as it arrives.
+	Data data;
+	while (data.size() < size)
+	{
+		const auto begin = data.size();
+		data.resize(begin + static_cast<size_t>(std::min<std::uint64_t>(size - begin, VaultFormat::CHUNK_SIZE)));
+		if (!m_stream.read(reinterpret_cast<char*>(data.data() + begin), static_cast<std::streamsize>(data.size() - begin)))
+		{
+			if (m_stream.bad())
+				throw std::ios_base::failure("Failed to read the vault from the stream");
+			throw std::runtime_error("Invalid vault file format: truncated vault");
+		}
+		Profiler::count(Profiler::Counter::IO_CALLS);
+	}
+	Profiler::count(Profiler::Counter::BYTES_READ, size);
+	m_offset += size;
+	return data;
+}
+
+void StreamReader::clear_way(const std::filesystem::path& directory, const std::filesystem::path& path)
+{
+	// An entry appended to the vault may replace a file of an earlier index by a directory, or the other way around.
+	// What was extracted in its way is removed, the index no longer has it.
+	auto current = directory;
+	std::filesystem::path relative;
+	for (auto part = path.begin(); part != path.end(); ++part)
+	{
+		current /= *part;
+		relative /= *part;
+		const auto status = std::filesystem::symlink_status(current);
+		if (std::next(part) == path.end() ? !is_directory(status) : (!exists(status) || is_directory(status)))
+			continue;
+		std::filesystem::remove_all(current);
+		const auto name = relative.generic_string();
+		std::erase_if(m_entries, [&name](const auto& extracted) { return extracted.first == name || extracted.first.starts_with(name + "/"); });
+	}
+	create_directories(directory / path.parent_path());
+}
@@ -0,0 +1,43 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(const size_t threads):
+	m_stopping(false)
+{
+	m_workers.reserve(std::max<size_t>(threads, 1));
+	for (size_t i = 0; i < std::max<size_t>(threads, 1); ++i)
+		m_workers.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::scoped_lock lock(m_mutex);
+		m_stopping = true;
+	}
+	m_condition.notify_all();
+	m_workers.clear();
+}
+
+size_t ThreadPool::size() const
+{
+	return m_workers.size();
+}
+
+void ThreadPool::work()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_stopping || !m_tasks.empty(); });
+			if (m_tasks.empty())
+				return;
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+		task();
+	}
+}
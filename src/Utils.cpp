@@ -3,13 +3,45 @@
 
 #ifdef _WIN32
 #include <conio.h>
+#include <windows.h>
 #else
+	#include <cerrno>
+	#include <fcntl.h>
+	#include <sys/wait.h>
 	#include <termios.h>
 	#include <unistd.h>
 #endif
 
 namespace
 {
+	bool passwordsFromTerminal = false;
+
+#ifndef _WIN32
+	// Reads a line from the controlling terminal when the standard input carries data.
+	EncryptionManager::Password read_terminal_line()
+	{
+		const int terminal = open("/dev/tty", O_RDWR | O_CLOEXEC);
+		if (terminal < 0)
+			throw std::runtime_error("No terminal to read the password from while the standard input carries the vault");
+		termios oldt, newt;
+		const bool hidden = tcgetattr(terminal, &oldt) == 0;
+		if (hidden)
+		{
+			newt = oldt;
+			newt.c_lflag &= ~ECHO;
+			tcsetattr(terminal, TCSANOW, &newt);
+		}
+		EncryptionManager::Password password;
+		char ch;
+		while (read(terminal, &ch, 1) == 1 && ch != '\n')
+			password.push_back(ch);
+		if (hidden)
+			tcsetattr(terminal, TCSANOW, &oldt);
+		close(terminal);
+		return password;
+	}
+#endif
+
 	EncryptionManager::Password get_hidden_input()
 	{
 		EncryptionManager::Password password;
@@ -29,6 +61,12 @@ namespace
 			}
 		}
 #else
+		if (passwordsFromTerminal)
+		{
+			password = read_terminal_line();
+			std::cerr << std::endl;
+			return password;
+		}
 		termios oldt, newt;
 		tcgetattr(STDIN_FILENO, &oldt);
 		newt = oldt;
@@ -40,17 +78,23 @@ namespace
 		tcsetattr(STDIN_FILENO, TCSANOW, &oldt);
 #endif
 
-		std::cout << std::endl;
+		std::cerr << std::endl;
 		return password;
 	}
 }
 
-std::optional<EncryptionManager::Password> ask_password_with_confirmation()
+void read_passwords_from_terminal(const bool enabled)
+{
+	passwordsFromTerminal = enabled;
+}
+
+std::optional<EncryptionManager::Password> ask_password_with_confirmation(const std::string& name)
 {
-	std::cout << "Enter password: ";
+	// Prompts go to the standard error, the standard output can carry a vault.
+	std::cerr << "Enter " << name << ": ";
 	EncryptionManager::Password password = get_hidden_input();
 
-	std::cout << "Confirm password: ";
+	std::cerr << "Confirm " << name << ": ";
 	if (const EncryptionManager::Password confirm_password = get_hidden_input(); password == confirm_password)
 		return password;
 	return std::nullopt;
@@ -60,7 +104,7 @@ Answer ask_confirmation(const std::string& question, const Answer defaultAnswer)
 {
 	if (defaultAnswer == Answer::ABORT)
 		throw std::invalid_argument("The default answer cannot be ABORT");
-	std::cout << question << (defaultAnswer == Answer::YES ? " [Y/n] " : " [y/N] ");
+	std::cerr << question << (defaultAnswer == Answer::YES ? " [Y/n] " : " [y/N] ");
 	std::string answer;
 	std::getline(std::cin, answer);
 	if (answer.empty())
@@ -73,14 +117,61 @@ Answer ask_confirmation(const std::string& question, const Answer defaultAnswer)
 	return Answer::ABORT;
 }
 
-std::filesystem::path get_temp_name(const std::filesystem::path& parentPath)
+std::filesystem::path get_temp_name(const std::filesystem::path& parentPath, const std::string& prefix)
 {
 	std::filesystem::path filePath;
 	int counter = 0;
 	do
 	{
-		filePath = parentPath / ("temp" + std::to_string(counter));
+		filePath = parentPath / (prefix + std::to_string(counter));
 		++counter;
 	} while (exists(filePath));
 	return filePath;
 }
+
+bool remove_detached(const std::filesystem::path& path)
+{
+#ifdef _WIN32
+	std::wstring command = L"cmd.exe /d /c rmdir /s /q \"" + absolute(path).wstring() + L"\"";
+	STARTUPINFOW startup{};
+	startup.cb = sizeof(startup);
+	PROCESS_INFORMATION process{};
+	if (!CreateProcessW(nullptr, command.data(), nullptr, nullptr, FALSE, CREATE_NO_WINDOW | CREATE_NEW_PROCESS_GROUP, nullptr, nullptr, &startup, &process))
+		return false;
+	CloseHandle(process.hThread);
+	CloseHandle(process.hProcess);
+	return true;
+#else
+	// rm runs in a grandchild in its own session, reparented once the child exits, so it is never waited for and ignores
+	// the signals sent to the terminal. Only async-signal-safe calls are made between fork and exec.
+	const auto target = absolute(path).string();
+	const char* const args[] = {"rm", "-rf", "--", target.c_str(), nullptr};
+	const pid_t child = fork();
+	if (child < 0)
+		return false;
+	if (child == 0)
+	{
+		setsid();
+		const pid_t remover = fork();
+		if (remover == 0)
+		{
+			if (const int null = open("/dev/null", O_RDWR); null >= 0)
+			{
+				dup2(null, STDIN_FILENO);
+				dup2(null, STDOUT_FILENO);
+				dup2(null, STDERR_FILENO);
+			}
+			execv("/bin/rm", const_cast<char* const*>(args));
+			_exit(127);
+		}
+		_exit(remover < 0 ? 1 : 0);
+	}
+	int status = 0;
+	while (waitpid(child, &status, 0) < 0)
+	{
+		if (errno != EINTR)
+			return false;
+	}
+	return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+#endif
+}
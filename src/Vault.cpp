@@ -1,8 +1,18 @@
 #include "Vault.h"
 #include "File.h"
 #include "Utils.h"
+#include "BlockReader.h"
+#include "BlockWriter.h"
+#include "Checkpoint.h"
 #include "CompressionManager.h"
+#include "KeyAgent.h"
+#include "KeyRing.h"
+#include "Profiler.h"
+#include "Recipients.h"
+#include "StreamReader.h"
+#include "ThreadPool.h"
 
+#include <atomic>
 #include <stack>
 #include <fstream>
 #include <sstream>
@@ -10,11 +20,479 @@
 #include <chrono>
 #include <date.h>
 #include <iostream>
+#include <map>
+#include <ranges>
+#include <set>
 
-Vault::Vault(const std::filesystem::path& file):
-	Directory(file.stem().string(), last_write_time(file), status(file).permissions()),
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	class WrongPassword final : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	// Prompts again after a wrong password, the vault stays loaded between attempts.
+	template<typename Unlock>
+	auto with_password_attempts(const std::string& name, Unlock&& unlock)
+	{
+		for (size_t attempt = 1;; ++attempt)
+		{
+			try
+			{
+				const auto password = ask_password_with_confirmation(name);
+				if (!password)
+					throw WrongPassword("Password confirmation failed");
+				return unlock(*password);
+			}
+			catch (const WrongPassword& e)
+			{
+				if (attempt == Vault::PASSWORD_ATTEMPTS)
+					throw;
+				std::cerr << e.what() << ", try again." << std::endl;
+			}
+		}
+	}
+
+	struct UnlockedKeySlot
+	{
+		size_t index;
+		EncryptionManager::Key passwordKey;
+		EncryptionManager::Key dataKey;
+	};
+
+	UnlockedKeySlot unlock_key_slot(const KeySlots& keySlots, const EncryptionManager::Password& password, const MemoryBudget& budget)
+	{
+		for (const auto index : keySlots.active())
+		{
+			const auto& slot = keySlots.slot(index);
+			budget.check(slot.kdf);
+			auto passwordKey = EncryptionManager::derive_key(password, slot.salt, slot.kdf);
+			if (auto dataKey = keySlots.unlock(index, passwordKey))
+				return {index, std::move(passwordKey), std::move(*dataKey)};
+		}
+		throw WrongPassword("Wrong password: it doesn't unlock any key slot of the vault");
+	}
+
+	// Unlocks a key slot with a password key cached by the agent, or with the password prompted, whose key is then cached for the vault.
+	// A vault read from a stream has no path to cache it for.
+	EncryptionManager::Key unlock_key_slots(const KeySlots& keySlots, const std::filesystem::path& vault, KeyRing* keyRing, const MemoryBudget& budget)
+	{
+		const auto agent = KeyAgent::running_socket();
+		const auto cache = agent && !vault.empty();
+		for (const auto index : keySlots.active())
+		{
+			const auto& slot = keySlots.slot(index);
+			if (const auto passwordKey = agent ? KeyAgent::get(*agent, slot.salt, slot.kdf) : std::nullopt)
+			{
+				if (auto dataKey = keySlots.unlock(index, *passwordKey))
+					return std::move(*dataKey);
+			}
+		}
+		// A batch isn't prompted again after a wrong password, the vault is only reported as failed.
+		if (keyRing)
+		{
+			for (const auto index : keySlots.active())
+			{
+				const auto& slot = keySlots.slot(index);
+				auto passwordKey = keyRing->derive(slot.salt, slot.kdf);
+				if (auto dataKey = keySlots.unlock(index, passwordKey))
+				{
+					if (cache)
+						KeyAgent::put(*agent, vault, {slot.salt, slot.kdf, std::move(passwordKey)});
+					return std::move(*dataKey);
+				}
+			}
+			throw WrongPassword("Wrong password: it doesn't unlock any key slot of the vault");
+		}
+		// The key slot authenticates the password on its own, so a wrong one is rejected as soon as it is derived.
+		auto [index, passwordKey, dataKey] = with_password_attempts("password", [&keySlots, &budget](const EncryptionManager::Password& password) { return unlock_key_slot(keySlots, password, budget); });
+		const auto& slot = keySlots.slot(index);
+		if (cache)
+			KeyAgent::put(*agent, vault, {slot.salt, slot.kdf, std::move(passwordKey)});
+		return std::move(dataKey);
+	}
+
+	// Reads the header and the key slots of a vault being written, to resume writing it.
+	std::pair<VaultHeader, std::vector<std::uint8_t>> read_partial_header(const std::filesystem::path& path)
+	{
+		std::ifstream file(path.string(), std::ios::binary);
+		if (!file.is_open())
+			throw std::ios_base::failure("Failed to open the file: " + path.string());
+		std::array<std::uint8_t, VaultFormat::MAGIC.size() + sizeof(std::uint32_t)> prefix{};
+		if (!file.read(reinterpret_cast<char*>(prefix.data()), prefix.size()) || !VaultFormat::has_magic(prefix))
+			throw std::runtime_error("Invalid partial vault " + path.string() + ": missing magic number");
+		std::vector<std::uint8_t> headerBytes(VaultFormat::read_uint(std::span(prefix).subspan(VaultFormat::MAGIC.size()), sizeof(std::uint32_t)));
+		file.read(reinterpret_cast<char*>(headerBytes.data()), static_cast<std::streamsize>(headerBytes.size()));
+		auto header = BlockReader::parse_header(headerBytes);
+		if (header.keySlots)
+		{
+			std::vector<std::uint8_t> keySlots(KeySlots::SIZE);
+			file.read(reinterpret_cast<char*>(keySlots.data()), static_cast<std::streamsize>(keySlots.size()));
+			header.keySlots = KeySlots(keySlots);
+		}
+		if (!file)
+			throw std::runtime_error("Invalid partial vault " + path.string() + ": truncated header");
+		return {std::move(header), std::move(headerBytes)};
+	}
+
+	// Builds the nodes of the entries found on disk. The .vaultignore files apply below their directory, and the patterns
+	// given to close override them. The links to a same file are found by device and inode, its content is only stored once.
+	class Scanner
+	{
+	public:
+		Scanner(const IgnoreRules& excludes, ProgressTracker* progress):
+			m_excludes(excludes),
+			m_progress(progress)
+		{
+		}
+
+		// Scans the subtree of a directory, the files unchanged since its previous node keep their content.
+		void scan(const std::filesystem::path& path, const std::string& relativePath, Directory& directory, const Directory* previous)
+		{
+			m_directories.emplace(path, relativePath, directory, previous);
+			run();
+		}
+
+		// Scans an entry on its own, with the .vaultignore files of the directories leading to it.
+		void scan_entry(const std::filesystem::path& root, const std::filesystem::path& path, Directory& parent, const Node* previous)
+		{
+			std::filesystem::path ancestor;
+			load_ignore_file(root, {});
+			for (const auto& part : path.parent_path())
+			{
+				ancestor /= part;
+				load_ignore_file(root / ancestor, ancestor.generic_string());
+			}
+			add(std::filesystem::directory_entry(root / path), path.generic_string(), parent, previous);
+			run();
+		}
+
+		// The files whose content is to be stored, with the path of their directory, in the order they were found.
+		[[nodiscard]] const std::vector<std::pair<Node*, std::filesystem::path>>& stored() const
+		{
+			return m_stored;
+		}
+
+	private:
+		const IgnoreRules& m_excludes;
+		ProgressTracker* m_progress;
+		IgnoreRules m_ignoreFiles;
+		std::set<std::string> m_loaded;
+		std::map<std::pair<std::uint64_t, std::uint64_t>, std::shared_ptr<std::string>> m_hardLinks;
+		std::stack<std::tuple<std::filesystem::path, std::string, std::reference_wrapper<Directory>, const Directory*>> m_directories;
+		std::vector<std::pair<Node*, std::filesystem::path>> m_stored;
+
+		void run()
+		{
+			while (!m_directories.empty())
+			{
+				auto [dir_path, relative_path, dir, previousDir] = m_directories.top();
+				m_directories.pop();
+				load_ignore_file(dir_path, relative_path);
+				for (const auto& entry : std::filesystem::directory_iterator(dir_path))
+				{
+					const auto name = entry.path().filename().string();
+					const Node* previousChild = nullptr;
+					if (previousDir)
+					{
+						const auto child = std::ranges::find_if(previousDir->children(), [&name](const auto& c) { return c->name() == name; });
+						previousChild = child != previousDir->children().end() ? child->get() : nullptr;
+					}
+					add(entry, relative_path.empty() ? name : relative_path + "/" + name, dir.get(), previousChild);
+				}
+			}
+		}
+
+		void load_ignore_file(const std::filesystem::path& directory, const std::string& relativePath)
+		{
+			if (const auto ignoreFile = directory / IgnoreRules::FILE_NAME; m_loaded.insert(relativePath).second && exists(ignoreFile))
+				m_ignoreFiles.load(ignoreFile, relativePath);
+		}
+
+		[[nodiscard]] bool excluded(const std::string& path, const bool directory) const
+		{
+			if (const auto verdict = m_excludes.excluded(path, directory))
+				return *verdict;
+			return m_ignoreFiles.excluded(path, directory).value_or(false);
+		}
+
+		void add(const std::filesystem::directory_entry& entry, const std::string& path, Directory& parent, const Node* previous)
+		{
+			// Excluded entries are skipped with the type read along with the directory, their subtrees are never visited.
+			const auto name = entry.path().filename().string();
+			if (excluded(path, !entry.is_symlink() && entry.is_directory()))
+				return;
+			if (entry.is_symlink())
+				throw std::runtime_error("Invalid vault file format: " + entry.path().string() + " is a symlink");
+			if (entry.is_regular_file())
+			{
+				bool hardLinked = false;
+				bool linked = false;
+				auto file = std::make_unique<File>(name, entry.last_write_time(), entry.status().permissions());
+#ifndef _WIN32
+				if (struct stat status{}; ::stat(entry.path().c_str(), &status) == 0 && status.st_nlink > 1)
+				{
+					auto& firstLink = m_hardLinks[{static_cast<std::uint64_t>(status.st_dev), static_cast<std::uint64_t>(status.st_ino)}];
+					hardLinked = true;
+					linked = firstLink != nullptr;
+					if (!linked)
+						firstLink = std::make_shared<std::string>();
+					file->set_hard_link(firstLink, path);
+				}
+#endif
+				// A file with the size and the time of its previous node keeps its content without being read again.
+				if (const auto previousFile = dynamic_cast<const File*>(previous); previousFile && !hardLinked && previousFile->link().empty()
+					&& previousFile->size() == entry.file_size() && previousFile->last_write_time() == entry.last_write_time())
+				{
+					file = std::make_unique<File>(*previousFile);
+					file->set_attributes(entry.last_write_time(), entry.status().permissions());
+				}
+				else
+					m_stored.emplace_back(file.get(), entry.path().parent_path());
+				if (m_progress)
+					m_progress->add(1, linked ? 0 : entry.file_size(), 0);
+				parent.children().push_back(std::move(file));
+			}
+			else if (entry.is_directory())
+			{
+				auto directory = std::make_unique<Directory>(name, entry.last_write_time(), entry.status().permissions());
+				m_directories.emplace(entry.path(), path, *directory, dynamic_cast<const Directory*>(previous));
+				parent.children().push_back(std::move(directory));
+			}
+			else
+				throw std::runtime_error("Invalid vault file format: " + entry.path().string() + " is not a regular file or directory");
+		}
+	};
+
+	// Tells whether a path of the vault is the entry or one below it, the empty path being the root.
+	bool is_within(const std::filesystem::path& path, const std::filesystem::path& entry)
+	{
+		return std::mismatch(entry.begin(), entry.end(), path.begin(), path.end()).first == entry.end();
+	}
+
+	// The hard links of a directory to the entries scanned again.
+	void find_links(const Directory& directory, const std::filesystem::path& path, const std::vector<std::filesystem::path>& scanned, std::vector<std::filesystem::path>& links)
+	{
+		for (const auto& child : directory.children())
+		{
+			if (const auto file = dynamic_cast<const File*>(child.get()); file && !file->link().empty()
+				&& std::ranges::any_of(scanned, [file](const std::filesystem::path& entry) { return is_within(file->link(), entry); }))
+				links.push_back(path / file->name());
+			else if (const auto subdirectory = dynamic_cast<const Directory*>(child.get()))
+				find_links(*subdirectory, path / subdirectory->name(), scanned, links);
+		}
+	}
+
+	// Copies the blocks of the files below the directory into a vault being compacted, in the order of the index.
+	// The hard links have no blocks of their own, they share those of the file they refer to.
+	void copy_blocks(Directory& directory, const std::filesystem::path& path, BlockWriter& writer, const BlockReader& reader, std::map<std::uint64_t, BlockInfo>& copied)
+	{
+		for (const auto& child : directory.children())
+		{
+			if (const auto subdirectory = dynamic_cast<Directory*>(child.get()))
+				copy_blocks(*subdirectory, path / subdirectory->name(), writer, reader, copied);
+			else if (const auto file = dynamic_cast<File*>(child.get()); file && file->link().empty())
+			{
+				writer.begin_entry(path / file->name());
+				file->copy_blocks(writer, reader, copied);
+			}
+		}
+	}
+
+	// The stored size of the blocks of the files below the directory, by id so the shared ones are counted once.
+	void find_blocks(const Directory& directory, std::map<std::uint64_t, std::uint64_t>& blocks)
+	{
+		for (const auto& child : directory.children())
+		{
+			if (const auto subdirectory = dynamic_cast<const Directory*>(child.get()))
+				find_blocks(*subdirectory, blocks);
+			else if (const auto file = dynamic_cast<const File*>(child.get()))
+			{
+				for (const auto& block : file->blocks())
+				{
+					if (!block.hole())
+						blocks.emplace(block.id, block.storedSize);
+				}
+			}
+		}
+	}
+
+	// Truncates a vault to its length before an interrupted append, which left it without a trailer.
+	void roll_back_append(const std::filesystem::path& vault)
+	{
+		const auto journal = VaultFormat::append_journal_path(vault);
+		if (!exists(journal))
+			return;
+		if (const auto length = VaultFormat::appended_length(vault); length && *length <= file_size(vault))
+			resize_file(vault, *length);
+		std::filesystem::remove(journal);
+	}
+
+	// Keeps the files matching the patterns and the directories leading to them, a matching directory keeps its whole subtree.
+	bool select_entries(Directory& directory, const std::string& path, const IgnoreRules& patterns)
+	{
+		std::erase_if(directory.children(), [&path, &patterns](const std::unique_ptr<Node>& child)
+		{
+			const auto childPath = path.empty() ? child->name() : path + "/" + child->name();
+			const auto subdirectory = dynamic_cast<Directory*>(child.get());
+			if (patterns.matches(childPath, subdirectory != nullptr))
+				return false;
+			return !subdirectory || !select_entries(*subdirectory, childPath, patterns);
+		});
+		return !directory.children().empty();
+	}
+
+	std::pair<std::uint64_t, std::uint64_t> count_files(const Directory& root)
+	{
+		std::uint64_t files = 0;
+		std::uint64_t bytes = 0;
+		std::stack<std::reference_wrapper<const Directory>> dirs_to_visit;
+		dirs_to_visit.emplace(root);
+		while (!dirs_to_visit.empty())
+		{
+			const auto& dir = dirs_to_visit.top().get();
+			dirs_to_visit.pop();
+			for (const auto& child : dir.children())
+			{
+				if (const auto file = dynamic_cast<const File*>(child.get()))
+				{
+					++files;
+					if (file->link().empty())
+						bytes += file->size();
+				}
+				else if (const auto directory = dynamic_cast<const Directory*>(child.get()))
+					dirs_to_visit.emplace(*directory);
+			}
+		}
+		return {files, bytes};
+	}
+
+	// The hard links to a file left out of a partial open get its content instead.
+	void break_links(const Directory& root, Directory& directory)
+	{
+		for (const auto& child : directory.children())
+		{
+			if (const auto file = dynamic_cast<File*>(child.get()); file && !file->link().empty() && !root.find(file->link()))
+				file->break_link();
+			else if (const auto subdirectory = dynamic_cast<Directory*>(child.get()))
+				break_links(root, *subdirectory);
+		}
+	}
+
+	// Makes the hard links once every file is extracted, and restores the attributes of the directories holding them.
+	void create_links(const std::filesystem::path& root, const Directory& directory, const std::filesystem::path& path)
+	{
+		bool linked = false;
+		for (const auto& child : directory.children())
+		{
+			if (const auto file = dynamic_cast<const File*>(child.get()); file && !file->link().empty())
+			{
+				if (!linked)
+					std::filesystem::permissions(path, directory.permissions() | std::filesystem::perms::owner_write);
+				linked = true;
+				file->create_link(path, root / file->link());
+			}
+			else if (const auto subdirectory = dynamic_cast<const Directory*>(child.get()))
+				create_links(root, *subdirectory, path / subdirectory->name());
+		}
+		if (linked)
+		{
+			std::filesystem::permissions(path, directory.permissions());
+			std::filesystem::last_write_time(path, directory.last_write_time());
+		}
+	}
+
+	// Drops the files committed by an interrupted open from the entries to extract, and clears the way for the others.
+	// The directories are extracted again to restore their attributes, and the hard links made again.
+	void skip_extracted(const Checkpoint& checkpoint, Directory& directory, const std::filesystem::path& path)
+	{
+		if (!exists(path))
+			return;
+		std::filesystem::permissions(path, std::filesystem::perms::owner_all, std::filesystem::perm_options::add);
+		std::erase_if(directory.children(), [&checkpoint, &path](const std::unique_ptr<Node>& child)
+		{
+			const auto childPath = path / child->name();
+			if (const auto subdirectory = dynamic_cast<Directory*>(child.get()))
+			{
+				skip_extracted(checkpoint, *subdirectory, childPath);
+				return false;
+			}
+			const auto& file = dynamic_cast<const File&>(*child);
+			std::error_code error;
+			if (const auto entry = file.link().empty() ? checkpoint.find(childPath) : nullptr; entry && entry->size == file.size() && entry->lastWriteTime == file.last_write_time() && file_size(childPath, error) == entry->size && !error)
+				return true;
+			std::filesystem::remove(childPath, error);
+			return false;
+		});
+	}
+
+	// A hidden directory next to the destination that no other open of a stream uses.
+	std::filesystem::path create_stream_staging(const std::filesystem::path& destination)
+	{
+		for (std::uint64_t counter = 0;; ++counter)
+		{
+			if (auto path = destination / (".stdin." + std::to_string(counter) + ".partial"); create_directory(path))
+				return path;
+		}
+	}
+
+	// Drops the files extracted from a stream from the entries left to extract once they match the index, and restores their attributes.
+	void take_extracted(const std::map<std::string, StreamReader::Entry>& extracted, Directory& directory, const std::string& path, const std::filesystem::path& directoryPath, std::set<std::string>& taken)
+	{
+		std::erase_if(directory.children(), [&](const std::unique_ptr<Node>& child)
+		{
+			const auto childPath = path.empty() ? child->name() : path + "/" + child->name();
+			if (const auto subdirectory = dynamic_cast<Directory*>(child.get()))
+			{
+				take_extracted(extracted, *subdirectory, childPath, directoryPath / child->name(), taken);
+				return false;
+			}
+			// The hard links and the empty files have no blocks, they are made as from a vault file.
+			const auto& file = dynamic_cast<const File&>(*child);
+			if (!file.link().empty() || file.blocks().empty())
+				return false;
+			const auto entry = extracted.find(childPath);
+			if (entry == extracted.end())
+				throw std::runtime_error("The content of " + childPath + " is not in the stream, it is corrupted or the entry is a hard link to a file left out of the partial open");
+			const auto same = [](const BlockInfo& block, const BlockInfo& other)
+			{
+				return block.id == other.id && block.offset == other.offset && block.size == other.size && block.storedSize == other.storedSize && block.checksum == other.checksum && block.volume == other.volume;
+			};
+			if (entry->second.size != file.size() || entry->second.checksum != file.checksum() || !std::ranges::equal(entry->second.blocks, file.blocks(), same))
+				throw std::runtime_error("Corrupted vault entry: " + childPath);
+			const auto filePath = directoryPath / child->name();
+			std::filesystem::permissions(filePath, file.permissions());
+			std::filesystem::last_write_time(filePath, file.last_write_time());
+			taken.insert(childPath);
+			return true;
+		});
+	}
+
+	// Removes a file extracted from a stream that a later index dropped, and the directories it leaves empty.
+	void remove_stale(const std::filesystem::path& root, const std::filesystem::path& path)
+	{
+		std::filesystem::remove(root / path);
+		std::error_code error;
+		for (auto parent = path.parent_path(); !parent.empty() && std::filesystem::is_empty(root / parent, error) && !error; parent = parent.parent_path())
+			std::filesystem::remove(root / parent);
+	}
+}
+
+Vault::Vault(const std::filesystem::path& file, MemoryBudget budget):
+	Directory(file.stem().string(), std::filesystem::last_write_time(file), status(file).permissions()),
 	m_file(file),
-	m_opened(!m_file.is_regular_file())
+	m_opened(!m_file.is_regular_file()),
+	m_budget(std::move(budget)),
+	m_durability(Durability::FULL),
+	m_sourceRemoval(SourceRemoval::NOW),
+	m_resume(false),
+	m_useAgent(false),
+	m_stream(nullptr)
 {
 	if (!m_file.exists())
 		throw std::runtime_error(file.string() + " does not exist");
@@ -22,33 +500,261 @@ Vault::Vault(const std::filesystem::path& file):
 		throw std::runtime_error(file.string() + " is not a valid vault file");
 }
 
-void Vault::open(const std::optional<std::filesystem::path>& destination)
+Vault::Vault(std::istream& stream, MemoryBudget budget):
+	Directory({}, std::filesystem::file_time_type::clock::now(), std::filesystem::perms::owner_all),
+	m_opened(false),
+	m_budget(std::move(budget)),
+	m_durability(Durability::FULL),
+	m_sourceRemoval(SourceRemoval::NOW),
+	m_resume(false),
+	m_useAgent(false),
+	m_stream(&stream)
+{
+}
+
+void Vault::open(const std::optional<std::filesystem::path>& destination, const std::vector<std::string>& only)
 {
 	if (m_opened)
 		throw std::invalid_argument("You can't open a vault that is already opened");
-	read_from_file();
-	const auto backUp = m_file;
-	const auto tempMove = get_temp_name(backUp.path().parent_path());
-	rename(m_file, tempMove);
-	m_file = std::filesystem::directory_entry(destination.value_or(m_file.path().parent_path()) / m_name);
-	try { write_to_dir(); }
-	catch (const std::exception& e)
-	{
-		if (!std::string(e.what()).ends_with("already exists"))
-			remove_all(m_file);
-		m_file = backUp;
-		rename(tempMove, m_file);
+	if (m_stream)
+	{
+		open_stream(destination.value_or(std::filesystem::current_path()), only);
+		return;
+	}
+	std::vector<std::filesystem::path> volumes;
+	const auto reader = read_from_file();
+	if (reader)
+	{
+		for (const auto& volume : reader->volumes())
+			volumes.push_back(reader->volume_path(volume));
+	}
+	// The unselected entries are dropped from the index before extracting, so their blocks are never read.
+	const auto partial = !only.empty();
+	if (partial && !select_entries(*this, {}, IgnoreRules(only)))
+	{
+		m_children.clear();
+		throw std::runtime_error("No entry of " + m_file.path().string() + " matches the patterns to open");
+	}
+	if (partial)
+		break_links(*this, *this);
+	// The entries are extracted in a hidden directory next to the destination and moved in place once complete,
+	// so a failure or a crash never leaves a partial vault there. A partial open leaves the vault closed.
+	const auto vault = m_file;
+	const auto target = destination.value_or(m_file.path().parent_path()) / m_name;
+	const auto replacesVault = !partial && exists(target) && equivalent(target, vault.path());
+	if (exists(target) && !replacesVault)
+	{
+		m_children.clear();
+		throw std::runtime_error(target.string() + " already exists");
+	}
+	// The files extracted are journaled, so an interrupted open is resumed after the ones committed.
+	const auto staging = Checkpoint::partial_path(target);
+	Checkpoint checkpoint(Checkpoint::journal_path(target), staging / m_name, vault.path(), m_resume, m_durability);
+	if (checkpoint.resumed())
+		skip_extracted(checkpoint, *this, staging / m_name);
+	else
+		remove_all(staging);
+	checkpoint.set_sync([this, &staging]
+	{
+		if (m_durability != Durability::NONE)
+			AtomicFile::sync_file_system(staging);
+	});
+	if (reader)
+		reader->set_checkpoint(&checkpoint);
+	if (m_progress)
+	{
+		const auto [files, bytes] = count_files(*this);
+		m_progress->start(ProgressPhase::EXTRACTING, files, bytes);
+	}
+	try
+	{
+		create_directories(staging);
+		m_file = std::filesystem::directory_entry(staging / m_name);
+		write_to_dir();
+		if (m_durability != Durability::NONE)
+			AtomicFile::sync_file_system(staging);
+		m_children.clear();
+		// A vault file without extension has the name of its directory, it is only removed once its entries are extracted.
+		if (replacesVault)
+			remove(vault.path());
+		rename(m_file.path(), target);
+		remove(staging);
+		checkpoint.remove();
+		if (m_durability == Durability::FULL)
+			AtomicFile::sync(target.has_parent_path() ? target.parent_path() : ".");
+	}
+	catch (const std::ios_base::failure&)
+	{
+		// A failure to write the entries, such as a full disk, keeps the ones committed so that the open can be resumed.
+		m_children.clear();
+		m_file = vault;
+		if (!checkpoint.keep())
+		{
+			checkpoint.remove();
+			std::error_code error;
+			remove_all(staging, error);
+		}
+		throw;
+	}
+	catch (const std::exception&)
+	{
+		m_children.clear();
+		m_file = vault;
+		checkpoint.remove();
+		std::error_code error;
+		remove_all(staging, error);
+		throw;
+	}
+	m_children.clear();
+	m_file = vault;
+	if (!partial)
+	{
+		if (!replacesVault)
+			remove(vault.path());
+		for (const auto& volume : volumes)
+			remove(volume);
+		// The journal of an interrupted append goes with the vault it was appended to.
+		std::error_code error;
+		std::filesystem::remove(VaultFormat::append_journal_path(vault.path()), error);
+		m_file = std::filesystem::directory_entry(target);
+		m_opened = true;
+	}
+	if (m_progress)
+		m_progress->finish();
+}
+
+void Vault::open_stream(const std::filesystem::path& destination, const std::vector<std::string>& only)
+{
+	StreamReader reader(*m_stream);
+	// Each open of a stream works in a hidden directory of its own next to the destination, so two of them never clash.
+	const auto staging = create_stream_staging(destination);
+	try
+	{
+		if (!reader.framed())
+		{
+			// A vault written before its data was framed is copied there first, and opened from the copy.
+			const auto spool = staging / "stdin.vlt";
+			{
+				std::ofstream file(spool.string(), std::ios::binary);
+				if (!file.is_open())
+					throw std::ios_base::failure("Failed to create the file: " + spool.string());
+				const auto prefix = reader.prefix();
+				file.write(reinterpret_cast<const char*>(prefix.data()), static_cast<std::streamsize>(prefix.size()));
+				std::vector<char> buffer(VaultFormat::CHUNK_SIZE);
+				while (m_stream->read(buffer.data(), static_cast<std::streamsize>(buffer.size())) || m_stream->gcount() > 0)
+				{
+					if (!file.write(buffer.data(), m_stream->gcount()))
+						throw std::ios_base::failure("Failed to write the file: " + spool.string());
+				}
+				if (m_stream->bad())
+					throw std::ios_base::failure("Failed to read the vault from the standard input");
+				file.close();
+				if (!file)
+					throw std::ios_base::failure("Failed to write the file: " + spool.string());
+			}
+			m_stream = nullptr;
+			m_file = std::filesystem::directory_entry(spool);
+			open(destination, only);
+			remove_all(staging);
+			return;
+		}
+
+		if (reader.header().encrypted)
+		{
+			auto key = unlock_data_key(reader.header(), {});
+			if (!key)
+				throw std::runtime_error("Invalid vault file format: missing key slots");
+			reader.set_key(std::move(*key));
+		}
+		if (m_progress)
+			m_progress->start(ProgressPhase::EXTRACTING);
+		reader.set_progress(m_progress.get());
+		// The files are extracted as their blocks arrive. A partial open only extracts those matching the patterns, or
+		// in a directory matching them, as it selects the entries of the index.
+		const auto partial = !only.empty();
+		const IgnoreRules patterns(only);
+		const auto entries = staging / "entries";
+		const auto index = reader.extract(entries, [&patterns, partial](const std::filesystem::path& path)
+		{
+			if (!partial)
+				return true;
+			std::string entry;
+			for (auto part = path.begin(); part != path.end(); ++part)
+			{
+				entry += (entry.empty() ? "" : "/") + part->string();
+				if (patterns.matches(entry, std::next(part) != path.end()))
+					return true;
+			}
+			return false;
+		});
+		auto doc = pugi::xml_document();
+		if (!doc.load_buffer(index.data(), index.size()))
+			throw std::runtime_error("Failed to load the vault index");
+		read_content(doc.document_element(), nullptr, false);
+		if (partial && !select_entries(*this, {}, patterns))
+			throw std::runtime_error("No entry of the vault read from the standard input matches the patterns to open");
+		if (partial)
+			break_links(*this, *this);
+		if (const std::filesystem::path name = m_name; name.empty() || name != name.filename() || name == "." || name == "..")
+			throw std::runtime_error("Invalid vault file format: invalid vault name " + m_name);
+		const auto target = destination / m_name;
+		if (exists(target))
+			throw std::runtime_error(target.string() + " already exists");
+
+		// The files extracted are checked against the index, the directories, the empty files and the hard links are made
+		// after them, and the files an append replaced are dropped.
+		const auto root = staging / m_name;
+		rename(entries, root);
+		std::set<std::string> taken;
+		take_extracted(reader.entries(), *this, {}, root, taken);
+		for (const auto& path : reader.entries() | std::views::keys)
+		{
+			if (!taken.contains(path))
+				remove_stale(root, path);
+		}
+		m_file = std::filesystem::directory_entry(root);
+		write_to_dir();
+		if (m_durability != Durability::NONE)
+			AtomicFile::sync_file_system(staging);
+		m_children.clear();
+		rename(root, target);
+		remove(staging);
+		if (m_durability == Durability::FULL)
+			AtomicFile::sync(destination);
+		// A partial open leaves nothing to close.
+		m_file = std::filesystem::directory_entry(target);
+		m_opened = !partial;
+	}
+	catch (const std::exception&)
+	{
+		m_children.clear();
+		std::error_code error;
+		remove_all(staging, error);
 		throw;
 	}
-	remove_all(tempMove);
-	m_opened = true;
+	if (m_progress)
+		m_progress->finish();
+}
+
+void Vault::write(std::ostream& stream, const bool compress, const bool encrypt, const KdfParameters& kdf, const std::optional<Cipher>& cipher, const std::vector<std::filesystem::path>& recipients)
+{
+	if (!m_opened)
+		throw std::invalid_argument("You can't write a vault that is closed");
+	const auto publicKeys = scan_for_closing(encrypt, kdf, recipients);
+	// The directory is left in place, nothing tells that the reader of the stream kept the vault.
+	write_to_stream(stream, m_file.path(), compress, encrypt, kdf, cipher.value_or(EncryptionManager::preferred_cipher()), publicKeys, std::nullopt, std::nullopt, nullptr);
+	m_children.clear();
 }
 
-void Vault::close(const std::optional<std::filesystem::path>& destination, const std::optional<std::string>& extension, const bool compress, const bool encrypt)
+void Vault::close(const std::optional<std::filesystem::path>& destination, const std::optional<std::string>& extension, const bool compress, const bool encrypt, const KdfParameters& kdf, const std::optional<Cipher>& cipher, const std::vector<std::filesystem::path>& recipients, const std::optional<std::uint64_t>& volumeSize)
 {
 	if (!m_opened)
 		throw std::invalid_argument("You can't close a vault that is already closed");
-	read_from_dir();
+	if (volumeSize && *volumeSize < VaultFormat::MIN_VOLUME_SIZE)
+		throw std::invalid_argument("The volume size must be at least " + MemoryBudget::format(VaultFormat::MIN_VOLUME_SIZE));
+	if (m_resume && (volumeSize || !recipients.empty()))
+		throw std::invalid_argument("Only a vault in a single file, not encrypted for recipients, can be resumed");
+	const auto publicKeys = scan_for_closing(encrypt, kdf, recipients);
 	if (destination.has_value())
 	{
 		const auto path = destination.value().lexically_normal();
@@ -56,66 +762,522 @@ void Vault::close(const std::optional<std::filesystem::path>& destination, const
 		if (const auto mismatch_pair = std::mismatch(path.begin(), path.end(), base.begin(), base.end()); mismatch_pair.second == base.end())
 			throw std::invalid_argument("The destination must not be a subdirectory of the vault");
 	}
-	const auto backUp = m_file;
-	const auto tempMove = get_temp_name(backUp.path().parent_path());
-	rename(m_file, tempMove);
-	m_file = std::filesystem::directory_entry((destination.value_or(m_file.path().parent_path()).lexically_normal() / m_name).replace_extension(extension.value_or(".vlt")));
-	try { write_to_file(compress, encrypt); }
-	catch (const std::exception& e)
-	{
-		if (!std::string(e.what()).ends_with("already exists"))
-			remove_all(m_file);
-		m_file = backUp;
-		rename(tempMove, m_file);
+	// The source stays in place until the vault is published, and is only removed after that. A vault file without
+	// extension takes the name of its directory, which is then moved aside first.
+	const auto original = m_file;
+	auto source = m_file.path();
+	const auto vaultPath = (destination.value_or(m_file.path().parent_path()).lexically_normal() / m_name).replace_extension(extension.value_or(".vlt"));
+	const auto replacesSource = exists(vaultPath) && equivalent(vaultPath, source);
+	if (replacesSource && m_sourceRemoval == SourceRemoval::KEEP)
+		throw std::invalid_argument("The source can't be kept when the vault file takes its name");
+	if (replacesSource)
+	{
+		source = get_temp_name(source.has_parent_path() ? source.parent_path() : ".", "." + m_name + ".closing");
+		rename(original.path(), source);
+	}
+	m_file = std::filesystem::directory_entry(vaultPath);
+	try { write_to_file(source, compress, encrypt, kdf, cipher.value_or(EncryptionManager::preferred_cipher()), publicKeys, volumeSize); }
+	catch (const std::exception&)
+	{
+		m_file = original;
+		if (replacesSource)
+			rename(source, m_file);
 		throw;
 	}
-	remove_all(tempMove);
 	m_opened = false;
+	remove_source(source);
 }
 
-void Vault::read_from_dir()
+void Vault::remove_source(const std::filesystem::path& source)
 {
-	if (!m_opened)
-		throw std::runtime_error("The vault " + m_file.path().string() + " is not opened");
+	switch (m_sourceRemoval)
+	{
+	case SourceRemoval::NOW:
+		remove_all(source);
+		break;
+	case SourceRemoval::BACKGROUND:
+	{
+		// The source is moved aside at once, so its name is free when close returns, and removed by a detached process
+		// that outlives the command. It is removed now if no process could be started.
+		const auto trash = get_temp_name(source.has_parent_path() ? source.parent_path() : ".", "." + source.filename().string() + ".removing");
+		rename(source, trash);
+		if (!remove_detached(trash))
+			remove_all(trash);
+		break;
+	}
+	case SourceRemoval::KEEP:
+		break;
+	}
+}
 
-	std::stack<std::pair<std::filesystem::path, std::reference_wrapper<Directory>>> dirs_to_visit;
-	dirs_to_visit.emplace(m_file.path(), std::reference_wrapper<Directory>(*this));
+std::vector<std::string> Vault::verify()
+{
+	if (m_opened)
+		throw std::invalid_argument("You can't verify a vault that is opened");
+	load();
 
+	std::vector<std::pair<std::string, const File*>> files;
+	std::stack<std::pair<std::filesystem::path, std::reference_wrapper<const Directory>>> dirs_to_visit;
+	dirs_to_visit.emplace(std::filesystem::path(), std::cref(*this));
 	while (!dirs_to_visit.empty())
 	{
 		auto [dir_path, dir] = dirs_to_visit.top();
 		dirs_to_visit.pop();
 
-		for (const auto& entry : std::filesystem::directory_iterator(dir_path))
+		for (const auto& child : dir.get().children())
 		{
-			if (entry.is_symlink())
-				throw std::runtime_error("Invalid vault file format: " + entry.path().string() + " is a symlink");
-			if (entry.is_regular_file())
+			// A hard link is verified with the file it refers to.
+			if (const auto file = dynamic_cast<const File*>(child.get()); file && file->link().empty())
+				files.emplace_back((dir_path / file->name()).generic_string(), file);
+			else if (const auto directory = dynamic_cast<const Directory*>(child.get()))
+				dirs_to_visit.emplace(dir_path / directory->name(), std::cref(*directory));
+		}
+	}
+
+	if (m_progress)
+	{
+		std::uint64_t bytes = 0;
+		for (const auto& file : files | std::views::values)
+			bytes += file->size();
+		m_progress->start(ProgressPhase::VERIFYING, files.size(), bytes);
+	}
+	// Each block is checked on its own, so the blocks of a large file are checked in parallel, and the failures are collected
+	// per entry. The blocks cover every byte stored, an entry is also corrupted if they don't add up to its size.
+	std::vector<std::pair<size_t, std::future<bool>>> results;
+	std::vector<std::atomic<size_t>> remaining(files.size());
+	std::vector<bool> valid(files.size(), true);
+	{
+		ThreadPool pool(m_budget.threads());
+		for (size_t i = 0; i < files.size(); ++i)
+		{
+			const auto file = files[i].second;
+			if (file->blocks().empty())
 			{
-				const auto& path = entry.path();
-				dir.get().children().push_back(std::make_unique<File>(path.filename().string(), entry.last_write_time(), entry.status().permissions(), Botan::base64_encode(File::read(path))));
+				results.emplace_back(i, pool.submit([file] { return file->verify(); }));
+				continue;
 			}
-			else if (entry.is_directory())
+			std::uint64_t size = 0;
+			for (const auto& block : file->blocks())
+				size += block.size;
+			valid[i] = size == file->size();
+			remaining[i] = file->blocks().size();
+			for (const auto& block : file->blocks())
 			{
-				auto directory = std::make_unique<Directory>(entry.path().filename().string(), entry.last_write_time(), entry.status().permissions());
-				dirs_to_visit.emplace(entry.path(), *directory);
-				dir.get().children().push_back(std::move(directory));
+				results.emplace_back(i, pool.submit([file, &block, &counter = remaining[i]]
+				{
+					const auto verified = file->verify(block);
+					if (counter.fetch_sub(1) == 1)
+						file->report_verified();
+					return verified;
+				}));
 			}
-			else
-				throw std::runtime_error("Invalid vault file format: " + entry.path().string() + " is not a regular file or directory");
 		}
 	}
+
+	for (auto& [file, result] : results)
+	{
+		if (!result.get())
+			valid[file] = false;
+	}
+	std::vector<std::string> corrupted;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		if (!valid[i])
+			corrupted.push_back(files[i].first);
+	}
+	std::ranges::sort(corrupted);
+	m_children.clear();
+	if (m_progress)
+		m_progress->finish();
+	return corrupted;
+}
+
+void Vault::load()
+{
+	if (m_opened)
+		throw std::invalid_argument("You can't load a vault that is opened");
+	read_from_file();
+}
+
+VaultInfo Vault::info()
+{
+	if (m_opened)
+		throw std::invalid_argument("You can't inspect a vault that is opened");
+	// Only the index is read, the sizes come from the blocks it lists.
+	const auto reader = read_from_file();
+
+	VaultInfo info;
+	info.fileSize = file_size(m_file.path());
+	size_t blockOverhead = 0;
+	if (reader)
+	{
+		info.header = reader->header();
+		info.indexSize = reader->index().storedSize;
+		info.volumes = reader->volumes();
+		if (info.header->encrypted)
+			blockOverhead = EncryptionManager::nonce_size(info.header->cipher) + EncryptionManager::TAG_SIZE;
+	}
+	else
+		info.indexSize = info.fileSize;
+
+	// Directories are listed parents first, so adding each one to its parent in reverse order rolls up the subtrees.
+	std::vector<size_t> parents;
+	std::stack<std::pair<size_t, std::reference_wrapper<const Directory>>> dirs_to_visit;
+	info.directories.push_back({".", 0, 0, 0, 0, 0});
+	parents.push_back(0);
+	dirs_to_visit.emplace(0, std::cref(*this));
+	while (!dirs_to_visit.empty())
+	{
+		const auto [index, dir] = dirs_to_visit.top();
+		dirs_to_visit.pop();
+
+		for (const auto& child : dir.get().children())
+		{
+			if (const auto file = dynamic_cast<const File*>(child.get()))
+			{
+				auto& directory = info.directories[index];
+				++directory.files;
+				directory.size += file->size();
+				if (!file->link().empty())
+					continue;
+				if (!reader)
+				{
+					directory.compressedSize += file->size();
+					directory.storedSize += file->data().size();
+					continue;
+				}
+				for (const auto& block : file->blocks())
+				{
+					directory.storedSize += block.storedSize;
+					directory.compressedSize += block.storedSize - std::min<std::uint64_t>(block.storedSize, blockOverhead);
+				}
+			}
+			else if (const auto subdirectory = dynamic_cast<const Directory*>(child.get()))
+			{
+				const auto& parentPath = info.directories[index].path;
+				info.directories.push_back({index ? parentPath + "/" + subdirectory->name() : subdirectory->name(), 0, 0, 0, 0, 0});
+				parents.push_back(index);
+				dirs_to_visit.emplace(info.directories.size() - 1, std::cref(*subdirectory));
+			}
+		}
+	}
+	for (size_t i = info.directories.size() - 1; i > 0; --i)
+	{
+		const auto& directory = info.directories[i];
+		auto& parent = info.directories[parents[i]];
+		parent.files += directory.files;
+		parent.directories += directory.directories + 1;
+		parent.size += directory.size;
+		parent.compressedSize += directory.compressedSize;
+		parent.storedSize += directory.storedSize;
+	}
+	std::sort(info.directories.begin() + 1, info.directories.end(), [](const DirectoryInfo& a, const DirectoryInfo& b) { return a.path < b.path; });
+	m_children.clear();
+	return info;
+}
+
+void Vault::change_password(const KeySlotAction action)
+{
+	if (m_opened)
+		throw std::invalid_argument("You can't change the password of a vault that is opened");
+	const auto vault_path = m_file.path();
+	if (!BlockReader::is_vault_file(vault_path))
+		throw std::invalid_argument(vault_path.string() + " has no key slots, open and close it again to add them");
+	KeySlots keySlots;
+	std::uint64_t offset;
+	{
+		const BlockReader reader(vault_path);
+		if (!reader.header().encrypted)
+			throw std::invalid_argument(vault_path.string() + " is not encrypted");
+		if (!reader.header().keySlots && !reader.header().recipients.empty())
+			throw std::invalid_argument(vault_path.string() + " is only encrypted for recipients, it has no password");
+		if (!reader.header().keySlots)
+			throw std::invalid_argument(vault_path.string() + " has no key slots, open and close it again to add them");
+		keySlots = *reader.header().keySlots;
+		offset = reader.key_slots_offset();
+	}
+
+	const auto [index, passwordKey, dataKey] = with_password_attempts(action == KeySlotAction::REMOVE ? "password to remove" : "current password",
+		[this, &keySlots](const EncryptionManager::Password& password) { return unlock_key_slot(keySlots, password, m_budget); });
+	if (action == KeySlotAction::REMOVE && keySlots.active().size() == 1)
+		throw std::invalid_argument("The last password of a vault can't be removed");
+
+	// Each slot is stored on its own, the new one first, so the vault can always be unlocked if this is interrupted.
+	if (action != KeySlotAction::REMOVE)
+	{
+		const auto newPassword = ask_password_with_confirmation("new password");
+		if (!newPassword)
+			throw std::runtime_error("Password confirmation failed");
+		const auto kdf = keySlots.slot(index).kdf;
+		auto salt = EncryptionManager::generate_new_salt();
+		const auto newPasswordKey = EncryptionManager::derive_key(*newPassword, salt, kdf);
+		keySlots.store(vault_path, offset, keySlots.add(dataKey, std::move(salt), kdf, newPasswordKey));
+	}
+	if (action != KeySlotAction::ADD)
+	{
+		keySlots.remove(index);
+		keySlots.store(vault_path, offset, index);
+	}
+}
+
+void Vault::update(const std::filesystem::path& source, const std::vector<std::filesystem::path>& changed)
+{
+	if (m_opened)
+		throw std::invalid_argument("You can't update a vault that is opened");
+	if (!m_reader)
+	{
+		roll_back_append(m_file.path());
+		m_reader = read_from_file();
+		if (!m_reader || !m_reader->volumes().empty())
+		{
+			m_reader.reset();
+			m_children.clear();
+			throw std::invalid_argument("Only a vault in a single file can be updated, open and close " + m_file.path().string() + " again");
+		}
+	}
+	if (changed.empty())
+		return;
+
+	std::vector<std::filesystem::path> paths;
+	for (const auto& path : changed)
+	{
+		auto normal = path.lexically_normal();
+		if (!normal.has_filename())
+			normal = normal.parent_path();
+		if (normal == ".")
+			normal.clear();
+		if (normal.is_absolute() || (!normal.empty() && *normal.begin() == ".."))
+			throw std::invalid_argument(path.string() + " is not below " + source.string());
+		// A changed .vaultignore file changes the entries of its whole directory.
+		if (normal.filename() == IgnoreRules::FILE_NAME)
+			normal = normal.parent_path();
+		paths.push_back(std::move(normal));
+	}
+	std::ranges::sort(paths);
+
+	// A path is scanned again from its first ancestor missing from the index, and only once with the others below it.
+	// The files unchanged since their previous node keep their content, the others are appended.
+	Scanner scanner(m_excludes, nullptr);
+	std::vector<std::filesystem::path> scanned;
+	const auto rescan = [this, &source, &scanner, &scanned](const std::filesystem::path& path)
+	{
+		if (std::ranges::any_of(scanned, [&path](const std::filesystem::path& entry) { return is_within(path, entry); }))
+			return;
+		Directory* parent = this;
+		std::filesystem::path entry;
+		for (const auto& part : path)
+		{
+			entry /= part;
+			if (entry == path)
+				break;
+			const auto child = std::ranges::find_if(parent->children(), [&part](const auto& c) { return c->name() == part.string(); });
+			const auto directory = child != parent->children().end() ? dynamic_cast<Directory*>(child->get()) : nullptr;
+			if (!directory)
+				break;
+			parent = directory;
+		}
+		scanned.push_back(entry);
+		if (entry.empty())
+		{
+			Directory previous(m_name, m_lastWriteTime, m_permissions);
+			previous.children() = std::move(m_children);
+			m_children.clear();
+			scanner.scan(source, {}, *this, &previous);
+			set_attributes(std::filesystem::last_write_time(source), std::filesystem::status(source).permissions());
+			return;
+		}
+		auto& children = parent->children();
+		std::unique_ptr<Node> previous;
+		if (const auto child = std::ranges::find_if(children, [&entry](const auto& c) { return c->name() == entry.filename().string(); }); child != children.end())
+		{
+			previous = std::move(*child);
+			children.erase(child);
+		}
+		if (exists(symlink_status(source / entry)))
+			scanner.scan_entry(source, entry, *parent, previous.get());
+		const auto directory = source / entry.parent_path();
+		parent->set_attributes(std::filesystem::last_write_time(directory), std::filesystem::status(directory).permissions());
+	};
+	try
+	{
+		for (const auto& path : paths)
+			rescan(path);
+		// The hard links to an entry scanned again are scanned again too, the file they refer to may have changed or be gone.
+		std::vector<std::filesystem::path> links;
+		find_links(*this, {}, scanned, links);
+		for (const auto& link : links)
+			rescan(link);
+		append(source, scanner.stored());
+	}
+	catch (const std::exception&)
+	{
+		// The index in memory no longer matches the vault, it is loaded again by the next update.
+		m_reader.reset();
+		m_children.clear();
+		throw;
+	}
+}
+
+void Vault::append(const std::filesystem::path& source, const std::vector<std::pair<Node*, std::filesystem::path>>& stored)
+{
+	// The length of the vault is journaled before appending to it, so an interrupted append is rolled back.
+	const auto vault_path = m_file.path();
+	const auto offset = m_reader->size();
+	const auto journal = VaultFormat::append_journal_path(vault_path);
+	{
+		std::ofstream stream(journal.string(), std::ios::binary | std::ios::trunc);
+		stream << offset << '\n';
+		stream.close();
+		if (!stream)
+			throw std::ios_base::failure("Failed to write the file: " + journal.string());
+	}
+	if (m_durability != Durability::NONE)
+		AtomicFile::sync(journal);
+	if (m_durability == Durability::FULL)
+		AtomicFile::sync(vault_path.has_parent_path() ? vault_path.parent_path() : ".");
+
+	// The blocks, the index, the tree and the trailer are written after the previous trailer, which readers then ignore.
+	const Profiler::Scope scope("append");
+	try
+	{
+		std::ofstream stream(vault_path.string(), std::ios::binary | std::ios::in | std::ios::out);
+		if (!stream.is_open())
+			throw std::ios_base::failure("Failed to open the file: " + vault_path.string());
+		stream.seekp(static_cast<std::streamoff>(offset));
+		const auto headerBytes = m_reader->header_bytes();
+		BlockWriter writer(stream, m_reader->header(), {headerBytes.begin(), headerBytes.end()}, m_reader->key(), m_budget.threads(), offset, m_reader->tree());
+		writer.set_source(source);
+		for (const auto& [node, path] : stored)
+			node->store(writer, path);
+		auto doc = pugi::xml_document();
+		write_content(doc);
+		std::ostringstream index;
+		doc.save(index, "", pugi::format_raw | pugi::format_no_declaration);
+		const auto str = index.str();
+		writer.finish({str.begin(), str.end()});
+		stream.close();
+		if (!stream)
+			throw std::ios_base::failure("Failed to write the file: " + vault_path.string());
+		if (m_durability != Durability::NONE)
+			AtomicFile::sync(vault_path);
+	}
+	catch (const std::exception&)
+	{
+		roll_back_append(vault_path);
+		throw;
+	}
+	std::filesystem::remove(journal);
+	// The vault is read again, so the next append continues from its tree.
+	const auto key = m_reader->key();
+	m_reader = std::make_shared<BlockReader>(vault_path);
+	if (key)
+		m_reader->set_key(*key);
+
+	// Each append leaves the blocks of the entries changed and the previous index and tree behind. The vault is rewritten
+	// once they take more room than what is still in use, and at least a chunk, so a long running watch doesn't grow it without bound.
+	std::map<std::uint64_t, std::uint64_t> blocks;
+	find_blocks(*this, blocks);
+	auto live = m_reader->data_offset() + m_reader->size() - m_reader->index().offset;
+	for (const auto size : blocks | std::views::values)
+		live += size;
+	if (const auto dead = m_reader->size() - std::min(live, m_reader->size()); dead > live && dead >= VaultFormat::CHUNK_SIZE)
+		compact();
+}
+
+void Vault::compact()
+{
+	// The blocks still in use are copied as they are stored, without decoding them, into a file replacing the vault at once.
+	const auto vault_path = m_file.path();
+	const auto key = m_reader->key();
+	const Profiler::Scope scope("compact");
+	{
+		AtomicFile vault_file(vault_path, m_durability);
+		BlockWriter writer(vault_file.stream(), m_reader->header(), key, 1);
+		std::map<std::uint64_t, BlockInfo> copied;
+		copy_blocks(*this, {}, writer, *m_reader, copied);
+		auto doc = pugi::xml_document();
+		write_content(doc);
+		std::ostringstream index;
+		doc.save(index, "", pugi::format_raw | pugi::format_no_declaration);
+		const auto str = index.str();
+		writer.finish({str.begin(), str.end()});
+		vault_file.replace();
+	}
+	const auto reader = std::make_shared<BlockReader>(vault_path);
+	if (key)
+		reader->set_key(*key);
+	load_index(reader);
+	m_reader = reader;
+}
+
+void Vault::set_progress_observer(ProgressObserver& observer)
+{
+	m_progress = std::make_unique<ProgressTracker>(observer);
+}
+
+void Vault::set_exclude_patterns(const std::vector<std::string>& patterns)
+{
+	m_excludes = IgnoreRules(patterns);
+}
+
+void Vault::set_durability(const Durability durability)
+{
+	m_durability = durability;
+}
+
+void Vault::set_source_removal(const SourceRemoval removal)
+{
+	m_sourceRemoval = removal;
+}
+
+void Vault::set_resume(const bool resume)
+{
+	m_resume = resume;
+}
+
+void Vault::set_use_agent(const bool useAgent)
+{
+	m_useAgent = useAgent;
+}
+
+void Vault::set_key_ring(std::shared_ptr<KeyRing> keyRing)
+{
+	m_keyRing = std::move(keyRing);
+}
+
+void Vault::set_identity(const std::filesystem::path& identity)
+{
+	m_identity = Recipients::read_identity(identity);
+}
+
+void Vault::read_from_dir()
+{
+	if (!m_opened)
+		throw std::runtime_error("The vault " + m_file.path().string() + " is not opened");
+	const Profiler::Scope scope("scan");
+	m_children.clear();
+	Scanner scanner(m_excludes, m_progress.get());
+	scanner.scan(m_file.path(), {}, *this, nullptr);
 }
 
 void Vault::write_to_dir() const
 {
-	if (m_file.exists())
+	// The files of a vault read from a stream are extracted as it is read, the rest of its entries after them.
+	if (m_file.exists() && !m_resume && !m_stream)
 		throw std::runtime_error(m_file.path().string() + " already exists");
+	const Profiler::Scope scope("extract");
 
-	Directory::create(m_file.path().parent_path());
+	if (const auto threads = m_budget.threads(); threads > 1)
+	{
+		ThreadPool pool(threads);
+		Directory::create(m_file.path().parent_path(), &pool);
+	}
+	else
+		Directory::create(m_file.path().parent_path(), nullptr);
+	create_links(m_file.path(), *this, m_file.path());
 }
 
-void Vault::read_from_file()
+std::shared_ptr<BlockReader> Vault::read_from_file()
 {
 	if (m_opened)
 		throw std::runtime_error("The vault " + m_file.path().string() + " is not closed");
@@ -123,7 +1285,92 @@ void Vault::read_from_file()
 	const auto vault_path = m_file.path();
 	if (!exists(vault_path))
 		throw std::runtime_error(vault_path.string() + " doesn't exists");
+	m_children.clear();
+
+	if (!BlockReader::is_vault_file(vault_path))
+	{
+		read_from_legacy_file();
+		return nullptr;
+	}
 
+	const auto reader = std::make_shared<BlockReader>(vault_path);
+	reader->set_progress(m_progress.get());
+	if (reader->header().encrypted)
+		unlock(*reader);
+	load_index(reader);
+	return reader;
+}
+
+void Vault::load_index(const std::shared_ptr<BlockReader>& reader)
+{
+	const Profiler::Scope scope("read_index");
+	const auto index = reader->read_index();
+	auto doc = pugi::xml_document();
+	if (!doc.load_buffer(index.data(), index.size()))
+		throw std::runtime_error("Failed to load the vault index");
+	m_children.clear();
+	read_content(doc.document_element(), reader, false);
+}
+
+void Vault::unlock(BlockReader& reader) const
+{
+	const auto& header = reader.header();
+	const auto vault = absolute(m_file.path()).lexically_normal();
+	if (auto key = unlock_data_key(header, vault))
+	{
+		reader.set_key(std::move(*key));
+		return;
+	}
+
+	const auto agent = KeyAgent::running_socket();
+	if (auto key = agent ? KeyAgent::get(*agent, header.salt, header.kdf) : std::nullopt)
+	{
+		try
+		{
+			reader.set_key(std::move(*key));
+			return;
+		}
+		catch (const std::runtime_error&) {}
+	}
+	const auto unlock = [&reader, &header](const EncryptionManager::Key& key)
+	{
+		try { reader.set_key(key); }
+		catch (const std::runtime_error& e) { throw WrongPassword(e.what()); }
+		return key;
+	};
+	if (!m_keyRing)
+		m_budget.check(header.kdf);
+	auto key = m_keyRing ? unlock(m_keyRing->derive(header.salt, header.kdf)) : with_password_attempts("password", [&unlock, &header](const EncryptionManager::Password& password)
+	{
+		return unlock(EncryptionManager::derive_key(password, header.salt, header.kdf));
+	});
+	if (agent)
+		KeyAgent::put(*agent, vault, {header.salt, header.kdf, std::move(key)});
+}
+
+std::optional<EncryptionManager::Key> Vault::unlock_data_key(const VaultHeader& header, const std::filesystem::path& vault) const
+{
+	const auto name = vault.empty() ? std::string("the standard input") : m_file.path().string();
+	if (!header.recipients.empty())
+	{
+		if (m_identity)
+		{
+			if (auto dataKey = header.recipients.unlock(*m_identity))
+				return dataKey;
+			if (!header.keySlots)
+				throw std::runtime_error("The identity is not a recipient of " + name);
+		}
+		else if (!header.keySlots)
+			throw std::invalid_argument(name + " is encrypted for recipients, an identity is needed to open it");
+	}
+	if (header.keySlots)
+		return unlock_key_slots(*header.keySlots, vault, m_keyRing.get(), m_budget);
+	return std::nullopt;
+}
+
+void Vault::read_from_legacy_file()
+{
+	const auto vault_path = m_file.path();
 	auto doc = pugi::xml_document();
 	if (!doc.load_file(vault_path.string().c_str()))
 		throw std::runtime_error("Failed to load the XML file: " + vault_path.string());
@@ -132,13 +1379,15 @@ void Vault::read_from_file()
 	using namespace std::string_view_literals;
 	if (root.name() == "encrypted"sv)
 	{
-		const auto password = ask_password_with_confirmation();
-		if (!password)
-			throw std::runtime_error("Password confirmation failed");
 		const auto data = Botan::base64_decode(root.attribute("data").value());
 		const auto nonce = Botan::base64_decode(root.attribute("nonce").value());
 		const auto salt = Botan::base64_decode(root.attribute("salt").value());
-		const auto decrypted_data = EncryptionManager::decrypt(data, *password, salt, nonce);
+		const auto decrypt = [&data, &nonce, &salt](const EncryptionManager::Password& password)
+		{
+			try { return EncryptionManager::decrypt(data, password, salt, nonce); }
+			catch (const std::exception&) { throw WrongPassword("Wrong password or corrupted vault"); }
+		};
+		const auto decrypted_data = m_keyRing ? decrypt(m_keyRing->password()) : with_password_attempts("password", decrypt);
 		if (!doc.load_buffer(decrypted_data.data(), decrypted_data.size()))
 			throw std::runtime_error("Failed to load the decrypted XML data");
 		root = doc.document_element();
@@ -152,6 +1401,12 @@ void Vault::read_from_file()
 			throw std::runtime_error("Failed to load the decrypted XML data");
 		root = doc.document_element();
 	}
+	read_content(root, nullptr, true);
+}
+
+void Vault::read_content(const pugi::xml_node& root, const std::shared_ptr<const BlockReader>& reader, const bool legacy)
+{
+	using namespace std::string_view_literals;
 	if (root.name() != "vault"sv)
 		throw std::runtime_error("Invalid vault file format: missing vault tag");
 	m_name = root.attribute("name").value();
@@ -165,6 +1420,7 @@ void Vault::read_from_file()
 	m_lastWriteTime = std::chrono::clock_cast<std::chrono::file_clock>(lastWriteTime);
 #endif
 
+	std::vector<std::pair<File*, std::string>> links;
 	std::deque<std::pair<pugi::xml_node, std::reference_wrapper<Directory>>> dirs;
 	dirs.emplace_back(root, std::ref(*this));
 	while (!dirs.empty())
@@ -179,13 +1435,33 @@ void Vault::read_from_file()
 					permissions = static_cast<std::filesystem::perms>(child.attribute("permissions").as_uint());
 				else
 					permissions = std::filesystem::perms::owner_all | std::filesystem::perms::group_all | std::filesystem::perms::others_all;
-				auto data = child.attribute("data").value();
 #if defined(__cpp_lib_chrono) && __cpp_lib_chrono >= 201907L
 				std::istringstream(child.attribute("lastWriteTime").value()) >> date::parse("%F %T", lastWriteTime);
-				dir.get().children().push_back(std::make_unique<File>(name, std::chrono::clock_cast<std::chrono::file_clock>(lastWriteTime), permissions, data));
+				const auto fileLastWriteTime = std::chrono::clock_cast<std::chrono::file_clock>(lastWriteTime);
 #else
-				dir.get().children().push_back(std::make_unique<File>(name, std::filesystem::file_time_type::clock::now(), permissions, data));
+				const auto fileLastWriteTime = std::filesystem::file_time_type::clock::now();
 #endif
+				if (legacy)
+				{
+					dir.get().children().push_back(std::make_unique<File>(name, fileLastWriteTime, permissions, child.attribute("data").value()));
+					continue;
+				}
+				if (const auto link = child.attribute("link"))
+				{
+					auto file = std::make_unique<File>(name, fileLastWriteTime, permissions, 0, std::string(), std::vector<BlockInfo>(), reader);
+					links.emplace_back(file.get(), link.value());
+					dir.get().children().push_back(std::move(file));
+					continue;
+				}
+				std::vector<BlockInfo> blocks;
+				for (const auto& block : child.children())
+				{
+					if (block.name() == "block"sv)
+						blocks.push_back({block.attribute("id").as_ullong(), block.attribute("offset").as_ullong(), block.attribute("size").as_ullong(), block.attribute("storedSize").as_ullong(), block.attribute("checksum").value(), block.attribute("volume").as_ullong()});
+					else if (block.name() == "hole"sv)
+						blocks.push_back({0, 0, block.attribute("size").as_ullong(), 0, {}});
+				}
+				dir.get().children().push_back(std::make_unique<File>(name, fileLastWriteTime, permissions, child.attribute("size").as_ullong(), child.attribute("checksum").value(), std::move(blocks), reader));
 			}
 			else if (child.name() == "directory"sv)
 			{
@@ -209,54 +1485,178 @@ void Vault::read_from_file()
 		}
 		dirs.pop_front();
 	}
+	// A hard link shares the content of the file it refers to, which is loaded with the whole index.
+	for (const auto& [file, link] : links)
+	{
+		const auto target = dynamic_cast<const File*>(find(link));
+		if (!target || !target->link().empty())
+			throw std::runtime_error("Invalid vault file format: " + file->name() + " is a hard link to the missing file " + link);
+		file->link_to(link, *target);
+	}
 }
 
-void Vault::write_to_file(bool compress, const bool encrypt) const
+std::vector<EncryptionManager::Data> Vault::scan_for_closing(const bool encrypt, const KdfParameters& kdf, const std::vector<std::filesystem::path>& recipients)
+{
+	if (encrypt)
+	{
+		EncryptionManager::validate(kdf);
+		// The key of a batch is derived by its key ring, within the budget of the whole batch.
+		if (recipients.empty() && !m_keyRing)
+			m_budget.check(kdf);
+	}
+	else if (!recipients.empty())
+		throw std::invalid_argument("Recipients can only be given to encrypt a vault");
+	std::vector<EncryptionManager::Data> publicKeys;
+	for (const auto& recipient : recipients)
+		publicKeys.push_back(Recipients::read_public_key(recipient));
+	if (m_progress)
+		m_progress->start(ProgressPhase::SCANNING);
+	read_from_dir();
+	if (m_progress)
+		m_progress->finish();
+	return publicKeys;
+}
+
+void Vault::write_to_file(const std::filesystem::path& source, const bool compress, const bool encrypt, const KdfParameters& kdf, const Cipher cipher, const std::vector<EncryptionManager::Data>& recipients, const std::optional<std::uint64_t>& volumeSize)
 {
 	if (m_file.exists())
 		throw std::runtime_error(m_file.path().string() + " already exists");
 
-	std::ofstream vault_file(m_file.path().string());
-	if (!vault_file.is_open())
-		throw std::ios_base::failure("Failed to open the file: " + m_file.path().string());
+	// The blocks of a split vault are spread over its volumes, and the key of a vault for recipients can't be recovered
+	// without their identities, so these are written anonymously.
+	if (volumeSize || !recipients.empty())
+	{
+		AtomicFile vault_file(m_file.path(), m_durability);
+		write_to_stream(vault_file.stream(), source, compress, encrypt, kdf, cipher, recipients, absolute(m_file.path()).lexically_normal(), volumeSize, nullptr);
+		// The volumes are complete once the stream is, they are synced before the vault file referring to them is published.
+		for (size_t volume = 1; volumeSize && m_durability != Durability::NONE && exists(VaultFormat::volume_path(m_file.path(), volume)); ++volume)
+			AtomicFile::sync(VaultFormat::volume_path(m_file.path(), volume));
+		vault_file.commit();
+		return;
+	}
+
+	// The others are written under a hidden name with the journal of the entries stored, so an interrupted close is resumed after the ones committed.
+	Checkpoint checkpoint(Checkpoint::journal_path(m_file.path()), source, source, m_resume, m_durability);
+	AtomicFile vault_file(m_file.path(), m_durability, Checkpoint::partial_path(m_file.path()), checkpoint.offset());
+	checkpoint.set_sync([&vault_file] { vault_file.flush(); });
+	try
+	{
+		write_to_stream(vault_file.stream(), source, compress, encrypt, kdf, cipher, recipients, absolute(m_file.path()).lexically_normal(), std::nullopt, &checkpoint);
+		vault_file.commit();
+	}
+	catch (const std::ios_base::failure&)
+	{
+		// A failure to read or write the entries keeps the ones committed, so that the close can be resumed once it is fixed.
+		if (checkpoint.keep())
+			vault_file.keep();
+		else
+			checkpoint.remove();
+		throw;
+	}
+	catch (const std::exception&)
+	{
+		// The checkpoint resumed from is left for another attempt, a close without resuming starts over.
+		if (checkpoint.resumed())
+			vault_file.keep();
+		else
+			checkpoint.remove();
+		throw;
+	}
+	checkpoint.remove();
+}
+
+void Vault::write_to_stream(std::ostream& stream, const std::filesystem::path& source, const bool compress, const bool encrypt, const KdfParameters& kdf, const Cipher cipher, const std::vector<EncryptionManager::Data>& recipients, const std::optional<std::filesystem::path>& agentVault, const std::optional<std::uint64_t>& volumeSize, Checkpoint* checkpoint)
+{
+	// A resumed vault keeps the header and the key written by the interrupted close.
+	// A vault in a single file is framed, so it can be opened from a stream. Its volumes couldn't be.
+	const auto writer = checkpoint && checkpoint->resumed() ? resume_writer(stream, compress, encrypt, cipher, *checkpoint) : create_writer(stream, compress, encrypt, kdf, cipher, recipients, agentVault, !volumeSize);
+	writer->set_source(source);
+	writer->set_checkpoint(checkpoint);
+	if (volumeSize)
+		writer->set_volumes(m_file.path(), *volumeSize);
+	if (m_progress)
+	{
+		// The totals found while scanning are the ones to store.
+		const auto scanned = m_progress->progress();
+		m_progress->start(ProgressPhase::STORING, scanned.entries, scanned.bytesIn);
+		writer->set_progress(m_progress.get());
+	}
+	{
+		const Profiler::Scope scope("store");
+		for (const auto& child : m_children)
+		{
+			child->store(*writer, source);
+		}
+	}
 
+	const Profiler::Scope scope("write_index");
 	auto doc = pugi::xml_document();
 	write_content(doc);
-	const auto docToData = [&doc]() -> Botan::secure_vector<std::uint8_t>
-		{
-			std::ostringstream vaultContent;
-			doc.save(vaultContent);
-			auto str = vaultContent.str();
-			return {str.begin(), str.end()};
-		};
-	if (compress)
+	std::ostringstream index;
+	doc.save(index, "", pugi::format_raw | pugi::format_no_declaration);
+	const auto str = index.str();
+	writer->finish({str.begin(), str.end()});
+	if (m_progress)
+		m_progress->finish();
+}
+
+std::unique_ptr<BlockWriter> Vault::create_writer(std::ostream& stream, const bool compress, const bool encrypt, const KdfParameters& kdf, const Cipher cipher, const std::vector<EncryptionManager::Data>& recipients, const std::optional<std::filesystem::path>& agentVault, const bool framed) const
+{
+	VaultHeader header{VaultFormat::VERSION, compress, encrypt, VaultFormat::checksum_algorithm(VaultFormat::VERSION), {}, kdf, {}, cipher, {}, framed};
+	std::optional<EncryptionManager::Key> key;
+	if (encrypt && !recipients.empty())
 	{
-		CompressionManager::Data data = docToData();
-		const auto compressedData = CompressionManager::compress(data);
-		doc.reset();
-		auto root = doc.append_child("compressed");
-		if (!root)
-			throw std::runtime_error("Failed to create the XML node");
-		root.append_attribute("originalSize").set_value(std::to_string(data.size()).c_str());
-		root.append_attribute("data").set_value(base64_encode(compressedData).c_str());
+		// The key is only wrapped for the recipients' X25519 keys, so nothing is prompted nor derived from a password.
+		key = EncryptionManager::generate_key();
+		for (const auto& publicKey : recipients)
+			header.recipients.add(*key, publicKey);
 	}
-	if (encrypt)
+	else if (encrypt)
 	{
-		const auto password = ask_password_with_confirmation();
-		if (!password)
-			throw std::runtime_error("Password confirmation failed");
-		const auto salt = EncryptionManager::generate_new_salt();
-		EncryptionManager::Data data = docToData();
-		const auto [encryptedData, nonce] = EncryptionManager::encrypt(std::move(data), *password, salt);
-		doc.reset();
-		auto root = doc.append_child("encrypted");
-		if (!root)
-			throw std::runtime_error("Failed to create the XML node");
-		root.append_attribute("data").set_value(base64_encode(encryptedData).c_str());
-		root.append_attribute("nonce").set_value(base64_encode(nonce).c_str());
-		root.append_attribute("salt").set_value(base64_encode(salt).c_str());
-	}
-	doc.save(vault_file, "\t", pugi::format_no_declaration | pugi::format_indent);
+		// The payload is encrypted with a random key wrapped in a key slot, so the password can change without rewriting it.
+		// When asked to, a password key cached by the agent for this vault is reused with its salt, so a warm vault is closed
+		// without deriving it again. It is said so, the password isn't confirmed then. A streamed vault has no path to cache its key for.
+		const auto agent = agentVault ? KeyAgent::running_socket() : std::nullopt;
+		EncryptionManager::Salt salt;
+		EncryptionManager::Key passwordKey;
+		if (auto entry = agent && m_useAgent ? KeyAgent::find(*agent, *agentVault) : std::nullopt; entry && entry->kdf == header.kdf)
+		{
+			std::cerr << "Encrypting " << agentVault->string() << " with the password it was opened with, cached by the key agent" << std::endl;
+			salt = std::move(entry->salt);
+			passwordKey = std::move(entry->key);
+		}
+		else
+		{
+			// The vaults closed by a batch share the salt of their parameters, so its key is derived once for all of them.
+			if (m_keyRing)
+				std::tie(salt, passwordKey) = m_keyRing->closing_key(header.kdf);
+			else
+			{
+				const auto password = ask_password_with_confirmation();
+				if (!password)
+					throw std::runtime_error("Password confirmation failed");
+				salt = EncryptionManager::generate_new_salt();
+				passwordKey = EncryptionManager::derive_key(*password, salt, header.kdf);
+			}
+			if (agent)
+				KeyAgent::put(*agent, *agentVault, {salt, header.kdf, passwordKey});
+		}
+		key = EncryptionManager::generate_key();
+		header.keySlots.emplace().add(*key, std::move(salt), header.kdf, passwordKey);
+	}
+	return std::make_unique<BlockWriter>(stream, std::move(header), std::move(key), m_budget.threads());
+}
+
+std::unique_ptr<BlockWriter> Vault::resume_writer(std::ostream& stream, const bool compress, const bool encrypt, const Cipher cipher, Checkpoint& checkpoint) const
+{
+	// The key is unlocked from the key slots written by the interrupted close, like when opening the vault.
+	auto [header, headerBytes] = read_partial_header(Checkpoint::partial_path(m_file.path()));
+	if (header.compressed != compress || header.encrypted != encrypt || (encrypt && header.cipher != cipher))
+		throw std::invalid_argument("The interrupted close of " + m_file.path().string() + " used other options, close it again without resuming");
+	std::optional<EncryptionManager::Key> key;
+	if (header.keySlots)
+		key = unlock_key_slots(*header.keySlots, absolute(m_file.path()).lexically_normal(), m_keyRing.get(), m_budget);
+	return std::make_unique<BlockWriter>(stream, std::move(header), std::move(headerBytes), std::move(key), m_budget.threads(), checkpoint);
 }
 
 void Vault::write_content(pugi::xml_node& parentNode) const
@@ -0,0 +1,162 @@
+#include "VaultFileSystem.h"
+
+#include <stack>
+#include <stdexcept>
+
+#ifdef VAULT_WITH_FUSE
+#define FUSE_USE_VERSION 31
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <fuse.h>
+#include <unistd.h>
+
+namespace
+{
+	VaultFileSystem& context()
+	{
+		return *static_cast<VaultFileSystem*>(fuse_get_context()->private_data);
+	}
+
+	timespec to_timespec(const std::filesystem::file_time_type time)
+	{
+		const auto systemTime = std::chrono::time_point_cast<std::chrono::nanoseconds>(time - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now());
+		const auto nanoseconds = systemTime.time_since_epoch().count();
+		return {static_cast<time_t>(nanoseconds / 1'000'000'000), static_cast<long>(nanoseconds % 1'000'000'000)};
+	}
+
+	int get_attributes(const char* path, struct stat* st, fuse_file_info*)
+	{
+		const auto node = context().find(path);
+		if (!node)
+			return -ENOENT;
+		std::memset(st, 0, sizeof(struct stat));
+		const auto permissions = static_cast<mode_t>(node->permissions() & ~(std::filesystem::perms::owner_write | std::filesystem::perms::group_write | std::filesystem::perms::others_write));
+		if (const auto file = dynamic_cast<const File*>(node))
+		{
+			st->st_mode = S_IFREG | permissions;
+			st->st_nlink = 1;
+			st->st_size = static_cast<off_t>(file->size());
+		}
+		else
+		{
+			st->st_mode = S_IFDIR | permissions;
+			st->st_nlink = 2;
+		}
+		st->st_uid = getuid();
+		st->st_gid = getgid();
+		st->st_mtim = to_timespec(node->last_write_time());
+		st->st_atim = st->st_mtim;
+		st->st_ctim = st->st_mtim;
+		return 0;
+	}
+
+	int read_directory(const char* path, void* buffer, const fuse_fill_dir_t filler, off_t, fuse_file_info*, fuse_readdir_flags)
+	{
+		const auto directory = dynamic_cast<const Directory*>(context().find(path));
+		if (!directory)
+			return -ENOENT;
+		filler(buffer, ".", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+		filler(buffer, "..", nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+		for (const auto& child : directory->children())
+			filler(buffer, child->name().c_str(), nullptr, 0, static_cast<fuse_fill_dir_flags>(0));
+		return 0;
+	}
+
+	int open_file(const char* path, fuse_file_info* info)
+	{
+		const auto node = context().find(path);
+		if (!node)
+			return -ENOENT;
+		if (!dynamic_cast<const File*>(node))
+			return -EISDIR;
+		if ((info->flags & O_ACCMODE) != O_RDONLY)
+			return -EROFS;
+		info->keep_cache = 1;
+		return 0;
+	}
+
+	int read_file(const char* path, char* buffer, const size_t size, const off_t offset, fuse_file_info*)
+	{
+		const auto file = dynamic_cast<const File*>(context().find(path));
+		if (!file)
+			return -ENOENT;
+		try
+		{
+			const auto data = context().read(*file, static_cast<std::uint64_t>(offset), size);
+			std::memcpy(buffer, data.data(), data.size());
+			return static_cast<int>(data.size());
+		}
+		catch (const std::exception&)
+		{
+			return -EIO;
+		}
+	}
+}
+#endif
+
+VaultFileSystem::VaultFileSystem(const Directory& root, const size_t cacheSize):
+	m_root(root),
+	m_cache(cacheSize)
+{
+	std::stack<std::pair<std::string, std::reference_wrapper<const Directory>>> dirs_to_visit;
+	m_nodes.emplace("/", &m_root);
+	dirs_to_visit.emplace("", std::cref(m_root));
+	while (!dirs_to_visit.empty())
+	{
+		auto [dir_path, dir] = dirs_to_visit.top();
+		dirs_to_visit.pop();
+
+		for (const auto& child : dir.get().children())
+		{
+			auto path = dir_path + "/" + child->name();
+			if (const auto directory = dynamic_cast<const Directory*>(child.get()))
+				dirs_to_visit.emplace(path, std::cref(*directory));
+			m_nodes.emplace(std::move(path), child.get());
+		}
+	}
+}
+
+bool VaultFileSystem::is_supported()
+{
+#ifdef VAULT_WITH_FUSE
+	return true;
+#else
+	return false;
+#endif
+}
+
+void VaultFileSystem::mount(const std::filesystem::path& mountpoint)
+{
+	if (!is_directory(mountpoint))
+		throw std::invalid_argument("The mount point " + mountpoint.string() + " is not a directory");
+#ifdef VAULT_WITH_FUSE
+	fuse_operations operations{};
+	operations.getattr = get_attributes;
+	operations.readdir = read_directory;
+	operations.open = open_file;
+	operations.read = read_file;
+
+	const auto target = mountpoint.string();
+	std::vector<std::string> arguments = {"vault", "-f", "-o", "ro,default_permissions,fsname=vault", target};
+	std::vector<char*> argv;
+	for (auto& argument : arguments)
+		argv.push_back(argument.data());
+	if (fuse_main(static_cast<int>(argv.size()), argv.data(), &operations, this) != 0)
+		throw std::runtime_error("Failed to mount the vault on " + target);
+#else
+	throw std::runtime_error("This build of vault has no FUSE support, rebuild it with libfuse3 to mount vaults");
+#endif
+}
+
+const Node* VaultFileSystem::find(const std::string& path) const
+{
+	const auto it = m_nodes.find(path);
+	return it == m_nodes.end() ? nullptr : it->second;
+}
+
+File::Data VaultFileSystem::read(const File& file, const std::uint64_t offset, const std::uint64_t length)
+{
+	return file.content(offset, length, m_cache);
+}
@@ -0,0 +1,68 @@
+#include "VaultFormat.h"
+
+#include "ChecksumManager.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+
+bool VaultFormat::has_magic(const std::span<const std::uint8_t> data)
+{
+	return data.size() >= MAGIC.size() && std::ranges::equal(data.first(MAGIC.size()), MAGIC, [](const std::uint8_t byte, const char c) { return byte == static_cast<std::uint8_t>(c); });
+}
+
+std::filesystem::path VaultFormat::volume_path(const std::filesystem::path& vault, const std::uint64_t volume)
+{
+	std::ostringstream extension;
+	extension << '.' << std::setw(3) << std::setfill('0') << volume;
+	return vault.string() + extension.str();
+}
+
+std::filesystem::path VaultFormat::append_journal_path(const std::filesystem::path& vault)
+{
+	return vault.parent_path() / ("." + vault.filename().string() + ".append");
+}
+
+std::optional<std::uint64_t> VaultFormat::appended_length(const std::filesystem::path& vault)
+{
+	std::ifstream stream(append_journal_path(vault).string(), std::ios::binary);
+	std::uint64_t length = 0;
+	if (!stream.is_open() || !(stream >> length))
+		return std::nullopt;
+	return length;
+}
+
+std::string VaultFormat::checksum_algorithm(const std::uint32_t version)
+{
+	if (version < FIRST_VERSION || version > VERSION)
+		throw std::runtime_error("Unsupported vault format version " + std::to_string(version));
+	return ChecksumManager::ALGORITHM;
+}
+
+void VaultFormat::write_uint(std::ostream& stream, std::uint64_t value, const size_t size)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		stream.put(static_cast<char>(value & 0xFF));
+		value >>= 8;
+	}
+}
+
+void VaultFormat::write_frame(std::ostream& stream, const FrameType type, const std::uint64_t length, const std::uint64_t size)
+{
+	stream.put(static_cast<char>(type));
+	write_uint(stream, length, sizeof(std::uint64_t));
+	write_uint(stream, size, sizeof(std::uint64_t));
+}
+
+std::uint64_t VaultFormat::read_uint(const std::span<const std::uint8_t> data, const size_t size)
+{
+	if (data.size() < size)
+		throw std::runtime_error("Invalid vault file format: truncated integer");
+	std::uint64_t value = 0;
+	for (size_t i = size; i > 0; --i)
+		value = value << 8 | data[i - 1];
+	return value;
+}
@@ -1,14 +1,385 @@
 #include "../include/VaultManager.h"
+#include "DirectoryWatcher.h"
+#include "File.h"
+#include "KeyAgent.h"
+#include "KeyRing.h"
+#include "Recipients.h"
+#include "ThreadPool.h"
+#include "Utils.h"
 #include "Vault.h"
+#include "VaultFileSystem.h"
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#if defined(WIN32)
+#include <fcntl.h>
+#include <io.h>
+#endif
 
-void VaultManager::open_vault(const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination)
+namespace
 {
-	Vault vault_obj(vault);
-	vault_obj.open(destination);
+	// The passwords are read from the terminal while the vault is read from the standard input, however the open ends.
+	class TerminalPasswords
+	{
+	public:
+		TerminalPasswords()
+		{
+			read_passwords_from_terminal(true);
+		}
+
+		~TerminalPasswords()
+		{
+			read_passwords_from_terminal(false);
+		}
+
+		TerminalPasswords(const TerminalPasswords&) = delete;
+		TerminalPasswords& operator=(const TerminalPasswords&) = delete;
+	};
+
+	std::string json_string(const std::string_view value)
+	{
+		std::ostringstream stream;
+		stream << '"';
+		for (const auto c : value)
+		{
+			if (c == '"' || c == '\\')
+				stream << '\\' << c;
+			else if (static_cast<unsigned char>(c) < 0x20)
+				stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c) << std::dec;
+			else
+				stream << c;
+		}
+		stream << '"';
+		return stream.str();
+	}
+
+	std::string kdf_description(const KdfParameters& kdf)
+	{
+		return std::string(EncryptionManager::KDF_ALGORITHM) + ", " + std::to_string(kdf.memory / 1024) + " MiB, " + std::to_string(kdf.iterations) + " iterations, " + std::to_string(kdf.lanes) + " lanes";
+	}
+
+	std::string kdf_json(const KdfParameters& kdf)
+	{
+		return R"({"algorithm":")" + std::string(EncryptionManager::KDF_ALGORITHM) + R"(","memory":)" + std::to_string(kdf.memory) + R"(,"iterations":)" + std::to_string(kdf.iterations) + R"(,"lanes":)" + std::to_string(kdf.lanes) + "}";
+	}
+
+	void print_info(const std::filesystem::path& vault, const VaultInfo& info)
+	{
+		std::cout << "Vault: " << vault.string() << " (" << info.fileSize << " bytes)" << std::endl;
+		if (!info.header)
+			std::cout << "Format: legacy XML" << std::endl;
+		else
+		{
+			const auto& header = *info.header;
+			std::cout << "Format: version " << header.version << std::endl;
+			std::cout << "Checksum: " << header.checksum << std::endl;
+			std::cout << "Compression: " << (header.compressed ? "zlib" : "none") << std::endl;
+			std::cout << "Encryption: " << (header.encrypted ? EncryptionManager::cipher_name(header.cipher) : "none") << std::endl;
+			if (header.keySlots)
+			{
+				for (const auto index : header.keySlots->active())
+					std::cout << "Key slot " << index << ": " << kdf_description(header.keySlots->slot(index).kdf) << std::endl;
+			}
+			else if (!header.salt.empty())
+				std::cout << "Key derivation: " << kdf_description(header.kdf) << std::endl;
+			if (!header.recipients.empty())
+				std::cout << "Recipients: " << header.recipients.entries().size() << std::endl;
+			std::cout << "Block size: " << VaultFormat::CHUNK_SIZE << " bytes" << std::endl;
+		}
+		std::cout << "Index: " << info.indexSize << " bytes" << std::endl;
+		for (const auto& volume : info.volumes)
+			std::cout << "Volume: " << volume.name << " (" << volume.size << " bytes)" << std::endl;
+		std::cout << std::endl;
+
+		// Sizes are in bytes and include the whole subtree of each directory, the ratio is the stored size over the original one.
+		std::cout << std::setw(10) << "Files" << std::setw(8) << "Dirs" << std::setw(16) << "Size" << std::setw(16) << "Compressed" << std::setw(16) << "Stored" << std::setw(8) << "Ratio" << "  Path" << std::endl;
+		for (const auto& directory : info.directories)
+		{
+			std::ostringstream ratio;
+			if (directory.size)
+				ratio << std::fixed << std::setprecision(1) << 100.0 * static_cast<double>(directory.storedSize) / static_cast<double>(directory.size) << "%";
+			else
+				ratio << "-";
+			std::cout << std::setw(10) << directory.files << std::setw(8) << directory.directories << std::setw(16) << directory.size << std::setw(16) << directory.compressedSize
+				<< std::setw(16) << directory.storedSize << std::setw(8) << ratio.str() << "  " << directory.path << std::endl;
+		}
+	}
+
+	void print_info_json(const std::filesystem::path& vault, const VaultInfo& info)
+	{
+		std::cout << R"({"vault":)" << json_string(vault.string()) << R"(,"fileSize":)" << info.fileSize;
+		if (!info.header)
+			std::cout << R"(,"format":"legacy")";
+		else
+		{
+			const auto& header = *info.header;
+			std::cout << R"(,"format":)" << header.version << R"(,"checksum":)" << json_string(header.checksum)
+				<< R"(,"compression":)" << (header.compressed ? R"("zlib")" : "null")
+				<< R"(,"encryption":)" << (header.encrypted ? json_string(EncryptionManager::cipher_name(header.cipher)) : "null");
+			std::cout << R"(,"keySlots":[)";
+			if (header.keySlots)
+			{
+				for (bool first = true; const auto index : header.keySlots->active())
+				{
+					std::cout << (first ? "" : ",") << R"({"slot":)" << index << R"(,"kdf":)" << kdf_json(header.keySlots->slot(index).kdf) << "}";
+					first = false;
+				}
+			}
+			std::cout << "]";
+			if (!header.keySlots && !header.salt.empty())
+				std::cout << R"(,"kdf":)" << kdf_json(header.kdf);
+			std::cout << R"(,"recipients":)" << header.recipients.entries().size() << R"(,"blockSize":)" << VaultFormat::CHUNK_SIZE;
+		}
+		std::cout << R"(,"indexSize":)" << info.indexSize << R"(,"volumes":[)";
+		for (bool first = true; const auto& volume : info.volumes)
+		{
+			std::cout << (first ? "" : ",") << R"({"name":)" << json_string(volume.name) << R"(,"size":)" << volume.size << "}";
+			first = false;
+		}
+		std::cout << R"(],"directories":[)";
+		for (bool first = true; const auto& directory : info.directories)
+		{
+			std::cout << (first ? "" : ",") << R"({"path":)" << json_string(directory.path) << R"(,"files":)" << directory.files << R"(,"directories":)" << directory.directories
+				<< R"(,"size":)" << directory.size << R"(,"compressedSize":)" << directory.compressedSize << R"(,"storedSize":)" << directory.storedSize << "}";
+			first = false;
+		}
+		std::cout << "]}" << std::endl;
+	}
+
+	BatchResult run_job(const BatchJob& job, const MemoryBudget& budget, const std::shared_ptr<KeyRing>& keyRing, const Durability durability)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		BatchResult result;
+		try
+		{
+			Vault vault(job.vault, budget);
+			vault.set_key_ring(keyRing);
+			vault.set_durability(durability);
+			if (job.action == BatchAction::OPEN)
+			{
+				if (job.identity)
+					vault.set_identity(*job.identity);
+				vault.open(job.destination, job.patterns);
+			}
+			else
+			{
+				vault.set_exclude_patterns(job.patterns);
+				vault.close(job.destination, job.extension, job.compress, job.encrypt);
+			}
+		}
+		catch (const std::exception& e)
+		{
+			result.error = e.what();
+		}
+		result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		return result;
+	}
+}
+
+void VaultManager::set_max_memory(const std::optional<std::uint64_t>& maxMemory)
+{
+	m_budget = MemoryBudget(maxMemory);
+}
+
+void VaultManager::set_progress_observer(std::shared_ptr<ProgressObserver> observer)
+{
+	m_observer = std::move(observer);
+}
+
+void VaultManager::open_vault(const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination, const std::optional<std::filesystem::path>& identity, const std::vector<std::string>& only, const Durability durability, const bool resume)
+{
+	if (vault == STANDARD_STREAM)
+	{
+		// The stream is extracted as it is read, in a staging directory of its own, so there is nothing to resume from.
+		if (resume)
+			throw std::invalid_argument("An open from the standard input can't be resumed");
+#if defined(WIN32)
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		const TerminalPasswords passwords;
+		Vault vault_obj(std::cin, m_budget);
+		if (m_observer)
+			vault_obj.set_progress_observer(*m_observer);
+		if (identity)
+			vault_obj.set_identity(*identity);
+		vault_obj.set_durability(durability);
+		vault_obj.open(destination, only);
+		return;
+	}
+	Vault vault_obj(vault, m_budget);
+	if (m_observer)
+		vault_obj.set_progress_observer(*m_observer);
+	if (identity)
+		vault_obj.set_identity(*identity);
+	vault_obj.set_durability(durability);
+	vault_obj.set_resume(resume);
+	vault_obj.open(destination, only);
+}
+
+void VaultManager::stream_vault(const std::filesystem::path& vault, const bool compress, const bool encrypt, const KdfParameters& kdf, const std::optional<Cipher>& cipher, const std::vector<std::filesystem::path>& recipients, const std::vector<std::string>& excludes)
+{
+#if defined(WIN32)
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	Vault vault_obj(vault, m_budget);
+	if (m_observer)
+		vault_obj.set_progress_observer(*m_observer);
+	vault_obj.set_exclude_patterns(excludes);
+	vault_obj.write(std::cout, compress, encrypt, kdf, cipher, recipients);
+	if (!std::cout.flush())
+		throw std::ios_base::failure("Failed to write the vault to the standard output");
+}
+
+void VaultManager::close_vault(const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination, const std::optional<std::string>& extension, const bool compress, const bool encrypt, const KdfParameters& kdf, const std::optional<Cipher>& cipher, const std::vector<std::filesystem::path>& recipients, const std::optional<std::uint64_t>& volumeSize, const std::vector<std::string>& excludes, const Durability durability, const SourceRemoval removal, const bool resume, const bool useAgent)
+{
+	Vault vault_obj(vault, m_budget);
+	if (m_observer)
+		vault_obj.set_progress_observer(*m_observer);
+	vault_obj.set_exclude_patterns(excludes);
+	vault_obj.set_durability(durability);
+	vault_obj.set_source_removal(removal);
+	vault_obj.set_resume(resume);
+	vault_obj.set_use_agent(useAgent);
+	vault_obj.close(destination, extension, compress, encrypt, kdf, cipher, recipients, volumeSize);
+}
+
+std::vector<std::string> VaultManager::verify_vault(const std::filesystem::path& vault)
+{
+	Vault vault_obj(vault, m_budget);
+	if (m_observer)
+		vault_obj.set_progress_observer(*m_observer);
+	return vault_obj.verify();
+}
+
+void VaultManager::info_vault(const std::filesystem::path& vault, const std::optional<std::filesystem::path>& identity, const bool json)
+{
+	Vault vault_obj(vault, m_budget);
+	if (identity)
+		vault_obj.set_identity(*identity);
+	const auto info = vault_obj.info();
+	if (json)
+		print_info_json(vault, info);
+	else
+		print_info(vault, info);
+}
+
+void VaultManager::cat_vault(const std::filesystem::path& vault, const std::filesystem::path& entry, const std::uint64_t offset, const std::optional<std::uint64_t>& length)
+{
+	Vault vault_obj(vault, m_budget);
+	vault_obj.load();
+	const auto file = dynamic_cast<const File*>(vault_obj.find(entry));
+	if (!file)
+		throw std::invalid_argument(entry.string() + " is not a file of the vault " + vault.string());
+#if defined(WIN32)
+	_setmode(_fileno(stdout), _O_BINARY);
+#endif
+	file->write_range(std::cout, offset, length.value_or(std::numeric_limits<std::uint64_t>::max()));
+	std::cout.flush();
+}
+
+void VaultManager::mount_vault(const std::filesystem::path& vault, const std::filesystem::path& mountpoint, const size_t cacheSize)
+{
+	if (!VaultFileSystem::is_supported())
+		throw std::runtime_error("This build of vault has no FUSE support, rebuild it with libfuse3 to mount vaults");
+	Vault vault_obj(vault, m_budget);
+	vault_obj.load();
+	VaultFileSystem fileSystem(vault_obj, m_budget.cache_size(cacheSize));
+	fileSystem.mount(mountpoint);
+}
+
+KdfCalibration VaultManager::calibrate_kdf(const std::chrono::milliseconds target)
+{
+	if (target.count() <= 0)
+		throw std::invalid_argument("The key derivation target duration must be positive");
+	return EncryptionManager::calibrate(target, m_budget.kdf_memory());
+}
+
+double VaultManager::benchmark_cipher(const Cipher cipher)
+{
+	return EncryptionManager::measure_throughput(cipher, std::chrono::milliseconds(500));
+}
+
+void VaultManager::passwd_vault(const std::filesystem::path& vault, const KeySlotAction action)
+{
+	Vault vault_obj(vault, m_budget);
+	vault_obj.change_password(action);
+}
+
+void VaultManager::run_agent(const std::filesystem::path& socket, const std::chrono::seconds ttl)
+{
+	if (!KeyAgent::is_supported())
+		throw std::runtime_error("The key agent is only available on Unix systems");
+	KeyAgent agent(socket, ttl);
+	std::cout << "Key agent listening on " << socket.string() << std::endl;
+	std::cout << KeyAgent::SOCKET_VARIABLE << "=" << socket.string() << "; export " << KeyAgent::SOCKET_VARIABLE << ";" << std::endl;
+	agent.run();
+}
+
+void VaultManager::stop_agent(const std::filesystem::path& socket)
+{
+	if (!KeyAgent::stop(socket))
+		throw std::runtime_error("No key agent is listening on " + socket.string());
+}
+
+void VaultManager::generate_identity(const std::filesystem::path& identity)
+{
+	const auto publicKey = Recipients::generate_identity(identity);
+	std::cout << "Identity written to " << identity.string() << ", keep it secret" << std::endl;
+	std::cout << "Public key: " << Recipients::format_public_key(publicKey) << std::endl;
+}
+
+std::vector<BatchResult> VaultManager::run_batch(const std::vector<BatchJob>& jobs, const size_t concurrency, const Durability durability)
+{
+	// The jobs running at once share the memory budget and the processors, and the password and the keys derived from it.
+	const auto running = m_budget.operations(std::min(concurrency, jobs.size()));
+	const auto budget = m_budget.share(running);
+	const auto keyRing = std::make_shared<KeyRing>(m_budget);
+	std::vector<BatchResult> results(jobs.size());
+	ThreadPool pool(running);
+	std::vector<std::future<void>> done;
+	for (size_t index = 0; index < jobs.size(); ++index)
+		done.push_back(pool.submit([&jobs, &results, &budget, &keyRing, durability, index] { results[index] = run_job(jobs[index], budget, keyRing, durability); }));
+	for (auto& job : done)
+		job.get();
+	return results;
 }
 
-void VaultManager::close_vault(const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination, const std::optional<std::string>& extension, const bool compress, const bool encrypt)
+void VaultManager::watch_vault(const std::filesystem::path& directory, const std::filesystem::path& vault, const bool compress, const bool encrypt, const std::vector<std::string>& excludes, const std::chrono::milliseconds delay, const Durability durability)
 {
-	Vault vault_obj(vault);
-	vault_obj.close(destination, extension, compress, encrypt);
+	if (!DirectoryWatcher::is_supported())
+		throw std::runtime_error("Watching a directory is only supported on Linux");
+	const auto source = absolute(directory).lexically_normal();
+	if (const auto target = absolute(vault).lexically_normal(); std::mismatch(source.begin(), source.end(), target.begin(), target.end()).first == source.end())
+		throw std::invalid_argument("The vault must not be inside the directory it is synced from");
+	// The directory is watched first, so the changes made while the vault is written or brought up to date are synced after.
+	DirectoryWatcher watcher(directory, delay);
+	const auto keyRing = std::make_shared<KeyRing>(m_budget);
+	std::vector<std::filesystem::path> changed{std::filesystem::path()};
+	if (!exists(vault))
+	{
+		Vault vault_obj(directory, m_budget);
+		if (m_observer)
+			vault_obj.set_progress_observer(*m_observer);
+		vault_obj.set_key_ring(keyRing);
+		vault_obj.set_exclude_patterns(excludes);
+		AtomicFile file(vault, durability);
+		vault_obj.write(file.stream(), compress, encrypt);
+		file.commit();
+		changed.clear();
+	}
+	// An existing vault is brought up to date by scanning the whole directory, keeping the content of the files unchanged since.
+	Vault vault_obj(vault, m_budget);
+	vault_obj.set_key_ring(keyRing);
+	vault_obj.set_exclude_patterns(excludes);
+	vault_obj.set_durability(durability);
+	vault_obj.update(directory, changed);
+	std::cout << "Watching " << directory.string() << " into " << vault.string() << ", press Ctrl+C to stop" << std::endl;
+	watcher.run([&vault_obj, &directory](const std::vector<std::filesystem::path>& paths)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		vault_obj.update(directory, paths);
+		const auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+		std::cout << "Synced " << paths.size() << (paths.size() == 1 ? " change" : " changes") << " in " << duration.count() << " ms" << std::endl;
+	});
 }
@@ -0,0 +1,101 @@
+#include "VolumeWriter.h"
+#include "Profiler.h"
+#include "VaultFormat.h"
+
+VolumeWriter::VolumeWriter(std::filesystem::path path, const std::vector<std::uint8_t>& header):
+	m_path(std::move(path)),
+	m_size(0),
+	m_sealed(false)
+{
+	if (exists(m_path))
+		throw std::runtime_error("The volume " + m_path.string() + " already exists, remove it first");
+	m_stream.open(m_path.string(), std::ios::binary);
+	if (!m_stream.is_open())
+		throw std::ios_base::failure("Failed to open the file: " + m_path.string());
+	m_stream.write(VaultFormat::MAGIC.data(), VaultFormat::MAGIC.size());
+	VaultFormat::write_uint(m_stream, header.size(), sizeof(std::uint32_t));
+	m_stream.write(reinterpret_cast<const char*>(header.data()), static_cast<std::streamsize>(header.size()));
+	if (!m_stream)
+		throw std::ios_base::failure("Failed to write the header of the volume " + m_path.string());
+	m_size = VaultFormat::MAGIC.size() + sizeof(std::uint32_t) + header.size();
+	m_thread = std::jthread([this] { work(); });
+}
+
+VolumeWriter::~VolumeWriter()
+{
+	seal();
+}
+
+const std::filesystem::path& VolumeWriter::path() const
+{
+	return m_path;
+}
+
+std::uint64_t VolumeWriter::size() const
+{
+	return m_size;
+}
+
+void VolumeWriter::write(Data data)
+{
+	std::unique_lock lock(m_mutex);
+	m_condition.wait(lock, [this] { return m_error || m_queue.size() < DEPTH; });
+	if (m_error)
+		std::rethrow_exception(m_error);
+	m_size += data.size();
+	m_queue.push_back(std::move(data));
+	m_condition.notify_all();
+}
+
+void VolumeWriter::seal()
+{
+	{
+		std::scoped_lock lock(m_mutex);
+		m_sealed = true;
+	}
+	m_condition.notify_all();
+}
+
+void VolumeWriter::close()
+{
+	seal();
+	if (m_thread.joinable())
+		m_thread.join();
+	if (m_error)
+		std::rethrow_exception(m_error);
+}
+
+void VolumeWriter::work()
+{
+	// The blocks are written and the volume flushed on this thread, so the next volume is filled while this one drains.
+	try
+	{
+		while (true)
+		{
+			Data data;
+			{
+				std::unique_lock lock(m_mutex);
+				m_condition.wait(lock, [this] { return m_sealed || !m_queue.empty(); });
+				if (m_queue.empty())
+					break;
+				data = std::move(m_queue.front());
+				m_queue.pop_front();
+			}
+			m_condition.notify_all();
+			if (!m_stream.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size())))
+				throw std::ios_base::failure("Failed to write the volume " + m_path.string());
+			Profiler::count(Profiler::Counter::IO_CALLS);
+			Profiler::count(Profiler::Counter::BYTES_WRITTEN, data.size());
+		}
+		m_stream.close();
+		if (!m_stream)
+			throw std::ios_base::failure("Failed to write the volume " + m_path.string());
+	}
+	catch (...)
+	{
+		std::scoped_lock lock(m_mutex);
+		m_error = std::current_exception();
+		m_queue.clear();
+	}
+	m_condition.notify_all();
+}
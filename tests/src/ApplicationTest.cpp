@@ -3,13 +3,30 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h>
 
+#include "Profiler.h"
 #include "Vault.h"
+#include "VaultFileSystem.h"
 
 class MockVaultManager final : public VaultManager
 {
 public:
-    MOCK_METHOD(void, open_vault, (const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination), (override));
-    MOCK_METHOD(void, close_vault, (const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination, const std::optional<std::string>& extension, bool compress, bool encrypt), (override));
+    MOCK_METHOD(void, set_max_memory, (const std::optional<std::uint64_t>& maxMemory), (override));
+    MOCK_METHOD(void, set_progress_observer, (std::shared_ptr<ProgressObserver> observer), (override));
+    MOCK_METHOD(void, open_vault, (const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination, const std::optional<std::filesystem::path>& identity, const std::vector<std::string>& only, Durability durability, bool resume), (override));
+    MOCK_METHOD(void, stream_vault, (const std::filesystem::path& vault, bool compress, bool encrypt, const KdfParameters& kdf, const std::optional<Cipher>& cipher, const std::vector<std::filesystem::path>& recipients, const std::vector<std::string>& excludes), (override));
+    MOCK_METHOD(void, close_vault, (const std::filesystem::path& vault, const std::optional<std::filesystem::path>& destination, const std::optional<std::string>& extension, bool compress, bool encrypt, const KdfParameters& kdf, const std::optional<Cipher>& cipher, const std::vector<std::filesystem::path>& recipients, const std::optional<std::uint64_t>& volumeSize, const std::vector<std::string>& excludes, Durability durability, SourceRemoval removal, bool resume, bool useAgent), (override));
+    MOCK_METHOD(std::vector<std::string>, verify_vault, (const std::filesystem::path& vault), (override));
+    MOCK_METHOD(void, info_vault, (const std::filesystem::path& vault, const std::optional<std::filesystem::path>& identity, bool json), (override));
+    MOCK_METHOD(void, cat_vault, (const std::filesystem::path& vault, const std::filesystem::path& entry, std::uint64_t offset, const std::optional<std::uint64_t>& length), (override));
+    MOCK_METHOD(void, mount_vault, (const std::filesystem::path& vault, const std::filesystem::path& mountpoint, size_t cacheSize), (override));
+    MOCK_METHOD(KdfCalibration, calibrate_kdf, (std::chrono::milliseconds target), (override));
+    MOCK_METHOD(double, benchmark_cipher, (Cipher cipher), (override));
+    MOCK_METHOD(void, passwd_vault, (const std::filesystem::path& vault, KeySlotAction action), (override));
+    MOCK_METHOD(void, run_agent, (const std::filesystem::path& socket, std::chrono::seconds ttl), (override));
+    MOCK_METHOD(void, stop_agent, (const std::filesystem::path& socket), (override));
+    MOCK_METHOD(void, generate_identity, (const std::filesystem::path& identity), (override));
+    MOCK_METHOD(std::vector<BatchResult>, run_batch, (const std::vector<BatchJob>& jobs, size_t concurrency, Durability durability), (override));
+    MOCK_METHOD(void, watch_vault, (const std::filesystem::path& directory, const std::filesystem::path& vault, bool compress, bool encrypt, const std::vector<std::string>& excludes, std::chrono::milliseconds delay, Durability durability), (override));
 };
 
 class ApplicationTest : public testing::Test
@@ -55,6 +72,7 @@ protected:
     {
         std::cout.clear();
         std::cerr.clear();
+        Profiler::reset();
         if (exists(m_temp_dir))
             remove_all(m_temp_dir);
     }
@@ -75,7 +93,7 @@ TEST_F(ApplicationTest, ExecuteOpenWithValidArgs)
     const char* args[] = {"vault", "open", "--vault", vault.c_str()};
     init(args);
 
-    EXPECT_CALL(*m_vaultManagerPtr, open_vault(testing::Eq(vault), testing::Eq(std::nullopt))).Times(1);
+    EXPECT_CALL(*m_vaultManagerPtr, open_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(false))).Times(1);
 
     EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
 }
@@ -86,7 +104,7 @@ TEST_F(ApplicationTest, ExecuteCloseWithValidArgs)
     const char* args[] = {"vault", "close", "--vault", vault.c_str()};
     init(args);
 
-    EXPECT_CALL(*m_vaultManagerPtr, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false))).Times(1);
+    EXPECT_CALL(*m_vaultManagerPtr, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
 
     EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
 }
@@ -139,7 +157,7 @@ TEST_F(ApplicationTest, ExecuteOpenWithDestination)
 
     init(args);
 
-    EXPECT_CALL(*m_vaultManagerPtr, open_vault(testing::Eq(vault), testing::Eq(destination))).Times(1);
+    EXPECT_CALL(*m_vaultManagerPtr, open_vault(testing::Eq(vault), testing::Eq(destination), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(false))).Times(1);
 
     EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
 }
@@ -150,7 +168,7 @@ TEST_F(ApplicationTest, ExecuteCloseWithDestination)
     const auto destination = create_directory("destination").string();
     const char* args[] = {"vault", "close", "--vault", vault.c_str(), "--destination", destination.c_str()};
 
-    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(destination), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false))).Times(1);
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(destination), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
 
     init(args);
 
@@ -162,7 +180,7 @@ TEST_F(ApplicationTest, ExecuteCloseWithExtension)
     const auto vault = create_directory("vault").string();
     const char* args[] = {"vault", "close", "--vault", vault.c_str(), "--extension", "vault"};
 
-    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq("vault"), testing::Eq(false), testing::Eq(false))).Times(1);
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq("vault"), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
 
     init(args);
 
@@ -176,7 +194,7 @@ TEST_F(ApplicationTest, ExecuteOpenWithDifferentFlagTypes)
     const auto concatenated = "--destination=" + destination;
     const char* args[] = {"vault", "open", "-v", vault.c_str(), destination.c_str()};
 
-    EXPECT_CALL(*m_vaultManager, open_vault(testing::Eq(vault), testing::Eq(destination))).Times(1);
+    EXPECT_CALL(*m_vaultManager, open_vault(testing::Eq(vault), testing::Eq(destination), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(false))).Times(1);
 
     init(args);
 
@@ -189,7 +207,7 @@ TEST_F(ApplicationTest, ExecuteCloseWithDifferentFlagTypes)
     const auto destination = create_directory("destination").string();
     const char* args[] = {"vault", "close", "--destination", destination.c_str(), vault.c_str()};
 
-    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(destination), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false))).Times(1);
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(destination), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
 
     init(args);
 
@@ -201,9 +219,688 @@ TEST_F(ApplicationTest, ExecuteCloseWithEncryption)
     const auto vault = create_directory("vault").string();
     const char* args[] = {"vault", "close", "-E", vault.c_str()};
 
-    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(true))).Times(1);
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(true), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
 
     init(args);
 
     EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
 }
+
+TEST_F(ApplicationTest, ExecuteVerifyWithValidArgs)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "verify", vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, verify_vault(testing::Eq(vault))).WillOnce(testing::Return(std::vector<std::string>{}));
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteVerifyWithCorruptedEntries)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "verify", "--vault", vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, verify_vault(testing::Eq(vault))).WillOnce(testing::Return(std::vector<std::string>{"file.txt"}));
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteBatch)
+{
+    const auto manifest = (m_temp_dir / "manifest").string();
+    std::ofstream(manifest) << "# Deploy\n\nclose projects/app -C -E --exclude '*.log'\r\n  open \"archives/data set.vlt\" -d /srv --only config\n";
+    const char* args[] = {"vault", "batch", manifest.c_str(), "-j", "8", "--fsync", "data"};
+
+    BatchJob close;
+    close.action = BatchAction::CLOSE;
+    close.vault = "projects/app";
+    close.compress = true;
+    close.encrypt = true;
+    close.patterns = {"*.log"};
+    BatchJob open;
+    open.vault = "archives/data set.vlt";
+    open.destination = "/srv";
+    open.patterns = {"config"};
+    EXPECT_CALL(*m_vaultManager, run_batch(testing::ElementsAre(close, open), testing::Eq(8u), testing::Eq(Durability::DATA)))
+        .WillOnce(testing::Return(std::vector<BatchResult>(2)));
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteBatchWithFailedJob)
+{
+    const auto manifest = (m_temp_dir / "manifest").string();
+    std::ofstream(manifest) << "open first.vlt\nopen second.vlt\n";
+    const char* args[] = {"vault", "batch", manifest.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, run_batch(testing::SizeIs(2), testing::Eq(4u), testing::Eq(Durability::FULL)))
+        .WillOnce(testing::Return(std::vector<BatchResult>{{}, {"Wrong password", {}}}));
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteBatchWithInvalidManifest)
+{
+    const auto manifest = (m_temp_dir / "manifest").string();
+    std::ofstream(manifest) << "open first.vlt\nverify second.vlt\n";
+    const char* args[] = {"vault", "batch", manifest.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, run_batch).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteWatch)
+{
+    const auto directory = create_directory("project").string();
+    const auto vault = (m_temp_dir / "project.vlt").string();
+    const char* args[] = {"vault", "watch", directory.c_str(), vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, watch_vault(testing::Eq(directory), testing::Eq(vault), testing::Eq(false), testing::Eq(false), testing::IsEmpty(), testing::Eq(std::chrono::milliseconds(1000)), testing::Eq(Durability::FULL))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteWatchWithOptions)
+{
+    const auto directory = create_directory("project").string();
+    const auto vault = (m_temp_dir / "project.vlt").string();
+    const char* args[] = {"vault", "watch", directory.c_str(), vault.c_str(), "-C", "-E", "--delay", "250ms", "--exclude", "*.log", "--fsync", "none"};
+
+    EXPECT_CALL(*m_vaultManager, watch_vault(testing::Eq(directory), testing::Eq(vault), testing::Eq(true), testing::Eq(true), testing::ElementsAre("*.log"), testing::Eq(std::chrono::milliseconds(250)), testing::Eq(Durability::NONE))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteWatchWithMissingDirectory)
+{
+    const auto directory = (m_temp_dir / "missing").string();
+    const auto vault = (m_temp_dir / "missing.vlt").string();
+    const char* args[] = {"vault", "watch", directory.c_str(), vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, watch_vault).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteInfo)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "info", vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, info_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteInfoWithJsonAndIdentity)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const auto identity = create_file("identity").string();
+    const char* args[] = {"vault", "info", "--json", "-i", identity.c_str(), vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, info_vault(testing::Eq(vault), testing::Eq(std::optional<std::filesystem::path>(identity)), testing::Eq(true))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCatWithValidArgs)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "cat", vault.c_str(), "inner/file.txt"};
+
+    EXPECT_CALL(*m_vaultManager, cat_vault(testing::Eq(vault), testing::Eq("inner/file.txt"), testing::Eq(0u), testing::Eq(std::nullopt)));
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCatWithRange)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "cat", "--vault", vault.c_str(), "--path", "file.txt", "--offset", "10737418240", "--length", "4096"};
+
+    EXPECT_CALL(*m_vaultManager, cat_vault(testing::Eq(vault), testing::Eq("file.txt"), testing::Eq(10737418240u), testing::Eq(std::optional<std::uint64_t>(4096))));
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCatWithoutPath)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "cat", vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, cat_vault(testing::_, testing::_, testing::_, testing::_)).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteMountWithValidArgs)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const auto mountpoint = create_directory("mountpoint").string();
+    const char* args[] = {"vault", "mount", vault.c_str(), mountpoint.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, mount_vault(testing::Eq(vault), testing::Eq(mountpoint), testing::Eq(VaultFileSystem::DEFAULT_CACHE_SIZE)));
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteMountWithCacheSize)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const auto mountpoint = create_directory("mountpoint").string();
+    const char* args[] = {"vault", "mount", "--vault", vault.c_str(), "--mountpoint", mountpoint.c_str(), "--cache-size", "16"};
+
+    EXPECT_CALL(*m_vaultManager, mount_vault(testing::Eq(vault), testing::Eq(mountpoint), testing::Eq(16u * 1024 * 1024)));
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteMountWithNonExistentMountpoint)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const auto mountpoint = (m_temp_dir / "missing").string();
+    const char* args[] = {"vault", "mount", vault.c_str(), mountpoint.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, mount_vault(testing::_, testing::_, testing::_)).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithMaxMemory)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--max-memory", "512MiB"};
+
+    {
+        testing::InSequence sequence;
+        EXPECT_CALL(*m_vaultManager, set_max_memory(testing::Eq(std::optional<std::uint64_t>(512u * 1024 * 1024))));
+        EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false)));
+    }
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteOpenWithMaxMemoryBeforeSubcommand)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "--max-memory", "1G", "open", vault.c_str()};
+
+    {
+        testing::InSequence sequence;
+        EXPECT_CALL(*m_vaultManager, set_max_memory(testing::Eq(std::optional<std::uint64_t>(1024u * 1024 * 1024))));
+        EXPECT_CALL(*m_vaultManager, open_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(false)));
+    }
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteWithInvalidMaxMemory)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "open", vault.c_str(), "--max-memory", "lots"};
+
+    EXPECT_CALL(*m_vaultManager, open_vault(testing::_, testing::_, testing::_, testing::_, testing::_, testing::_)).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseToStandardOutput)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", "-C", vault.c_str(), "-o", "-"};
+
+    EXPECT_CALL(*m_vaultManager, stream_vault(testing::Eq(vault), testing::Eq(true), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::IsEmpty())).Times(1);
+    EXPECT_CALL(*m_vaultManager, close_vault).Times(0);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseToStandardOutputWithDestination)
+{
+    const auto vault = create_directory("vault").string();
+    const auto destination = create_directory("destination").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "-d", destination.c_str(), "-o", "-"};
+
+    EXPECT_CALL(*m_vaultManager, stream_vault).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseToOutputFile)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "-o", "vault.vlt"};
+
+    EXPECT_CALL(*m_vaultManager, stream_vault).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithVolumeSize)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--volume-size", "4G"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(4ull << 30), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithExcludes)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--exclude", "node_modules/", "--exclude", "*.log"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::ElementsAre("node_modules/", "*.log"), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseKeepSourceWithoutSync)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--keep-source", "--fsync", "none"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::NONE), testing::Eq(SourceRemoval::KEEP), testing::Eq(false), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseRemoveInBackground)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--remove-in-background"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::BACKGROUND), testing::Eq(false), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseKeepSourceRemoveInBackground)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--keep-source", "--remove-in-background"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseResume)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--resume"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(true), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseResumeWithVolumeSize)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--resume", "--volume-size", "4G"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseToStandardOutputWithVolumeSize)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "-o", "-", "--volume-size", "4G"};
+
+    EXPECT_CALL(*m_vaultManager, stream_vault).Times(0);
+    EXPECT_CALL(*m_vaultManager, close_vault).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteOpenOnly)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "open", vault.c_str(), "--only", "config/**", "*.sql"};
+
+    EXPECT_CALL(*m_vaultManager, open_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::ElementsAre("config/**", "*.sql"), testing::Eq(Durability::FULL), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteOpenResume)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "open", vault.c_str(), "--resume"};
+
+    EXPECT_CALL(*m_vaultManager, open_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(true))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteOpenFromStandardInput)
+{
+    const auto destination = create_directory("destination").string();
+    const char* args[] = {"vault", "open", "-", "-d", destination.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, open_vault(testing::Eq(std::filesystem::path("-")), testing::Eq(std::optional<std::filesystem::path>(destination)), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithProgress)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "--progress", "close", vault.c_str()};
+
+    {
+        testing::InSequence sequence;
+        EXPECT_CALL(*m_vaultManager, set_progress_observer(testing::NotNull()));
+        EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false)));
+    }
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteOpenWithStats)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "--stats", "open", vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, open_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+    EXPECT_TRUE(Profiler::enabled());
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithTrace)
+{
+    const auto vault = create_directory("vault").string();
+    const auto trace = (m_temp_dir / "trace.json").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--trace", trace.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(false), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+    EXPECT_TRUE(std::filesystem::exists(trace));
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithKdfParameters)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", "-E", vault.c_str(), "--kdf-memory", "256", "--kdf-iterations", "2", "--kdf-lanes", "8"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(true), testing::Eq(KdfParameters{256 * 1024, 2, 8}), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithKdfParametersWithoutEncryption)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--kdf-memory", "256"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::_, testing::_, testing::_, testing::_, testing::_, testing::_, testing::_, testing::_, testing::Eq(std::nullopt), testing::IsEmpty(), testing::_, testing::_, testing::_, testing::_)).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithCipher)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", "-E", vault.c_str(), "--cipher", "aes-gcm"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(true), testing::Eq(KdfParameters()), testing::Eq(Cipher::AES_256_GCM), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithUseAgent)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", "-E", vault.c_str(), "--use-agent"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(true), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(true))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithUseAgentWithoutEncrypt)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--use-agent"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithUnknownCipher)
+{
+    const auto vault = create_directory("vault").string();
+    const char* args[] = {"vault", "close", "-E", vault.c_str(), "--cipher", "des"};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::_, testing::_, testing::_, testing::_, testing::_, testing::_, testing::_, testing::_, testing::Eq(std::nullopt), testing::IsEmpty(), testing::_, testing::_, testing::_, testing::_)).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteOpenWithIdentity)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const auto identity = create_file("identity").string();
+    const char* args[] = {"vault", "open", vault.c_str(), "--identity", identity.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, open_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(identity), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithRecipients)
+{
+    const auto vault = create_directory("vault").string();
+    const auto first = create_file("first.pub").string();
+    const auto second = create_file("second.pub").string();
+    const char* args[] = {"vault", "close", "-E", vault.c_str(), "--recipient", first.c_str(), "-r", second.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::Eq(vault), testing::Eq(std::nullopt), testing::Eq(std::nullopt), testing::Eq(false), testing::Eq(true), testing::Eq(KdfParameters()), testing::Eq(std::nullopt), testing::ElementsAre(std::filesystem::path(first), std::filesystem::path(second)), testing::Eq(std::nullopt), testing::IsEmpty(), testing::Eq(Durability::FULL), testing::Eq(SourceRemoval::NOW), testing::Eq(false), testing::Eq(false))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCloseWithRecipientsWithoutEncryption)
+{
+    const auto vault = create_directory("vault").string();
+    const auto recipient = create_file("recipient.pub").string();
+    const char* args[] = {"vault", "close", vault.c_str(), "--recipient", recipient.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, close_vault(testing::_, testing::_, testing::_, testing::_, testing::_, testing::_, testing::_, testing::_, testing::Eq(std::nullopt), testing::IsEmpty(), testing::_, testing::_, testing::_, testing::_)).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteKeygen)
+{
+    const auto identity = (m_temp_dir / "identity").string();
+    const char* args[] = {"vault", "keygen", identity.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, generate_identity(testing::Eq(identity))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteCipherBench)
+{
+    const char* args[] = {"vault", "cipher-bench"};
+
+    EXPECT_CALL(*m_vaultManager, benchmark_cipher(testing::_)).Times(static_cast<int>(EncryptionManager::CIPHERS.size())).WillRepeatedly(testing::Return(1e9));
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteKdfBenchWithTarget)
+{
+    const char* args[] = {"vault", "kdf-bench", "--target", "1s"};
+
+    EXPECT_CALL(*m_vaultManager, calibrate_kdf(testing::Eq(std::chrono::milliseconds(1000)))).WillOnce(testing::Return(KdfCalibration{KdfParameters(), std::chrono::milliseconds(900)}));
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteAgentWithTtl)
+{
+    const auto socket = (m_temp_dir / "agent.sock").string();
+    const char* args[] = {"vault", "agent", "--socket", socket.c_str(), "--ttl", "2m"};
+
+    EXPECT_CALL(*m_vaultManager, run_agent(testing::Eq(socket), testing::Eq(std::chrono::seconds(120)))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecuteAgentStop)
+{
+    const auto socket = (m_temp_dir / "agent.sock").string();
+    const char* args[] = {"vault", "agent", "--stop", "-s", socket.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, stop_agent(testing::Eq(socket))).Times(1);
+    EXPECT_CALL(*m_vaultManager, run_agent(testing::_, testing::_)).Times(0);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecutePasswd)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "passwd", vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, passwd_vault(testing::Eq(vault), testing::Eq(KeySlotAction::CHANGE))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecutePasswdAdd)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "passwd", "--add", vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, passwd_vault(testing::Eq(vault), testing::Eq(KeySlotAction::ADD))).Times(1);
+
+    init(args);
+
+    EXPECT_EQ(m_app->execute(), EXIT_SUCCESS);
+}
+
+TEST_F(ApplicationTest, ExecutePasswdAddAndRemove)
+{
+    const auto vault = create_file("vault.vlt").string();
+    const char* args[] = {"vault", "passwd", "-a", "-r", vault.c_str()};
+
+    EXPECT_CALL(*m_vaultManager, passwd_vault(testing::_, testing::_)).Times(0);
+
+    init(args);
+
+    EXPECT_NE(m_app->execute(), EXIT_SUCCESS);
+}
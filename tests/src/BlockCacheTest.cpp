@@ -0,0 +1,64 @@
+#include "BlockCache.h"
+
+#include <gtest/gtest.h>
+
+namespace
+{
+    BlockCache::Data block(const size_t size, const std::uint8_t value)
+    {
+        return BlockCache::Data(size, value);
+    }
+}
+
+TEST(BlockCache, GetLoadsOnce)
+{
+    BlockCache cache(1024);
+    int loads = 0;
+    const auto load = [&] { ++loads; return block(16, 1); };
+
+    const auto first = cache.get(0, load);
+    const auto second = cache.get(0, load);
+
+    ASSERT_EQ(loads, 1);
+    ASSERT_EQ(first, second);
+    ASSERT_EQ(cache.size(), 16u);
+}
+
+TEST(BlockCache, EvictLeastRecentlyUsed)
+{
+    BlockCache cache(32);
+    int loads = 0;
+
+    (void)cache.get(0, [&] { ++loads; return block(16, 0); });
+    (void)cache.get(1, [&] { ++loads; return block(16, 1); });
+    (void)cache.get(0, [&] { ++loads; return block(16, 0); });
+    (void)cache.get(2, [&] { ++loads; return block(16, 2); });
+    ASSERT_EQ(loads, 3);
+    ASSERT_EQ(cache.size(), 32u);
+
+    (void)cache.get(0, [&] { ++loads; return block(16, 0); });
+    ASSERT_EQ(loads, 3) << "The most recently used block must stay cached";
+    (void)cache.get(1, [&] { ++loads; return block(16, 1); });
+    ASSERT_EQ(loads, 4) << "The least recently used block must have been evicted";
+}
+
+TEST(BlockCache, BlockLargerThanCapacity)
+{
+    BlockCache cache(8);
+    int loads = 0;
+
+    const auto data = cache.get(0, [&] { ++loads; return block(16, 3); });
+    (void)cache.get(0, [&] { ++loads; return block(16, 3); });
+
+    ASSERT_EQ(data->size(), 16u);
+    ASSERT_EQ(loads, 2);
+    ASSERT_EQ(cache.size(), 0u);
+}
+
+TEST(BlockCache, InvalidLoad)
+{
+    BlockCache cache(1024);
+
+    ASSERT_THROW((void)cache.get(0, []() -> BlockCache::Data { throw std::runtime_error("Corrupted"); }), std::runtime_error);
+    ASSERT_EQ(cache.size(), 0u);
+}
@@ -0,0 +1,43 @@
+#include "ChecksumManager.h"
+
+#include <gtest/gtest.h>
+
+TEST(ChecksumManager, ComputeIsDeterministic)
+{
+    const ChecksumManager::Data data = {'H', 'e', 'l', 'l', 'o'};
+    ASSERT_EQ(ChecksumManager::compute(data), ChecksumManager::compute(data));
+}
+
+TEST(ChecksumManager, ComputeHexDigest)
+{
+    const ChecksumManager::Data data = {'H', 'e', 'l', 'l', 'o'};
+    const auto checksum = ChecksumManager::compute(data);
+    ASSERT_EQ(checksum.size(), 64u);
+    ASSERT_TRUE(std::ranges::all_of(checksum, [](const char c) { return std::isxdigit(c) && !std::isupper(c); }));
+}
+
+TEST(ChecksumManager, ComputeEmptyData)
+{
+    const ChecksumManager::Data data;
+    ASSERT_FALSE(ChecksumManager::compute(data).empty());
+}
+
+TEST(ChecksumManager, MatchesValidData)
+{
+    const ChecksumManager::Data data = {'H', 'e', 'l', 'l', 'o'};
+    ASSERT_TRUE(ChecksumManager::matches(data, ChecksumManager::compute(data)));
+}
+
+TEST(ChecksumManager, MatchesModifiedData)
+{
+    ChecksumManager::Data data = {'H', 'e', 'l', 'l', 'o'};
+    const auto checksum = ChecksumManager::compute(data);
+    data[0] ^= 0xFF;
+    ASSERT_FALSE(ChecksumManager::matches(data, checksum));
+}
+
+TEST(ChecksumManager, InvalidAlgorithm)
+{
+    const ChecksumManager::Data data = {'H', 'e', 'l', 'l', 'o'};
+    ASSERT_ANY_THROW(auto _ = ChecksumManager::compute(data, "NotAHash"));
+}
@@ -0,0 +1,72 @@
+#include "DirectoryWatcher.h"
+
+#include <fstream>
+#include <gtest/gtest.h>
+
+#if defined(__linux__)
+class DirectoryWatcherTest : public testing::Test
+{
+protected:
+    std::filesystem::path m_temp_dir;
+
+    void write_file(const std::string& name, const std::string& content) const
+    {
+        std::ofstream((m_temp_dir / name).string()) << content;
+    }
+
+    void SetUp() override
+    {
+        m_temp_dir = std::filesystem::temp_directory_path() / "vault_watcher_test_directory";
+        std::filesystem::remove_all(m_temp_dir);
+        std::filesystem::create_directories(m_temp_dir / "inner");
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_temp_dir);
+    }
+};
+
+TEST_F(DirectoryWatcherTest, ReportsABurstOfChangesOnce)
+{
+    DirectoryWatcher watcher(m_temp_dir, std::chrono::milliseconds(200));
+    write_file("inner/file.txt", "Content of file.txt");
+    write_file("file.txt", "Content of file.txt");
+    std::filesystem::create_directories(m_temp_dir / "new/deep");
+    write_file("new/deep/file.txt", "Content of new/deep/file.txt");
+
+    const auto changed = watcher.wait(std::chrono::seconds(5));
+
+    // The entries below a new directory are scanned with it.
+    EXPECT_EQ(changed, (std::vector<std::filesystem::path>{"file.txt", "inner/file.txt", "new"}));
+    EXPECT_TRUE(watcher.wait(std::chrono::milliseconds(300)).empty());
+}
+
+TEST_F(DirectoryWatcherTest, WatchesTheNewDirectories)
+{
+    DirectoryWatcher watcher(m_temp_dir, std::chrono::milliseconds(100));
+    std::filesystem::create_directories(m_temp_dir / "new/deep");
+    ASSERT_EQ(watcher.wait(std::chrono::seconds(5)), std::vector<std::filesystem::path>{"new"});
+
+    write_file("new/deep/file.txt", "Content of new/deep/file.txt");
+    EXPECT_EQ(watcher.wait(std::chrono::seconds(5)), std::vector<std::filesystem::path>{"new/deep/file.txt"});
+
+    std::filesystem::rename(m_temp_dir / "new", m_temp_dir / "inner/moved");
+    EXPECT_EQ(watcher.wait(std::chrono::seconds(5)), (std::vector<std::filesystem::path>{"inner/moved", "new"}));
+    write_file("inner/moved/deep/file.txt", "Changed");
+    EXPECT_EQ(watcher.wait(std::chrono::seconds(5)), std::vector<std::filesystem::path>{"inner/moved/deep/file.txt"});
+}
+
+TEST_F(DirectoryWatcherTest, WaitsForTheTimeoutWithoutChange)
+{
+    DirectoryWatcher watcher(m_temp_dir);
+
+    EXPECT_TRUE(watcher.wait(std::chrono::milliseconds(50)).empty());
+}
+
+TEST_F(DirectoryWatcherTest, MissingDirectory)
+{
+    EXPECT_THROW(DirectoryWatcher(m_temp_dir / "missing"), std::invalid_argument);
+    EXPECT_THROW(DirectoryWatcher(m_temp_dir, std::chrono::milliseconds(0)), std::invalid_argument);
+}
+#endif
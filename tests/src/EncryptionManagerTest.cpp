@@ -123,3 +123,64 @@ TEST_F(EncryptionManagerTest, NonRandomDataEncryptionDecryption)
 
     EXPECT_EQ(decrypted_data, known_data) << "Decrypted known data should match original.";
 }
+
+TEST_F(EncryptionManagerTest, KdfParametersChangeTheKey)
+{
+    const KdfParameters parameters{1024, 1, 1};
+    const auto key = EncryptionManager::derive_key(password, salt, parameters);
+
+    EXPECT_EQ(EncryptionManager::derive_key(password, salt, parameters), key);
+    EXPECT_NE(EncryptionManager::derive_key(password, salt, {2048, 1, 1}), key);
+    EXPECT_NE(EncryptionManager::derive_key(password, salt, {1024, 2, 1}), key);
+    EXPECT_NE(EncryptionManager::derive_key(password, salt, {1024, 1, 2}), key);
+}
+
+TEST_F(EncryptionManagerTest, InvalidKdfParameters)
+{
+    EXPECT_THROW(EncryptionManager::validate({1024, 0, 1}), std::invalid_argument);
+    EXPECT_THROW(EncryptionManager::validate({1024, 1, 0}), std::invalid_argument);
+    EXPECT_THROW(EncryptionManager::validate({8, 1, 4}), std::invalid_argument);
+    EXPECT_THROW(EncryptionManager::validate({EncryptionManager::MAX_KDF_MEMORY + 1, 1, 1}), std::invalid_argument);
+    EXPECT_THROW(EncryptionManager::validate({1024, 1, EncryptionManager::MAX_KDF_LANES + 1}), std::invalid_argument);
+    EXPECT_NO_THROW(EncryptionManager::validate(KdfParameters()));
+    EXPECT_NO_THROW(EncryptionManager::validate(EncryptionManager::legacy_kdf_parameters()));
+}
+
+TEST_F(EncryptionManagerTest, CalibrateStaysWithinMemoryLimit)
+{
+    const auto [parameters, duration] = EncryptionManager::calibrate(std::chrono::milliseconds(1), 1024);
+
+    EXPECT_NO_THROW(EncryptionManager::validate(parameters));
+    EXPECT_LE(parameters.memory, std::max<std::uint32_t>(1024, 8 * parameters.lanes));
+    EXPECT_GE(parameters.iterations, 1u);
+}
+
+TEST_F(EncryptionManagerTest, EveryCipherRoundTrips)
+{
+    const auto data = generate_random_data(1024);
+    const auto key = EncryptionManager::generate_key();
+    for (const auto cipher : EncryptionManager::CIPHERS)
+    {
+        auto [encrypted_data, nonce] = EncryptionManager::encrypt(data, key, {}, cipher);
+
+        EXPECT_EQ(nonce.size(), EncryptionManager::nonce_size(cipher));
+        EXPECT_EQ(EncryptionManager::decrypt(std::move(encrypted_data), key, nonce, {}, cipher), data);
+    }
+}
+
+TEST_F(EncryptionManagerTest, WrongCipherFailsDecryption)
+{
+    const auto data = generate_random_data(1024);
+    const auto key = EncryptionManager::generate_key();
+    auto [encrypted_data, nonce] = EncryptionManager::encrypt(data, key, {}, Cipher::AES_256_GCM);
+
+    EXPECT_THROW(static_cast<void>(EncryptionManager::decrypt(std::move(encrypted_data), key, nonce, {}, Cipher::CHACHA20_POLY1305)), std::exception);
+}
+
+TEST_F(EncryptionManagerTest, CipherNames)
+{
+    for (const auto cipher : EncryptionManager::CIPHERS)
+        EXPECT_EQ(EncryptionManager::find_cipher(EncryptionManager::cipher_name(cipher)), cipher);
+    EXPECT_EQ(EncryptionManager::find_cipher("none"), std::nullopt);
+    EXPECT_EQ(EncryptionManager::preferred_cipher(), EncryptionManager::has_hardware_aes() ? Cipher::AES_256_GCM : Cipher::CHACHA20_POLY1305);
+}
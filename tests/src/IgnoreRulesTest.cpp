@@ -0,0 +1,63 @@
+#include "IgnoreRules.h"
+
+#include <gtest/gtest.h>
+
+TEST(IgnoreRulesTest, MatchWildcards)
+{
+    EXPECT_TRUE(IgnoreRules::match("*.log", "debug.log"));
+    EXPECT_FALSE(IgnoreRules::match("*.log", "logs/debug.log"));
+    EXPECT_TRUE(IgnoreRules::match("file?.txt", "file2.txt"));
+    EXPECT_FALSE(IgnoreRules::match("file?.txt", "file.txt"));
+    EXPECT_TRUE(IgnoreRules::match("file[0-9].txt", "file2.txt"));
+    EXPECT_FALSE(IgnoreRules::match("file[!0-9].txt", "file2.txt"));
+    EXPECT_TRUE(IgnoreRules::match("file[!0-9].txt", "fileA.txt"));
+    EXPECT_TRUE(IgnoreRules::match("\\*.txt", "*.txt"));
+    EXPECT_FALSE(IgnoreRules::match("\\*.txt", "a.txt"));
+}
+
+TEST(IgnoreRulesTest, MatchDoubleAsterisk)
+{
+    EXPECT_TRUE(IgnoreRules::match("**/build", "build"));
+    EXPECT_TRUE(IgnoreRules::match("**/build", "a/b/build"));
+    EXPECT_TRUE(IgnoreRules::match("a/**/b", "a/b"));
+    EXPECT_TRUE(IgnoreRules::match("a/**/b", "a/x/y/b"));
+    EXPECT_FALSE(IgnoreRules::match("a/**/b", "a/xb"));
+    EXPECT_TRUE(IgnoreRules::match("cache/**", "cache/a/b"));
+    EXPECT_FALSE(IgnoreRules::match("cache/**", "cache"));
+}
+
+TEST(IgnoreRulesTest, ExcludeLikeGitignore)
+{
+    IgnoreRules rules;
+    rules.add("# comment");
+    rules.add("");
+    rules.add("node_modules/");
+    rules.add("*.log  ");
+    rules.add("!keep.log");
+    rules.add("/build");
+    rules.add("docs/*.pdf");
+
+    EXPECT_EQ(rules.excluded("node_modules", true), true);
+    EXPECT_EQ(rules.excluded("web/node_modules", true), true);
+    EXPECT_FALSE(rules.excluded("node_modules", false).has_value());
+    EXPECT_EQ(rules.excluded("src/debug.log", false), true);
+    EXPECT_EQ(rules.excluded("src/keep.log", false), false);
+    EXPECT_EQ(rules.excluded("build", true), true);
+    EXPECT_FALSE(rules.excluded("src/build", true).has_value());
+    EXPECT_EQ(rules.excluded("docs/manual.pdf", false), true);
+    EXPECT_FALSE(rules.excluded("docs/api/manual.pdf", false).has_value());
+    EXPECT_FALSE(rules.excluded("README.md", false).has_value());
+}
+
+TEST(IgnoreRulesTest, ExcludeBelowBase)
+{
+    IgnoreRules rules;
+    rules.add("/out", "project");
+    rules.add("*.tmp", "project");
+
+    EXPECT_EQ(rules.excluded("project/out", true), true);
+    EXPECT_EQ(rules.excluded("project/src/a.tmp", false), true);
+    EXPECT_FALSE(rules.excluded("out", true).has_value());
+    EXPECT_FALSE(rules.excluded("a.tmp", false).has_value());
+    EXPECT_FALSE(rules.excluded("project2/a.tmp", false).has_value());
+}
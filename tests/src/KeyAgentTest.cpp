@@ -0,0 +1,114 @@
+#include "KeyAgent.h"
+
+#include <thread>
+#include <gtest/gtest.h>
+
+#if !defined(_WIN32)
+class KeyAgentTest : public testing::Test
+{
+protected:
+    std::filesystem::path m_temp_dir;
+    std::filesystem::path m_socket;
+    std::unique_ptr<KeyAgent> m_agent;
+    std::thread m_thread;
+
+    void start(const std::chrono::seconds ttl = KeyAgent::DEFAULT_TTL)
+    {
+        m_agent = std::make_unique<KeyAgent>(m_socket, ttl);
+        m_thread = std::thread([this] { m_agent->run(); });
+    }
+
+    [[nodiscard]] static KeyAgent::Entry make_entry()
+    {
+        return {EncryptionManager::generate_new_salt(), KdfParameters{1024, 1, 1}, EncryptionManager::Key(32, 0x42)};
+    }
+
+    void SetUp() override
+    {
+        m_temp_dir = std::filesystem::temp_directory_path() / "vault_agent_test_directory";
+        std::filesystem::remove_all(m_temp_dir);
+        std::filesystem::create_directory(m_temp_dir);
+        m_socket = m_temp_dir / "agent.sock";
+    }
+
+    void TearDown() override
+    {
+        if (m_thread.joinable())
+        {
+            KeyAgent::stop(m_socket);
+            m_thread.join();
+        }
+        m_agent.reset();
+        std::filesystem::remove_all(m_temp_dir);
+    }
+};
+
+TEST_F(KeyAgentTest, StoredKeysAreServedBySaltAndVault)
+{
+    start();
+    const auto entry = make_entry();
+
+    ASSERT_TRUE(KeyAgent::put(m_socket, "/vaults/a.vlt", entry));
+
+    const auto key = KeyAgent::get(m_socket, entry.salt, entry.kdf);
+    ASSERT_TRUE(key.has_value());
+    EXPECT_EQ(*key, entry.key);
+
+    const auto found = KeyAgent::find(m_socket, "/vaults/a.vlt");
+    ASSERT_TRUE(found.has_value());
+    EXPECT_EQ(found->salt, entry.salt);
+    EXPECT_EQ(found->kdf, entry.kdf);
+    EXPECT_EQ(found->key, entry.key);
+
+    EXPECT_FALSE(KeyAgent::find(m_socket, "/vaults/b.vlt").has_value());
+}
+
+TEST_F(KeyAgentTest, KeysAreOnlyServedForTheirKdfParameters)
+{
+    start();
+    const auto entry = make_entry();
+
+    ASSERT_TRUE(KeyAgent::put(m_socket, "/vaults/a.vlt", entry));
+
+    EXPECT_FALSE(KeyAgent::get(m_socket, entry.salt, {2048, 1, 1}).has_value());
+    EXPECT_FALSE(KeyAgent::get(m_socket, EncryptionManager::generate_new_salt(), entry.kdf).has_value());
+}
+
+TEST_F(KeyAgentTest, ExpiredKeysAreForgotten)
+{
+    start(std::chrono::seconds(0));
+    const auto entry = make_entry();
+
+    ASSERT_TRUE(KeyAgent::put(m_socket, "/vaults/a.vlt", entry));
+
+    EXPECT_FALSE(KeyAgent::get(m_socket, entry.salt, entry.kdf).has_value());
+    EXPECT_FALSE(KeyAgent::find(m_socket, "/vaults/a.vlt").has_value());
+}
+
+TEST_F(KeyAgentTest, NoAgentListening)
+{
+    const auto entry = make_entry();
+
+    EXPECT_FALSE(KeyAgent::put(m_socket, "/vaults/a.vlt", entry));
+    EXPECT_FALSE(KeyAgent::get(m_socket, entry.salt, entry.kdf).has_value());
+    EXPECT_FALSE(KeyAgent::stop(m_socket));
+}
+
+TEST_F(KeyAgentTest, SecondAgentOnTheSameSocket)
+{
+    start();
+
+    EXPECT_THROW({ KeyAgent agent(m_socket); }, std::runtime_error);
+}
+
+TEST_F(KeyAgentTest, StopRemovesTheSocket)
+{
+    start();
+
+    ASSERT_TRUE(KeyAgent::stop(m_socket));
+    m_thread.join();
+    m_agent.reset();
+
+    EXPECT_FALSE(std::filesystem::exists(m_socket));
+}
+#endif
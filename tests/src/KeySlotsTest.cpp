@@ -0,0 +1,87 @@
+#include "KeySlots.h"
+
+#include <sstream>
+#include <gtest/gtest.h>
+
+class KeySlotsTest : public testing::Test
+{
+protected:
+    KdfParameters m_kdf{1024, 1, 1};
+    EncryptionManager::Key m_dataKey = EncryptionManager::generate_key();
+
+    [[nodiscard]] static EncryptionManager::Key password_key(const std::string& password, const EncryptionManager::Salt& salt, const KdfParameters& kdf)
+    {
+        return EncryptionManager::derive_key(EncryptionManager::Password(password.begin(), password.end()), salt, kdf);
+    }
+};
+
+TEST_F(KeySlotsTest, UnlockWithTheRightPassword)
+{
+    KeySlots keySlots;
+    const auto salt = EncryptionManager::generate_new_salt();
+    const auto index = keySlots.add(m_dataKey, salt, m_kdf, password_key("password", salt, m_kdf));
+
+    const auto dataKey = keySlots.unlock(index, password_key("password", salt, m_kdf));
+    ASSERT_TRUE(dataKey.has_value());
+    EXPECT_EQ(*dataKey, m_dataKey);
+    EXPECT_FALSE(keySlots.unlock(index, password_key("wrong", salt, m_kdf)).has_value());
+}
+
+TEST_F(KeySlotsTest, SerializationRoundTrip)
+{
+    KeySlots keySlots;
+    const auto first = EncryptionManager::generate_new_salt();
+    const auto second = EncryptionManager::generate_new_salt();
+    keySlots.add(m_dataKey, first, m_kdf, password_key("first", first, m_kdf));
+    const auto index = keySlots.add(m_dataKey, second, {2048, 2, 1}, password_key("second", second, {2048, 2, 1}));
+    keySlots.remove(0);
+
+    std::ostringstream stream;
+    keySlots.write(stream);
+    const auto str = stream.str();
+    ASSERT_EQ(str.size(), KeySlots::SIZE);
+
+    const KeySlots read(std::span(reinterpret_cast<const std::uint8_t*>(str.data()), str.size()));
+    EXPECT_EQ(read.active(), std::vector<size_t>{index});
+    EXPECT_EQ(read.slot(index).salt, second);
+    EXPECT_EQ(read.slot(index).kdf, (KdfParameters{2048, 2, 1}));
+    EXPECT_EQ(read.unlock(index, password_key("second", second, {2048, 2, 1})), m_dataKey);
+}
+
+TEST_F(KeySlotsTest, AlteredSlotDoesNotUnlock)
+{
+    KeySlots keySlots;
+    const auto salt = EncryptionManager::generate_new_salt();
+    keySlots.add(m_dataKey, salt, m_kdf, password_key("password", salt, m_kdf));
+
+    std::ostringstream stream;
+    keySlots.write(stream);
+    auto str = stream.str();
+    str[sizeof(std::uint32_t) + 16] ^= 0x01;
+
+    const KeySlots read(std::span(reinterpret_cast<const std::uint8_t*>(str.data()), str.size()));
+    const auto& slot = read.slot(0);
+    EXPECT_FALSE(read.unlock(0, password_key("password", slot.salt, slot.kdf)).has_value());
+}
+
+TEST_F(KeySlotsTest, AllSlotsInUse)
+{
+    KeySlots keySlots;
+    const auto salt = EncryptionManager::generate_new_salt();
+    const auto passwordKey = password_key("password", salt, m_kdf);
+    for (size_t i = 0; i < KeySlots::COUNT; ++i)
+        EXPECT_EQ(keySlots.add(m_dataKey, salt, m_kdf, passwordKey), i);
+
+    EXPECT_THROW(keySlots.add(m_dataKey, salt, m_kdf, passwordKey), std::runtime_error);
+    keySlots.remove(3);
+    EXPECT_EQ(keySlots.add(m_dataKey, salt, m_kdf, passwordKey), 3u);
+}
+
+TEST_F(KeySlotsTest, RemoveUnusedSlot)
+{
+    KeySlots keySlots;
+
+    EXPECT_THROW(keySlots.remove(0), std::invalid_argument);
+    EXPECT_THROW(keySlots.remove(KeySlots::COUNT), std::invalid_argument);
+    EXPECT_THROW(static_cast<void>(keySlots.slot(0)), std::invalid_argument);
+}
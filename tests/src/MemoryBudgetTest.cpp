@@ -0,0 +1,78 @@
+#include "MemoryBudget.h"
+
+#include <thread>
+#include <gtest/gtest.h>
+
+TEST(MemoryBudget, Unlimited)
+{
+    const MemoryBudget budget;
+
+    ASSERT_FALSE(budget.limit().has_value());
+    ASSERT_EQ(budget.threads(), std::max<size_t>(std::thread::hardware_concurrency(), 1));
+    ASSERT_EQ(budget.cache_size(1234), 1234u);
+}
+
+TEST(MemoryBudget, ThreadsFitTheBudget)
+{
+    const MemoryBudget budget(MemoryBudget::BASE_MEMORY + MemoryBudget::WORKER_MEMORY);
+
+    ASSERT_EQ(budget.threads(), 1u);
+    ASSERT_EQ(budget.cache_size(64 * 1024 * 1024), 0u);
+}
+
+TEST(MemoryBudget, CacheSizeFitsTheBudget)
+{
+    const MemoryBudget budget(MemoryBudget::BASE_MEMORY + 1024 * MemoryBudget::WORKER_MEMORY);
+    const auto remaining = 1024 * MemoryBudget::WORKER_MEMORY - budget.threads() * MemoryBudget::WORKER_MEMORY;
+
+    ASSERT_EQ(budget.cache_size(1024), 1024u);
+    ASSERT_EQ(budget.cache_size(remaining + 1), remaining);
+}
+
+TEST(MemoryBudget, PeakRss)
+{
+    ASSERT_GT(MemoryBudget::peak_rss(), 0u);
+}
+
+TEST(MemoryBudget, Format)
+{
+    ASSERT_EQ(MemoryBudget::format(512 * 1024 * 1024), "512.0 MiB");
+    ASSERT_EQ(MemoryBudget::format(1536 * 1024), "1.5 MiB");
+}
+
+TEST(MemoryBudget, KeyDerivationFitsTheBudget)
+{
+    const MemoryBudget budget(MemoryBudget::BASE_MEMORY + 64 * 1024 * 1024);
+
+    ASSERT_EQ(MemoryBudget().kdf_memory(), EncryptionManager::MAX_KDF_MEMORY);
+    ASSERT_EQ(budget.kdf_memory(), 64u * 1024);
+    ASSERT_NO_THROW(budget.check({64 * 1024, 3, 4}));
+    ASSERT_THROW(budget.check({64 * 1024 + 1, 3, 4}), std::invalid_argument);
+}
+
+TEST(MemoryBudget, InvalidTooSmallBudget)
+{
+    ASSERT_THROW(MemoryBudget(MemoryBudget::BASE_MEMORY), std::invalid_argument);
+}
+
+TEST(MemoryBudget, SharedByOperations)
+{
+    const MemoryBudget budget(4 * (MemoryBudget::BASE_MEMORY + MemoryBudget::WORKER_MEMORY));
+
+    ASSERT_EQ(budget.operations(8), 4u);
+    ASSERT_EQ(budget.operations(2), 2u);
+    const auto shared = budget.share(4);
+    ASSERT_EQ(shared.limit(), MemoryBudget::BASE_MEMORY + MemoryBudget::WORKER_MEMORY);
+    ASSERT_EQ(shared.threads(), 1u);
+    ASSERT_THROW(static_cast<void>(budget.share(8)), std::invalid_argument);
+}
+
+TEST(MemoryBudget, UnlimitedSharesTheProcessors)
+{
+    const MemoryBudget budget;
+    const auto processors = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    ASSERT_EQ(budget.operations(16), 16u);
+    ASSERT_FALSE(budget.share(2).limit().has_value());
+    ASSERT_EQ(budget.share(2).threads(), std::max<size_t>(processors / 2, 1));
+}
@@ -0,0 +1,122 @@
+#include "MerkleTree.h"
+#include "ChecksumManager.h"
+
+#include <sstream>
+#include <gtest/gtest.h>
+
+namespace
+{
+    std::vector<BlockInfo> build_tree(MerkleTree& tree, const std::uint64_t count)
+    {
+        std::vector<BlockInfo> blocks;
+        for (std::uint64_t i = 0; i < count; ++i)
+        {
+            BlockInfo block{i, 16 + i * 32, 32, 32, ChecksumManager::compute(ChecksumManager::Data(32, static_cast<std::uint8_t>(i)))};
+            tree.add(block);
+            blocks.push_back(block);
+        }
+        return blocks;
+    }
+
+    std::vector<std::uint8_t> serialize(const MerkleTree& tree)
+    {
+        std::ostringstream stream;
+        const auto written = tree.write(stream);
+        const auto str = stream.str();
+        EXPECT_EQ(written, str.size());
+        EXPECT_EQ(written, tree.size());
+        return {str.begin(), str.end()};
+    }
+}
+
+TEST(MerkleTree, VerifyEveryLeaf)
+{
+    for (std::uint64_t count = 1; count <= 9; ++count)
+    {
+        MerkleTree tree(ChecksumManager::ALGORITHM);
+        const auto blocks = build_tree(tree, count);
+        const auto serialized = serialize(tree);
+        const auto root = tree.root();
+
+        ASSERT_EQ(tree.leaves(), count);
+        ASSERT_EQ(serialized.size(), MerkleTree::serialized_size(count, root.size()));
+        for (const auto& block : blocks)
+            EXPECT_TRUE(MerkleTree::verify(block, serialized, count, root, ChecksumManager::ALGORITHM)) << "Leaf " << block.id << " of " << count;
+    }
+}
+
+TEST(MerkleTree, RootDependsOnEveryLeaf)
+{
+    MerkleTree tree(ChecksumManager::ALGORITHM);
+    auto blocks = build_tree(tree, 5);
+    blocks[4].offset += 1;
+    MerkleTree other(ChecksumManager::ALGORITHM);
+    for (const auto& block : blocks)
+        other.add(block);
+
+    ASSERT_NE(tree.root(), other.root());
+}
+
+TEST(MerkleTree, ContinueFromLeaves)
+{
+    MerkleTree tree(ChecksumManager::ALGORITHM);
+    build_tree(tree, 5);
+    const auto serialized = serialize(tree);
+    MerkleTree continued(ChecksumManager::ALGORITHM, std::span(serialized).first(5 * tree.root().size()));
+    ASSERT_EQ(continued.leaves(), 5u);
+    ASSERT_EQ(continued.root(), tree.root());
+
+    const BlockInfo block{5, 1000, 32, 32, ChecksumManager::compute(ChecksumManager::Data(32, 5))};
+    tree.add(block);
+    continued.add(block);
+    ASSERT_EQ(continued.root(), tree.root());
+    ASSERT_THROW(MerkleTree(ChecksumManager::ALGORITHM, std::span(serialized).first(5)), std::runtime_error);
+}
+
+TEST(MerkleTree, EmptyTree)
+{
+    const MerkleTree tree(ChecksumManager::ALGORITHM);
+
+    ASSERT_EQ(tree.leaves(), 0u);
+    ASSERT_FALSE(tree.root().empty());
+    ASSERT_TRUE(serialize(tree).empty());
+}
+
+TEST(MerkleTree, InvalidVerifyTamperedBlock)
+{
+    MerkleTree tree(ChecksumManager::ALGORITHM);
+    auto blocks = build_tree(tree, 6);
+    const auto serialized = serialize(tree);
+    const auto root = tree.root();
+
+    blocks[3].storedSize += 1;
+    EXPECT_FALSE(MerkleTree::verify(blocks[3], serialized, 6, root, ChecksumManager::ALGORITHM));
+    blocks[2].checksum[0] = blocks[2].checksum[0] == '0' ? '1' : '0';
+    EXPECT_FALSE(MerkleTree::verify(blocks[2], serialized, 6, root, ChecksumManager::ALGORITHM));
+    blocks[1].id = 0;
+    EXPECT_FALSE(MerkleTree::verify(blocks[1], serialized, 6, root, ChecksumManager::ALGORITHM));
+}
+
+TEST(MerkleTree, InvalidVerifyTamperedTree)
+{
+    MerkleTree tree(ChecksumManager::ALGORITHM);
+    const auto blocks = build_tree(tree, 4);
+    auto serialized = serialize(tree);
+    const auto root = tree.root();
+
+    serialized[root.size()] ^= 0xFF;
+    EXPECT_FALSE(MerkleTree::verify(blocks[0], serialized, 4, root, ChecksumManager::ALGORITHM));
+    EXPECT_TRUE(MerkleTree::verify(blocks[2], serialized, 4, root, ChecksumManager::ALGORITHM)) << "Only the proofs using the tampered node are affected";
+}
+
+TEST(MerkleTree, InvalidVerifyOutOfRange)
+{
+    MerkleTree tree(ChecksumManager::ALGORITHM);
+    auto blocks = build_tree(tree, 3);
+    const auto serialized = serialize(tree);
+    const auto root = tree.root();
+
+    blocks[2].id = 3;
+    EXPECT_FALSE(MerkleTree::verify(blocks[2], serialized, 3, root, ChecksumManager::ALGORITHM));
+    EXPECT_FALSE(MerkleTree::verify(blocks[0], std::span(serialized).first(serialized.size() - 1), 3, root, ChecksumManager::ALGORITHM));
+}
@@ -0,0 +1,83 @@
+#include "Profiler.h"
+
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <gtest/gtest.h>
+
+class ProfilerTest : public testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        Profiler::reset();
+    }
+};
+
+TEST_F(ProfilerTest, DisabledByDefault)
+{
+    {
+        const Profiler::Scope scope("disabled");
+    }
+    Profiler::count(Profiler::Counter::BYTES_READ, 42);
+
+    std::ostringstream summary;
+    Profiler::print_summary(summary);
+
+    ASSERT_FALSE(Profiler::enabled());
+    ASSERT_EQ(Profiler::counter(Profiler::Counter::BYTES_READ), 0u);
+    ASSERT_EQ(summary.str().find("disabled"), std::string::npos);
+}
+
+TEST_F(ProfilerTest, ScopesAndCountersAreAggregated)
+{
+    Profiler::enable();
+    for (int i = 0; i < 3; ++i)
+        const Profiler::Scope scope("phase");
+    std::thread([] { Profiler::count(Profiler::Counter::FILES, 2); }).join();
+    Profiler::count(Profiler::Counter::FILES);
+
+    std::ostringstream summary;
+    Profiler::print_summary(summary);
+
+    ASSERT_EQ(Profiler::counter(Profiler::Counter::FILES), 3u);
+    ASSERT_NE(summary.str().find("phase"), std::string::npos);
+    ASSERT_NE(summary.str().find("files: 3"), std::string::npos);
+}
+
+TEST_F(ProfilerTest, ReportsAllocationsOnlyWhenCounted)
+{
+    // Only the vault executable replaces the global operator new, the tests keep the default one.
+    ASSERT_FALSE(Profiler::counts_allocations());
+    Profiler::enable();
+    std::ostringstream summary;
+    Profiler::print_summary(summary);
+    Profiler::count_allocations();
+    Profiler::count(Profiler::Counter::ALLOCATIONS, 5);
+    std::ostringstream counted;
+    Profiler::print_summary(counted);
+    Profiler::count_allocations(false);
+
+    ASSERT_EQ(summary.str().find("allocations"), std::string::npos);
+    ASSERT_NE(counted.str().find("allocations: 5"), std::string::npos);
+}
+
+TEST_F(ProfilerTest, WriteTrace)
+{
+    const auto path = std::filesystem::temp_directory_path() / "vault_profiler_test.json";
+    Profiler::enable(true);
+    {
+        const Profiler::Scope scope("traced");
+    }
+    Profiler::count(Profiler::Counter::BYTES_WRITTEN, 7);
+    Profiler::write_trace(path);
+
+    std::ifstream file(path);
+    const std::string trace((std::istreambuf_iterator(file)), std::istreambuf_iterator<char>());
+    file.close();
+    std::filesystem::remove(path);
+
+    ASSERT_TRUE(trace.starts_with("{\"traceEvents\":["));
+    ASSERT_NE(trace.find("\"name\":\"traced\",\"cat\":\"vault\",\"ph\":\"X\""), std::string::npos);
+    ASSERT_NE(trace.find("\"bytes_written\":7"), std::string::npos);
+}
@@ -0,0 +1,92 @@
+#include "ProgressBar.h"
+
+#include <sstream>
+#include <thread>
+#include <vector>
+#include <gtest/gtest.h>
+
+class RecordingObserver final : public ProgressObserver
+{
+public:
+    std::vector<Progress> updates;
+
+    void on_progress(const Progress& progress) override
+    {
+        updates.push_back(progress);
+    }
+};
+
+TEST(ProgressTracker, UpdatesAreThrottled)
+{
+    RecordingObserver observer;
+    ProgressTracker tracker(observer);
+
+    tracker.start(ProgressPhase::STORING, 1000, 1000);
+    for (int i = 0; i < 1000; ++i)
+        tracker.add(1, 1, 2);
+    tracker.finish();
+
+    ASSERT_FALSE(observer.updates.empty());
+    ASSERT_LT(observer.updates.size(), 1000u);
+    const auto& last = observer.updates.back();
+    ASSERT_TRUE(last.finished);
+    ASSERT_EQ(last.phase, ProgressPhase::STORING);
+    ASSERT_EQ(last.entries, 1000u);
+    ASSERT_EQ(last.bytesIn, 1000u);
+    ASSERT_EQ(last.bytesOut, 2000u);
+    ASSERT_EQ(last.totalBytes, 1000u);
+}
+
+TEST(ProgressTracker, NotifiesWhileRunning)
+{
+    RecordingObserver observer;
+    ProgressTracker tracker(observer);
+
+    tracker.start(ProgressPhase::EXTRACTING, 2, 2);
+    tracker.add(1, 0, 1);
+    std::this_thread::sleep_for(ProgressTracker::INTERVAL + std::chrono::milliseconds(10));
+    tracker.add(1, 0, 1);
+
+    ASSERT_EQ(observer.updates.size(), 1u);
+    ASSERT_FALSE(observer.updates.front().finished);
+    ASSERT_EQ(observer.updates.front().entries, 2u);
+}
+
+TEST(ProgressTracker, StartResetsTheCounters)
+{
+    RecordingObserver observer;
+    ProgressTracker tracker(observer);
+
+    tracker.start(ProgressPhase::SCANNING);
+    tracker.add(3, 30, 0);
+    tracker.start(ProgressPhase::STORING, 3, 30);
+
+    const auto progress = tracker.progress();
+    ASSERT_EQ(progress.phase, ProgressPhase::STORING);
+    ASSERT_EQ(progress.entries, 0u);
+    ASSERT_EQ(progress.totalEntries, 3u);
+}
+
+TEST(ProgressBar, Format)
+{
+    Progress progress{ProgressPhase::STORING, false, 5, 10, 50 * 1000 * 1000, 10, 100 * 1000 * 1000, std::chrono::seconds(10)};
+
+    const auto line = ProgressBar::format(progress);
+
+    ASSERT_TRUE(line.starts_with("Storing    [############............]  50%"));
+    ASSERT_NE(line.find("5/10 entries"), std::string::npos);
+    ASSERT_NE(line.find("5.0 MB/s"), std::string::npos);
+    ASSERT_NE(line.find("ETA 0:10"), std::string::npos);
+}
+
+TEST(ProgressBar, FinishedLineEnds)
+{
+    std::ostringstream stream;
+    ProgressBar bar(stream);
+
+    bar.on_progress({ProgressPhase::SCANNING, false, 1, 0, 10, 0, 0, {}});
+    bar.on_progress({ProgressPhase::SCANNING, true, 2, 0, 20, 0, 0, {}});
+
+    ASSERT_TRUE(stream.str().starts_with("\rScanning   1 entries"));
+    ASSERT_TRUE(stream.str().ends_with("\n"));
+}
@@ -0,0 +1,73 @@
+#include "Recipients.h"
+
+#include <fstream>
+#include <gtest/gtest.h>
+
+class RecipientsTest : public testing::Test
+{
+protected:
+    std::filesystem::path m_temp_dir;
+    EncryptionManager::Key m_dataKey = EncryptionManager::generate_key();
+
+    void SetUp() override
+    {
+        m_temp_dir = std::filesystem::temp_directory_path() / "recipients_test";
+        std::filesystem::remove_all(m_temp_dir);
+        std::filesystem::create_directory(m_temp_dir);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_temp_dir);
+    }
+
+    [[nodiscard]] std::pair<EncryptionManager::Key, EncryptionManager::Data> generate(const std::string& name) const
+    {
+        const auto publicKey = Recipients::generate_identity(m_temp_dir / name);
+        return {Recipients::read_identity(m_temp_dir / name), publicKey};
+    }
+};
+
+TEST_F(RecipientsTest, EveryRecipientUnlocks)
+{
+    const auto [firstSecret, firstPublic] = generate("first");
+    const auto [secondSecret, secondPublic] = generate("second");
+    const auto [otherSecret, otherPublic] = generate("other");
+    Recipients recipients;
+    recipients.add(m_dataKey, firstPublic);
+    recipients.add(m_dataKey, secondPublic);
+
+    EXPECT_EQ(recipients.unlock(firstSecret), m_dataKey);
+    EXPECT_EQ(recipients.unlock(secondSecret), m_dataKey);
+    EXPECT_FALSE(recipients.unlock(otherSecret).has_value());
+}
+
+TEST_F(RecipientsTest, SerializationRoundTrip)
+{
+    const auto [secretKey, publicKey] = generate("identity");
+    Recipients recipients;
+    recipients.add(m_dataKey, publicKey);
+
+    pugi::xml_document doc;
+    auto header = doc.append_child("header");
+    recipients.write(header);
+    const Recipients read(header);
+
+    ASSERT_EQ(read.entries().size(), 1u);
+    EXPECT_EQ(read.entries()[0].publicKey, publicKey);
+    EXPECT_EQ(read.unlock(secretKey), m_dataKey);
+}
+
+TEST_F(RecipientsTest, KeyFiles)
+{
+    const auto [secretKey, publicKey] = generate("identity");
+
+    EXPECT_EQ(Recipients::read_public_key(m_temp_dir / "identity.pub"), publicKey);
+    EXPECT_EQ(Recipients::public_key(secretKey), publicKey);
+    EXPECT_THROW(static_cast<void>(Recipients::read_public_key(m_temp_dir / "identity")), std::runtime_error);
+    EXPECT_THROW(static_cast<void>(Recipients::read_identity(m_temp_dir / "identity.pub")), std::runtime_error);
+    EXPECT_THROW(static_cast<void>(Recipients::generate_identity(m_temp_dir / "identity")), std::runtime_error);
+#ifndef _WIN32
+    EXPECT_EQ(std::filesystem::status(m_temp_dir / "identity").permissions(), std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+#endif
+}
@@ -1,13 +1,41 @@
+#include "BlockReader.h"
+#include "ChecksumManager.h"
+#include "KeyAgent.h"
+#include "KeyRing.h"
+#include "Recipients.h"
 #include "Vault.h"
+#include "VaultFileSystem.h"
+#include "VaultFormat.h"
+#include "VaultManager.h"
 #include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <thread>
 #include <botan/allocator.h>
 #include <botan/exceptn.h>
 #include <gtest/gtest.h>
 
+#ifndef _WIN32
+#include <csignal>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#endif
+
 class VaultTest : public testing::Test
 {
 protected:
     std::filesystem::path m_temp_dir;
+    std::istringstream m_input;
+    std::streambuf* m_stdin = nullptr;
+
+    // Passwords are read from std::cin when it is not a terminal, which is only the case outside Windows.
+    void type_input(const std::string& input)
+    {
+        m_input.str(input);
+        m_input.clear();
+        m_stdin = std::cin.rdbuf(m_input.rdbuf());
+    }
 
     void write_file(const std::string& name, const std::string& content) const
     {
@@ -24,6 +52,21 @@ protected:
         return buffer.str();
     }
 
+    void corrupt_file(const std::string& name, const std::string& content) const
+    {
+        auto data = read_file(name);
+        const auto position = data.find(content);
+        ASSERT_NE(position, std::string::npos);
+        data[position] ^= 0xFF;
+        std::ofstream file((m_temp_dir / name).string(), std::ios::binary);
+        file << data;
+    }
+
+    [[nodiscard]] static bool is_vault_file(const std::string& content)
+    {
+        return content.starts_with(std::string(VaultFormat::MAGIC.data(), VaultFormat::MAGIC.size()));
+    }
+
     [[nodiscard]] bool exists(const std::string& name) const
     {
         return std::filesystem::exists(m_temp_dir / name);
@@ -84,11 +127,23 @@ protected:
         m_temp_dir = std::filesystem::temp_directory_path() / "vault_test_directory";
         cleanup_test_environment();
         create_directory(m_temp_dir);
+#if !defined(_WIN32)
+        // Keeps a key agent running for the user out of the tests.
+        setenv(KeyAgent::SOCKET_VARIABLE, (m_temp_dir / "agent.sock").c_str(), 1);
+#endif
     }
 
     void TearDown() override
     {
+        if (m_stdin)
+        {
+            std::cin.rdbuf(m_stdin);
+            std::cin.clear();
+        }
         cleanup_test_environment();
+#if !defined(_WIN32)
+        unsetenv(KeyAgent::SOCKET_VARIABLE);
+#endif
     }
 };
 
@@ -101,7 +156,7 @@ TEST_F(VaultTest, Close)
 
     EXPECT_FALSE(exists("test_vault"));
     EXPECT_TRUE(exists("test_vault.vlt"));
-    EXPECT_TRUE(read_file("test_vault.vlt").starts_with("<vault"));
+    EXPECT_TRUE(is_vault_file(read_file("test_vault.vlt")));
 }
 
 TEST_F(VaultTest, CloseEmptyVault)
@@ -115,8 +170,9 @@ TEST_F(VaultTest, CloseEmptyVault)
     EXPECT_FALSE(exists("test_vault"));
     EXPECT_TRUE(exists("test_vault.vlt"));
     const auto vaultContent = read_file("test_vault.vlt");
-    EXPECT_TRUE(vaultContent.starts_with("<vault name=\"test_vault\""));
-    EXPECT_TRUE(vaultContent.ends_with(" />\n"));
+    EXPECT_TRUE(is_vault_file(vaultContent));
+    EXPECT_NE(vaultContent.find("<vault name=\"test_vault\""), std::string::npos);
+    EXPECT_EQ(vaultContent.find("<file"), std::string::npos);
 }
 
 TEST_F(VaultTest, CloseWithCustomExtension)
@@ -184,7 +240,7 @@ TEST_F(VaultTest, OpenClose)
 
     EXPECT_TRUE(exists("test_vault.vlt"));
     EXPECT_FALSE(exists("test_vault"));
-    EXPECT_TRUE(read_file("test_vault.vlt").starts_with("<vault"));
+    EXPECT_TRUE(is_vault_file(read_file("test_vault.vlt")));
 
     vault.open();
 
@@ -403,7 +459,9 @@ TEST_F(VaultTest, CloseWithCompression)
 
     EXPECT_FALSE(exists("test_vault"));
     EXPECT_TRUE(exists("test_vault.vlt"));
-    EXPECT_TRUE(read_file("test_vault.vlt").starts_with("<compressed"));
+    const auto vaultContent = read_file("test_vault.vlt");
+    EXPECT_TRUE(is_vault_file(vaultContent));
+    EXPECT_NE(vaultContent.find("compression=\"zlib\""), std::string::npos);
 }
 
 TEST_F(VaultTest, OpenWithCompression)
@@ -417,38 +475,1502 @@ TEST_F(VaultTest, OpenWithCompression)
     assert_test_vault_existence();
 }
 
-#if defined(__cpp_lib_chrono) && __cpp_lib_chrono >= 201907L
-TEST_F(VaultTest, CloseOpenKeepLastWriteTime)
+TEST_F(VaultTest, Verify)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+
+    EXPECT_TRUE(vault.verify().empty());
+    EXPECT_TRUE(exists("test_vault.vlt"));
+    EXPECT_FALSE(exists("test_vault"));
+}
+
+TEST_F(VaultTest, VerifyWithCompression)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, true);
+
+    EXPECT_TRUE(vault.verify().empty());
+}
+
+TEST_F(VaultTest, VerifyLegacyVault)
+{
+    write_file("test_vault.vlt", get_test_vault_xml());
+
+    Vault vault(m_temp_dir / "test_vault.vlt");
+
+    EXPECT_TRUE(vault.verify().empty());
+}
+
+TEST_F(VaultTest, VerifyReportsCorruptedEntries)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    corrupt_file("test_vault.vlt", "Content of inner/file2.txt");
+    corrupt_file("test_vault.vlt", "Content of file.txt");
+
+    EXPECT_EQ(vault.verify(), (std::vector<std::string>{"inner/file2.txt", "inner/inner/file.txt"}));
+}
+
+TEST_F(VaultTest, VerifyReportsTheEntryOfACorruptedChunk)
 {
     create_directory(m_temp_dir / "test_vault");
+    std::map<std::string, std::string> contents;
+    for (const auto& [name, factor] : {std::pair{"first.bin", 2654435761u}, std::pair{"second.bin", 2246822519u}})
+    {
+        auto& content = contents[name];
+        content.resize(VaultFormat::CHUNK_SIZE * 3);
+        std::ranges::generate(content, [i = 0u, factor]() mutable { return static_cast<char>((i++ * factor) >> 24); });
+        std::ofstream((m_temp_dir / "test_vault" / name).string(), std::ios::binary) << content;
+    }
     write_file("test_vault/file.txt", "Content of file.txt");
-    const auto dir_last_write_time = last_write_time(m_temp_dir / "test_vault");
-    const auto file_last_write_time = last_write_time(m_temp_dir / "test_vault/file.txt");
 
     Vault vault(m_temp_dir / "test_vault");
     vault.close();
+    // Only the second chunk of one of the files is corrupted, its other chunks and the other files are intact.
+    corrupt_file("test_vault.vlt", contents["second.bin"].substr(VaultFormat::CHUNK_SIZE + 100, 64));
+
+    EXPECT_EQ(vault.verify(), std::vector<std::string>{"second.bin"});
+}
+
+TEST_F(VaultTest, InvalidOpenWithAnotherChecksumAlgorithm)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    auto data = read_file("test_vault.vlt");
+    const auto position = data.find(ChecksumManager::ALGORITHM);
+    ASSERT_NE(position, std::string::npos);
+    data.replace(position, std::string_view(ChecksumManager::ALGORITHM).size(), "BLAKE2b(160)");
+    std::ofstream((m_temp_dir / "test_vault.vlt").string(), std::ios::binary) << data;
+
+    EXPECT_THROW({vault.open();}, std::runtime_error) << "The algorithm is pinned by the format version, not taken from the header";
+    EXPECT_THROW({auto _ = vault.verify();}, std::runtime_error);
+}
+
+TEST_F(VaultTest, InvalidVerifyCorruptedIndex)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    corrupt_file("test_vault.vlt", "<vault name=");
+
+    EXPECT_THROW({auto _ = vault.verify();}, std::runtime_error);
+}
+
+TEST_F(VaultTest, WriteToStream)
+{
+    create_test_vault_directory();
+    std::ostringstream stream;
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.write(stream, true);
+
+    EXPECT_TRUE(exists("test_vault"));
+    EXPECT_FALSE(exists("test_vault.vlt"));
+    EXPECT_TRUE(is_vault_file(stream.str()));
+
+    write_file("streamed.vlt", stream.str());
+    std::filesystem::create_directory(m_temp_dir / "output");
+    Vault streamed(m_temp_dir / "streamed.vlt");
+    streamed.open(m_temp_dir / "output");
+
+    EXPECT_EQ(read_file("output/test_vault/inner/inner/file2.txt"), "Content of file2.txt");
+    EXPECT_EQ(read_file("output/test_vault/file.txt"), "Content of test_vault/file.txt");
+}
+
+TEST_F(VaultTest, OpenFromStandardInput)
+{
+    create_test_vault_directory();
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    const auto content = read_file("test_vault.vlt");
+    std::filesystem::create_directory(m_temp_dir / "output");
+    type_input(content);
+
+    VaultManager manager;
+    manager.open_vault(VaultManager::STANDARD_STREAM, m_temp_dir / "output", std::nullopt, {}, Durability::FULL, false);
+
+    EXPECT_EQ(read_file("output/test_vault/inner/file.txt"), "Content of inner/file.txt");
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator(m_temp_dir / "output"), std::filesystem::directory_iterator()), 1);
+}
+
+TEST_F(VaultTest, PartialOpenFromStandardInput)
+{
+    create_test_vault_directory();
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    const auto content = read_file("test_vault.vlt");
+    std::filesystem::create_directory(m_temp_dir / "output");
+    type_input(content);
+
+    VaultManager manager;
+    manager.open_vault(VaultManager::STANDARD_STREAM, m_temp_dir / "output", std::nullopt, {"inner/file.txt"}, Durability::FULL, false);
+
+    // Nothing is left of the staging directory even though a partial open leaves the vault closed.
+    EXPECT_EQ(read_file("output/test_vault/inner/file.txt"), "Content of inner/file.txt");
+    EXPECT_FALSE(exists("output/test_vault/file.txt"));
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator(m_temp_dir / "output"), std::filesystem::directory_iterator()), 1);
+}
+
+TEST_F(VaultTest, InvalidOpenFromStandardInput)
+{
+    std::filesystem::create_directory(m_temp_dir / "output");
+    type_input("not a vault");
+
+    VaultManager manager;
+
+    EXPECT_THROW(manager.open_vault(VaultManager::STANDARD_STREAM, m_temp_dir / "output", std::nullopt, {}, Durability::FULL, false), std::runtime_error);
+    EXPECT_TRUE(std::filesystem::is_empty(m_temp_dir / "output"));
+}
+
+TEST_F(VaultTest, OpenEncryptedFromStandardInput)
+{
+    create_test_vault_directory();
+    static_cast<void>(Recipients::generate_identity(m_temp_dir / "identity"));
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, true, true, KdfParameters(), std::nullopt, {m_temp_dir / "identity.pub"});
+    const auto content = read_file("test_vault.vlt");
+    std::filesystem::create_directory(m_temp_dir / "output");
+    type_input(content);
+
+    VaultManager manager;
+    manager.open_vault(VaultManager::STANDARD_STREAM, m_temp_dir / "output", m_temp_dir / "identity", {}, Durability::FULL, false);
+
+    EXPECT_EQ(read_file("output/test_vault/inner/inner/file2.txt"), "Content of file2.txt");
+    EXPECT_EQ(read_file("output/test_vault/file.txt"), "Content of test_vault/file.txt");
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator(m_temp_dir / "output"), std::filesystem::directory_iterator()), 1);
+}
+
+TEST_F(VaultTest, OpenAppendedVaultFromStandardInput)
+{
+    create_test_vault_directory();
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_source_removal(SourceRemoval::KEEP);
+        vault.close();
+    }
+    const auto source = m_temp_dir / "source";
+    rename(m_temp_dir / "test_vault", source);
+    // The stream holds the entries replaced by the append before the index dropping them.
+    write_file("source/file.txt", "Changed content of file.txt");
+    std::filesystem::remove(source / "inner/inner/file2.txt");
+    std::filesystem::remove(source / "file2.txt");
+    create_directory(source / "file2.txt");
+    write_file("source/file2.txt/file.txt", "Content of file2.txt/file.txt");
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    vault.set_durability(Durability::NONE);
+    vault.update(source, {"file.txt", "file2.txt", "file2.txt/file.txt", "inner/inner/file2.txt"});
+    const auto content = read_file("test_vault.vlt");
+    std::filesystem::create_directory(m_temp_dir / "output");
+    type_input(content);
+
+    VaultManager manager;
+    manager.open_vault(VaultManager::STANDARD_STREAM, m_temp_dir / "output", std::nullopt, {}, Durability::FULL, false);
+
+    EXPECT_EQ(read_file("output/test_vault/file.txt"), "Changed content of file.txt");
+    EXPECT_EQ(read_file("output/test_vault/file2.txt/file.txt"), "Content of file2.txt/file.txt");
+    EXPECT_EQ(read_file("output/test_vault/inner/inner/file.txt"), "Content of file.txt");
+    EXPECT_FALSE(exists("output/test_vault/inner/inner/file2.txt"));
+    EXPECT_EQ(std::distance(std::filesystem::directory_iterator(m_temp_dir / "output"), std::filesystem::directory_iterator()), 1);
+}
+
+TEST_F(VaultTest, CorruptedOpenFromStandardInput)
+{
+    create_test_vault_directory();
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    corrupt_file("test_vault.vlt", "Content of inner/file.txt");
+    const auto content = read_file("test_vault.vlt");
+    std::filesystem::create_directory(m_temp_dir / "output");
+    type_input(content);
+
+    VaultManager manager;
+
+    // The files extracted before the end of the stream are dropped once the blocks don't match the trailer.
+    EXPECT_THROW(manager.open_vault(VaultManager::STANDARD_STREAM, m_temp_dir / "output", std::nullopt, {}, Durability::FULL, false), std::runtime_error);
+    EXPECT_TRUE(std::filesystem::is_empty(m_temp_dir / "output"));
+    EXPECT_THROW(manager.open_vault(VaultManager::STANDARD_STREAM, m_temp_dir / "output", std::nullopt, {}, Durability::FULL, true), std::invalid_argument);
+}
+
+TEST_F(VaultTest, CloseInVolumes)
+{
+    create_directory(m_temp_dir / "test_vault");
+    for (const auto name : {"a", "b", "c"})
+        write_file(std::string("test_vault/") + name + ".bin", std::string(3 * VaultFormat::CHUNK_SIZE / 2, name[0]));
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, false, false, KdfParameters(), std::nullopt, {}, VaultFormat::MIN_VOLUME_SIZE);
+
+    EXPECT_FALSE(exists("test_vault"));
+    EXPECT_LT(std::filesystem::file_size(m_temp_dir / "test_vault.vlt"), VaultFormat::CHUNK_SIZE);
+    const auto info = vault.info();
+    ASSERT_EQ(info.volumes.size(), 3u);
+    for (size_t i = 0; i < info.volumes.size(); ++i)
+    {
+        EXPECT_EQ(info.volumes[i].name, "test_vault.vlt.00" + std::to_string(i + 1));
+        EXPECT_EQ(std::filesystem::file_size(m_temp_dir / info.volumes[i].name), info.volumes[i].size);
+        EXPECT_LE(info.volumes[i].size, VaultFormat::MIN_VOLUME_SIZE);
+    }
+    EXPECT_THROW(Vault(m_temp_dir / "test_vault.vlt.002").open(), std::runtime_error);
+    EXPECT_TRUE(vault.verify().empty());
+
     vault.open();
 
-    EXPECT_EQ(last_write_time(m_temp_dir / "test_vault"), dir_last_write_time);
-    EXPECT_EQ(last_write_time(m_temp_dir / "test_vault/file.txt"), file_last_write_time);
+    EXPECT_EQ(read_file("test_vault/b.bin"), std::string(3 * VaultFormat::CHUNK_SIZE / 2, 'b'));
+    EXPECT_FALSE(exists("test_vault.vlt"));
+    EXPECT_FALSE(exists("test_vault.vlt.001"));
+    EXPECT_FALSE(exists("test_vault.vlt.003"));
+}
+
+TEST_F(VaultTest, ReadOnlyTheVolumesOfAnEntry)
+{
+    create_directory(m_temp_dir / "test_vault");
+    write_file("test_vault/a.bin", std::string(3 * VaultFormat::CHUNK_SIZE / 2, 'a'));
+    write_file("test_vault/b.bin", std::string(3 * VaultFormat::CHUNK_SIZE / 2, 'b'));
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, false, false, KdfParameters(), std::nullopt, {}, VaultFormat::MIN_VOLUME_SIZE);
+    vault.load();
+    VaultFileSystem fileSystem(vault, 0);
+    const auto first = dynamic_cast<const File*>(fileSystem.find("/a.bin"));
+    const auto second = dynamic_cast<const File*>(fileSystem.find("/b.bin"));
+    ASSERT_NE(first, nullptr);
+    ASSERT_NE(second, nullptr);
+    const auto volume = first->blocks().front().volume;
+    ASSERT_NE(volume, 0u);
+    ASSERT_NE(second->blocks().back().volume, volume);
+    std::filesystem::remove(VaultFormat::volume_path(m_temp_dir / "test_vault.vlt", second->blocks().back().volume));
+
+    const auto data = fileSystem.read(*first, 0, 4);
+    EXPECT_EQ(std::string(data.begin(), data.end()), "aaaa");
+    EXPECT_THROW({auto _ = second->content();}, std::runtime_error);
+}
+
+TEST_F(VaultTest, InvalidCloseWithSmallVolumes)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+
+    EXPECT_THROW(vault.close(std::nullopt, std::nullopt, false, false, KdfParameters(), std::nullopt, {}, VaultFormat::CHUNK_SIZE), std::invalid_argument);
+    assert_test_vault_existence();
 }
+
+TEST_F(VaultTest, CloseWithExcludes)
+{
+    create_test_vault_directory();
+    create_directory(m_temp_dir / "test_vault/node_modules");
+    create_directory(m_temp_dir / "test_vault/inner/build");
+    write_file("test_vault/node_modules/package.json", "{}");
+    write_file("test_vault/inner/build/output.o", "object");
+    write_file("test_vault/inner/debug.log", "log");
+    write_file("test_vault/inner/keep.log", "kept");
+    write_file("test_vault/.vaultignore", "# Generated\nnode_modules/\n*.log\n!keep.log\n");
+    write_file("test_vault/inner/.vaultignore", "/build\n");
+#ifndef _WIN32
+    std::filesystem::create_directory_symlink(m_temp_dir / "test_vault/inner", m_temp_dir / "test_vault/node_modules/link");
 #endif
 
-#if !defined(_WIN32)
-TEST_F(VaultTest, CloseOpenKeepPermissions)
+    Vault vault(m_temp_dir / "test_vault");
+    vault.set_exclude_patterns({"inner/inner/file2.txt"});
+    vault.close();
+    vault.open();
+
+    EXPECT_TRUE(exists("test_vault/.vaultignore"));
+    EXPECT_TRUE(exists("test_vault/inner/.vaultignore"));
+    EXPECT_TRUE(exists("test_vault/inner/keep.log"));
+    EXPECT_TRUE(exists("test_vault/inner/inner/file.txt"));
+    EXPECT_FALSE(exists("test_vault/inner/inner/file2.txt"));
+    EXPECT_FALSE(exists("test_vault/inner/debug.log"));
+    EXPECT_FALSE(exists("test_vault/inner/build"));
+    EXPECT_FALSE(exists("test_vault/node_modules"));
+}
+
+TEST_F(VaultTest, ExcludesOverrideIgnoreFile)
 {
-    const auto vaultPath = m_temp_dir / "test_vault";
-    create_directory(vaultPath);
-    write_file("test_vault/file.txt", "Content of file.txt");
+    create_test_vault_directory();
+    write_file("test_vault/.vaultignore", "file2.txt\n");
 
-    std::filesystem::permissions(vaultPath, std::filesystem::perms::none | std::filesystem::perms::owner_all);
-    std::filesystem::permissions(vaultPath / "file.txt", std::filesystem::perms::owner_all | std::filesystem::perms::others_exec | std::filesystem::perms::group_read);
+    Vault vault(m_temp_dir / "test_vault");
+    vault.set_exclude_patterns({"!inner/file2.txt"});
+    vault.close();
+    vault.open();
 
-    Vault vault(vaultPath);
+    EXPECT_FALSE(exists("test_vault/file2.txt"));
+    EXPECT_TRUE(exists("test_vault/inner/file2.txt"));
+    EXPECT_FALSE(exists("test_vault/inner/inner/file2.txt"));
+}
+
+TEST_F(VaultTest, OpenOnly)
+{
+    create_test_vault_directory();
+    std::filesystem::create_directory(m_temp_dir / "output");
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    corrupt_file("test_vault.vlt", "Content of test_vault/file2.txt");
+    vault.open(m_temp_dir / "output", {"inner/inner", "/file.txt"});
+
+    EXPECT_TRUE(exists("test_vault.vlt"));
+    EXPECT_EQ(read_file("output/test_vault/file.txt"), "Content of test_vault/file.txt");
+    EXPECT_EQ(read_file("output/test_vault/inner/inner/file.txt"), "Content of file.txt");
+    EXPECT_EQ(read_file("output/test_vault/inner/inner/file2.txt"), "Content of file2.txt");
+    EXPECT_FALSE(exists("output/test_vault/file2.txt"));
+    EXPECT_FALSE(exists("output/test_vault/inner/file.txt"));
+    EXPECT_THROW(vault.open(), std::runtime_error) << "The unselected entry is still corrupted";
+}
+
+TEST_F(VaultTest, OpenOnlyWithWildcards)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
     vault.close();
+    vault.open(std::nullopt, {"file2.*", "!inner/inner/*"});
+
+    EXPECT_TRUE(exists("test_vault.vlt"));
+    EXPECT_EQ(read_file("test_vault/file2.txt"), "Content of test_vault/file2.txt");
+    EXPECT_EQ(read_file("test_vault/inner/file2.txt"), "Content of inner/file2.txt");
+    EXPECT_FALSE(exists("test_vault/file.txt"));
+    EXPECT_FALSE(exists("test_vault/inner/inner"));
+}
+
+TEST_F(VaultTest, InvalidOpenOnlyWithoutMatch)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+
+    EXPECT_THROW(vault.open(std::nullopt, {"*.sql"}), std::runtime_error);
+    EXPECT_TRUE(exists("test_vault.vlt"));
+    EXPECT_FALSE(exists("test_vault"));
+}
+
+class PhaseObserver final : public ProgressObserver
+{
+public:
+    std::vector<Progress> finished;
+
+    void on_progress(const Progress& progress) override
+    {
+        if (progress.finished)
+            finished.push_back(progress);
+    }
+};
+
+TEST_F(VaultTest, CloseOpenVerifyReportProgress)
+{
+    create_test_vault_directory();
+    PhaseObserver observer;
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.set_progress_observer(observer);
+    vault.close(std::nullopt, std::nullopt, true);
+    EXPECT_TRUE(vault.verify().empty());
     vault.open();
 
-    EXPECT_EQ(std::filesystem::status(vaultPath).permissions(), (std::filesystem::perms::none | std::filesystem::perms::owner_all));
-    EXPECT_EQ(std::filesystem::status(vaultPath / "file.txt").permissions(), (std::filesystem::perms::owner_all | std::filesystem::perms::others_exec | std::filesystem::perms::group_read));
+    ASSERT_EQ(observer.finished.size(), 4u);
+    EXPECT_EQ(observer.finished[0].phase, ProgressPhase::SCANNING);
+    EXPECT_EQ(observer.finished[0].entries, 6u);
+    EXPECT_EQ(observer.finished[0].bytesIn, 151u);
+    EXPECT_EQ(observer.finished[1].phase, ProgressPhase::STORING);
+    EXPECT_EQ(observer.finished[1].entries, 6u);
+    EXPECT_EQ(observer.finished[1].totalEntries, 6u);
+    EXPECT_EQ(observer.finished[1].bytesIn, 151u);
+    EXPECT_EQ(observer.finished[1].totalBytes, 151u);
+    EXPECT_GT(observer.finished[1].bytesOut, 0u);
+    EXPECT_EQ(observer.finished[2].phase, ProgressPhase::VERIFYING);
+    EXPECT_EQ(observer.finished[2].entries, 6u);
+    EXPECT_EQ(observer.finished[2].bytesOut, 151u);
+    EXPECT_EQ(observer.finished[3].phase, ProgressPhase::EXTRACTING);
+    EXPECT_EQ(observer.finished[3].entries, 6u);
+    EXPECT_EQ(observer.finished[3].totalEntries, 6u);
+    EXPECT_EQ(observer.finished[3].bytesIn, observer.finished[1].bytesOut);
+    EXPECT_EQ(observer.finished[3].bytesOut, 151u);
+}
+
+TEST_F(VaultTest, Info)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    const auto info = vault.info();
+
+    ASSERT_TRUE(info.header.has_value());
+    EXPECT_EQ(info.header->version, VaultFormat::VERSION);
+    EXPECT_FALSE(info.header->compressed);
+    EXPECT_EQ(info.fileSize, std::filesystem::file_size(m_temp_dir / "test_vault.vlt"));
+    EXPECT_GT(info.indexSize, 0u);
+    ASSERT_EQ(info.directories.size(), 3u);
+    EXPECT_EQ(info.directories[0].path, ".");
+    EXPECT_EQ(info.directories[0].files, 6u);
+    EXPECT_EQ(info.directories[0].directories, 2u);
+    EXPECT_EQ(info.directories[0].size, 151u);
+    EXPECT_EQ(info.directories[0].storedSize, 151u);
+    EXPECT_EQ(info.directories[1].path, "inner");
+    EXPECT_EQ(info.directories[1].files, 4u);
+    EXPECT_EQ(info.directories[1].directories, 1u);
+    EXPECT_EQ(info.directories[1].size, 90u);
+    EXPECT_EQ(info.directories[2].path, "inner/inner");
+    EXPECT_EQ(info.directories[2].files, 2u);
+    EXPECT_EQ(info.directories[2].size, 39u);
+    EXPECT_EQ(info.directories[2].compressedSize, 39u);
+    EXPECT_TRUE(exists("test_vault.vlt"));
+}
+
+TEST_F(VaultTest, InfoSeparatesEncryptionOverhead)
+{
+    create_test_vault_directory();
+    type_input("password\npassword\npassword\npassword\n");
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, false, true, KdfParameters{1024, 1, 1}, Cipher::CHACHA20_POLY1305);
+    const auto info = vault.info();
+
+    ASSERT_TRUE(info.header.has_value());
+    EXPECT_TRUE(info.header->encrypted);
+    ASSERT_TRUE(info.header->keySlots.has_value());
+    EXPECT_EQ(info.header->keySlots->active().size(), 1u);
+    EXPECT_EQ(info.directories[0].size, 151u);
+    EXPECT_EQ(info.directories[0].compressedSize, 151u);
+    EXPECT_EQ(info.directories[0].storedSize, 151u + 6 * (EncryptionManager::NONCE_SIZE + EncryptionManager::TAG_SIZE));
+}
+
+TEST_F(VaultTest, InfoLegacyVault)
+{
+    write_file("test_vault.vlt", get_test_vault_xml());
+
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    const auto info = vault.info();
+
+    EXPECT_FALSE(info.header.has_value());
+    EXPECT_EQ(info.indexSize, info.fileSize);
+    EXPECT_EQ(info.directories.front().path, ".");
 }
+
+TEST_F(VaultTest, InvalidVerifyOpenedVault)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+
+    EXPECT_THROW({auto _ = vault.verify();}, std::invalid_argument) << "The vault is opened";
+}
+
+TEST_F(VaultTest, InvalidOpenCorruptedVault)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    corrupt_file("test_vault.vlt", "Content of test_vault/file2.txt");
+
+    EXPECT_THROW({vault.open();}, std::runtime_error);
+    EXPECT_TRUE(exists("test_vault.vlt"));
+    EXPECT_FALSE(exists("test_vault"));
+}
+
+TEST_F(VaultTest, InvalidOpenLeavesNothingBehind)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    corrupt_file("test_vault.vlt", "Content of test_vault/file2.txt");
+
+    EXPECT_THROW(vault.open(), std::runtime_error);
+    std::vector<std::string> entries;
+    for (const auto& entry : std::filesystem::directory_iterator(m_temp_dir))
+        entries.push_back(entry.path().filename().string());
+    EXPECT_EQ(entries, std::vector<std::string>{"test_vault.vlt"}) << "The partially extracted entries are removed";
+}
+
+TEST_F(VaultTest, CloseKeepSource)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.set_durability(Durability::NONE);
+    vault.set_source_removal(SourceRemoval::KEEP);
+    vault.close();
+
+    EXPECT_TRUE(exists("test_vault.vlt"));
+    EXPECT_EQ(read_file("test_vault/inner/inner/file.txt"), "Content of file.txt");
+}
+
+TEST_F(VaultTest, CloseRemoveSourceInBackground)
+{
+    create_test_vault_directory();
+    Vault vault(m_temp_dir / "test_vault");
+    vault.set_source_removal(SourceRemoval::BACKGROUND);
+    vault.close();
+    EXPECT_FALSE(exists("test_vault")) << "The source is moved aside when close returns";
+
+    // The source is removed by a process that doesn't hold the vault, nor the command, until it is done.
+    std::vector<std::string> entries;
+    for (auto attempt = 0; attempt < 100; ++attempt)
+    {
+        entries.clear();
+        for (const auto& entry : std::filesystem::directory_iterator(m_temp_dir))
+            entries.push_back(entry.path().filename().string());
+        if (entries.size() == 1)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    }
+    EXPECT_EQ(entries, std::vector<std::string>{"test_vault.vlt"});
+}
+
+TEST_F(VaultTest, CloseOpenWithoutExtension)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, "");
+    EXPECT_TRUE(std::filesystem::is_regular_file(m_temp_dir / "test_vault"));
+    vault.open();
+
+    assert_test_vault_existence();
+}
+
+// Removes the last entry of a directory once it is scanned, so that storing it fails after the others are stored.
+class RemoveLastEntry final : public ProgressObserver
+{
+public:
+    std::filesystem::path directory;
+    std::filesystem::path removed;
+
+    void on_progress(const Progress& progress) override
+    {
+        if (progress.phase != ProgressPhase::SCANNING || !progress.finished)
+            return;
+        for (const auto& entry : std::filesystem::directory_iterator(directory))
+            removed = entry.path();
+        std::filesystem::remove(removed);
+    }
+};
+
+TEST_F(VaultTest, CloseResumesAfterTheEntriesStored)
+{
+    create_directory(m_temp_dir / "test_vault");
+    for (const std::string name : {"a.txt", "b.txt", "c.txt", "d.txt"})
+        write_file("test_vault/" + name, "Content of " + name);
+    RemoveLastEntry observer;
+    observer.directory = m_temp_dir / "test_vault";
+
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_durability(Durability::NONE);
+        vault.set_progress_observer(observer);
+        EXPECT_THROW(vault.close(), std::ios_base::failure);
+    }
+    EXPECT_TRUE(exists(".test_vault.vlt.partial"));
+    EXPECT_TRUE(exists(".test_vault.vlt.checkpoint"));
+    EXPECT_FALSE(exists("test_vault.vlt"));
+
+    // The entries stored are taken from the checkpoint while they keep their size and time, even if their content changed.
+    const auto removed = observer.removed.filename().string();
+    write_file("test_vault/" + removed, "Content of " + removed);
+    for (const auto& entry : std::filesystem::directory_iterator(m_temp_dir / "test_vault"))
+    {
+        const auto name = entry.path().filename().string();
+        if (name == removed)
+            continue;
+        const auto time = entry.last_write_time();
+        write_file("test_vault/" + name, "Changed of " + name);
+        last_write_time(entry.path(), time);
+    }
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.set_durability(Durability::NONE);
+    vault.set_resume(true);
+    vault.close();
+    EXPECT_FALSE(exists(".test_vault.vlt.partial"));
+    EXPECT_FALSE(exists(".test_vault.vlt.checkpoint"));
+    EXPECT_TRUE(vault.verify().empty());
+    vault.open();
+
+    for (const std::string name : {"a.txt", "b.txt", "c.txt", "d.txt"})
+        EXPECT_EQ(read_file("test_vault/" + name), "Content of " + name);
+}
+
+TEST_F(VaultTest, CloseWithoutResumingStartsOver)
+{
+    create_directory(m_temp_dir / "test_vault");
+    for (const std::string name : {"a.txt", "b.txt", "c.txt"})
+        write_file("test_vault/" + name, "Content of " + name);
+    RemoveLastEntry observer;
+    observer.directory = m_temp_dir / "test_vault";
+
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_durability(Durability::NONE);
+        vault.set_progress_observer(observer);
+        EXPECT_THROW(vault.close(), std::ios_base::failure);
+    }
+    const auto removed = observer.removed.filename().string();
+    write_file("test_vault/" + removed, "Content of " + removed);
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    EXPECT_FALSE(exists(".test_vault.vlt.partial"));
+    EXPECT_FALSE(exists(".test_vault.vlt.checkpoint"));
+    vault.open();
+
+    for (const std::string name : {"a.txt", "b.txt", "c.txt"})
+        EXPECT_EQ(read_file("test_vault/" + name), "Content of " + name);
+}
+
+TEST_F(VaultTest, ResumeSplitVault)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.set_resume(true);
+
+    EXPECT_THROW(vault.close(std::nullopt, std::nullopt, false, false, KdfParameters(), std::nullopt, {}, 1024), std::invalid_argument);
+    EXPECT_TRUE(exists("test_vault"));
+    EXPECT_FALSE(exists("test_vault.vlt"));
+}
+
+TEST_F(VaultTest, MountReadsEntriesFromTheIndex)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, true);
+    vault.load();
+    VaultFileSystem fileSystem(vault, 1024);
+
+    EXPECT_NE(fileSystem.find("/"), nullptr);
+    EXPECT_NE(dynamic_cast<const Directory*>(fileSystem.find("/inner/inner")), nullptr);
+    EXPECT_EQ(fileSystem.find("/missing"), nullptr);
+    const auto file = dynamic_cast<const File*>(fileSystem.find("/inner/file2.txt"));
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(file->size(), 26u);
+    const auto data = fileSystem.read(*file, 11, 5);
+    EXPECT_EQ(std::string(data.begin(), data.end()), "inner");
+    EXPECT_TRUE(fileSystem.read(*file, 100, 5).empty());
+    EXPECT_TRUE(exists("test_vault.vlt"));
+    EXPECT_FALSE(exists("test_vault"));
+}
+
+TEST_F(VaultTest, MountLegacyVault)
+{
+    write_file("test_vault.vlt", get_test_vault_xml());
+
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    vault.load();
+    VaultFileSystem fileSystem(vault, 1024);
+
+    const auto file = dynamic_cast<const File*>(fileSystem.find("/file.txt"));
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(file->size(), 30u);
+    const auto data = fileSystem.read(*file, 21, 100);
+    EXPECT_EQ(std::string(data.begin(), data.end()), "/file.txt");
+}
+
+TEST_F(VaultTest, CloseOpenChunkedFile)
+{
+    create_directory(m_temp_dir / "test_vault");
+    std::string content(VaultFormat::CHUNK_SIZE * 5 / 2, '\0');
+    std::ranges::generate(content, [i = 0u]() mutable { return static_cast<char>((i++ * 2654435761u) >> 24); });
+    std::ofstream((m_temp_dir / "test_vault/large.bin").string(), std::ios::binary) << content;
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, true);
+    EXPECT_TRUE(vault.verify().empty());
+    vault.open();
+
+    std::ifstream file((m_temp_dir / "test_vault/large.bin").string(), std::ios::binary);
+    EXPECT_EQ(std::string(std::istreambuf_iterator(file), {}), content);
+}
+
+TEST_F(VaultTest, CloseOpenWithMemoryBudget)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault", MemoryBudget(MemoryBudget::BASE_MEMORY + MemoryBudget::WORKER_MEMORY));
+    vault.close(std::nullopt, std::nullopt, true);
+    EXPECT_TRUE(vault.verify().empty());
+    vault.open();
+
+    assert_test_vault_existence();
+}
+
+TEST_F(VaultTest, InvalidKeyDerivationOverTheMemoryBudget)
+{
+    create_test_vault_directory();
+    const MemoryBudget budget(MemoryBudget::BASE_MEMORY + MemoryBudget::WORKER_MEMORY);
+
+    EXPECT_THROW(Vault(m_temp_dir / "test_vault", budget).close(std::nullopt, std::nullopt, false, true, {16 * 1024, 1, 1}), std::invalid_argument);
+    EXPECT_TRUE(exists("test_vault"));
+    EXPECT_FALSE(exists("test_vault.vlt"));
+
+    // A vault whose header asks for more memory than the budget is refused before the password is derived.
+    type_input("password\npassword\n");
+    Vault(m_temp_dir / "test_vault").close(std::nullopt, std::nullopt, false, true, {16 * 1024, 1, 1});
+    EXPECT_THROW(Vault(m_temp_dir / "test_vault.vlt", budget).open(), std::invalid_argument);
+    EXPECT_TRUE(exists("test_vault.vlt"));
+}
+
+TEST_F(VaultTest, ReadChunkedFileRange)
+{
+    create_directory(m_temp_dir / "test_vault");
+    std::string content(VaultFormat::CHUNK_SIZE * 3 + 10, '\0');
+    std::ranges::generate(content, [i = 0u]() mutable { return static_cast<char>((i++ * 2654435761u) >> 24); });
+    std::ofstream((m_temp_dir / "test_vault/large.bin").string(), std::ios::binary) << content;
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    vault.load();
+    const auto file = dynamic_cast<const File*>(vault.find("large.bin"));
+    ASSERT_NE(file, nullptr);
+    EXPECT_EQ(file->size(), content.size());
+
+    const auto offset = VaultFormat::CHUNK_SIZE - 5;
+    std::ostringstream range;
+    file->write_range(range, offset, VaultFormat::CHUNK_SIZE + 10);
+    EXPECT_EQ(range.str(), content.substr(offset, VaultFormat::CHUNK_SIZE + 10));
+
+    std::ostringstream tail;
+    file->write_range(tail, content.size() - 4, 100);
+    EXPECT_EQ(tail.str(), content.substr(content.size() - 4));
+
+    std::ostringstream outside;
+    file->write_range(outside, content.size(), 100);
+    EXPECT_TRUE(outside.str().empty());
+    EXPECT_EQ(vault.find("missing.bin"), nullptr);
+}
+
+TEST_F(VaultTest, CloseOpenSparseFile)
+{
+    create_directory(m_temp_dir / "test_vault");
+    std::string data(VaultFormat::CHUNK_SIZE, '\0');
+    std::ranges::generate(data, [i = 0u]() mutable { return static_cast<char>((i++ * 2654435761u) >> 24); });
+    const auto path = m_temp_dir / "test_vault/sparse.img";
+    {
+        std::ofstream file(path.string(), std::ios::binary);
+        file << data;
+        file.seekp(static_cast<std::streamoff>(VaultFormat::CHUNK_SIZE * 5));
+        file << data;
+    }
+    std::filesystem::resize_file(path, VaultFormat::CHUNK_SIZE * 8 + 10);
+    std::string content(VaultFormat::CHUNK_SIZE * 8 + 10, '\0');
+    content.replace(0, data.size(), data);
+    content.replace(VaultFormat::CHUNK_SIZE * 5, data.size(), data);
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    vault.load();
+    const auto file = dynamic_cast<const File*>(vault.find("sparse.img"));
+    ASSERT_NE(file, nullptr);
+    if (std::ranges::none_of(file->blocks(), &BlockInfo::hole))
+        GTEST_SKIP() << "The file system doesn't report holes";
+    EXPECT_EQ(file->size(), content.size());
+    EXPECT_LT(file_size(m_temp_dir / "test_vault.vlt"), VaultFormat::CHUNK_SIZE * 3) << "Only the data is stored";
+    std::ostringstream range;
+    file->write_range(range, VaultFormat::CHUNK_SIZE - 5, VaultFormat::CHUNK_SIZE * 5);
+    EXPECT_EQ(range.str(), content.substr(VaultFormat::CHUNK_SIZE - 5, VaultFormat::CHUNK_SIZE * 5));
+    EXPECT_TRUE(vault.verify().empty());
+    vault.open();
+
+    std::ifstream extracted(path.string(), std::ios::binary);
+    EXPECT_EQ(std::string(std::istreambuf_iterator(extracted), {}), content);
+#ifndef _WIN32
+    struct stat status{};
+    ASSERT_EQ(stat(path.c_str(), &status), 0);
+    EXPECT_LT(static_cast<std::uint64_t>(status.st_blocks) * 512, content.size()) << "The holes are not allocated";
+#endif
+}
+
+TEST_F(VaultTest, UpdateAppendsTheChangedEntries)
+{
+    create_test_vault_directory();
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_source_removal(SourceRemoval::KEEP);
+        vault.close();
+    }
+    // The directory is moved aside, so the vault can be opened in its place.
+    const auto source = m_temp_dir / "source";
+    rename(m_temp_dir / "test_vault", source);
+    const auto closed = read_file("test_vault.vlt");
+    write_file("source/file.txt", "Changed content of file.txt");
+    std::filesystem::remove(source / "inner/inner/file2.txt");
+    create_directories(source / "new/deep");
+    write_file("source/new/deep/file.txt", "Content of new/deep/file.txt");
+
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    vault.set_durability(Durability::NONE);
+    vault.update(source, {"file.txt", "inner/inner/file2.txt", "new/deep/file.txt", "./new/deep/"});
+    EXPECT_TRUE(read_file("test_vault.vlt").starts_with(closed)) << "The vault is only appended to";
+    write_file("source/inner/file2.txt", "Changed content of inner/file2.txt");
+    vault.update(source, {"inner/file2.txt"});
+    EXPECT_THROW(vault.update(source, {"../file.txt"}), std::invalid_argument);
+
+    Vault updated(m_temp_dir / "test_vault.vlt");
+    EXPECT_TRUE(updated.verify().empty());
+    updated.open();
+    EXPECT_EQ(read_file("test_vault/file.txt"), "Changed content of file.txt");
+    EXPECT_EQ(read_file("test_vault/file2.txt"), "Content of test_vault/file2.txt");
+    EXPECT_EQ(read_file("test_vault/inner/file2.txt"), "Changed content of inner/file2.txt");
+    EXPECT_EQ(read_file("test_vault/inner/inner/file.txt"), "Content of file.txt");
+    EXPECT_FALSE(exists("test_vault/inner/inner/file2.txt"));
+    EXPECT_EQ(read_file("test_vault/new/deep/file.txt"), "Content of new/deep/file.txt");
+}
+
+TEST_F(VaultTest, UpdateRollsBackAnInterruptedAppend)
+{
+    create_test_vault_directory();
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_source_removal(SourceRemoval::KEEP);
+        vault.close();
+    }
+    const auto closed = read_file("test_vault.vlt");
+    std::ofstream(m_temp_dir / ".test_vault.vlt.append") << closed.size() << '\n';
+    std::ofstream(m_temp_dir / "test_vault.vlt", std::ios::binary | std::ios::app) << "Torn append";
+    write_file("test_vault/file.txt", "Changed content of file.txt");
+
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    vault.update(m_temp_dir / "test_vault", {});
+    EXPECT_EQ(read_file("test_vault.vlt"), closed);
+    EXPECT_FALSE(exists(".test_vault.vlt.append"));
+    vault.update(m_temp_dir / "test_vault", {"file.txt"});
+    EXPECT_FALSE(exists(".test_vault.vlt.append"));
+    remove_all(m_temp_dir / "test_vault");
+
+    Vault updated(m_temp_dir / "test_vault.vlt");
+    updated.open();
+    EXPECT_EQ(read_file("test_vault/file.txt"), "Changed content of file.txt");
+    EXPECT_EQ(read_file("test_vault/inner/file.txt"), "Content of inner/file.txt");
+}
+
+TEST_F(VaultTest, ReadVaultWithAnInterruptedAppend)
+{
+    create_test_vault_directory();
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.close();
+    }
+    const auto closed = read_file("test_vault.vlt");
+    std::ofstream(m_temp_dir / ".test_vault.vlt.append") << closed.size() << '\n';
+    std::ofstream(m_temp_dir / "test_vault.vlt", std::ios::binary | std::ios::app) << "Torn append";
+
+    // The vault is read as it was before the append, which is left to be rolled back by the next update.
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    EXPECT_TRUE(vault.verify().empty());
+    EXPECT_NO_THROW(static_cast<void>(vault.info()));
+    EXPECT_TRUE(exists(".test_vault.vlt.append"));
+    vault.open();
+
+    assert_test_vault_existence();
+    EXPECT_FALSE(exists(".test_vault.vlt.append"));
+}
+
+TEST_F(VaultTest, UpdateCompactsTheVault)
+{
+    create_directory(m_temp_dir / "test_vault");
+    write_file("test_vault/file.txt", "Content of file.txt");
+    std::string content(VaultFormat::CHUNK_SIZE * 2, '\0');
+    const auto write_content = [this, &content](const unsigned factor)
+    {
+        std::ranges::generate(content, [i = 0u, factor]() mutable { return static_cast<char>((i++ * factor) >> 24); });
+        std::ofstream((m_temp_dir / "test_vault/large.bin").string(), std::ios::binary) << content;
+    };
+    write_content(2654435761u);
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_source_removal(SourceRemoval::KEEP);
+        vault.close();
+    }
+    const auto source = m_temp_dir / "source";
+    rename(m_temp_dir / "test_vault", source);
+
+    // Every update supersedes the whole file, the vault is rewritten once the blocks left behind outweigh the others.
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    vault.set_durability(Durability::NONE);
+    for (const auto factor : {2246822519u, 3266489917u, 668265263u, 374761393u})
+    {
+        rename(source, m_temp_dir / "test_vault");
+        write_content(factor);
+        rename(m_temp_dir / "test_vault", source);
+        vault.update(source, {"large.bin"});
+        EXPECT_LE(file_size(m_temp_dir / "test_vault.vlt"), 2 * content.size() + 64 * 1024);
+    }
+    EXPECT_LT(file_size(m_temp_dir / "test_vault.vlt"), content.size() + 64 * 1024) << "The vault was compacted by the last update";
+
+    Vault updated(m_temp_dir / "test_vault.vlt");
+    EXPECT_TRUE(updated.verify().empty());
+    updated.open();
+    EXPECT_EQ(read_file("test_vault/large.bin"), content);
+    EXPECT_EQ(read_file("test_vault/file.txt"), "Content of file.txt");
+}
+
+TEST_F(VaultTest, UpdateOpenedOrSplitVault)
+{
+    create_directory(m_temp_dir / "test_vault");
+    std::string content(VaultFormat::CHUNK_SIZE * 3, '\0');
+    std::ranges::generate(content, [i = 0u]() mutable { return static_cast<char>((i++ * 2654435761u) >> 24); });
+    std::ofstream((m_temp_dir / "test_vault/file.bin").string(), std::ios::binary) << content;
+    Vault vault(m_temp_dir / "test_vault");
+
+    EXPECT_THROW(vault.update(m_temp_dir / "test_vault", {}), std::invalid_argument);
+    vault.set_source_removal(SourceRemoval::KEEP);
+    vault.close(std::nullopt, std::nullopt, false, false, KdfParameters(), std::nullopt, {}, VaultFormat::MIN_VOLUME_SIZE);
+    EXPECT_THROW(vault.update(m_temp_dir / "test_vault", {"file.bin"}), std::invalid_argument);
+}
+
+#if defined(__cpp_lib_chrono) && __cpp_lib_chrono >= 201907L
+TEST_F(VaultTest, UpdateKeepsTheUnchangedFiles)
+{
+    create_directory(m_temp_dir / "test_vault");
+    std::string content(VaultFormat::CHUNK_SIZE * 2, '\0');
+    std::ranges::generate(content, [i = 0u]() mutable { return static_cast<char>((i++ * 2654435761u) >> 24); });
+    std::ofstream((m_temp_dir / "test_vault/file.bin").string(), std::ios::binary) << content;
+    write_file("test_vault/file.txt", "Content of file.txt");
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_source_removal(SourceRemoval::KEEP);
+        vault.close();
+    }
+    const auto closedSize = file_size(m_temp_dir / "test_vault.vlt");
+    write_file("test_vault/file.txt", "Changed content of file.txt");
+
+    // The whole directory is scanned again, only the file changed is read and appended.
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    vault.update(m_temp_dir / "test_vault", {""});
+    EXPECT_LT(file_size(m_temp_dir / "test_vault.vlt"), closedSize + VaultFormat::CHUNK_SIZE);
+    remove_all(m_temp_dir / "test_vault");
+
+    Vault updated(m_temp_dir / "test_vault.vlt");
+    EXPECT_TRUE(updated.verify().empty());
+    updated.open();
+    EXPECT_EQ(read_file("test_vault/file.txt"), "Changed content of file.txt");
+    std::ifstream file((m_temp_dir / "test_vault/file.bin").string(), std::ios::binary);
+    EXPECT_EQ(std::string(std::istreambuf_iterator(file), {}), content);
+}
+#endif
+
+TEST_F(VaultTest, InvalidLoadOpenedVault)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+
+    EXPECT_THROW({vault.load();}, std::invalid_argument) << "The vault is opened";
+}
+
+#if defined(__cpp_lib_chrono) && __cpp_lib_chrono >= 201907L
+TEST_F(VaultTest, CloseOpenKeepLastWriteTime)
+{
+    create_directory(m_temp_dir / "test_vault");
+    write_file("test_vault/file.txt", "Content of file.txt");
+    const auto dir_last_write_time = last_write_time(m_temp_dir / "test_vault");
+    const auto file_last_write_time = last_write_time(m_temp_dir / "test_vault/file.txt");
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    vault.open();
+
+    EXPECT_EQ(last_write_time(m_temp_dir / "test_vault"), dir_last_write_time);
+    EXPECT_EQ(last_write_time(m_temp_dir / "test_vault/file.txt"), file_last_write_time);
+}
+#endif
+
+#if !defined(_WIN32)
+TEST_F(VaultTest, CloseOpenKeepPermissions)
+{
+    const auto vaultPath = m_temp_dir / "test_vault";
+    create_directory(vaultPath);
+    write_file("test_vault/file.txt", "Content of file.txt");
+
+    std::filesystem::permissions(vaultPath, std::filesystem::perms::none | std::filesystem::perms::owner_all);
+    std::filesystem::permissions(vaultPath / "file.txt", std::filesystem::perms::owner_all | std::filesystem::perms::others_exec | std::filesystem::perms::group_read);
+
+    Vault vault(vaultPath);
+    vault.close();
+    vault.open();
+
+    EXPECT_EQ(std::filesystem::status(vaultPath).permissions(), (std::filesystem::perms::none | std::filesystem::perms::owner_all));
+    EXPECT_EQ(std::filesystem::status(vaultPath / "file.txt").permissions(), (std::filesystem::perms::owner_all | std::filesystem::perms::others_exec | std::filesystem::perms::group_read));
+}
+#endif
+
+#ifndef _WIN32
+TEST_F(VaultTest, CloseOpenHardLinks)
+{
+    create_directory(m_temp_dir / "test_vault");
+    create_directory(m_temp_dir / "test_vault/inner");
+    std::string content(VaultFormat::CHUNK_SIZE, '\0');
+    std::ranges::generate(content, [i = 0u]() mutable { return static_cast<char>((i++ * 2654435761u) >> 24); });
+    std::ofstream((m_temp_dir / "test_vault/file.bin").string(), std::ios::binary) << content;
+    create_hard_link(m_temp_dir / "test_vault/file.bin", m_temp_dir / "test_vault/inner/link.bin");
+    create_hard_link(m_temp_dir / "test_vault/file.bin", m_temp_dir / "test_vault/link.bin");
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    EXPECT_LT(file_size(m_temp_dir / "test_vault.vlt"), VaultFormat::CHUNK_SIZE * 2) << "The content is stored once";
+    vault.load();
+    const auto link = dynamic_cast<const File*>(vault.find("inner/link.bin"));
+    ASSERT_NE(link, nullptr);
+    EXPECT_EQ(link->size(), content.size());
+    EXPECT_TRUE(vault.verify().empty());
+    vault.open();
+
+    EXPECT_EQ(hard_link_count(m_temp_dir / "test_vault/file.bin"), 3u);
+    EXPECT_TRUE(equivalent(m_temp_dir / "test_vault/file.bin", m_temp_dir / "test_vault/inner/link.bin"));
+    EXPECT_TRUE(equivalent(m_temp_dir / "test_vault/file.bin", m_temp_dir / "test_vault/link.bin"));
+    std::ifstream file((m_temp_dir / "test_vault/inner/link.bin").string(), std::ios::binary);
+    EXPECT_EQ(std::string(std::istreambuf_iterator(file), {}), content);
+}
+
+TEST_F(VaultTest, OpenOnlyHardLink)
+{
+    create_directory(m_temp_dir / "test_vault");
+    create_directory(m_temp_dir / "test_vault/inner");
+    write_file("test_vault/file.txt", "Content of file.txt");
+    create_hard_link(m_temp_dir / "test_vault/file.txt", m_temp_dir / "test_vault/inner/link.txt");
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+    vault.open(std::nullopt, {"inner/"});
+
+    EXPECT_FALSE(exists("test_vault/file.txt"));
+    EXPECT_EQ(read_file("test_vault/inner/link.txt"), "Content of file.txt");
+}
+
+TEST_F(VaultTest, UpdateHardLinkToRemovedFile)
+{
+    create_directory(m_temp_dir / "test_vault");
+    create_directory(m_temp_dir / "test_vault/inner");
+    write_file("test_vault/file.txt", "Content of file.txt");
+    create_hard_link(m_temp_dir / "test_vault/file.txt", m_temp_dir / "test_vault/inner/link.txt");
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_source_removal(SourceRemoval::KEEP);
+        vault.close();
+    }
+    std::filesystem::remove(m_temp_dir / "test_vault/file.txt");
+
+    // The link to the file removed is stored with its own content.
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    vault.update(m_temp_dir / "test_vault", {"file.txt"});
+    remove_all(m_temp_dir / "test_vault");
+    Vault updated(m_temp_dir / "test_vault.vlt");
+    updated.open();
+
+    EXPECT_FALSE(exists("test_vault/file.txt"));
+    EXPECT_EQ(read_file("test_vault/inner/link.txt"), "Content of file.txt");
+}
+#endif
+
+TEST_F(VaultTest, CloseWithInvalidKdfParameters)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    EXPECT_THROW(vault.close(std::nullopt, std::nullopt, false, true, {1024, 0, 1}), std::invalid_argument);
+    EXPECT_TRUE(exists("test_vault"));
+    EXPECT_FALSE(exists("test_vault.vlt"));
+}
+
+#if !defined(_WIN32)
+TEST_F(VaultTest, CloseOpenEncryptedWithKdfParameters)
+{
+    create_test_vault_directory();
+    type_input("password\npassword\npassword\npassword\n");
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, false, true, {1024, 2, 2});
+
+    {
+        const BlockReader reader(m_temp_dir / "test_vault.vlt");
+        ASSERT_TRUE(reader.header().keySlots.has_value());
+        ASSERT_EQ(reader.header().keySlots->active(), std::vector<size_t>{0});
+        EXPECT_EQ(reader.header().keySlots->slot(0).kdf, (KdfParameters{1024, 2, 2}));
+    }
+
+    vault.open();
+
+    assert_test_vault_existence();
+}
+
+TEST_F(VaultTest, CloseOpenWithEachCipher)
+{
+    type_input("password\npassword\npassword\npassword\npassword\npassword\npassword\npassword\n");
+    for (const auto cipher : EncryptionManager::CIPHERS)
+    {
+        create_test_vault_directory();
+
+        Vault vault(m_temp_dir / "test_vault");
+        vault.close(std::nullopt, std::nullopt, true, true, {1024, 1, 1}, cipher);
+
+        EXPECT_EQ(BlockReader(m_temp_dir / "test_vault.vlt").header().cipher, cipher);
+
+        vault.open();
+
+        assert_test_vault_existence();
+        std::filesystem::remove_all(m_temp_dir / "test_vault");
+    }
+}
+
+TEST_F(VaultTest, CloseOpenWithRecipients)
+{
+    create_test_vault_directory();
+    static_cast<void>(Recipients::generate_identity(m_temp_dir / "first"));
+    static_cast<void>(Recipients::generate_identity(m_temp_dir / "second"));
+    static_cast<void>(Recipients::generate_identity(m_temp_dir / "other"));
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, false, true, KdfParameters(), std::nullopt, {m_temp_dir / "first.pub", m_temp_dir / "second.pub"});
+
+    Vault other(m_temp_dir / "test_vault.vlt");
+    other.set_identity(m_temp_dir / "other");
+    EXPECT_THROW(other.open(), std::runtime_error);
+    EXPECT_THROW(Vault(m_temp_dir / "test_vault.vlt").open(), std::invalid_argument);
+    EXPECT_THROW(Vault(m_temp_dir / "test_vault.vlt").change_password(), std::invalid_argument);
+
+    vault.set_identity(m_temp_dir / "second");
+    vault.open();
+
+    assert_test_vault_existence();
+}
+
+TEST_F(VaultTest, RecipientsNeedEncryption)
+{
+    create_test_vault_directory();
+    static_cast<void>(Recipients::generate_identity(m_temp_dir / "identity"));
+
+    Vault vault(m_temp_dir / "test_vault");
+    EXPECT_THROW(vault.close(std::nullopt, std::nullopt, false, false, KdfParameters(), std::nullopt, {m_temp_dir / "identity.pub"}), std::invalid_argument);
+}
+
+TEST_F(VaultTest, WarmAgentSkipsThePassword)
+{
+    create_test_vault_directory();
+    const auto socket = m_temp_dir / "agent.sock";
+    KeyAgent agent(socket);
+    std::thread thread([&agent] { agent.run(); });
+
+    type_input("password\npassword\n");
+    Vault vault(m_temp_dir / "test_vault");
+    vault.set_use_agent(true);
+    vault.close(std::nullopt, std::nullopt, false, true, {1024, 1, 1});
+    vault.open();
+    vault.close(std::nullopt, std::nullopt, false, true, {1024, 1, 1});
+    vault.open();
+
+    KeyAgent::stop(socket);
+    thread.join();
+    assert_test_vault_existence();
+}
+
+TEST_F(VaultTest, CloseWithoutUseAgentPromptsForThePassword)
+{
+    create_test_vault_directory();
+    const auto socket = m_temp_dir / "agent.sock";
+    KeyAgent agent(socket);
+    std::thread thread([&agent] { agent.run(); });
+
+    // The vault is opened with the cached key, but closed again under the new password prompted, which the agent then caches.
+    type_input("password\npassword\nother\nother\n");
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, false, true, {1024, 1, 1});
+    vault.open();
+    vault.close(std::nullopt, std::nullopt, false, true, {1024, 1, 1});
+    KeyAgent::stop(socket);
+    thread.join();
+
+    type_input("password\npassword\npassword\npassword\npassword\npassword\nother\nother\n");
+    EXPECT_THROW(vault.open(), std::runtime_error);
+    vault.open();
+    assert_test_vault_existence();
+}
+
+TEST_F(VaultTest, ChangePasswordOnlyRewritesKeySlots)
+{
+    create_test_vault_directory();
+    type_input("old\nold\nold\nold\nnew\nnew\nold\nold\nold\nold\nold\nold\nnew\nnew\n");
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, false, true, {1024, 1, 1});
+    const auto before = read_file("test_vault.vlt");
+    vault.change_password();
+    const auto after = read_file("test_vault.vlt");
+
+    ASSERT_EQ(after.size(), before.size());
+    const auto dataOffset = before.find("</header>") + KeySlots::SIZE;
+    EXPECT_EQ(after.substr(dataOffset), before.substr(dataOffset));
+
+    EXPECT_THROW(vault.open(), std::runtime_error);
+    EXPECT_TRUE(exists("test_vault.vlt"));
+    vault.open();
+
+    assert_test_vault_existence();
+}
+
+TEST_F(VaultTest, AddAndRemovePassword)
+{
+    create_test_vault_directory();
+    type_input("first\nfirst\nfirst\nfirst\nsecond\nsecond\nfirst\nfirst\nsecond\nsecond\nsecond\nsecond\n");
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, false, true, {1024, 1, 1});
+    vault.change_password(KeySlotAction::ADD);
+    vault.change_password(KeySlotAction::REMOVE);
+    EXPECT_THROW(vault.change_password(KeySlotAction::REMOVE), std::invalid_argument);
+    vault.open();
+
+    assert_test_vault_existence();
+}
+
+TEST_F(VaultTest, ChangePasswordOfUnencryptedVault)
+{
+    create_test_vault_directory();
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close();
+
+    EXPECT_THROW(vault.change_password(), std::invalid_argument);
+}
+
+TEST_F(VaultTest, RetryAfterWrongPassword)
+{
+    create_test_vault_directory();
+    type_input("password\npassword\nwrong\nwrong\npassword\nmistyped\npassword\npassword\n");
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, false, true, {1024, 1, 1});
+    vault.open();
+
+    assert_test_vault_existence();
+}
+
+TEST_F(VaultTest, TooManyWrongPasswords)
+{
+    create_test_vault_directory();
+    type_input("password\npassword\nwrong\nwrong\nwrong\nwrong\nwrong\nwrong\npassword\npassword\n");
+
+    Vault vault(m_temp_dir / "test_vault");
+    vault.close(std::nullopt, std::nullopt, false, true, {1024, 1, 1});
+
+    EXPECT_THROW(vault.open(), std::runtime_error);
+    EXPECT_TRUE(exists("test_vault.vlt"));
+    EXPECT_FALSE(exists("test_vault"));
+}
+
+TEST_F(VaultTest, ResumeEncryptedClose)
+{
+    create_directory(m_temp_dir / "test_vault");
+    for (const std::string name : {"a.txt", "b.txt", "c.txt"})
+        write_file("test_vault/" + name, "Content of " + name);
+    RemoveLastEntry observer;
+    observer.directory = m_temp_dir / "test_vault";
+    type_input("password\npassword\npassword\npassword\npassword\npassword\n");
+
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_durability(Durability::NONE);
+        vault.set_progress_observer(observer);
+        EXPECT_THROW(vault.close(std::nullopt, std::nullopt, false, true, {1024, 1, 1}), std::ios_base::failure);
+    }
+    // The entries stored are sealed in the journal, their names aren't readable next to the encrypted vault.
+    const auto journal = read_file(".test_vault.vlt.checkpoint");
+    EXPECT_NE(journal.find("<sealed"), std::string::npos);
+    for (const std::string name : {"a.txt", "b.txt", "c.txt"})
+        EXPECT_EQ(journal.find(name), std::string::npos) << name;
+    const auto removed = observer.removed.filename().string();
+    write_file("test_vault/" + removed, "Content of " + removed);
+    // The entries unsealed are taken from the checkpoint while they keep their size and time.
+    for (const auto& entry : std::filesystem::directory_iterator(m_temp_dir / "test_vault"))
+    {
+        const auto name = entry.path().filename().string();
+        if (name == removed)
+            continue;
+        const auto time = entry.last_write_time();
+        write_file("test_vault/" + name, "Changed of " + name);
+        last_write_time(entry.path(), time);
+    }
+
+    // The options of the interrupted close are kept, the key is unlocked from its key slot.
+    Vault vault(m_temp_dir / "test_vault");
+    vault.set_resume(true);
+    EXPECT_THROW(vault.close(), std::invalid_argument);
+    EXPECT_TRUE(exists(".test_vault.vlt.checkpoint"));
+    vault.close(std::nullopt, std::nullopt, false, true, {1024, 1, 1});
+    EXPECT_FALSE(exists(".test_vault.vlt.checkpoint"));
+    vault.open();
+
+    for (const std::string name : {"a.txt", "b.txt", "c.txt"})
+        EXPECT_EQ(read_file("test_vault/" + name), "Content of " + name);
+}
+
+TEST_F(VaultTest, UpdateEncryptedVault)
+{
+    create_test_vault_directory();
+    type_input("password\npassword\npassword\npassword\npassword\npassword\n");
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_source_removal(SourceRemoval::KEEP);
+        vault.close(std::nullopt, std::nullopt, true, true, {1024, 1, 1});
+    }
+    write_file("test_vault/file.txt", "Changed content of file.txt");
+
+    // The key is unlocked once, the entries appended are encrypted and compressed like the others.
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    vault.update(m_temp_dir / "test_vault", {"file.txt"});
+    write_file("test_vault/file2.txt", "Changed content of file2.txt");
+    vault.update(m_temp_dir / "test_vault", {"file2.txt"});
+    EXPECT_EQ(read_file("test_vault.vlt").find("Changed content"), std::string::npos);
+    remove_all(m_temp_dir / "test_vault");
+
+    Vault updated(m_temp_dir / "test_vault.vlt");
+    updated.open();
+    EXPECT_EQ(read_file("test_vault/file.txt"), "Changed content of file.txt");
+    EXPECT_EQ(read_file("test_vault/file2.txt"), "Changed content of file2.txt");
+    EXPECT_EQ(read_file("test_vault/inner/inner/file.txt"), "Content of file.txt");
+}
+
+TEST_F(VaultTest, BatchPromptsOnceForThePassword)
+{
+    std::vector<BatchJob> closing;
+    std::vector<BatchJob> opening;
+    for (const std::string name : {"first", "second", "third"})
+    {
+        create_directory(m_temp_dir / name);
+        write_file(name + "/file.txt", "Content of " + name);
+        BatchJob job;
+        job.action = BatchAction::CLOSE;
+        job.vault = m_temp_dir / name;
+        job.encrypt = name != "third";
+        closing.push_back(job);
+        job.action = BatchAction::OPEN;
+        job.vault = m_temp_dir / (name + ".vlt");
+        opening.push_back(job);
+    }
+    type_input("password\npassword\npassword\npassword\n");
+    VaultManager manager;
+
+    for (const auto& [error, duration] : manager.run_batch(closing, 2, Durability::NONE))
+        EXPECT_FALSE(error.has_value()) << *error;
+    // The vaults closed together share the salt of the password, so its key is derived once.
+    const BlockReader first(m_temp_dir / "first.vlt");
+    const BlockReader second(m_temp_dir / "second.vlt");
+    EXPECT_EQ(first.header().keySlots->slot(0).salt, second.header().keySlots->slot(0).salt);
+    EXPECT_FALSE(BlockReader(m_temp_dir / "third.vlt").header().encrypted);
+
+    for (const auto& [error, duration] : manager.run_batch(opening, 3, Durability::NONE))
+        EXPECT_FALSE(error.has_value()) << *error;
+    for (const std::string name : {"first", "second", "third"})
+        EXPECT_EQ(read_file(name + "/file.txt"), "Content of " + name);
+}
+
+TEST_F(VaultTest, KeyRingDerivesAKeyPerSaltAndParameters)
+{
+    type_input("password\npassword\n");
+    KeyRing keyRing;
+    const auto salt = EncryptionManager::generate_new_salt();
+    const KdfParameters first{8 * 1024, 1, 1};
+    const KdfParameters second{16 * 1024, 1, 1};
+
+    const auto firstKey = keyRing.derive(salt, first);
+    const auto secondKey = keyRing.derive(salt, second);
+
+    EXPECT_NE(firstKey, secondKey) << "The same salt with other parameters derives another key";
+    EXPECT_EQ(secondKey, EncryptionManager::derive_key(keyRing.password(), salt, second));
+    EXPECT_EQ(keyRing.derive(salt, first), firstKey);
+}
+
+TEST_F(VaultTest, BatchReportsTheFailedJobs)
+{
+    create_test_vault_directory();
+    type_input("password\npassword\nwrong\nwrong\n");
+    VaultManager manager;
+    BatchJob close;
+    close.action = BatchAction::CLOSE;
+    close.vault = m_temp_dir / "test_vault";
+    close.encrypt = true;
+    ASSERT_FALSE(manager.run_batch({close}, 1, Durability::NONE)[0].error.has_value());
+    BatchJob open;
+    open.vault = m_temp_dir / "test_vault.vlt";
+    BatchJob missing;
+    missing.vault = m_temp_dir / "missing.vlt";
+
+    const auto results = manager.run_batch({open, missing}, 2, Durability::NONE);
+
+    ASSERT_EQ(results.size(), 2u);
+    EXPECT_TRUE(results[0].error.has_value());
+    EXPECT_TRUE(results[1].error.has_value());
+    EXPECT_TRUE(exists("test_vault.vlt"));
+    EXPECT_FALSE(exists("test_vault"));
+}
+
+#if defined(__cpp_lib_chrono) && __cpp_lib_chrono >= 201907L
+TEST_F(VaultTest, OpenResumesAfterTheEntriesExtracted)
+{
+    create_directory(m_temp_dir / "test_vault");
+    for (const std::string name : {"a.txt", "b.txt", "c.txt", "d.txt"})
+        write_file("test_vault/" + name, "Content of " + name);
+    // The last entry, extracted after the others, is made too large to be written.
+    std::string large;
+    for (const auto& entry : std::filesystem::directory_iterator(m_temp_dir / "test_vault"))
+        large = entry.path().filename().string();
+    const std::string content(4 * 1024 * 1024, 'x');
+    write_file("test_vault/" + large, content);
+    {
+        Vault vault(m_temp_dir / "test_vault");
+        vault.set_durability(Durability::NONE);
+        vault.close();
+    }
+
+    // The large file can't be written past the limit, the others are extracted and committed before it fails.
+    rlimit limit{};
+    ASSERT_EQ(getrlimit(RLIMIT_FSIZE, &limit), 0);
+    auto lowered = limit;
+    lowered.rlim_cur = 1024 * 1024;
+    const auto handler = std::signal(SIGXFSZ, SIG_IGN);
+    ASSERT_EQ(setrlimit(RLIMIT_FSIZE, &lowered), 0);
+    {
+        Vault vault(m_temp_dir / "test_vault.vlt");
+        vault.set_durability(Durability::NONE);
+        EXPECT_THROW(vault.open(), std::ios_base::failure);
+    }
+    setrlimit(RLIMIT_FSIZE, &limit);
+    std::signal(SIGXFSZ, handler);
+    EXPECT_TRUE(exists(".test_vault.partial"));
+    EXPECT_TRUE(exists(".test_vault.checkpoint"));
+    EXPECT_FALSE(exists("test_vault"));
+    EXPECT_TRUE(exists("test_vault.vlt"));
+
+    // The entries extracted are kept as they are, so a change to them shows they aren't extracted again.
+    for (const std::string name : {"a.txt", "b.txt", "c.txt", "d.txt"})
+    {
+        if (name != large)
+            write_file(".test_vault.partial/test_vault/" + name, "Changed of " + name);
+    }
+
+    Vault vault(m_temp_dir / "test_vault.vlt");
+    vault.set_durability(Durability::NONE);
+    vault.set_resume(true);
+    vault.open();
+    EXPECT_FALSE(exists(".test_vault.partial"));
+    EXPECT_FALSE(exists(".test_vault.checkpoint"));
+    EXPECT_FALSE(exists("test_vault.vlt"));
+
+    for (const std::string name : {"a.txt", "b.txt", "c.txt", "d.txt"})
+        EXPECT_EQ(read_file("test_vault/" + name), name == large ? content : "Changed of " + name);
+}
+#endif
 #endif